@@ -0,0 +1,31 @@
+#ifndef __config_h
+#define __config_h
+/* config.h -- automatically generated, do not edit */
+
+#ifndef CAT_HAS_INTPTR_T
+#define CAT_HAS_INTPTR_T 1
+#endif /* CAT_HAS_INTPTR_T */
+#ifndef CAT_HAS_UINTPTR_T
+#define CAT_HAS_UINTPTR_T 1
+#endif /* CAT_HAS_UINTPTR_T */
+#ifndef CAT_S32_T
+#define CAT_S32_T int
+#endif /* CAT_S32_T */
+#ifndef CAT_U32_T
+#define CAT_U32_T unsigned int
+#endif /* CAT_U32_T */
+#if !CAT_ANSI89
+#ifndef CAT_HAS_LONGLONG
+#define CAT_HAS_LONGLONG 1
+#endif /* CAT_HAS_LONGLONG */
+#endif /* !CAT_ANSI89 */
+#ifndef CAT_64BIT
+#define CAT_64BIT 1
+#endif /* CAT_64BIT */
+#ifndef CAT_S64_T
+#define CAT_S64_T long
+#endif /* CAT_S64_T */
+#ifndef CAT_U64_T
+#define CAT_U64_T unsigned long
+#endif /* CAT_U64_T */
+#endif /* __config_h */
@@ -13,6 +13,16 @@
 #include <cat/cat.h>
 #include <cat/aux.h>
 
+/*
+ * When CAT_AVL_RANK is non-zero every node tracks the size of its subtree
+ * so avl_select() and avl_rank() run in O(log n).  This changes the layout
+ * of 'struct anode' so the library and all code sharing trees with it must
+ * be built with the same setting.  Trees without it pay nothing.
+ */
+#ifndef CAT_AVL_RANK
+#define CAT_AVL_RANK 0
+#endif /* CAT_AVL_RANK */
+
 /* Structure for an AVL-tree node: to be embedded in other structures */
 struct anode {
 	struct anode *	p[3];
@@ -20,6 +30,9 @@ struct anode {
 	uchar	        pdir;	/* on the parent's left or right ? */
 	struct avltree *tree;   /* tree that owns this node */
 	void *		key;    /* the node's key */
+#if CAT_AVL_RANK
+	ulong		cnt;	/* number of nodes in this subtree */
+#endif /* CAT_AVL_RANK */
 };
 
 #define CA_L 0	/* left node */
@@ -83,7 +96,8 @@ DECL struct anode * avl_lkup(struct avltree *t, const void *key, int *dir);
 /*
  * Insert a new node 'n' into an AVL tree 't' with 'loc' as the parent, and 
  * dir indicating which pointer in 'loc' will point to 'n'.  See avl_lkup()
- * for how to find the correct 'loc' and 'dir' values.
+ * for how to find the correct 'loc' and 'dir' values.  If 'dir' is CA_N
+ * then 'n' replaces 'loc' which gets returned.
  */
 DECL struct anode * avl_ins(struct avltree *t, struct anode *n,
 			    struct anode *loc, int dir);
@@ -106,6 +120,83 @@ DECL struct anode * avl_getmin(struct avltree *t);
 /* Return a pointer to the maximum node in 't' or NULL if the tree is empty */
 DECL struct anode * avl_getmax(struct avltree *t);
 
+/*
+ * Return the node after or before 'n' in key order or NULL if there is
+ * none.  Walking a whole tree this way costs O(1) amortized per node.
+ */
+DECL struct anode * avl_next(struct anode *n);
+DECL struct anode * avl_prev(struct anode *n);
+
+/* Return the first node in 't' whose key is >= 'key' or NULL if none is */
+DECL struct anode * avl_lbound(struct avltree *t, const void *key);
+
+/* Return the first node in 't' whose key is > 'key' or NULL if none is */
+DECL struct anode * avl_ubound(struct avltree *t, const void *key);
+
+/*
+ * Build 't' from the 'n' nodes in 'nodes' in O(n) time.  'nodes' must be
+ * sorted in strictly increasing key order, their keys must be set and 't'
+ * must be empty.  The resulting tree is perfectly balanced.
+ */
+DECL void avl_build(struct avltree *t, struct anode **nodes, ulong n);
+
+/*
+ * Store the nodes of 't' in key order in 'nodes' and return how many
+ * nodes the tree holds.  If that is no more than 'max' the nodes are also
+ * removed from 't' leaving it empty.  Otherwise 't' is unchanged and only
+ * the first 'max' nodes are stored.
+ */
+DECL ulong avl_flatten(struct avltree *t, struct anode **nodes, ulong max);
+
+/*
+ * Join based operations.  All trees involved must order keys with the
+ * same 'cmp'.  The restructuring takes O(log n) time but every node that
+ * ends up in a different tree also gets its 'tree' pointer updated at a
+ * cost of O(1) per node moved.
+ */
+
+/*
+ * Move every node of 't' with a key greater than 'key' into the empty
+ * tree 'gt'.  Returns the node whose key matches 'key' after removing it
+ * from 't' or NULL if there is none.
+ */
+DECL struct anode * avl_split(struct avltree *t, const void *key,
+			      struct avltree *gt);
+
+/*
+ * Join 't1', the node 'k' (which must not be in a tree) and 't2' into
+ * 't1' leaving 't2' empty.  Every key in 't1' must be less than k's key
+ * and every key in 't2' greater.
+ */
+DECL void avl_join(struct avltree *t1, struct anode *k, struct avltree *t2);
+
+/*
+ * Set operations taking O(m log(n/m + 1)) comparisons for trees of m and
+ * n >= m nodes.  avl_union() moves the nodes of 't2' into 't1' except for
+ * those whose key is already in 't1':  it removes those and passes them
+ * to 'func' leaving 't2' empty.  avl_inter() keeps only the nodes of 't1'
+ * whose key is also in 't2' and avl_diff() only the nodes whose key is
+ * not.  Both pass the nodes they remove from 't1' to 'func' and leave
+ * 't2' unchanged.  'func' may be NULL.
+ */
+DECL void avl_union(struct avltree *t1, struct avltree *t2, apply_f func,
+		    void *ctx);
+DECL void avl_inter(struct avltree *t1, struct avltree *t2, apply_f func,
+		    void *ctx);
+DECL void avl_diff(struct avltree *t1, struct avltree *t2, apply_f func,
+		   void *ctx);
+
+#if CAT_AVL_RANK
+/* Return the number of nodes in 't' */
+DECL ulong avl_count(struct avltree *t);
+
+/* Return the node with in-order index 'k' (from 0) or NULL if k >= count */
+DECL struct anode * avl_select(struct avltree *t, ulong k);
+
+/* Return the number of nodes in 't' whose keys are less than 'key' */
+DECL ulong avl_rank(struct avltree *t, const void *key);
+#endif /* CAT_AVL_RANK */
+
 
 /* ----- Auxiliary (helper) functions (don't use) ----- */
 DECL void avl_fix(struct anode *p, struct anode *c, int dir);
@@ -118,6 +209,24 @@ DECL void avl_rright(struct anode *n1, struct anode *n2, int ins);
 DECL void avl_zleft(struct anode *n1, struct anode *n2, struct anode *n3);
 DECL void avl_zright(struct anode *n1, struct anode *n2, struct anode *n3);
 DECL struct anode *avl_findrep(struct anode *node);
+DECL int avl_height(struct avltree *t);
+DECL int avl_join_h(struct avltree *t1, int h1, struct anode *k,
+		    struct avltree *t2, int h2);
+DECL struct anode *avl_split_h(struct avltree *t, int h, const void *key,
+			       struct avltree *gt, int *lh, int *gh);
+DECL void avl_concat(struct avltree *t1, struct avltree *t2);
+DECL void avl_setown(struct avltree *t, struct avltree *own);
+DECL void avl_drain(struct avltree *t, apply_f func, void *ctx);
+DECL void avl_union_r(struct avltree *t1, struct avltree *t2,
+		      struct avltree *own, apply_f func, void *ctx);
+DECL void avl_inter_r(struct avltree *t1, struct anode *n2, apply_f func,
+		      void *ctx);
+DECL void avl_diff_r(struct avltree *t1, struct anode *n2, apply_f func,
+		     void *ctx);
+#if CAT_AVL_RANK
+DECL void avl_recnt(struct anode *n);
+DECL void avl_recnt_up(struct anode *n, int dir);
+#endif /* CAT_AVL_RANK */
 
 
 /* ----- Implementation ----- */
@@ -140,6 +249,9 @@ DECL void avl_ninit(struct anode *n, void *k)
 	n->pdir = CA_P;
 	n->b = 0;
 	n->key = k;
+#if CAT_AVL_RANK
+	n->cnt = 1;
+#endif /* CAT_AVL_RANK */
 }
 
 
@@ -178,7 +290,7 @@ DECL struct anode *avl_ins(struct avltree *t, struct anode *node,
 	if ( loc ) {
 		p = loc;
 		dir = atdir;
-		abort_unless((dir == CA_L) || (dir == CA_R) || 
+		abort_unless((dir == CA_L) || (dir == CA_R) || (dir == CA_N) ||
 			     ((dir == CA_P) && (p == &t->root)));
 	} else {
 		avl_findloc(t, key, &p, &dir);
@@ -188,6 +300,10 @@ DECL struct anode *avl_ins(struct avltree *t, struct anode *node,
 		avl_fix(node, p->p[CA_L], CA_L);
 		avl_fix(node, p->p[CA_R], CA_R);
 		avl_fix(p->p[CA_P], node, p->pdir);
+		node->b = p->b;
+#if CAT_AVL_RANK
+		node->cnt = p->cnt;
+#endif /* CAT_AVL_RANK */
 		node->tree = t;
 		p->tree = NULL;
 		avl_ninit(p, p->key);
@@ -240,6 +356,623 @@ DECL struct anode * avl_getmax(struct avltree *t)
 }
 
 
+DECL struct anode * avl_next(struct anode *n)
+{
+	abort_unless(n);
+	if ( n->p[CA_R] != NULL ) {
+		n = n->p[CA_R];
+		while ( n->p[CA_L] != NULL )
+			n = n->p[CA_L];
+		return n;
+	}
+	while ( n->pdir == CA_R )
+		n = n->p[CA_P];
+	return (n->pdir == CA_P) ? NULL : n->p[CA_P];
+}
+
+
+DECL struct anode * avl_prev(struct anode *n)
+{
+	abort_unless(n);
+	if ( n->p[CA_L] != NULL ) {
+		n = n->p[CA_L];
+		while ( n->p[CA_R] != NULL )
+			n = n->p[CA_R];
+		return n;
+	}
+	while ( n->pdir == CA_L )
+		n = n->p[CA_P];
+	return (n->pdir == CA_P) ? NULL : n->p[CA_P];
+}
+
+
+DECL struct anode * avl_lbound(struct avltree *t, const void *key)
+{
+	struct anode *node, *best = NULL;
+	int rv;
+
+	abort_unless(t);
+	node = t->avl_root;
+	while ( node != NULL ) {
+		rv = (*t->cmp)(key, node->key);
+		if ( rv <= 0 ) {
+			best = node;
+			if ( rv == 0 )
+				break;
+			node = node->p[CA_L];
+		} else {
+			node = node->p[CA_R];
+		}
+	}
+	return best;
+}
+
+
+DECL struct anode * avl_ubound(struct avltree *t, const void *key)
+{
+	struct anode *node, *best = NULL;
+
+	abort_unless(t);
+	node = t->avl_root;
+	while ( node != NULL ) {
+		if ( (*t->cmp)(key, node->key) < 0 ) {
+			best = node;
+			node = node->p[CA_L];
+		} else {
+			node = node->p[CA_R];
+		}
+	}
+	return best;
+}
+
+
+#if CAT_AVL_RANK
+
+#define AVL_CNT(n)	((n) != NULL ? (n)->cnt : 0)
+
+DECL ulong avl_count(struct avltree *t)
+{
+	abort_unless(t);
+	return AVL_CNT(t->avl_root);
+}
+
+
+DECL struct anode *avl_select(struct avltree *t, ulong k)
+{
+	struct anode *trav;
+	ulong lcnt;
+
+	abort_unless(t);
+	trav = t->avl_root;
+	while ( trav != NULL ) {
+		lcnt = AVL_CNT(trav->p[CA_L]);
+		if ( k < lcnt ) {
+			trav = trav->p[CA_L];
+		} else if ( k == lcnt ) {
+			return trav;
+		} else {
+			k -= lcnt + 1;
+			trav = trav->p[CA_R];
+		}
+	}
+	return NULL;
+}
+
+
+DECL ulong avl_rank(struct avltree *t, const void *key)
+{
+	struct anode *trav;
+	ulong rank = 0;
+	int rv;
+
+	abort_unless(t);
+	trav = t->avl_root;
+	while ( trav != NULL ) {
+		rv = (*t->cmp)(key, trav->key);
+		if ( rv < 0 ) {
+			trav = trav->p[CA_L];
+		} else if ( rv == 0 ) {
+			return rank + AVL_CNT(trav->p[CA_L]);
+		} else {
+			rank += AVL_CNT(trav->p[CA_L]) + 1;
+			trav = trav->p[CA_R];
+		}
+	}
+	return rank;
+}
+
+
+DECL void avl_recnt(struct anode *n)
+{
+	n->cnt = 1 + AVL_CNT(n->p[CA_L]) + AVL_CNT(n->p[CA_R]);
+}
+
+
+/* Recount 'n' and its ancestors.  'dir' == CA_P means 'n' is the tree root */
+/* sentinel and there is nothing to count. */
+DECL void avl_recnt_up(struct anode *n, int dir)
+{
+	while ( dir != CA_P ) {
+		avl_recnt(n);
+		dir = n->pdir;
+		n = n->p[CA_P];
+	}
+}
+
+#undef AVL_CNT
+
+#endif /* CAT_AVL_RANK */
+
+
+DECL void avl_build(struct avltree *t, struct anode **nodes, ulong n)
+{
+	struct {
+		ulong		lo;
+		ulong		len;
+		struct anode *	par;
+		int		dir;
+	} stk[sizeof(ulong) * 8 + 1];
+	struct anode *node, *par;
+	ulong lo, len, l, r;
+	int top, dir;
+
+	abort_unless(t);
+	abort_unless(t->avl_root == NULL);
+	abort_unless(nodes || n == 0);
+	if ( n == 0 )
+		return;
+
+	stk[0].lo = 0;
+	stk[0].len = n;
+	stk[0].par = &t->root;
+	stk[0].dir = CA_P;
+	top = 1;
+	while ( top > 0 ) {
+		--top;
+		lo = stk[top].lo;
+		len = stk[top].len;
+		par = stk[top].par;
+		dir = stk[top].dir;
+		/* the right subtree gets the extra node when 'len' is even */
+		l = (len - 1) / 2;
+		r = len - 1 - l;
+		node = nodes[lo + l];
+		avl_ninit(node, node->key);
+		node->tree = t;
+		/* heights differ only when 'r' reaches a new power of 2 */
+		node->b = (r != l) && ((r & (r - 1)) == 0);
+#if CAT_AVL_RANK
+		node->cnt = len;
+#endif /* CAT_AVL_RANK */
+		avl_fix(par, node, dir);
+		if ( r > 0 ) {
+			stk[top].lo = lo + l + 1;
+			stk[top].len = r;
+			stk[top].par = node;
+			stk[top].dir = CA_R;
+			++top;
+		}
+		if ( l > 0 ) {
+			stk[top].lo = lo;
+			stk[top].len = l;
+			stk[top].par = node;
+			stk[top].dir = CA_L;
+			++top;
+		}
+	}
+}
+
+
+DECL ulong avl_flatten(struct avltree *t, struct anode **nodes, ulong max)
+{
+	struct anode *trav;
+	ulong n = 0, i;
+
+	abort_unless(t);
+	abort_unless(nodes || max == 0);
+	for ( trav = avl_getmin(t); trav != NULL; trav = avl_next(trav) ) {
+		if ( n < max )
+			nodes[n] = trav;
+		++n;
+	}
+
+	if ( n <= max ) {
+		for ( i = 0; i < n; ++i ) {
+			avl_ninit(nodes[i], nodes[i]->key);
+			nodes[i]->tree = NULL;
+		}
+		t->avl_root = NULL;
+	}
+	return n;
+}
+
+
+/* AVL trees are at most 1.45 * log2(n) deep */
+#define AVL_MAXDEPTH	(sizeof(ulong) * 12)
+
+DECL struct anode *avl_split(struct avltree *t, const void *key,
+			     struct avltree *gt)
+{
+	struct anode *n;
+	int lh, gh;
+
+	abort_unless(t);
+	abort_unless(gt);
+	abort_unless(gt->avl_root == NULL);
+	n = avl_split_h(t, avl_height(t), key, gt, &lh, &gh);
+	avl_setown(gt, gt);
+	if ( n != NULL )
+		n->tree = NULL;
+	return n;
+}
+
+
+DECL void avl_join(struct avltree *t1, struct anode *k, struct avltree *t2)
+{
+	abort_unless(t1);
+	abort_unless(k);
+	abort_unless(t2);
+	avl_setown(t2, t1);
+	k->tree = t1;
+	avl_join_h(t1, avl_height(t1), k, t2, avl_height(t2));
+}
+
+
+DECL void avl_union(struct avltree *t1, struct avltree *t2, apply_f func,
+		    void *ctx)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	avl_union_r(t1, t2, t1, func, ctx);
+}
+
+
+DECL void avl_inter(struct avltree *t1, struct avltree *t2, apply_f func,
+		    void *ctx)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	avl_inter_r(t1, t2->avl_root, func, ctx);
+}
+
+
+DECL void avl_diff(struct avltree *t1, struct avltree *t2, apply_f func,
+		   void *ctx)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	avl_diff_r(t1, t2->avl_root, func, ctx);
+}
+
+
+/* the height of a tree is the length of the path down its taller sides */
+DECL int avl_height(struct avltree *t)
+{
+	struct anode *n;
+	int h = 0;
+
+	for ( n = t->avl_root; n != NULL; n = n->p[(n->b < 0) ? CA_L : CA_R] )
+		++h;
+	return h;
+}
+
+
+/*
+ * Join 't1' (of height 'h1'), 'k' and 't2' (of height 'h2') into 't1' and
+ * return the height of the result.  Neither tree's nodes get their owner
+ * changed.  'k' goes down the facing side of the taller tree to the first
+ * subtree no more than one level taller than the shorter tree and takes
+ * its place with that subtree and the shorter tree as children.  That
+ * grows the subtree by one level which gets rebalanced like an insert
+ * except that 'k' may be left balanced so a single rotation might not
+ * stop the height change.
+ */
+DECL int avl_join_h(struct avltree *t1, int h1, struct anode *k,
+		    struct avltree *t2, int h2)
+{
+	struct anode *par, *c, *n, *tmp;
+	int dir, h, hc;
+
+	abort_unless(t1);
+	abort_unless(k);
+	abort_unless(t2);
+
+	if ( h1 > h2 + 1 ) {
+		h = h1;
+		c = t1->avl_root;
+		hc = h1;
+		do {
+			par = c;
+			hc -= (c->b < 0) ? 2 : 1;
+			c = c->p[CA_R];
+		} while ( hc > h2 + 1 );
+		avl_fix(k, c, CA_L);
+		avl_fix(k, t2->avl_root, CA_R);
+		k->b = h2 - hc;
+		avl_fix(par, k, CA_R);
+		t2->avl_root = NULL;
+	} else if ( h2 > h1 + 1 ) {
+		h = h2;
+		c = t2->avl_root;
+		hc = h2;
+		do {
+			par = c;
+			hc -= (c->b > 0) ? 2 : 1;
+			c = c->p[CA_L];
+		} while ( hc > h1 + 1 );
+		avl_fix(k, t1->avl_root, CA_L);
+		avl_fix(k, c, CA_R);
+		k->b = hc - h1;
+		avl_fix(par, k, CA_L);
+		avl_fix(&t1->root, t2->avl_root, CA_P);
+		t2->avl_root = NULL;
+	} else {
+		avl_fix(k, t1->avl_root, CA_L);
+		avl_fix(k, t2->avl_root, CA_R);
+		k->b = h2 - h1;
+		avl_fix(&t1->root, k, CA_P);
+		t2->avl_root = NULL;
+#if CAT_AVL_RANK
+		avl_recnt(k);
+#endif /* CAT_AVL_RANK */
+		return ((h1 > h2) ? h1 : h2) + 1;
+	}
+#if CAT_AVL_RANK
+	avl_recnt(k);
+	avl_recnt_up(par, k->pdir);
+#endif /* CAT_AVL_RANK */
+
+	n = k;
+	while ( (dir = n->pdir) != CA_P ) {
+		n = n->p[CA_P];
+		if ( (n->b += (dir - 1)) == 0 )
+			return h;
+		if ( n->b < -1 ) {
+			tmp = n->p[CA_L];
+			if ( tmp->b > 0 ) {
+				avl_zright(n, tmp, tmp->p[CA_R]);
+				return h;
+			}
+			avl_rright(n, tmp, 0);
+			if ( tmp->b == 0 )
+				return h;
+			n = tmp;
+		} else if ( n->b > 1 ) {
+			tmp = n->p[CA_R];
+			if ( tmp->b < 0 ) {
+				avl_zleft(n, tmp, tmp->p[CA_L]);
+				return h;
+			}
+			avl_rleft(n, tmp, 0);
+			if ( tmp->b == 0 )
+				return h;
+			n = tmp;
+		}
+	}
+	return h + 1;
+}
+
+
+/*
+ * Split 't' of height 'h' at 'key' leaving the lesser keys in 't' and
+ * putting the greater ones in the empty tree 'gt'.  Their heights get
+ * stored in 'lh' and 'gh'.  The subtrees hanging off of the search path
+ * get joined bottom up with the path nodes as the join keys so the costs
+ * of the joins telescope to O(log n).  Owners do not change.
+ */
+DECL struct anode *avl_split_h(struct avltree *t, int h, const void *key,
+			       struct avltree *gt, int *lh, int *gh)
+{
+	struct {
+		struct anode *	n;
+		int		h;
+		int		dir;
+	} path[AVL_MAXDEPTH];
+	struct anode *n, *found = NULL;
+	struct avltree tmp;
+	int top = 0, rv, hl, hr;
+
+	abort_unless(t);
+	abort_unless(gt);
+	abort_unless(gt->avl_root == NULL);
+	abort_unless(lh);
+	abort_unless(gh);
+
+	n = t->avl_root;
+	while ( n != NULL ) {
+		rv = (*t->cmp)(key, n->key);
+		if ( rv == 0 ) {
+			found = n;
+			break;
+		}
+		abort_unless(top < AVL_MAXDEPTH);
+		path[top].n = n;
+		path[top].h = h;
+		if ( rv < 0 ) {
+			path[top].dir = CA_L;
+			h -= 1 + (n->b > 0);
+			n = n->p[CA_L];
+		} else {
+			path[top].dir = CA_R;
+			h -= 1 + (n->b < 0);
+			n = n->p[CA_R];
+		}
+		++top;
+	}
+
+	t->avl_root = NULL;
+	*lh = *gh = 0;
+	if ( found != NULL ) {
+		*lh = h - 1 - (found->b > 0);
+		*gh = h - 1 - (found->b < 0);
+		avl_fix(&t->root, found->p[CA_L], CA_P);
+		avl_fix(&gt->root, found->p[CA_R], CA_P);
+		avl_ninit(found, found->key);
+	}
+
+	avl_init(&tmp, t->cmp);
+	while ( top > 0 ) {
+		--top;
+		n = path[top].n;
+		h = path[top].h;
+		hl = h - 1 - (n->b > 0);
+		hr = h - 1 - (n->b < 0);
+		if ( path[top].dir == CA_L ) {
+			avl_fix(&tmp.root, n->p[CA_R], CA_P);
+			*gh = avl_join_h(gt, *gh, n, &tmp, hr);
+		} else {
+			avl_fix(&tmp.root, n->p[CA_L], CA_P);
+			*lh = avl_join_h(&tmp, hl, n, t, *lh);
+			avl_fix(&t->root, tmp.avl_root, CA_P);
+			tmp.avl_root = NULL;
+		}
+	}
+
+	return found;
+}
+
+
+/* Join 't1' and 't2' where all keys in 't1' are less than those in 't2' */
+DECL void avl_concat(struct avltree *t1, struct avltree *t2)
+{
+	struct avltree rest;
+	struct anode *k;
+	int lh, gh;
+
+	if ( t2->avl_root == NULL )
+		return;
+	avl_init(&rest, t2->cmp);
+	k = avl_getmin(t2);
+	k = avl_split_h(t2, avl_height(t2), k->key, &rest, &lh, &gh);
+	avl_join_h(t1, avl_height(t1), k, &rest, gh);
+}
+
+
+DECL void avl_setown(struct avltree *t, struct avltree *own)
+{
+	struct anode *n;
+
+	for ( n = avl_getmin(t); n != NULL; n = avl_next(n) )
+		n->tree = own;
+}
+
+
+/* Empty 't' passing each of its nodes to 'func' once it is detached */
+DECL void avl_drain(struct avltree *t, apply_f func, void *ctx)
+{
+	struct anode *n, *par;
+	int dir;
+
+	n = t->avl_root;
+	while ( n != NULL ) {
+		if ( n->p[CA_L] != NULL ) {
+			n = n->p[CA_L];
+		} else if ( n->p[CA_R] != NULL ) {
+			n = n->p[CA_R];
+		} else {
+			par = n->p[CA_P];
+			dir = n->pdir;
+			avl_ninit(n, n->key);
+			n->tree = NULL;
+			if ( func != NULL )
+				func(n, ctx);
+			par->p[dir] = NULL;
+			n = (dir == CA_P) ? NULL : par;
+		}
+	}
+}
+
+
+/* 't1' = 't1' U 't2' where nodes moving into the union get 'own' as owner */
+DECL void avl_union_r(struct avltree *t1, struct avltree *t2,
+		      struct avltree *own, apply_f func, void *ctx)
+{
+	struct avltree l2, r1;
+	struct anode *k, *b;
+	int lh, gh;
+
+	k = t2->avl_root;
+	if ( k == NULL )
+		return;
+	if ( t1->avl_root == NULL ) {
+		avl_setown(t2, own);
+		avl_fix(&t1->root, k, CA_P);
+		t2->avl_root = NULL;
+		return;
+	}
+
+	avl_init(&l2, t2->cmp);
+	avl_init(&r1, t1->cmp);
+	avl_fix(&l2.root, k->p[CA_L], CA_P);
+	avl_fix(&t2->root, k->p[CA_R], CA_P);
+	b = avl_split_h(t1, avl_height(t1), k->key, &r1, &lh, &gh);
+	avl_union_r(t1, &l2, own, func, ctx);
+	avl_union_r(&r1, t2, own, func, ctx);
+	if ( b != NULL ) {
+		avl_join_h(t1, avl_height(t1), b, &r1, avl_height(&r1));
+		avl_ninit(k, k->key);
+		k->tree = NULL;
+		if ( func != NULL )
+			func(k, ctx);
+	} else {
+		k->tree = own;
+		avl_join_h(t1, avl_height(t1), k, &r1, avl_height(&r1));
+	}
+}
+
+
+/* 't1' = 't1' ^ the keys in the subtree rooted at 'n2' */
+DECL void avl_inter_r(struct avltree *t1, struct anode *n2, apply_f func,
+		      void *ctx)
+{
+	struct avltree r1;
+	struct anode *b;
+	int lh, gh;
+
+	if ( t1->avl_root == NULL )
+		return;
+	if ( n2 == NULL ) {
+		avl_drain(t1, func, ctx);
+		return;
+	}
+
+	avl_init(&r1, t1->cmp);
+	b = avl_split_h(t1, avl_height(t1), n2->key, &r1, &lh, &gh);
+	avl_inter_r(t1, n2->p[CA_L], func, ctx);
+	avl_inter_r(&r1, n2->p[CA_R], func, ctx);
+	if ( b != NULL )
+		avl_join_h(t1, avl_height(t1), b, &r1, avl_height(&r1));
+	else
+		avl_concat(t1, &r1);
+}
+
+
+/* 't1' = 't1' - the keys in the subtree rooted at 'n2' */
+DECL void avl_diff_r(struct avltree *t1, struct anode *n2, apply_f func,
+		     void *ctx)
+{
+	struct avltree r1;
+	struct anode *b;
+	int lh, gh;
+
+	if ( t1->avl_root == NULL || n2 == NULL )
+		return;
+
+	avl_init(&r1, t1->cmp);
+	b = avl_split_h(t1, avl_height(t1), n2->key, &r1, &lh, &gh);
+	avl_diff_r(t1, n2->p[CA_L], func, ctx);
+	avl_diff_r(&r1, n2->p[CA_R], func, ctx);
+	avl_concat(t1, &r1);
+	if ( b != NULL ) {
+		b->tree = NULL;
+		if ( func != NULL )
+			func(b, ctx);
+	}
+}
+
+#undef AVL_MAXDEPTH
+
+
 /* currently an inorder traversal:  we could add an arg to change this */
 DECL void avl_apply(struct avltree *t, apply_f func, void * ctx)
 {
@@ -326,6 +1059,10 @@ DECL void avl_ins_at(struct avltree *t, struct anode *node, struct anode *par,
 	abort_unless(par);
 	abort_unless(dir >= CA_L && dir <= CA_R);
 	avl_fix(par, node, dir);
+#if CAT_AVL_RANK
+	node->cnt = 1;
+	avl_recnt_up(par, dir);
+#endif /* CAT_AVL_RANK */
 
 	while ( (dir = node->pdir) != CA_P ) {
 		node = node->p[CA_P];
@@ -408,6 +1145,11 @@ DECL void avl_rem(struct anode *node)
 	node->tree = NULL;
 	node->pdir = CA_P;
 	node->b = 0;
+#if CAT_AVL_RANK
+	node->cnt = 1;
+	/* rotations below preserve subtree sizes above the rotated nodes */
+	avl_recnt_up(trav, dir);
+#endif /* CAT_AVL_RANK */
 
 	/* now traverse up the tree */
 	while ( dir != CA_P ) {
@@ -464,6 +1206,10 @@ DECL void avl_rleft(struct anode *n1, struct anode *n2, int ins)
 	avl_fix(n1, n2->p[CA_L], CA_R);
 	avl_fix(n1->p[CA_P], n2, n1->pdir);
 	avl_fix(n2, n1, CA_L);
+#if CAT_AVL_RANK
+	avl_recnt(n1);
+	avl_recnt(n2);
+#endif /* CAT_AVL_RANK */
 
 	if ( ins || (n2->b > 0) ) {
 		n1->b = 0;
@@ -482,6 +1228,10 @@ DECL void avl_rright(struct anode *n1, struct anode *n2, int ins)
 	avl_fix(n1, n2->p[CA_R], CA_L);
 	avl_fix(n1->p[CA_P], n2, n1->pdir);
 	avl_fix(n2, n1, CA_R);
+#if CAT_AVL_RANK
+	avl_recnt(n1);
+	avl_recnt(n2);
+#endif /* CAT_AVL_RANK */
 
 	if ( ins || (n2->b < 0) ) {
 		n1->b = 0;
@@ -503,6 +1253,11 @@ DECL void avl_zleft(struct anode *n1, struct anode *n2, struct anode *n3)
 	avl_fix(n1->p[CA_P], n3, n1->pdir);
 	avl_fix(n3, n1, CA_L);
 	avl_fix(n3, n2, CA_R);
+#if CAT_AVL_RANK
+	avl_recnt(n1);
+	avl_recnt(n2);
+	avl_recnt(n3);
+#endif /* CAT_AVL_RANK */
 
 	switch ( n3->b ) {
 	case -1:
@@ -535,6 +1290,11 @@ DECL void avl_zright(struct anode *n1, struct anode *n2, struct anode *n3)
 	avl_fix(n1->p[CA_P], n3, n1->pdir);
 	avl_fix(n3, n1, CA_R);
 	avl_fix(n3, n2, CA_L);
+#if CAT_AVL_RANK
+	avl_recnt(n1);
+	avl_recnt(n2);
+	avl_recnt(n3);
+#endif /* CAT_AVL_RANK */
 
 	switch ( n3->b ) {
 	case -1:
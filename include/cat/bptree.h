@@ -0,0 +1,119 @@
+/*
+ * cat/bptree.h -- B+tree ordered map
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_bptree_h
+#define __cat_bptree_h
+
+#include <cat/cat.h>
+#include <cat/mem.h>
+
+/*
+ * A B+tree maps keys to data pointers.  Each node holds up to
+ * BPT_MAXKEYS keys in one contiguous array so a lookup touches a handful
+ * of cache lines per level instead of one node per key compared.  All
+ * entries live in the leaves which are linked in key order for fast
+ * scans.  Keys are compared with the same 'cmp_f' as the binary trees and
+ * the tree stores only the key and data pointers:  the caller owns the
+ * memory they refer to, so an entry can point back at the structure it
+ * indexes.  Tree nodes are allocated through a memory manager.
+ */
+
+/* Keys per node:  the default makes a node about 512 bytes with 64-bit */
+/* pointers.  Must be even and at least 4. */
+#ifndef BPT_MAXKEYS
+#define BPT_MAXKEYS	30
+#endif /* BPT_MAXKEYS */
+
+#define BPT_MINKEYS	(BPT_MAXKEYS / 2)
+
+/* Enough for more than 2^64 keys at the minimum fanout */
+#define BPT_MAXDEPTH	24
+
+struct bpnode {
+	uint			nkeys;
+	uint			isleaf;
+	void *			keys[BPT_MAXKEYS];
+};
+
+struct bpleaf {
+	struct bpnode		hdr;
+	struct bpleaf *		prev;
+	struct bpleaf *		next;
+	void *			data[BPT_MAXKEYS];
+};
+
+struct bpinode {
+	struct bpnode		hdr;
+	struct bpnode *		child[BPT_MAXKEYS + 1];
+};
+
+struct bptree {
+	struct bpnode *		root;
+	struct bpleaf *		first;
+	struct bpleaf *		last;
+	uint			height;	/* 0 when empty, 1 with a single leaf */
+	size_t			nkeys;
+	cmp_f			cmp;
+	struct memmgr *		mm;
+};
+
+/* Position of an entry in a tree:  invalidated by any insert or removal */
+struct bpt_cursor {
+	struct bpleaf *		leaf;
+	uint			idx;
+};
+
+#define bpt_ckey(c)	((c)->leaf->hdr.keys[(c)->idx])
+#define bpt_cdata(c)	((c)->leaf->data[(c)->idx])
+
+
+/* Initialize an empty tree that orders keys with 'cmp' */
+void	bpt_init(struct bptree *t, cmp_f cmp, struct memmgr *mm);
+
+/* Release all of the tree's nodes.  Keys and data are not touched. */
+void	bpt_fini(struct bptree *t);
+
+/* Return a pointer to the data slot for 'key' or NULL if not present. */
+void ** bpt_lkup(struct bptree *t, const void *key);
+
+/*
+ * Insert 'key' mapping to 'data'.  Returns 0 if the key was new, 1 if it
+ * was already present, in which case its data gets replaced and the old
+ * value is stored in '*odata' if 'odata' is non-NULL.  Returns -1 if
+ * unable to allocate a node:  the tree is unchanged in that case.
+ */
+int	bpt_ins(struct bptree *t, void *key, void *data, void **odata);
+
+/*
+ * Remove the entry for 'key' storing the key and data pointers that were
+ * in the tree in '*okey' and '*odata' if they are non-NULL.  Returns 0 on
+ * success and -1 if the key was not found.
+ */
+int	bpt_rem(struct bptree *t, const void *key, void **okey, void **odata);
+
+/* Call 'f' on the data of each entry in key order passing 'ctx' */
+void	bpt_apply(struct bptree *t, apply_f f, void *ctx);
+
+/*
+ * Cursor operations return 1 if the cursor refers to an entry afterwards
+ * and 0 if it ran off the end of the tree.
+ */
+
+/* Position 'c' at the first or last entry in 't' */
+int	bpt_first(struct bptree *t, struct bpt_cursor *c);
+int	bpt_last(struct bptree *t, struct bpt_cursor *c);
+
+/* Position 'c' at the first entry whose key is >= 'key' */
+int	bpt_lbound(struct bptree *t, const void *key, struct bpt_cursor *c);
+
+/* Move 'c' to the next or previous entry */
+int	bpt_next(struct bpt_cursor *c);
+int	bpt_prev(struct bpt_cursor *c);
+
+#endif /* __cat_bptree_h */
@@ -0,0 +1,93 @@
+/*
+ * cat/cnhash.h -- Concurrent hash table with lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_cnhash_h
+#define __cat_cnhash_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <cat/hash.h>
+#include <cat/epoch.h>
+#include <pthread.h>
+
+/*
+ * A chained hash table that any number of threads may use at once.
+ * Lookups take no locks:  they walk bucket chains that writers only
+ * ever change with single atomic pointer stores.  Writers serialize on
+ * one of a set of striped mutexes chosen by bucket.  Removed nodes (and
+ * their key copies) are freed through epoch based reclamation so a
+ * concurrent reader never touches freed memory.  The table does not
+ * resize:  pick the bucket count for the expected number of entries.
+ */
+
+struct cnhnode {
+	struct cnhnode *	next;
+	void *			key;
+	void *			data;
+	uint			hash;
+	struct ebr_node		ebr;
+};
+
+struct cnhtab;
+
+struct cnhtab_attr {
+	cmp_f			kcmp;
+	hash_f			hash;
+	size_t			hctx_size;
+	void *			(*key_dup)(struct cnhtab *t, void *k);
+	void			(*key_free)(struct cnhtab *t, void *k);
+	void *			ctx;
+};
+
+struct cnhtab {
+	struct cnhnode **	bkts;
+	uint			nbkts;
+	uint			nlocks;
+	pthread_mutex_t *	locks;
+	cmp_f			cmp;
+	hash_f			hash;
+	void *			hctx;
+	int			abort_on_fail;
+	void *			(*key_dup)(struct cnhtab *t, void *k);
+	void			(*key_free)(struct cnhtab *t, void *k);
+	void *			ctx;
+	struct ebr		ebr;
+};
+
+/* Maximum number of writer lock stripes */
+#ifndef CNHT_MAXLOCKS
+#define CNHT_MAXLOCKS		256
+#endif /* CNHT_MAXLOCKS */
+
+extern struct cnhtab_attr cnht_std_attr_skey;	/* string key table */
+extern struct cnhtab_attr cnht_std_attr_rkey;	/* raw key table */
+extern struct cnhtab_attr cnht_std_attr_pkey;	/* ptr key table */
+extern struct cnhtab_attr cnht_std_attr_bkey;	/* binary key table */
+
+/* 'nbkts' gets rounded up to a power of 2 */
+struct cnhtab *	cnht_new(size_t nbkts, struct cnhtab_attr *attr, void *hctx,
+			 int abort_on_fail);
+
+/* No other thread may use the table during or after this call */
+void		cnht_free(struct cnhtab *t);
+
+void *		cnht_get(struct cnhtab *t, void *key);
+
+/* Returns 1 if 'key' was present and its data replaced, 0 if a new */
+/* entry was added and -1 on allocation failure. */
+int		cnht_put(struct cnhtab *t, void *key, void *data);
+
+void *		cnht_del(struct cnhtab *t, void *key);
+
+/* 'f' runs on each entry's data with that entry's stripe lock held */
+void		cnht_apply(struct cnhtab *t, apply_f f, void *ctx);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_cnhash_h */
@@ -0,0 +1,113 @@
+/*
+ * cat/cnskip.h -- Concurrent lock-free skiplist ordered map
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_cnskip_h
+#define __cat_cnskip_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <cat/aux.h>
+#include <cat/epoch.h>
+
+/*
+ * An ordered map that any number of threads may read and modify at once
+ * without locks.  Each level of the skiplist is a linked list that
+ * writers change only with compare-and-swap.  A node gets deleted by
+ * setting the low bit of each of its next pointers, bottom level last,
+ * after which any thread that walks past it unlinks it.  Unlinked nodes
+ * (and their key copies) are freed through epoch based reclamation so no
+ * concurrent reader or cursor ever touches freed memory.
+ *
+ * Keys are ordered by 'kcmp' which gets called as kcmp(key, nodekey) like
+ * with the trees.  Data pointers may not be NULL.
+ */
+
+/* Each level holds about 1/4 of the nodes of the level below */
+#ifndef CNSL_MAXLVL
+#define CNSL_MAXLVL		16
+#endif /* CNSL_MAXLVL */
+
+struct cnslnode {
+	void *			key;
+	void *			data;	/* NULL once the node is deleted */
+	struct ebr_node		ebr;
+	int			refs;	/* one for the list, one for the inserter */
+	int			nlvl;
+	struct cnslnode *	next[1];	/* really 'nlvl' entries */
+};
+
+struct cnslist;
+
+struct cnslist_attr {
+	cmp_f			kcmp;
+	void *			(*key_dup)(struct cnslist *t, void *k);
+	void			(*key_free)(struct cnslist *t, void *k);
+	void *			ctx;
+};
+
+struct cnslist {
+	struct cnslnode *	head;
+	cmp_f			cmp;
+	uint			seq;	/* seeds node levels */
+	int			abort_on_fail;
+	void *			(*key_dup)(struct cnslist *t, void *k);
+	void			(*key_free)(struct cnslist *t, void *k);
+	void *			ctx;
+	struct ebr		ebr;
+};
+
+/*
+ * A cursor walks the list in key order.  It sees every entry that stays
+ * in the list for the whole walk, never sees an entry twice and never
+ * goes backwards, but it may or may not see entries added or removed
+ * while it runs.  A cursor holds an epoch read section from cnsl_first()
+ * or cnsl_lbound() until cnsl_cfini(), so keep walks short:  no node in
+ * the list can be freed until it ends.
+ */
+struct cnsl_cursor {
+	struct cnslist *	list;
+	struct cnslnode *	node;
+	void *			key;
+	void *			data;
+};
+
+extern struct cnslist_attr cnsl_std_attr_skey;	/* string key list */
+extern struct cnslist_attr cnsl_std_attr_rkey;	/* raw key list */
+extern struct cnslist_attr cnsl_std_attr_pkey;	/* ptr key list */
+extern struct cnslist_attr cnsl_std_attr_bkey;	/* binary key list */
+
+struct cnslist *cnsl_new(struct cnslist_attr *attr, int abort_on_fail);
+
+/* No other thread may use the list during or after this call */
+void		cnsl_free(struct cnslist *t);
+
+void *		cnsl_get(struct cnslist *t, void *key);
+
+/* Returns 1 if 'key' was present and its data replaced, 0 if a new */
+/* entry was added and -1 on allocation failure. */
+int		cnsl_put(struct cnslist *t, void *key, void *data);
+
+void *		cnsl_del(struct cnslist *t, void *key);
+
+/* Calls 'f' on each entry's data in key order with cursor semantics */
+void		cnsl_apply(struct cnslist *t, apply_f f, void *ctx);
+
+/*
+ * Cursor operations return 1 and fill in 'key' and 'data' if the cursor
+ * refers to an entry afterwards or 0 if it ran off the end of the list.
+ * Every cursor started must be finished with cnsl_cfini().
+ */
+int		cnsl_first(struct cnslist *t, struct cnsl_cursor *c);
+int		cnsl_lbound(struct cnslist *t, void *key, struct cnsl_cursor *c);
+int		cnsl_next(struct cnsl_cursor *c);
+void		cnsl_cfini(struct cnsl_cursor *c);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_cnskip_h */
@@ -0,0 +1,99 @@
+/*
+ * cat/dheap.h -- d-ary heap of elements stored by value
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_dheap_h
+#define __cat_dheap_h
+
+#include <cat/cat.h>
+#include <cat/mem.h>
+
+/*
+ * A min-heap where each node has 'arity' children (a power of 2 from 2 to
+ * DH_MAXARITY) and elements of 'esize' bytes live directly in the array
+ * instead of behind pointers.  The array starts DH_LINESZ aligned and is
+ * offset so that every group of siblings starts at a multiple of 'arity'
+ * elements from that boundary:  when 'arity * esize' is DH_LINESZ (e.g. 4
+ * 16-byte or 8 8-byte elements) a sift down step compares the children
+ * within a single cache line.  A 4-ary heap is also half as deep as a
+ * binary one.
+ *
+ * The comparison function gets pointers to two elements.  Element
+ * positions (as from dh_add()) change as the heap changes.
+ */
+
+#define DH_LINESZ	64
+#define DH_MAXARITY	64
+
+/* Bytes of memory needed to hold 'n' elements */
+#define DH_MEMLEN(n, arity, esize) \
+	(((size_t)(n) + (arity)) * (esize) + DH_LINESZ - 1)
+
+struct dheap {
+	uint			arity;	/* children per node */
+	uint			ashift;	/* log2(arity) */
+	size_t			esize;	/* size of an element */
+	uint			size;	/* current maximum number of elements */
+	uint			fill;	/* number of elements populated */
+	void *			mem;	/* memory the elements live in */
+	size_t			mlen;	/* length of 'mem' */
+	byte_t *		elem;	/* the top element */
+	cmp_f			cmp;	/* comparison function */
+	struct memmgr *		mm;	/* memory manager for dynamic resize */
+};
+
+/* The element at position 'pos' in 'hp' */
+#define dh_elem(hp, pos) ((void *)((hp)->elem + (size_t)(pos) * (hp)->esize))
+
+/*
+ * Initialize an empty heap 'hp' in 'mlen' bytes of memory at 'mem' (see
+ * DH_MEMLEN()).  If 'mm' is non-NULL it replaces the memory as the heap
+ * grows, so 'mem' must come from 'mm' (or be NULL).  Otherwise the heap
+ * has a fixed maximum size.
+ */
+void dh_init(struct dheap *hp, void *mem, size_t mlen, uint arity,
+	     size_t esize, cmp_f cmp, struct memmgr *mm);
+
+/*
+ * Make room for 'n' elements in total.  Returns 0 on success or -1 if
+ * the heap can't grow that large.
+ */
+int dh_reserve(struct dheap *hp, uint n);
+
+/*
+ * Copy the element at 'e' into 'hp'.  Returns 0 on success or -1 if the
+ * heap is full and can't be expanded.  On success, if 'pos' is non-NULL,
+ * then *pos holds the position of the new element.
+ */
+int dh_add(struct dheap *hp, const void *e, uint *pos);
+
+/* Returns a pointer to the top element or NULL if the heap is empty */
+void *dh_top(struct dheap *hp);
+
+/*
+ * Remove the top element, copying it to 'e' if 'e' is non-NULL.  Returns
+ * 0 on success or -1 if the heap is empty.
+ */
+int dh_extract(struct dheap *hp, void *e);
+
+/* The same for the element at position 'pos' */
+int dh_rem(struct dheap *hp, uint pos, void *e);
+
+/*
+ * Add the 'n' elements in the array 'ea'.  Large batches get appended and
+ * the heap gets rebuilt bottom up in linear time.  Returns 0 on success or
+ * -1 if there is no room for all of them (in which case none get added).
+ */
+int dh_add_n(struct dheap *hp, const void *ea, uint n);
+
+/*
+ * Remove up to 'n' elements from the top of the heap and store them in
+ * order in the array 'ea'.  Returns the number removed.
+ */
+uint dh_extract_n(struct dheap *hp, void *ea, uint n);
+
+#endif /* __cat_dheap_h */
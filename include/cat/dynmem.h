@@ -56,6 +56,11 @@ void dynmem_init(struct dynmem *dm);
 void *dynmem_malloc(struct dynmem *dm, size_t amt);
 void dynmem_free(struct dynmem *dm, void *mem);
 void *dynmem_realloc(struct dynmem *dm, void *omem, size_t newamt);
+/*
+ * Allocate 'amt' bytes at an address that is a multiple of 'align' (a
+ * power of 2).  The block is freed and resized like any other.
+ */
+void *dynmem_memalign(struct dynmem *dm, size_t align, size_t amt);
 
 void dynmem_add_pool(struct dynmem *dm, void *mem, size_t len);
 /* allows walking each pool in a dynmem heap */
@@ -161,6 +166,14 @@ void tlsf_add_pool(struct tlsf *tlsf, void *mem, size_t len);
 void *tlsf_malloc(struct tlsf *tlsf, size_t amt);
 void tlsf_free(struct tlsf *tlsf, void *mem);
 void *tlsf_realloc(struct tlsf *tlsf, void *omem, size_t newamt);
+/*
+ * Allocate 'amt' bytes at an address that is a multiple of 'align' (a
+ * power of 2) in constant time.  The block is freed and resized like any
+ * other.
+ */
+void *tlsf_memalign(struct tlsf *tlsf, size_t align, size_t amt);
+/* number of bytes the caller may use in 'mem' (>= the amount requested) */
+size_t tlsf_usable_size(void *mem);
 void tlsf_each_pool(struct tlsf *tlsf, apply_f f, void *ctx);
 void tlsf_each_block(struct tlsfpool *pool, apply_f f, void *ctx);
 
@@ -0,0 +1,84 @@
+/*
+ * cat/epoch.h -- Epoch based memory reclamation for lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_epoch_h
+#define __cat_epoch_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <pthread.h>
+
+/*
+ * Readers bracket every access to shared nodes with ebr_enter() and
+ * ebr_exit().  Writers unlink a node so that no new reader can find it and
+ * then hand it to ebr_retire().  The node's free function runs only after
+ * every thread that was inside a read section at the time of the unlink
+ * has left it.  Read sections may nest but should be short:  a thread
+ * that stays inside one blocks all reclamation.
+ */
+
+struct ebr_node {
+	struct ebr_node *	next;
+	void			(*free)(struct ebr_node *n, void *ctx);
+	ulong			epoch;
+};
+
+/* retired nodes waiting on one epoch */
+struct ebr_limbo {
+	struct ebr_node *	list;
+	ulong			epoch;
+};
+
+/* per-thread state:  records are reused once their thread exits */
+struct ebr_thr {
+	struct ebr_thr *	next;
+	struct ebr_thr *	tnext;	/* thread's records for other ebrs */
+	ulong			state;	/* (epoch << 1) | 1 when in a read */
+	int			depth;
+	int			inuse;
+	uint			nretired;
+	struct ebr_limbo	limbo[3];
+	struct ebr *		ebr;
+};
+
+struct ebr {
+	ulong			epoch;
+	struct ebr_thr *	threads;
+	pthread_mutex_t		lock;		/* protects orphans */
+	struct ebr_node *	orphans;	/* limbo of exited threads */
+	void *			ctx;
+};
+
+/* Try to advance the global epoch after this many retirements */
+#ifndef EBR_RETIRE_BATCH
+#define EBR_RETIRE_BATCH	64
+#endif /* EBR_RETIRE_BATCH */
+
+/* 'ctx' gets passed to each retired node's free function.  Returns 0 on */
+/* success and -1 if unable to create the lock or the thread key that all */
+/* instances share. */
+int  ebr_init(struct ebr *e, void *ctx);
+
+/* Free all retired nodes and thread records.  No thread may be in a */
+/* read section or retire nodes during or after this call. */
+void ebr_fini(struct ebr *e);
+
+void ebr_enter(struct ebr *e);
+void ebr_exit(struct ebr *e);
+
+/* Free 'n' with 'freef' once no reader can still hold a reference */
+void ebr_retire(struct ebr *e, struct ebr_node *n,
+		void (*freef)(struct ebr_node *n, void *ctx));
+
+/* Attempt to advance the epoch and reclaim the calling thread's nodes */
+void ebr_sync(struct ebr *e);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_epoch_h */
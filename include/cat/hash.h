@@ -13,6 +13,8 @@
 #include <cat/cat.h>
 #include <cat/aux.h>
 
+#include <string.h>
+
 /* pointer to a hash function: takes a 'key' and context */
 typedef uint (*hash_f)(const void *key, void *ctx);
 
@@ -68,6 +70,30 @@ DECL uint ht_hash(struct htab *t, const void *key);
  */
 DECL struct hnode * ht_lkup(struct htab *t, const void *key, uint *hash);
 
+/* 
+ * Like ht_lkup(), but using a 'hash' value for 'key' that was already
+ * calculated by ht_hash() or a previous ht_lkup() call.
+ */
+DECL struct hnode * ht_hlkup(struct htab *t, const void *key, uint hash);
+
+/*
+ * Look up 'n' keys at once:  store the node for 'keys[i]' (or NULL) in
+ * 'nodes[i]' and, if 'hashes' is non-NULL, the key's hash in 'hashes[i]'.
+ * Keys are hashed and their buckets and first nodes prefetched a group at
+ * a time before any chain is walked so that the cache misses of different
+ * keys overlap instead of stalling one after another.
+ */
+DECL void ht_lkup_batch(struct htab *t, void * const *keys, uint n,
+			struct hnode **nodes, uint *hashes);
+
+/* Number of keys ht_lkup_batch() keeps in flight at once */
+#ifndef HT_BATCH_SIZE
+#define HT_BATCH_SIZE	16
+#endif /* HT_BATCH_SIZE */
+
+/* Return the index of the bucket in 't' that holds nodes with hash 'hash' */
+DECL uint ht_bktidx(struct htab *t, uint hash);
+
 /* 
  * Insert 'node' into 't' with hash 'hash'.  Assumes 'hash' was calculated
  * by ht_hash() or returned through the third parameter of ht_lkup();
@@ -99,6 +125,30 @@ PTRDECL uint ht_rhash(const void *key, void *unused);
 /* A hash function that treats 'key' as an integer */
 PTRDECL uint ht_ihash(const void *key, void *unused);
 
+/*
+ * Faster hash functions that consume keys a machine word (8 bytes on
+ * 64-bit platforms) at a time and finish with a full avalanche mix so
+ * that every bit of the result is usable even by power-of-2 tables.
+ * If the hash context is non-NULL it must point to a 'ulong' seed value.
+ * Hash values may differ between platforms of different word size.
+ */
+
+/* Hash 'len' bytes at 'p' with the seed 'seed' */
+DECL uint ht_hashbytes(const void *p, size_t len, ulong seed);
+
+/* Fast hash for a NULL terminated string */
+PTRDECL uint ht_fshash(const void *key, void *seed);
+
+/* Fast hash over a 'struct raw'; ie. key points to a struct raw */
+PTRDECL uint ht_frhash(const void *key, void *seed);
+
+/* 
+ * Fast hash that treats 'key' as an integer.  Unlike ht_ihash() and
+ * ht_phash() every input bit affects every output bit, so this is also
+ * the better choice for (aligned) pointer keys.
+ */
+PTRDECL uint ht_fihash(const void *key, void *seed);
+
 
 /* ----- Implementation ----- */
 #if defined(CAT_HASH_DO_DECL) && CAT_HASH_DO_DECL
@@ -114,6 +164,9 @@ DECL void ht_init(struct htab *t, struct hnode **bkts, uint nbkts,
 	(void)ht_phash;
 	(void)ht_rhash;
 	(void)ht_ihash;
+	(void)ht_fshash;
+	(void)ht_frhash;
+	(void)ht_fihash;
 
 	abort_unless(t != NULL);
 	abort_unless(bkts != NULL);
@@ -170,28 +223,30 @@ STATIC_DECL uint _modulo(uint dend, uint dsor)
 #endif /* !CAT_HAS_DIV */
 
 
-DECL struct hnode * ht_lkup(struct htab *t, const void *key, uint *hp)
+DECL uint ht_bktidx(struct htab *t, uint hash)
 {
-	struct hnode *node;
-	uint h;
-
 	abort_unless(t != NULL);
-	abort_unless(key != NULL);
 
-	h = (*t->hash)(key, t->hctx);
-	if ( hp != NULL ) 
-		*hp = h;
 	if ( t->po2mask ) {
-		node = t->bkts[h & t->po2mask];
+		return hash & t->po2mask;
 	} else {
 #if CAT_HAS_DIV
-		node = t->bkts[h % t->nbkts];
+		return hash % t->nbkts;
 #else /* CAT_HAS_DIV */
-		h = _modulo(h, t->nbkts);
-		node = t->bkts[h];
+		return _modulo(hash, t->nbkts);
 #endif /* CAT_HAS_DIV */
 	}
+}
+
+
+DECL struct hnode * ht_hlkup(struct htab *t, const void *key, uint h)
+{
+	struct hnode *node;
 
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	node = t->bkts[ht_bktidx(t, h)];
 	while ( node != NULL ) {
 		if ( !(*t->cmp)(node->key, key) )
 			return node;
@@ -202,6 +257,63 @@ DECL struct hnode * ht_lkup(struct htab *t, const void *key, uint *hp)
 }
 
 
+DECL struct hnode * ht_lkup(struct htab *t, const void *key, uint *hp)
+{
+	uint h;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	h = (*t->hash)(key, t->hctx);
+	if ( hp != NULL ) 
+		*hp = h;
+
+	return ht_hlkup(t, key, h);
+}
+
+
+DECL void ht_lkup_batch(struct htab *t, void * const *keys, uint n,
+			struct hnode **nodes, uint *hashes)
+{
+	uint bidx[HT_BATCH_SIZE];
+	uint i, j, nb, h;
+	struct hnode *node;
+
+	abort_unless(t != NULL);
+	abort_unless(n == 0 || (keys != NULL && nodes != NULL));
+
+	for ( i = 0 ; i < n ; i += nb ) {
+		nb = (n - i < HT_BATCH_SIZE) ? n - i : HT_BATCH_SIZE;
+
+		/* hash every key in the group and fetch its bucket head */
+		for ( j = 0 ; j < nb ; ++j ) {
+			abort_unless(keys[i + j] != NULL);
+			h = (*t->hash)(keys[i + j], t->hctx);
+			if ( hashes != NULL )
+				hashes[i + j] = h;
+			bidx[j] = ht_bktidx(t, h);
+			CAT_PREFETCH(&t->bkts[bidx[j]]);
+		}
+
+		/* fetch the first node of each chain */
+		for ( j = 0 ; j < nb ; ++j ) {
+			node = t->bkts[bidx[j]];
+			nodes[i + j] = node;
+			if ( node != NULL )
+				CAT_PREFETCH(node);
+		}
+
+		/* by now most of the first nodes have arrived */
+		for ( j = 0 ; j < nb ; ++j ) {
+			node = nodes[i + j];
+			while ( node != NULL && (*t->cmp)(node->key, keys[i + j]) )
+				node = node->next;
+			nodes[i + j] = node;
+		}
+	}
+}
+
+
 DECL void ht_ins(struct htab *t, struct hnode *node, uint hash)
 {
 	struct hnode **trav;
@@ -209,17 +321,7 @@ DECL void ht_ins(struct htab *t, struct hnode *node, uint hash)
 	abort_unless(t != NULL);
 	abort_unless(node != NULL);
 
-	if ( t->po2mask ) {
-		trav = t->bkts + (hash & t->po2mask);
-	} else {
-#if CAT_HAS_DIV
-		trav = t->bkts + (hash % t->nbkts);
-#else /* CAT_HAS_DIV */
-		hash = _modulo(hash, t->nbkts);
-		trav = t->bkts + hash;
-#endif /* CAT_HAS_DIV */
-	}
-
+	trav = t->bkts + ht_bktidx(t, hash);
 	node->prevp = trav;
 	node->next = *trav;
 	if ( *trav != NULL )
@@ -332,6 +434,164 @@ PTRDECL uint ht_ihash(const void *key, void *unused)
 }
 
 
+#if CAT_64BIT
+
+#define HT_U64(hi, lo)	(((uint64_t)(hi) << 32) | (uint64_t)(lo))
+#define HT_P1		HT_U64(0x9E3779B1, 0x85EBCA87)
+#define HT_P2		HT_U64(0xC2B2AE3D, 0x27D4EB4F)
+#define HT_M1		HT_U64(0xBF58476D, 0x1CE4E5B9)
+#define HT_M2		HT_U64(0x94D049BB, 0x133111EB)
+#define HT_ROTL(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+/* little endian load of 8 bytes:  compilers reduce this to one load */
+STATIC_DECL uint64_t _ht_rd64(const uchar *p)
+{
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) |
+	       ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+	       ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+	       ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+
+STATIC_DECL uint _ht_fmix(uint64_t h)
+{
+	h ^= h >> 30;
+	h *= HT_M1;
+	h ^= h >> 27;
+	h *= HT_M2;
+	h ^= h >> 31;
+	return (uint)h;
+}
+
+
+DECL uint ht_hashbytes(const void *p, size_t len, ulong seed)
+{
+	const uchar *bp = p;
+	uint64_t h, w;
+	size_t i;
+
+	abort_unless(p != NULL || len == 0);
+
+	h = (uint64_t)seed + HT_P1 + (uint64_t)len * HT_P2;
+	for ( ; len >= 8 ; len -= 8, bp += 8 ) {
+		h += _ht_rd64(bp) * HT_P2;
+		h = HT_ROTL(h, 31) * HT_P1;
+	}
+
+	if ( len > 0 ) {
+		for ( w = 0, i = 0 ; i < len ; ++i )
+			w |= (uint64_t)bp[i] << (i * 8);
+		h += w * HT_P2;
+		h = HT_ROTL(h, 31) * HT_P1;
+	}
+
+	return _ht_fmix(h);
+}
+
+
+PTRDECL uint ht_fihash(const void *key, void *seed)
+{
+	uint64_t v = (uint64_t)ptr2uint(key);
+	if ( seed != NULL )
+		v ^= (uint64_t)*(const ulong *)seed * HT_P2;
+	return _ht_fmix(v + HT_P1);
+}
+
+#undef HT_U64
+#undef HT_P1
+#undef HT_P2
+#undef HT_M1
+#undef HT_M2
+#undef HT_ROTL
+
+#else /* CAT_64BIT */
+
+#define HT_P1		0x9E3779B1u
+#define HT_P2		0x85EBCA77u
+#define HT_M1		0x85EBCA6Bu
+#define HT_M2		0xC2B2AE35u
+#define HT_ROTL(x, r)	((((x) << (r)) | ((x) >> (32 - (r)))) & 0xFFFFFFFFu)
+
+STATIC_DECL uint32_t _ht_rd32(const uchar *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+STATIC_DECL uint _ht_fmix(uint32_t h)
+{
+	h &= 0xFFFFFFFFu;
+	h ^= h >> 16;
+	h = (h * HT_M1) & 0xFFFFFFFFu;
+	h ^= h >> 13;
+	h = (h * HT_M2) & 0xFFFFFFFFu;
+	h ^= h >> 16;
+	return (uint)h;
+}
+
+
+DECL uint ht_hashbytes(const void *p, size_t len, ulong seed)
+{
+	const uchar *bp = p;
+	uint32_t h, w;
+	size_t i;
+
+	abort_unless(p != NULL || len == 0);
+
+	h = (uint32_t)seed + HT_P1 + (uint32_t)len * HT_P2;
+	for ( ; len >= 4 ; len -= 4, bp += 4 ) {
+		h = (h + _ht_rd32(bp) * HT_P2) & 0xFFFFFFFFu;
+		h = (HT_ROTL(h, 13) * HT_P1) & 0xFFFFFFFFu;
+	}
+
+	if ( len > 0 ) {
+		for ( w = 0, i = 0 ; i < len ; ++i )
+			w |= (uint32_t)bp[i] << (i * 8);
+		h = (h + w * HT_P2) & 0xFFFFFFFFu;
+		h = (HT_ROTL(h, 13) * HT_P1) & 0xFFFFFFFFu;
+	}
+
+	return _ht_fmix(h);
+}
+
+
+PTRDECL uint ht_fihash(const void *key, void *seed)
+{
+	uint32_t v = (uint32_t)ptr2uint(key);
+	if ( seed != NULL )
+		v ^= (uint32_t)*(const ulong *)seed * HT_P2;
+	return _ht_fmix(v + HT_P1);
+}
+
+#undef HT_P1
+#undef HT_P2
+#undef HT_M1
+#undef HT_M2
+#undef HT_ROTL
+
+#endif /* CAT_64BIT */
+
+
+PTRDECL uint ht_fshash(const void *key, void *seed)
+{
+	abort_unless(key != NULL);
+	return ht_hashbytes(key, strlen(key),
+			    (seed == NULL) ? 0 : *(const ulong *)seed);
+}
+
+
+PTRDECL uint ht_frhash(const void *key, void *seed)
+{
+	struct raw const *r = key;
+
+	abort_unless(r != NULL);
+
+	return ht_hashbytes(r->data, r->len,
+			    (seed == NULL) ? 0 : *(const ulong *)seed);
+}
+
+
 struct hash_iter {
 	struct hnode **bucket;
 	struct hnode *node;
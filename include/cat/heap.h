@@ -32,6 +32,7 @@ struct heap {
 	void **			elem;  /* Pointer to array of elem pointers */
 	cmp_f			cmp;   /* Comparison function for the heap */
 	struct memmgr *		mm;    /* Memory manager for dynamic resize */
+	int			posoff;/* Offset of position in elems or -1 */
 };
 
 
@@ -56,6 +57,26 @@ DECL int hp_add(struct heap *hp, void *elem, int *pos);
 /* Return the index in 'hp->elem' of 'data' */
 DECL int hp_find(struct heap *hp, void *data);
 
+/*
+ * Make 'hp' an indexed heap:  every element holds an int 'posoff' bytes
+ * from its start that the heap keeps set to the element's index in
+ * 'hp->elem' as elements move (or to -1 once the element leaves the heap).
+ * Elements already in the heap get their positions set.  This turns
+ * finding an element into hp_pos() instead of an O(n) hp_find().
+ */
+DECL void hp_set_posoff(struct heap *hp, int posoff);
+
+/* Return the index in 'hp->elem' of 'elem' in an indexed heap (-1 if */
+/* 'elem' was removed). */
+DECL int hp_pos(struct heap *hp, void *elem);
+
+/*
+ * Restore the heap order after the priority of the element at position
+ * 'pos' changed in either direction.  Returns the element's new position.
+ * Together with hp_pos() this updates an element in O(log n).
+ */
+DECL int hp_update(struct heap *hp, int pos);
+
 /* 
  * Extract (remove) the element at the top of the heap and return it. 
  * Return NULL if the heap is empty.
@@ -69,6 +90,16 @@ DECL void * hp_rem(struct heap *hp, int elem);
 /* ----- Implementation ----- */
 #if defined(CAT_HEAP_DO_DECL) && CAT_HEAP_DO_DECL
 
+#define HPPOS(hp, e) (*(int *)((byte_t *)(e) + (hp)->posoff))
+
+/* Record the position of the element at 'pos' in an indexed heap */
+LOCAL void hp_setpos(struct heap *hp, int pos)
+{
+	if ( hp->posoff >= 0 )
+		HPPOS(hp, hp->elem[pos]) = pos;
+}
+
+
 LOCAL int reheapup(struct heap *hp, int pos)
 {
 	int ppos = (pos-1) >> 1;
@@ -83,15 +114,17 @@ LOCAL int reheapup(struct heap *hp, int pos)
 		hold = hp->elem[pos];
 		hp->elem[pos] = hp->elem[ppos];
 		hp->elem[ppos] = hold;
+		hp_setpos(hp, pos);
 		pos = ppos;
 		ppos = (pos-1) >> 1;
 	}
+	hp_setpos(hp, pos);
 
 	return pos;
 }
 
 
-LOCAL void reheapdown(struct heap *hp, int pos)
+LOCAL int reheapdown(struct heap *hp, int pos)
 {
 	int didswap;
 	int cld;
@@ -100,7 +133,7 @@ LOCAL void reheapdown(struct heap *hp, int pos)
 	abort_unless(hp);
 
 	if ( pos >= hp->fill ) 
-		return;
+		return pos;
 
 	do {
 		didswap = 0;
@@ -116,9 +149,13 @@ LOCAL void reheapdown(struct heap *hp, int pos)
 			hold = hp->elem[cld];
 			hp->elem[cld] = hp->elem[pos];
 			hp->elem[pos] = hold;
+			hp_setpos(hp, pos);
 			pos = cld;
 		}
 	} while (didswap);
+	hp_setpos(hp, pos);
+
+	return pos;
 }
 
 
@@ -135,6 +172,7 @@ DECL void hp_init(struct heap *hp, void **elem, int size, int fill,
 	hp->elem = elem;
 	hp->cmp  = cmp;
 	hp->mm = mm;
+	hp->posoff = -1;
 
 	if ( (hp->fill = fill) ) {
 		if ( fill > size ) 		/* sanity check */
@@ -196,6 +234,43 @@ DECL int hp_find(struct heap *hp, void *data)
 }
 
 
+DECL void hp_set_posoff(struct heap *hp, int posoff)
+{
+	int i;
+
+	abort_unless(hp);
+	abort_unless(posoff >= 0);
+
+	hp->posoff = posoff;
+	for ( i = 0 ; i < hp->fill ; ++i )
+		hp_setpos(hp, i);
+}
+
+
+DECL int hp_pos(struct heap *hp, void *elem)
+{
+	abort_unless(hp);
+	abort_unless(hp->posoff >= 0);
+	abort_unless(elem);
+
+	return HPPOS(hp, elem);
+}
+
+
+DECL int hp_update(struct heap *hp, int pos)
+{
+	int npos;
+
+	abort_unless(hp);
+	abort_unless(pos >= 0 && pos < hp->fill);
+
+	if ( (npos = reheapup(hp, pos)) == pos )
+		npos = reheapdown(hp, pos);
+
+	return npos;
+}
+
+
 DECL void * hp_extract(struct heap *hp)
 {
 	void *hold;
@@ -215,6 +290,8 @@ DECL void * hp_extract(struct heap *hp)
 	hp->fill -= 1;
 
 	reheapdown(hp, 0);
+	if ( hp->posoff >= 0 )
+		HPPOS(hp, hold) = -1;
 
 	return hold;
 }
@@ -239,10 +316,14 @@ DECL void * hp_rem(struct heap *hp, int elem)
 
 	if ( reheapup(hp, elem) == elem )
 		reheapdown(hp, elem);
+	if ( hp->posoff >= 0 )
+		HPPOS(hp, hold) = -1;
 
-	return hp->elem[last];
+	return hold;
 }
 
+#undef HPPOS
+
 #endif /* if defined(CAT_HEAP_DO_DECL) && CAT_HEAP_DO_DECL */
 
 
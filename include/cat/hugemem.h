@@ -0,0 +1,68 @@
+/*
+ * cat/hugemem.h -- TLSF pools backed by transparent huge pages
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_hugemem_h
+#define __cat_hugemem_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <cat/list.h>
+#include <cat/dynmem.h>
+
+/*
+ * Feeds a TLSF heap with pools mapped straight from the kernel.  Each
+ * pool starts on a huge page boundary and spans whole huge pages, and
+ * the kernel is asked to back it with transparent huge pages where the
+ * system supports them (madvise(MADV_HUGEPAGE)).  A heap much larger
+ * than the TLB can map with base pages then needs far fewer TLB entries,
+ * which cuts TLB misses on random access.  Whether the kernel actually
+ * uses huge pages depends on its settings and on free memory:  the pools
+ * work the same way either way.
+ */
+
+#ifndef HM_PGSIZE
+#define HM_PGSIZE	((size_t)2 * 1024 * 1024)
+#endif /* HM_PGSIZE */
+
+struct hugemem {
+	struct tlsf *		tlsf;
+	struct list		maps;
+	size_t			mapped;		/* bytes mapped */
+	ulong			npools;
+	ulong			nadvised;	/* pools marked for huge pages */
+};
+
+void hm_init(struct hugemem *hm, struct tlsf *tlsf);
+
+/*
+ * Map at least 'len' bytes rounded up to whole huge pages and add them to
+ * the heap as a new pool.  Returns 0 on success or -1 if the mapping
+ * fails.
+ */
+int hm_add_pool(struct hugemem *hm, size_t len);
+
+/*
+ * Unmap every pool.  Memory allocated from the pools is invalid after
+ * this and the heap must be reinitialized with tlsf_init() before reuse.
+ */
+void hm_fini(struct hugemem *hm);
+
+/*
+ * Map 'len' bytes rounded up to whole huge pages at a huge page boundary
+ * and ask for huge pages.  If 'advised' is not NULL, '*advised' is set to
+ * 1 if the kernel accepted the request and 0 otherwise.  Returns NULL if
+ * the mapping fails.  Release the memory with hm_unmap() and the same
+ * length.
+ */
+void *hm_map(size_t len, int *advised);
+void hm_unmap(void *mem, size_t len);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_hugemem_h */
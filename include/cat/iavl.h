@@ -0,0 +1,99 @@
+/*
+ * cat/iavl.h -- AVL tree linked by 32-bit indices
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_iavl_h
+#define __cat_iavl_h
+
+#include <cat/cat.h>
+#include <cat/aux.h>
+#include <cat/avl.h>
+
+/*
+ * An AVL tree over the elements of an array (or arena) of equal sized
+ * elements.  Nodes refer to each other by their element's index instead
+ * of by pointer and find their key at a fixed offset in the element
+ * rather than through a key pointer.  A node takes 16 bytes where a
+ * 'struct anode' takes 48 on a 64-bit machine.  Since nodes store no
+ * addresses the array may be moved (e.g. by realloc()) as long as
+ * iavl_setbase() gets called afterwards.
+ *
+ * 'cmp' gets called as cmp(key, ekey) where 'ekey' points to the key
+ * inside the element, not to a copy of the key pointer.  The CA_L, CA_R,
+ * CA_P and CA_N directions are the same as those of the pointer tree.
+ */
+
+#ifndef IDX_NIL
+#define IDX_NIL		((uint32_t)0xFFFFFFFF)
+#endif /* IDX_NIL */
+
+struct ianode {
+	uint32_t	p[3];
+	signed char	b;	/* - == left and + == right */
+	uchar		pdir;	/* on the parent's left or right ? */
+};
+
+struct iavltree {
+	cmp_f		cmp;
+	byte_t *	base;	/* first element */
+	size_t		esize;	/* size of each element */
+	size_t		noff;	/* offset of the 'struct ianode' in an element */
+	size_t		koff;	/* offset of the key in an element */
+	uint32_t	root;
+};
+
+#define iavl_elem(t, i)	((void *)((t)->base + (size_t)(i) * (t)->esize))
+#define iavl_node(t, i)	\
+	((struct ianode *)((t)->base + (size_t)(i) * (t)->esize + (t)->noff))
+#define iavl_key(t, i)	\
+	((void *)((t)->base + (size_t)(i) * (t)->esize + (t)->koff))
+
+
+/* Initialize an empty tree over the elements starting at 'base' */
+void iavl_init(struct iavltree *t, cmp_f cmp, void *base, size_t esize,
+	       size_t noff, size_t koff);
+
+/* Tell 't' that its elements now start at 'base' */
+void iavl_setbase(struct iavltree *t, void *base);
+
+/*
+ * Works like avl_lkup().  With 'dir' == NULL returns the index of the
+ * element matching 'key' or IDX_NIL.  Otherwise returns either the match
+ * with *dir == CA_N or the parent a new element with 'key' would get with
+ * *dir set to the side it goes on.  In an empty tree the parent is
+ * IDX_NIL and *dir is CA_P.
+ */
+uint32_t iavl_lkup(struct iavltree *t, const void *key, int *dir);
+
+/* Insert element 'n'.  Returns the index of the element that had the */
+/* same key and got replaced by 'n' or IDX_NIL if there was none. */
+uint32_t iavl_ins(struct iavltree *t, uint32_t n);
+
+/* Insert element 'n' at a location returned by iavl_lkup() */
+void	iavl_ins_at(struct iavltree *t, uint32_t n, uint32_t loc, int dir);
+
+/* Remove element 'n' which must be in 't' */
+void	iavl_rem(struct iavltree *t, uint32_t n);
+
+/* Pass each element (not node) of 't' to 'func':  children come first */
+void	iavl_apply(struct iavltree *t, apply_f func, void *ctx);
+
+int	 iavl_isempty(struct iavltree *t);
+uint32_t iavl_getroot(struct iavltree *t);
+uint32_t iavl_getmin(struct iavltree *t);
+uint32_t iavl_getmax(struct iavltree *t);
+
+/* In-order neighbors of 'n' or IDX_NIL at either end */
+uint32_t iavl_next(struct iavltree *t, uint32_t n);
+uint32_t iavl_prev(struct iavltree *t, uint32_t n);
+
+/* First element with a key >= 'key' and > 'key' respectively */
+uint32_t iavl_lbound(struct iavltree *t, const void *key);
+uint32_t iavl_ubound(struct iavltree *t, const void *key);
+
+#endif /* __cat_iavl_h */
@@ -0,0 +1,86 @@
+/*
+ * cat/ihash.h -- Chained hash table linked by 32-bit indices
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_ihash_h
+#define __cat_ihash_h
+
+#include <cat/cat.h>
+#include <cat/aux.h>
+#include <cat/hash.h>
+
+/*
+ * A chained hash table over an array of equal sized elements like the
+ * trees in iavl.h and irbtree.h.  Buckets and chain links hold element
+ * indices so a bucket costs 4 bytes and a node 8:  the next index and the
+ * key's full hash.  (A 'struct hnode' and its bucket pointer cost 32
+ * bytes on 64-bit machines.)  Chains are singly linked so iht_rem() walks
+ * the element's chain to unlink it; the cached hash keeps that walk and
+ * lookups from calling 'cmp' on mismatched keys.  The number of buckets
+ * must be a power of 2.
+ *
+ * 'hash' and 'cmp' get a pointer to the key inside the element.
+ */
+
+#ifndef IDX_NIL
+#define IDX_NIL		((uint32_t)0xFFFFFFFF)
+#endif /* IDX_NIL */
+
+struct ihnode {
+	uint32_t	next;
+	uint32_t	hash;
+};
+
+struct ihtab {
+	uint32_t *	bkts;
+	uint		nbkts;
+	uint		mask;
+	cmp_f		cmp;
+	hash_f		hash;
+	void *		hctx;
+	byte_t *	base;	/* first element */
+	size_t		esize;	/* size of each element */
+	size_t		noff;	/* offset of the 'struct ihnode' in an element */
+	size_t		koff;	/* offset of the key in an element */
+};
+
+#define iht_elem(t, i)	((void *)((t)->base + (size_t)(i) * (t)->esize))
+#define iht_node(t, i)	\
+	((struct ihnode *)((t)->base + (size_t)(i) * (t)->esize + (t)->noff))
+#define iht_key(t, i)	\
+	((void *)((t)->base + (size_t)(i) * (t)->esize + (t)->koff))
+
+
+/* Initialize 't' to use the 'nbkts' buckets in 'bkts' (all get emptied) */
+void	 iht_init(struct ihtab *t, uint32_t *bkts, uint nbkts, cmp_f cmp,
+		  hash_f hash, void *hctx, void *base, size_t esize,
+		  size_t noff, size_t koff);
+
+/* Tell 't' that its elements now start at 'base' */
+void	 iht_setbase(struct ihtab *t, void *base);
+
+uint	 iht_hash(struct ihtab *t, const void *key);
+
+/* Return the index of the element with key 'key' or IDX_NIL.  If 'hash' */
+/* is non-NULL store the hash of 'key' in it for iht_ins(). */
+uint32_t iht_lkup(struct ihtab *t, const void *key, uint *hash);
+uint32_t iht_hlkup(struct ihtab *t, const void *key, uint hash);
+
+/* Insert element 'n' whose key hashes to 'hash' */
+void	 iht_ins(struct ihtab *t, uint32_t n, uint hash);
+
+/* Insert element 'n' hashing its key first */
+void	 iht_ins_h(struct ihtab *t, uint32_t n);
+
+/* Remove element 'n' which must be in 't' */
+void	 iht_rem(struct ihtab *t, uint32_t n);
+
+/* Pass every element in 't' to 'func' */
+void	 iht_apply(struct ihtab *t, apply_f func, void *ctx);
+
+#endif /* __cat_ihash_h */
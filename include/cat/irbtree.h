@@ -0,0 +1,75 @@
+/*
+ * cat/irbtree.h -- Red-Black tree linked by 32-bit indices
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_irbtree_h
+#define __cat_irbtree_h
+
+#include <cat/cat.h>
+#include <cat/aux.h>
+#include <cat/rbtree.h>
+
+/*
+ * The red-black counterpart of the tree in iavl.h:  elements live in one
+ * array, nodes link by element index and keys get compared in place with
+ * cmp(key, ekey).  A 'struct irbnode' is 16 bytes against 48 for a
+ * 'struct rbnode' on 64-bit machines.  Directions and colors are the
+ * CRB_* values of rbtree.h.
+ */
+
+#ifndef IDX_NIL
+#define IDX_NIL		((uint32_t)0xFFFFFFFF)
+#endif /* IDX_NIL */
+
+struct irbnode {
+	uint32_t	p[3];
+	uchar		pdir;	/* on the parent's left or right ? */
+	uchar		col;	/* CRB_RED or CRB_BLACK */
+};
+
+struct irbtree {
+	cmp_f		cmp;
+	byte_t *	base;	/* first element */
+	size_t		esize;	/* size of each element */
+	size_t		noff;	/* offset of the 'struct irbnode' in an element */
+	size_t		koff;	/* offset of the key in an element */
+	uint32_t	root;
+};
+
+#define irb_elem(t, i)	((void *)((t)->base + (size_t)(i) * (t)->esize))
+#define irb_node(t, i)	\
+	((struct irbnode *)((t)->base + (size_t)(i) * (t)->esize + (t)->noff))
+#define irb_key(t, i)	\
+	((void *)((t)->base + (size_t)(i) * (t)->esize + (t)->koff))
+
+
+void	 irb_init(struct irbtree *t, cmp_f cmp, void *base, size_t esize,
+		  size_t noff, size_t koff);
+void	 irb_setbase(struct irbtree *t, void *base);
+
+/* Same two modes as iavl_lkup() */
+uint32_t irb_lkup(struct irbtree *t, const void *key, int *dir);
+
+/* Returns the index of the element that 'n' replaced or IDX_NIL */
+uint32_t irb_ins(struct irbtree *t, uint32_t n);
+void	 irb_ins_at(struct irbtree *t, uint32_t n, uint32_t loc, int dir);
+void	 irb_rem(struct irbtree *t, uint32_t n);
+
+/* Passes each element to 'func' with children visited before parents */
+void	 irb_apply(struct irbtree *t, apply_f func, void *ctx);
+
+int	 irb_isempty(struct irbtree *t);
+uint32_t irb_getroot(struct irbtree *t);
+uint32_t irb_getmin(struct irbtree *t);
+uint32_t irb_getmax(struct irbtree *t);
+uint32_t irb_next(struct irbtree *t, uint32_t n);
+uint32_t irb_prev(struct irbtree *t, uint32_t n);
+uint32_t irb_lbound(struct irbtree *t, const void *key);
+uint32_t irb_ubound(struct irbtree *t, const void *key);
+
+#endif /* __cat_irbtree_h */
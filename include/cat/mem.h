@@ -47,6 +47,20 @@ void *mem_resize(struct memmgr *m, void *mem, size_t len);
 void mem_free(struct memmgr *m, void *mem);
 
 
+/*
+ * Allocate 'len' bytes from 'm' at an address that is a multiple of
+ * 'align' (a power of 2).  This works with any memory manager by asking
+ * for 'align' extra bytes and keeping a pointer to the block in front of
+ * the aligned address.  So the memory must be released with
+ * mem_free_aligned() and can not be resized.  Managers that can align
+ * in place (tlsf_memalign(), dynmem_memalign()) waste less memory.
+ */
+void *mem_get_aligned(struct memmgr *m, size_t align, size_t len);
+
+/* Free memory from mem_get_aligned() */
+void mem_free_aligned(struct memmgr *m, void *mem);
+
+
 /*
  * This function is useful as an 'apply function' that gets
  * invoked over every element in some data structure.  It frees
@@ -95,6 +109,60 @@ size_t amm_get_fill(struct arraymm *amm);
 size_t amm_get_avail(struct arraymm *amm);
 
 
+/*
+ * A region memory manager bump allocates from a chain of blocks that it
+ * gets from another memory manager as needed.  Individual frees are
+ * no-ops except for the most recent allocation, which also is the only
+ * one that resizes in place.  Instead the caller frees everything
+ * allocated since a mark in one shot with rgn_release() or frees
+ * everything with rgn_reset().  Both only touch the blocks allocated
+ * since the mark, never the objects in them.  The first block stays
+ * allocated across releases so that a region reused for each request of
+ * a server usually needs no memory from its backing manager at all.
+ */
+struct rgnblk;
+
+struct region {
+	struct memmgr		mm;
+	struct memmgr *		bmm;
+	size_t			bsize;
+	struct arraymm		amm;	/* allocates from 'cur' */
+	struct rgnblk *		first;
+	struct rgnblk *		cur;
+	void *			last;	/* most recent allocation */
+};
+
+struct rgn_mark {
+	struct rgnblk *		blk;
+	size_t			fill;
+};
+
+/*
+ * Initialize 'rg' to get blocks of at least 'bsize' bytes from 'bmm'.
+ * Requests larger than 'bsize' get a block of their own.  No memory is
+ * allocated until the first request.
+ */
+void rgn_init(struct region *rg, struct memmgr *bmm, size_t bsize);
+
+/* Free all blocks including the first. */
+void rgn_fini(struct region *rg);
+
+void *rgn_alloc(struct region *rg, size_t len);
+void *rgn_resize(struct region *rg, void *mem, size_t len);
+void rgn_free(struct region *rg, void *mem);
+
+/*
+ * Record the current position of 'rg' in 'm'.  rgn_release() frees all
+ * memory allocated since the mark.  Marks nest:  releasing to a mark
+ * invalidates all marks taken after it.
+ */
+void rgn_mark(struct region *rg, struct rgn_mark *m);
+void rgn_release(struct region *rg, struct rgn_mark *m);
+
+/* Free all memory allocated from 'rg' but keep its first block. */
+void rgn_reset(struct region *rg);
+
+
 /* Declaration of default memmgr. */
 extern struct memmgr stdmm;
 
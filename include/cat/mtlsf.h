@@ -0,0 +1,86 @@
+/*
+ * cat/mtlsf.h -- Thread caching front end for the TLSF allocator
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_mtlsf_h
+#define __cat_mtlsf_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <pthread.h>
+#include <cat/mem.h>
+#include <cat/dynmem.h>
+
+/*
+ * A TLSF heap shared by many threads.  Each thread keeps a magazine of
+ * free blocks for each small size class.  Allocations and frees of small
+ * blocks only touch the calling thread's magazine.  An empty magazine
+ * refills with MT_BATCH blocks from the shared heap and a full one hands
+ * MT_BATCH blocks back, so the heap lock is taken about once per MT_BATCH
+ * small operations.  Large blocks go straight to the heap under the lock.
+ *
+ * Every block is the shared heap's, not a thread's, so any thread may free
+ * any block:  it lands in the freeing thread's magazine and returns to the
+ * heap when that magazine overflows.  A thread's magazines return to the
+ * heap when the thread exits.
+ */
+
+/* Small size classes are multiples of MT_CLASSSZ up to MT_MAXSMALL bytes */
+#ifndef MT_NCLASS
+#define MT_NCLASS	32
+#endif /* MT_NCLASS */
+#define MT_CLASSSZ	16
+#define MT_MAXSMALL	(MT_NCLASS * MT_CLASSSZ)
+
+/* Number of blocks moved between a magazine and the heap at once */
+#ifndef MT_BATCH
+#define MT_BATCH	32
+#endif /* MT_BATCH */
+
+/* free blocks linked through their first word */
+struct mt_mag {
+	void *			head;
+	uint			count;
+};
+
+struct mt_thr {
+	struct mt_thr *		next;
+	int			inuse;
+	struct mtlsf *		mt;
+	struct mt_mag		mags[MT_NCLASS];
+};
+
+struct mtlsf {
+	struct memmgr		mm;
+	struct tlsf *		tlsf;
+	pthread_mutex_t		lock;		/* protects tlsf and threads */
+	pthread_key_t		key;
+	struct mt_thr *		threads;
+	ulong			nlocks;		/* times the lock was taken */
+};
+
+/*
+ * Initialize 'mt' as a front end to 'tlsf', which no one may use directly
+ * afterwards.  Returns 0 on success and -1 if unable to allocate a thread
+ * key or mutex.
+ */
+int mtlsf_init(struct mtlsf *mt, struct tlsf *tlsf);
+
+/* Return all cached blocks to the heap.  No thread may use 'mt' after. */
+void mtlsf_fini(struct mtlsf *mt);
+
+void *mtlsf_malloc(struct mtlsf *mt, size_t len);
+void mtlsf_free(struct mtlsf *mt, void *mem);
+void *mtlsf_realloc(struct mtlsf *mt, void *mem, size_t len);
+
+/* Return the calling thread's cached blocks to the heap */
+void mtlsf_flush(struct mtlsf *mt);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_mtlsf_h */
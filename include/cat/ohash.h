@@ -0,0 +1,78 @@
+/*
+ * cat/ohash.h -- Open addressing hash table with grouped control bytes
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_ohash_h
+#define __cat_ohash_h
+
+#include <cat/cat.h>
+#include <cat/aux.h>
+#include <cat/hash.h>
+
+/*
+ * Keys and data pointers are stored in a flat array of slots.  A parallel
+ * array of control bytes holds 7 bits of each occupied slot's hash value
+ * or marks the slot as empty or deleted.  Lookups scan the control bytes
+ * OHT_GRPSZ slots at a time (with SSE2 when available) and only touch the
+ * slot array for candidate matches.  The control byte array must be
+ * OHT_CTLLEN(nslots) bytes long:  the first OHT_GRPSZ bytes are mirrored
+ * at the end so that any group can be loaded without wrapping.
+ */
+
+#define OHT_GRPSZ		16
+#define OHT_CTLLEN(nslots)	((nslots) + OHT_GRPSZ)
+
+#define OHT_EMPTY		0x80
+#define OHT_DELETED		0xFE
+
+struct ohslot {
+	void *			key;
+	void *			data;
+};
+
+struct ohtab {
+	struct ohslot *		slots;
+	uchar *			ctl;
+	uint			nslots;
+	uint			mask;
+	uint			shift;
+	uint			fill;
+	uint			ndel;
+	uint			maxfill;
+	cmp_f			cmp;
+	hash_f			hash;
+	void *			hctx;
+};
+
+/* 'nslots' must be a power of 2 and >= OHT_GRPSZ. */
+void oht_init(struct ohtab *t, struct ohslot *slots, uchar *ctl, uint nslots,
+	      cmp_f cmp, hash_f hash, void *hctx);
+
+/* Hash 'key' using the table's hash function and context */
+uint oht_hash(struct ohtab *t, const void *key);
+
+/* Returns the slot holding 'key' or NULL if not found.  If 'hash' is */
+/* non-NULL, the hash value for the key gets stored there. */
+struct ohslot *oht_lkup(struct ohtab *t, const void *key, uint *hash);
+
+/* Insert a key that is not already in the table using a hash from */
+/* oht_hash() or oht_lkup().  Returns the new slot or NULL if the table */
+/* has reached its maximum fill (see oht_isfull()). */
+struct ohslot *oht_ins(struct ohtab *t, void *key, void *data, uint hash);
+
+/* Remove a slot returned by oht_lkup() or oht_ins() */
+void oht_rem(struct ohtab *t, struct ohslot *slot);
+
+/* Returns non-zero if no more insertions are possible without rehashing. */
+/* Deleted slots count against the fill until the table is rebuilt. */
+int  oht_isfull(struct ohtab *t);
+
+/* Call 'f' with each occupied slot (struct ohslot *) in the table.  */
+/* 'f' may remove the slot it is passed. */
+void oht_apply(struct ohtab *t, apply_f f, void *ctx);
+
+#endif /* __cat_ohash_h */
@@ -0,0 +1,45 @@
+/*
+ * cat/parset.h -- Parallel set operations on balanced trees
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_parset_h
+#define __cat_parset_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <cat/aux.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+
+/*
+ * These work exactly like avl_union(), avl_inter(), avl_diff() and their
+ * red-black tree counterparts.  The difference is that the two halves
+ * produced by splitting on the root of 't2' are independent of each other
+ * and so the top log2('nthreads') levels of the recursion run the halves
+ * in separate threads.  Below that each piece runs sequentially.  With
+ * 'nthreads' <= 1 or when a thread can not be started the work runs in
+ * the calling thread.  'func' may get called from several threads at
+ * once.
+ */
+void avl_punion(struct avltree *t1, struct avltree *t2, apply_f func,
+		void *ctx, int nthreads);
+void avl_pinter(struct avltree *t1, struct avltree *t2, apply_f func,
+		void *ctx, int nthreads);
+void avl_pdiff(struct avltree *t1, struct avltree *t2, apply_f func,
+	       void *ctx, int nthreads);
+
+void rb_punion(struct rbtree *t1, struct rbtree *t2, apply_f func,
+	       void *ctx, int nthreads);
+void rb_pinter(struct rbtree *t1, struct rbtree *t2, apply_f func,
+	       void *ctx, int nthreads);
+void rb_pdiff(struct rbtree *t1, struct rbtree *t2, apply_f func,
+	      void *ctx, int nthreads);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_parset_h */
@@ -27,6 +27,7 @@ struct pcache {
 	unsigned		npools;
 	unsigned		maxpools;
 	unsigned		hiwat;
+	unsigned		maxidle;
 	struct memmgr *		mm;
 };
 
@@ -50,6 +51,14 @@ void  pc_freeall(struct pcache *pc);
 void *pc_alloc(struct pcache *pc);
 void  pc_free(void *item);
 
+/*
+ * Keep at most 'maxidle' completely free pages in 'pc' and return pages
+ * that empty beyond that to the memory manager however many pages 'pc'
+ * holds.  A 'maxidle' of 0 (the default) restores the 'hiwat' policy of
+ * releasing an emptied page only while the cache holds more than 'hiwat'.
+ */
+void  pc_set_maxidle(struct pcache *pc, uint maxidle);
+
 void  pc_addpg(struct pcache *pc, void *page, size_t size);
 void  pc_delpg(void *page);
 
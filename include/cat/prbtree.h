@@ -0,0 +1,129 @@
+/*
+ * cat/prbtree.h -- Persistent red-black tree with lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_prbtree_h
+#define __cat_prbtree_h
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+#include <cat/aux.h>
+#include <cat/epoch.h>
+#include <pthread.h>
+
+/*
+ * A persistent (left-leaning) red-black tree.  Published nodes never
+ * change:  an insert or delete copies the O(log n) nodes on its search
+ * path (plus a constant number per level for rebalancing) and then
+ * publishes the new root.  Readers look entries up in the current
+ * version with no locks, or take a snapshot that stays intact no matter
+ * how the tree changes afterwards.  Writers serialize on a mutex.
+ *
+ * Versions share every node they did not copy so nodes are reference
+ * counted.  The tree's own reference to a replaced root gets dropped
+ * through epoch based reclamation so a reader that loaded the old root
+ * can still finish its lookup.  Keys and data live until the last
+ * version holding them goes away at which point 'key_free' and (if not
+ * NULL) 'data_free' get called on them.
+ */
+
+#define PRB_RED		0
+#define PRB_BLACK	1
+
+/* Height bound for a tree of up to 2^63 entries */
+#define PRB_MAXDEPTH	128
+
+struct prbent;
+
+struct prbnode {
+	struct prbnode *	p[2];	/* left and right children */
+	void *			key;
+	void *			data;
+	struct prbent *		ent;	/* counts nodes sharing key/data */
+	ulong			refs;	/* parents and snapshots using this */
+	ulong			gen;	/* update that created this node */
+	int			col;
+};
+
+struct prbtree;
+
+struct prbtree_attr {
+	cmp_f			kcmp;
+	void *			(*key_dup)(struct prbtree *t, void *k);
+	void			(*key_free)(struct prbtree *t, void *k);
+	void			(*data_free)(struct prbtree *t, void *d);
+	void *			ctx;
+};
+
+struct prbtree {
+	struct prbnode *	root;
+	pthread_mutex_t		lock;	/* serializes writers */
+	ulong			gen;
+	size_t			nkeys;
+	struct prbnode *	spare;	/* preallocated nodes for updates */
+	uint			nspare;
+	cmp_f			cmp;
+	int			abort_on_fail;
+	void *			(*key_dup)(struct prbtree *t, void *k);
+	void			(*key_free)(struct prbtree *t, void *k);
+	void			(*data_free)(struct prbtree *t, void *d);
+	void *			ctx;
+	struct ebr		ebr;
+};
+
+/* An immutable version of a tree */
+struct prbsnap {
+	struct prbtree *	tree;
+	struct prbnode *	root;
+};
+
+/* In-order position in a snapshot */
+struct prb_cursor {
+	struct prbnode *	stk[PRB_MAXDEPTH];
+	int			top;
+};
+
+#define prb_ckey(c)	((c)->stk[(c)->top - 1]->key)
+#define prb_cdata(c)	((c)->stk[(c)->top - 1]->data)
+
+extern struct prbtree_attr prb_std_attr_skey;	/* string key tree */
+extern struct prbtree_attr prb_std_attr_rkey;	/* raw key tree */
+extern struct prbtree_attr prb_std_attr_pkey;	/* ptr key tree */
+extern struct prbtree_attr prb_std_attr_bkey;	/* binary key tree */
+
+struct prbtree *prb_new(struct prbtree_attr *attr, int abort_on_fail);
+
+/* No other thread may use the tree and no snapshot of it may remain */
+void		prb_free(struct prbtree *t);
+
+/* Look 'key' up in the current version */
+void *		prb_get(struct prbtree *t, void *key);
+
+/* Returns 1 if 'key' was present and its data replaced, 0 if a new */
+/* entry was added and -1 on allocation failure (tree unchanged). */
+int		prb_put(struct prbtree *t, void *key, void *data);
+
+/* Returns 1 if 'key' was removed, 0 if it was not present and -1 on */
+/* allocation failure (tree unchanged). */
+int		prb_del(struct prbtree *t, void *key);
+
+/* Take a snapshot of the current version and release it when done */
+void		prb_snap(struct prbtree *t, struct prbsnap *s);
+void		prb_srelease(struct prbsnap *s);
+
+void *		prb_sget(struct prbsnap *s, void *key);
+
+/* Cursor operations return 1 if the cursor refers to an entry afterwards */
+/* and 0 if it ran off the end of the snapshot. */
+int		prb_sfirst(struct prbsnap *s, struct prb_cursor *c);
+int		prb_slbound(struct prbsnap *s, void *key, struct prb_cursor *c);
+int		prb_next(struct prb_cursor *c);
+
+#endif /* CAT_HAS_POSIX */
+
+#endif /* __cat_prbtree_h */
@@ -13,6 +13,16 @@
 #include <cat/cat.h>
 #include <cat/aux.h>
 
+/*
+ * When CAT_RB_RANK is non-zero every node tracks the size of its subtree
+ * so rb_select() and rb_rank() run in O(log n).  This changes the layout
+ * of 'struct rbnode' so the library and all code sharing trees with it must
+ * be built with the same setting.  Trees without it pay nothing.
+ */
+#ifndef CAT_RB_RANK
+#define CAT_RB_RANK 0
+#endif /* CAT_RB_RANK */
+
 /* Structure for a Red-Black tree node: to be embedded in other structures */
 struct rbnode {
 	struct rbnode *	p[3];   /* child/parent pointers */
@@ -20,6 +30,9 @@ struct rbnode {
 	char		col;    /* node color (CRB_RED or CRB_BLACK) */
 	struct rbtree *	tree;   /* the tree that owns this node */
 	void *		key;    /* the key of the node */
+#if CAT_RB_RANK
+	ulong		cnt;	/* number of nodes in this subtree */
+#endif /* CAT_RB_RANK */
 } ;
 
 #define CRB_L 0	/* left node */
@@ -83,7 +96,8 @@ DECL struct rbnode * rb_lkup(struct rbtree *t, const void *key, int *dir);
 /*
  * Insert a new node 'n' into a Red-Black tree 't' with 'loc' as the parent,
  * and dir indicating which pointer in 'loc' will point to 'n'.  See rb_lkup()
- * for how to find the correct 'loc' and 'dir' values.
+ * for how to find the correct 'loc' and 'dir' values.  If 'dir' is CRB_N
+ * then 'n' replaces 'loc' which gets returned.
  */
 DECL struct rbnode * rb_ins(struct rbtree *t, struct rbnode *node, 
 			    struct rbnode *loc, int dir);
@@ -106,15 +120,87 @@ DECL struct rbnode * rb_getmin(struct rbtree *t);
 /* Return a pointer to the maximum node in 't' or NULL if the tree is empty */
 DECL struct rbnode * rb_getmax(struct rbtree *t);
 
+/*
+ * Return the node after or before 'n' in key order or NULL if there is
+ * none.  Walking a whole tree this way costs O(1) amortized per node.
+ */
+DECL struct rbnode * rb_next(struct rbnode *n);
+DECL struct rbnode * rb_prev(struct rbnode *n);
+
+/* Return the first node in 't' whose key is >= 'key' or NULL if none is */
+DECL struct rbnode * rb_lbound(struct rbtree *t, const void *key);
+
+/* Return the first node in 't' whose key is > 'key' or NULL if none is */
+DECL struct rbnode * rb_ubound(struct rbtree *t, const void *key);
+
+/*
+ * Build 't' from the 'n' nodes in 'nodes' in O(n) time.  'nodes' must be
+ * sorted in strictly increasing key order, their keys must be set and 't'
+ * must be empty.  The resulting tree is perfectly balanced.
+ */
+DECL void rb_build(struct rbtree *t, struct rbnode **nodes, ulong n);
+
+/*
+ * Store the nodes of 't' in key order in 'nodes' and return how many
+ * nodes the tree holds.  If that is no more than 'max' the nodes are also
+ * removed from 't' leaving it empty.  Otherwise 't' is unchanged and only
+ * the first 'max' nodes are stored.
+ */
+DECL ulong rb_flatten(struct rbtree *t, struct rbnode **nodes, ulong max);
+
+/*
+ * Join based split, join and set operations with the same interface and
+ * costs as those of the AVL tree:  see avl.h.
+ */
+DECL struct rbnode * rb_split(struct rbtree *t, const void *key,
+			      struct rbtree *gt);
+DECL void rb_join(struct rbtree *t1, struct rbnode *k, struct rbtree *t2);
+DECL void rb_union(struct rbtree *t1, struct rbtree *t2, apply_f func,
+		   void *ctx);
+DECL void rb_inter(struct rbtree *t1, struct rbtree *t2, apply_f func,
+		   void *ctx);
+DECL void rb_diff(struct rbtree *t1, struct rbtree *t2, apply_f func,
+		  void *ctx);
+
+#if CAT_RB_RANK
+/* Return the number of nodes in 't' */
+DECL ulong rb_count(struct rbtree *t);
+
+/* Return the node with in-order index 'k' (from 0) or NULL if k >= count */
+DECL struct rbnode * rb_select(struct rbtree *t, ulong k);
+
+/* Return the number of nodes in 't' whose keys are less than 'key' */
+DECL ulong rb_rank(struct rbtree *t, const void *key);
+#endif /* CAT_RB_RANK */
+
 
 /* ----- Auxiliary (helper) functions (don't use) ----- */
 DECL void rb_findloc(struct rbtree *t, const void *key, struct rbnode **p, 
 		     int *dir);
 DECL void rb_ins_at(struct rbtree *t, struct rbnode *node, struct rbnode *par, 
 		    int dir);
+DECL int rb_ins_fix(struct rbtree *t, struct rbnode *node);
 DECL void rb_fix(struct rbnode *par, struct rbnode *cld, int dir);
 DECL void rb_rleft(struct rbnode *n);
 DECL void rb_rright(struct rbnode *n);
+DECL int rb_bheight(struct rbtree *t);
+DECL int rb_join_h(struct rbtree *t1, int h1, struct rbnode *k,
+		   struct rbtree *t2, int h2);
+DECL struct rbnode *rb_split_h(struct rbtree *t, int h, const void *key,
+			       struct rbtree *gt, int *lh, int *gh);
+DECL void rb_concat(struct rbtree *t1, struct rbtree *t2);
+DECL void rb_setown(struct rbtree *t, struct rbtree *own);
+DECL void rb_drain(struct rbtree *t, apply_f func, void *ctx);
+DECL void rb_union_r(struct rbtree *t1, struct rbtree *t2,
+		     struct rbtree *own, apply_f func, void *ctx);
+DECL void rb_inter_r(struct rbtree *t1, struct rbnode *n2, apply_f func,
+		     void *ctx);
+DECL void rb_diff_r(struct rbtree *t1, struct rbnode *n2, apply_f func,
+		    void *ctx);
+#if CAT_RB_RANK
+DECL void rb_recnt(struct rbnode *n);
+DECL void rb_recnt_up(struct rbnode *n, int dir);
+#endif /* CAT_RB_RANK */
 
 
 /* ------ Implementation ----- */
@@ -137,6 +223,9 @@ DECL void rb_ninit(struct rbnode *n, void *k)
 	n->pdir = 0;
 	n->col  = CRB_RED;
 	n->key  = k;
+#if CAT_RB_RANK
+	n->cnt  = 1;
+#endif /* CAT_RB_RANK */
 }
 
 
@@ -177,7 +266,8 @@ DECL struct rbnode *rb_ins(struct rbtree *t, struct rbnode *node,
 	if ( loc ) {
 		p = loc;
 		dir = atdir;
-		abort_unless((dir == CRB_L) || (dir == CRB_R) || 
+		abort_unless((dir == CRB_L) || (dir == CRB_R) ||
+			     (dir == CRB_N) ||
 			     ((dir == CRB_P) && (p == &t->root)));
 	}
 	else {
@@ -189,6 +279,9 @@ DECL struct rbnode *rb_ins(struct rbtree *t, struct rbnode *node,
 		rb_fix(node, p->p[CRB_R], CRB_R);
 		rb_fix(p->p[CRB_P], node, p->pdir);
 		node->col = p->col;
+#if CAT_RB_RANK
+		node->cnt = p->cnt;
+#endif /* CAT_RB_RANK */
 		node->tree = t;
 		p->tree = NULL;
 		p->col = CRB_RED;
@@ -284,7 +377,6 @@ DECL void rb_findloc(struct rbtree *t, const void *key, struct rbnode **pn,
 DECL void rb_ins_at(struct rbtree *t, struct rbnode *node, struct rbnode *par, 
 								    int dir)
 {
-	struct rbnode *gp, *unc, *tmp;
 	abort_unless(t);
 	abort_unless(node);
 	abort_unless(par);
@@ -292,6 +384,20 @@ DECL void rb_ins_at(struct rbtree *t, struct rbnode *node, struct rbnode *par,
 
 	node->col = CRB_RED;
 	rb_fix(par, node, dir);
+#if CAT_RB_RANK
+	node->cnt = 1;
+	rb_recnt_up(par, dir);
+#endif /* CAT_RB_RANK */
+	rb_ins_fix(t, node);
+}
+
+
+/* Restore the red-black properties above the red node 'node'.  Returns 1 */
+/* if that turned the root red (and so it was recolored black) or 0 if not. */
+DECL int rb_ins_fix(struct rbtree *t, struct rbnode *node)
+{
+	struct rbnode *par, *gp, *unc, *tmp;
+
 	while ( node != t->rb_root && (par = node->p[CRB_P])->col == CRB_RED ) {
 
 		if ( par->pdir == CRB_L ) { 
@@ -337,7 +443,10 @@ DECL void rb_ins_at(struct rbtree *t, struct rbnode *node, struct rbnode *par,
 		}
 	}
 
+	if ( t->rb_root->col == CRB_BLACK )
+		return 0;
 	t->rb_root->col = CRB_BLACK;
+	return 1;
 }
 
 
@@ -395,6 +504,10 @@ DECL void rb_rem(struct rbnode *node)
 		rb_fix(node->p[CRB_P], tmp, node->pdir);
 	}
 	rb_ninit(node, node->key);
+#if CAT_RB_RANK
+	/* rotations below preserve subtree sizes above the rotated nodes */
+	rb_recnt_up(par, cdir);
+#endif /* CAT_RB_RANK */
 	if ( oldc == CRB_RED )
 		return;
 
@@ -505,6 +618,631 @@ DECL struct rbnode * rb_getmax(struct rbtree *t)
 }
 
 
+DECL struct rbnode * rb_next(struct rbnode *n)
+{
+	abort_unless(n);
+	if ( n->p[CRB_R] != NULL ) {
+		n = n->p[CRB_R];
+		while ( n->p[CRB_L] != NULL )
+			n = n->p[CRB_L];
+		return n;
+	}
+	while ( n->pdir == CRB_R )
+		n = n->p[CRB_P];
+	return (n->pdir == CRB_P) ? NULL : n->p[CRB_P];
+}
+
+
+DECL struct rbnode * rb_prev(struct rbnode *n)
+{
+	abort_unless(n);
+	if ( n->p[CRB_L] != NULL ) {
+		n = n->p[CRB_L];
+		while ( n->p[CRB_R] != NULL )
+			n = n->p[CRB_R];
+		return n;
+	}
+	while ( n->pdir == CRB_L )
+		n = n->p[CRB_P];
+	return (n->pdir == CRB_P) ? NULL : n->p[CRB_P];
+}
+
+
+DECL struct rbnode * rb_lbound(struct rbtree *t, const void *key)
+{
+	struct rbnode *node, *best = NULL;
+	int rv;
+
+	abort_unless(t);
+	node = t->rb_root;
+	while ( node != NULL ) {
+		rv = (*t->cmp)(key, node->key);
+		if ( rv <= 0 ) {
+			best = node;
+			if ( rv == 0 )
+				break;
+			node = node->p[CRB_L];
+		} else {
+			node = node->p[CRB_R];
+		}
+	}
+	return best;
+}
+
+
+DECL struct rbnode * rb_ubound(struct rbtree *t, const void *key)
+{
+	struct rbnode *node, *best = NULL;
+
+	abort_unless(t);
+	node = t->rb_root;
+	while ( node != NULL ) {
+		if ( (*t->cmp)(key, node->key) < 0 ) {
+			best = node;
+			node = node->p[CRB_L];
+		} else {
+			node = node->p[CRB_R];
+		}
+	}
+	return best;
+}
+
+
+#if CAT_RB_RANK
+
+#define RB_CNT(n)	((n) != NULL ? (n)->cnt : 0)
+
+DECL ulong rb_count(struct rbtree *t)
+{
+	abort_unless(t);
+	return RB_CNT(t->rb_root);
+}
+
+
+DECL struct rbnode *rb_select(struct rbtree *t, ulong k)
+{
+	struct rbnode *node;
+	ulong lcnt;
+
+	abort_unless(t);
+	node = t->rb_root;
+	while ( node != NULL ) {
+		lcnt = RB_CNT(node->p[CRB_L]);
+		if ( k < lcnt ) {
+			node = node->p[CRB_L];
+		} else if ( k == lcnt ) {
+			return node;
+		} else {
+			k -= lcnt + 1;
+			node = node->p[CRB_R];
+		}
+	}
+	return NULL;
+}
+
+
+DECL ulong rb_rank(struct rbtree *t, const void *key)
+{
+	struct rbnode *node;
+	ulong rank = 0;
+	int rv;
+
+	abort_unless(t);
+	node = t->rb_root;
+	while ( node != NULL ) {
+		rv = (*t->cmp)(key, node->key);
+		if ( rv < 0 ) {
+			node = node->p[CRB_L];
+		} else if ( rv == 0 ) {
+			return rank + RB_CNT(node->p[CRB_L]);
+		} else {
+			rank += RB_CNT(node->p[CRB_L]) + 1;
+			node = node->p[CRB_R];
+		}
+	}
+	return rank;
+}
+
+
+DECL void rb_recnt(struct rbnode *n)
+{
+	n->cnt = 1 + RB_CNT(n->p[CRB_L]) + RB_CNT(n->p[CRB_R]);
+}
+
+
+/* Recount 'n' and its ancestors.  'dir' == CRB_P means 'n' is the tree */
+/* root sentinel and there is nothing to count. */
+DECL void rb_recnt_up(struct rbnode *n, int dir)
+{
+	while ( dir != CRB_P ) {
+		rb_recnt(n);
+		dir = n->pdir;
+		n = n->p[CRB_P];
+	}
+}
+
+#undef RB_CNT
+
+#endif /* CAT_RB_RANK */
+
+
+DECL void rb_build(struct rbtree *t, struct rbnode **nodes, ulong n)
+{
+	struct {
+		ulong		lo;
+		ulong		len;
+		struct rbnode *	par;
+		int		dir;
+		int		depth;
+	} stk[sizeof(ulong) * 8 + 1];
+	struct rbnode *node, *par;
+	ulong lo, len, l, r;
+	int top, dir, depth, reddepth;
+
+	abort_unless(t);
+	abort_unless(t->rb_root == NULL);
+	abort_unless(nodes || n == 0);
+	if ( n == 0 )
+		return;
+
+	/* Splitting at the midpoint fills every level but the deepest one. */
+	/* Color the deepest level red if it is partial and all else black. */
+	for ( l = n, reddepth = 0; l > 0; l >>= 1 )
+		++reddepth;
+	if ( (n & (n + 1)) == 0 )
+		reddepth = -1;
+	else
+		reddepth -= 1;
+
+	stk[0].lo = 0;
+	stk[0].len = n;
+	stk[0].par = &t->root;
+	stk[0].dir = CRB_P;
+	stk[0].depth = 0;
+	top = 1;
+	while ( top > 0 ) {
+		--top;
+		lo = stk[top].lo;
+		len = stk[top].len;
+		par = stk[top].par;
+		dir = stk[top].dir;
+		depth = stk[top].depth;
+		/* the right subtree gets the extra node when 'len' is even */
+		l = (len - 1) / 2;
+		r = len - 1 - l;
+		node = nodes[lo + l];
+		rb_ninit(node, node->key);
+		node->tree = t;
+		node->col = (depth == reddepth) ? CRB_RED : CRB_BLACK;
+#if CAT_RB_RANK
+		node->cnt = len;
+#endif /* CAT_RB_RANK */
+		rb_fix(par, node, dir);
+		if ( r > 0 ) {
+			stk[top].lo = lo + l + 1;
+			stk[top].len = r;
+			stk[top].par = node;
+			stk[top].dir = CRB_R;
+			stk[top].depth = depth + 1;
+			++top;
+		}
+		if ( l > 0 ) {
+			stk[top].lo = lo;
+			stk[top].len = l;
+			stk[top].par = node;
+			stk[top].dir = CRB_L;
+			stk[top].depth = depth + 1;
+			++top;
+		}
+	}
+}
+
+
+DECL ulong rb_flatten(struct rbtree *t, struct rbnode **nodes, ulong max)
+{
+	struct rbnode *trav;
+	ulong n = 0, i;
+
+	abort_unless(t);
+	abort_unless(nodes || max == 0);
+	for ( trav = rb_getmin(t); trav != NULL; trav = rb_next(trav) ) {
+		if ( n < max )
+			nodes[n] = trav;
+		++n;
+	}
+
+	if ( n <= max ) {
+		for ( i = 0; i < n; ++i ) {
+			rb_ninit(nodes[i], nodes[i]->key);
+			nodes[i]->tree = NULL;
+		}
+		t->rb_root = NULL;
+	}
+	return n;
+}
+
+
+/* Red-black trees are at most 2 * log2(n) deep */
+#define RB_MAXDEPTH	(sizeof(ulong) * 16)
+
+DECL struct rbnode *rb_split(struct rbtree *t, const void *key,
+			     struct rbtree *gt)
+{
+	struct rbnode *n;
+	int lh, gh;
+
+	abort_unless(t);
+	abort_unless(gt);
+	abort_unless(gt->rb_root == NULL);
+	n = rb_split_h(t, rb_bheight(t), key, gt, &lh, &gh);
+	rb_setown(gt, gt);
+	if ( n != NULL )
+		n->tree = NULL;
+	return n;
+}
+
+
+DECL void rb_join(struct rbtree *t1, struct rbnode *k, struct rbtree *t2)
+{
+	abort_unless(t1);
+	abort_unless(k);
+	abort_unless(t2);
+	rb_setown(t2, t1);
+	k->tree = t1;
+	rb_join_h(t1, rb_bheight(t1), k, t2, rb_bheight(t2));
+}
+
+
+DECL void rb_union(struct rbtree *t1, struct rbtree *t2, apply_f func,
+		   void *ctx)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	rb_union_r(t1, t2, t1, func, ctx);
+	if ( t1->rb_root != NULL )
+		t1->rb_root->col = CRB_BLACK;
+}
+
+
+DECL void rb_inter(struct rbtree *t1, struct rbtree *t2, apply_f func,
+		   void *ctx)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	rb_inter_r(t1, t2->rb_root, func, ctx);
+	if ( t1->rb_root != NULL )
+		t1->rb_root->col = CRB_BLACK;
+}
+
+
+DECL void rb_diff(struct rbtree *t1, struct rbtree *t2, apply_f func,
+		  void *ctx)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	rb_diff_r(t1, t2->rb_root, func, ctx);
+	if ( t1->rb_root != NULL )
+		t1->rb_root->col = CRB_BLACK;
+}
+
+
+/* Number of black nodes on any path from the root down to a leaf */
+DECL int rb_bheight(struct rbtree *t)
+{
+	struct rbnode *n;
+	int h = 0;
+
+	for ( n = t->rb_root; n != NULL; n = n->p[CRB_L] )
+		if ( n->col == CRB_BLACK )
+			++h;
+	return h;
+}
+
+
+/*
+ * Join 't1' (of black height 'h1'), 'k' and 't2' (of black height 'h2')
+ * into 't1' and return the black height of the result.  Owners do not
+ * change.  Both roots get colored black first.  Then 'k' goes down the
+ * facing side of the tree with the greater black height until it finds
+ * a black node with the black height of the other tree.  'k' replaces it
+ * as a red node with it and the other tree as children and gets fixed up
+ * like any red node inserted there.
+ */
+DECL int rb_join_h(struct rbtree *t1, int h1, struct rbnode *k,
+		   struct rbtree *t2, int h2)
+{
+	struct rbnode *r1, *r2, *par, *c;
+	int h, hc;
+
+	abort_unless(t1);
+	abort_unless(k);
+	abort_unless(t2);
+
+	r1 = t1->rb_root;
+	r2 = t2->rb_root;
+	if ( r1 != NULL && r1->col == CRB_RED ) {
+		r1->col = CRB_BLACK;
+		++h1;
+	}
+	if ( r2 != NULL && r2->col == CRB_RED ) {
+		r2->col = CRB_BLACK;
+		++h2;
+	}
+
+	if ( h1 == h2 ) {
+		rb_fix(k, r1, CRB_L);
+		rb_fix(k, r2, CRB_R);
+		k->col = CRB_BLACK;
+		rb_fix(&t1->root, k, CRB_P);
+		t2->rb_root = NULL;
+#if CAT_RB_RANK
+		rb_recnt(k);
+#endif /* CAT_RB_RANK */
+		return h1 + 1;
+	}
+
+	if ( h1 > h2 ) {
+		h = h1;
+		c = r1;
+		hc = h1;
+		do {
+			if ( c->col == CRB_BLACK )
+				--hc;
+			par = c;
+			c = c->p[CRB_R];
+		} while ( c != NULL && (c->col == CRB_RED || hc != h2) );
+		abort_unless(hc == h2);
+		rb_fix(k, c, CRB_L);
+		rb_fix(k, r2, CRB_R);
+		k->col = CRB_RED;
+		rb_fix(par, k, CRB_R);
+		t2->rb_root = NULL;
+	} else {
+		h = h2;
+		c = r2;
+		hc = h2;
+		do {
+			if ( c->col == CRB_BLACK )
+				--hc;
+			par = c;
+			c = c->p[CRB_L];
+		} while ( c != NULL && (c->col == CRB_RED || hc != h1) );
+		abort_unless(hc == h1);
+		rb_fix(k, r1, CRB_L);
+		rb_fix(k, c, CRB_R);
+		k->col = CRB_RED;
+		rb_fix(par, k, CRB_L);
+		rb_fix(&t1->root, r2, CRB_P);
+		t2->rb_root = NULL;
+	}
+#if CAT_RB_RANK
+	rb_recnt(k);
+	rb_recnt_up(par, k->pdir);
+#endif /* CAT_RB_RANK */
+
+	return h + rb_ins_fix(t1, k);
+}
+
+
+/*
+ * Split 't' of black height 'h' at 'key' leaving the lesser keys in 't'
+ * and putting the greater ones in the empty tree 'gt' exactly like
+ * avl_split_h() does.  Both trees end up with black roots and their black
+ * heights in 'lh' and 'gh'.
+ */
+DECL struct rbnode *rb_split_h(struct rbtree *t, int h, const void *key,
+			       struct rbtree *gt, int *lh, int *gh)
+{
+	struct {
+		struct rbnode *	n;
+		int		h;
+		int		dir;
+	} path[RB_MAXDEPTH];
+	struct rbnode *n, *found = NULL;
+	struct rbtree tmp;
+	int top = 0, rv, hc;
+
+	abort_unless(t);
+	abort_unless(gt);
+	abort_unless(gt->rb_root == NULL);
+	abort_unless(lh);
+	abort_unless(gh);
+
+	n = t->rb_root;
+	while ( n != NULL ) {
+		rv = (*t->cmp)(key, n->key);
+		if ( rv == 0 ) {
+			found = n;
+			break;
+		}
+		abort_unless(top < RB_MAXDEPTH);
+		path[top].n = n;
+		path[top].h = h;
+		path[top].dir = (rv < 0) ? CRB_L : CRB_R;
+		h -= (n->col == CRB_BLACK);
+		n = n->p[path[top].dir];
+		++top;
+	}
+
+	t->rb_root = NULL;
+	*lh = *gh = 0;
+	if ( found != NULL ) {
+		*lh = *gh = h - (found->col == CRB_BLACK);
+		rb_fix(&t->root, found->p[CRB_L], CRB_P);
+		rb_fix(&gt->root, found->p[CRB_R], CRB_P);
+		rb_ninit(found, found->key);
+	}
+
+	rb_init(&tmp, t->cmp);
+	while ( top > 0 ) {
+		--top;
+		n = path[top].n;
+		hc = path[top].h - (n->col == CRB_BLACK);
+		if ( path[top].dir == CRB_L ) {
+			rb_fix(&tmp.root, n->p[CRB_R], CRB_P);
+			*gh = rb_join_h(gt, *gh, n, &tmp, hc);
+		} else {
+			rb_fix(&tmp.root, n->p[CRB_L], CRB_P);
+			*lh = rb_join_h(&tmp, hc, n, t, *lh);
+			rb_fix(&t->root, tmp.rb_root, CRB_P);
+			tmp.rb_root = NULL;
+		}
+	}
+
+	if ( t->rb_root != NULL && t->rb_root->col == CRB_RED ) {
+		t->rb_root->col = CRB_BLACK;
+		++*lh;
+	}
+	if ( gt->rb_root != NULL && gt->rb_root->col == CRB_RED ) {
+		gt->rb_root->col = CRB_BLACK;
+		++*gh;
+	}
+
+	return found;
+}
+
+
+/* Join 't1' and 't2' where all keys in 't1' are less than those in 't2' */
+DECL void rb_concat(struct rbtree *t1, struct rbtree *t2)
+{
+	struct rbtree rest;
+	struct rbnode *k;
+	int lh, gh;
+
+	if ( t2->rb_root == NULL )
+		return;
+	rb_init(&rest, t2->cmp);
+	k = rb_getmin(t2);
+	k = rb_split_h(t2, rb_bheight(t2), k->key, &rest, &lh, &gh);
+	rb_join_h(t1, rb_bheight(t1), k, &rest, gh);
+}
+
+
+DECL void rb_setown(struct rbtree *t, struct rbtree *own)
+{
+	struct rbnode *n;
+
+	for ( n = rb_getmin(t); n != NULL; n = rb_next(n) )
+		n->tree = own;
+}
+
+
+/* Empty 't' passing each of its nodes to 'func' once it is detached */
+DECL void rb_drain(struct rbtree *t, apply_f func, void *ctx)
+{
+	struct rbnode *n, *par;
+	int dir;
+
+	n = t->rb_root;
+	while ( n != NULL ) {
+		if ( n->p[CRB_L] != NULL ) {
+			n = n->p[CRB_L];
+		} else if ( n->p[CRB_R] != NULL ) {
+			n = n->p[CRB_R];
+		} else {
+			par = n->p[CRB_P];
+			dir = n->pdir;
+			rb_ninit(n, n->key);
+			n->tree = NULL;
+			if ( func != NULL )
+				func(n, ctx);
+			par->p[dir] = NULL;
+			n = (dir == CRB_P) ? NULL : par;
+		}
+	}
+}
+
+
+/* 't1' = 't1' U 't2' where nodes moving into the union get 'own' as owner */
+DECL void rb_union_r(struct rbtree *t1, struct rbtree *t2,
+		     struct rbtree *own, apply_f func, void *ctx)
+{
+	struct rbtree l2, r1;
+	struct rbnode *k, *b;
+	int lh, gh;
+
+	k = t2->rb_root;
+	if ( k == NULL )
+		return;
+	if ( t1->rb_root == NULL ) {
+		rb_setown(t2, own);
+		rb_fix(&t1->root, k, CRB_P);
+		t2->rb_root = NULL;
+		return;
+	}
+
+	rb_init(&l2, t2->cmp);
+	rb_init(&r1, t1->cmp);
+	rb_fix(&l2.root, k->p[CRB_L], CRB_P);
+	rb_fix(&t2->root, k->p[CRB_R], CRB_P);
+	b = rb_split_h(t1, rb_bheight(t1), k->key, &r1, &lh, &gh);
+	rb_union_r(t1, &l2, own, func, ctx);
+	rb_union_r(&r1, t2, own, func, ctx);
+	if ( b != NULL ) {
+		rb_join_h(t1, rb_bheight(t1), b, &r1, rb_bheight(&r1));
+		rb_ninit(k, k->key);
+		k->tree = NULL;
+		if ( func != NULL )
+			func(k, ctx);
+	} else {
+		k->tree = own;
+		rb_join_h(t1, rb_bheight(t1), k, &r1, rb_bheight(&r1));
+	}
+}
+
+
+/* 't1' = 't1' ^ the keys in the subtree rooted at 'n2' */
+DECL void rb_inter_r(struct rbtree *t1, struct rbnode *n2, apply_f func,
+		     void *ctx)
+{
+	struct rbtree r1;
+	struct rbnode *b;
+	int lh, gh;
+
+	if ( t1->rb_root == NULL )
+		return;
+	if ( n2 == NULL ) {
+		rb_drain(t1, func, ctx);
+		return;
+	}
+
+	rb_init(&r1, t1->cmp);
+	b = rb_split_h(t1, rb_bheight(t1), n2->key, &r1, &lh, &gh);
+	rb_inter_r(t1, n2->p[CRB_L], func, ctx);
+	rb_inter_r(&r1, n2->p[CRB_R], func, ctx);
+	if ( b != NULL )
+		rb_join_h(t1, rb_bheight(t1), b, &r1, rb_bheight(&r1));
+	else
+		rb_concat(t1, &r1);
+}
+
+
+/* 't1' = 't1' - the keys in the subtree rooted at 'n2' */
+DECL void rb_diff_r(struct rbtree *t1, struct rbnode *n2, apply_f func,
+		    void *ctx)
+{
+	struct rbtree r1;
+	struct rbnode *b;
+	int lh, gh;
+
+	if ( t1->rb_root == NULL || n2 == NULL )
+		return;
+
+	rb_init(&r1, t1->cmp);
+	b = rb_split_h(t1, rb_bheight(t1), n2->key, &r1, &lh, &gh);
+	rb_diff_r(t1, n2->p[CRB_L], func, ctx);
+	rb_diff_r(&r1, n2->p[CRB_R], func, ctx);
+	rb_concat(t1, &r1);
+	if ( b != NULL ) {
+		b->tree = NULL;
+		if ( func != NULL )
+			func(b, ctx);
+	}
+}
+
+#undef RB_MAXDEPTH
+
+
 DECL void rb_fix(struct rbnode *par, struct rbnode *cld, int dir)
 {
 
@@ -527,6 +1265,10 @@ DECL void rb_rleft(struct rbnode *n)
 	rb_fix(n, c->p[CRB_L], CRB_R);
 	rb_fix(n->p[CRB_P], c, n->pdir);
 	rb_fix(c, n, CRB_L);
+#if CAT_RB_RANK
+	rb_recnt(n);
+	rb_recnt(c);
+#endif /* CAT_RB_RANK */
 }
 
 
@@ -539,6 +1281,10 @@ DECL void rb_rright(struct rbnode *n)
 	rb_fix(n, c->p[CRB_R], CRB_L);
 	rb_fix(n->p[CRB_P], c, n->pdir);
 	rb_fix(c, n, CRB_R);
+#if CAT_RB_RANK
+	rb_recnt(n);
+	rb_recnt(c);
+#endif /* CAT_RB_RANK */
 }
 
 #endif /* CAT_RB_DO_DECL */
@@ -0,0 +1,74 @@
+/*
+ * cat/rheap.h -- Monotone radix heap for integer keys
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_rheap_h
+#define __cat_rheap_h
+
+#include <cat/cat.h>
+#include <cat/list.h>
+
+/*
+ * A radix heap is a min priority queue for unsigned integer keys where
+ * a key added may never be less than the last key extracted, as with
+ * Dijkstra's algorithm or timeouts on a clock that only moves forward.
+ * Elements live in bucket lists chosen by the highest bit where their
+ * key differs from the last extracted key.  When the lowest bucket runs
+ * out, the next non-empty bucket is split among the lower ones.  Each
+ * element moves down at most once per bucket, so operations cost
+ * amortized O(log C) for keys spanning a range of C, with no comparison
+ * function at all.
+ */
+
+#if CAT_64BIT
+typedef uint64_t rhkey_t;
+#define RH_KEYBITS	64
+#else /* CAT_64BIT */
+typedef uint32_t rhkey_t;
+#define RH_KEYBITS	32
+#endif /* CAT_64BIT */
+
+#define RH_NBKTS	(RH_KEYBITS + 1)
+
+struct rhnode {
+	struct list		entry;
+	rhkey_t			key;
+};
+
+struct rheap {
+	rhkey_t			last;	/* key of the last extracted element */
+	rhkey_t			bmap;	/* bit 'i - 1' set if bucket 'i' is used */
+	ulong			fill;	/* number of elements in the heap */
+	struct rhnode *		top;	/* a least node if known, or NULL */
+	struct list		bkts[RH_NBKTS];
+};
+
+/* Initialize an empty heap:  added keys must be >= 'base'. */
+void rh_init(struct rheap *hp, rhkey_t base);
+
+/* Initialize 'n' with key 'key' */
+void rh_ninit(struct rhnode *n, rhkey_t key);
+
+/*
+ * Add 'n' to 'hp'.  Returns 0 on success or -1 if 'n->key' is less than
+ * the last key extracted.
+ */
+int rh_add(struct rheap *hp, struct rhnode *n);
+
+/* Returns the node with the least key in 'hp' or NULL if 'hp' is empty. */
+struct rhnode *rh_top(struct rheap *hp);
+
+/* Removes and returns the least node in 'hp' or NULL if 'hp' is empty. */
+struct rhnode *rh_extract(struct rheap *hp);
+
+/*
+ * Remove 'n' from 'hp'.  To lower a key (as in Dijkstra's decrease-key),
+ * remove the node, change its key and add it again.
+ */
+void rh_rem(struct rheap *hp, struct rhnode *n);
+
+#endif /* __cat_rheap_h */
@@ -0,0 +1,92 @@
+/*
+ * cat/slab.h -- Slab memory manager with geometric size classes
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_slab_h
+#define __cat_slab_h
+
+#include <cat/cat.h>
+#include <cat/mem.h>
+#include <cat/pcache.h>
+
+/*
+ * A memory manager that serves small requests from a set of pool caches,
+ * one per size class.  The classes run from SLAB_MINSZ to SLAB_MAXSZ bytes
+ * in 4 geometric steps per power of 2 (16, 20, 24, 28, 32, 40, ...) so a
+ * request wastes at most 25% of its block to rounding.  Requests larger
+ * than SLAB_MAXSZ go to the backing memory manager, which also supplies
+ * the pages for the caches:  for example a TLSF heap through mtlsf or the
+ * standard library through estdmm.
+ */
+
+#define SLAB_LG2MIN	4
+#define SLAB_LG2MAX	12
+#define SLAB_MINSZ	(1 << SLAB_LG2MIN)
+#define SLAB_MAXSZ	(1 << SLAB_LG2MAX)
+#define SLAB_NCLASS	((SLAB_LG2MAX - SLAB_LG2MIN) * 4 + 1)
+
+/*
+ * Completely free pages each class keeps (see pc_set_maxidle()).  A page
+ * that empties beyond these goes back to the backing manager.
+ */
+#ifndef SLAB_HIWAT
+#define SLAB_HIWAT	2
+#endif /* SLAB_HIWAT */
+
+struct slab_class {
+	struct pcache		pc;
+	size_t			isize;		/* bytes per item */
+	ulong			nitems;		/* items allocated now */
+	ulong			nalloc;		/* allocations ever */
+	ulong			reqbytes;	/* bytes those requested */
+};
+
+struct slabmm {
+	struct memmgr		mm;
+	struct memmgr *		pgmm;
+	size_t			pgsiz;
+	ulong			nlarge;		/* large blocks allocated now */
+	size_t			lgbytes;	/* bytes in those blocks */
+	struct slab_class	classes[SLAB_NCLASS];
+};
+
+/*
+ * Statistics for one size class.  'idle' is the number of bytes in the
+ * class' pages that hold no live item (including page headers and the
+ * pointer before each item).  'rounding' is the number of bytes lost to
+ * rounding requests up to the item size over all allocations so far.
+ */
+struct slab_stats {
+	size_t			isize;
+	ulong			npages;
+	ulong			capacity;	/* items the pages can hold */
+	ulong			nitems;
+	ulong			nalloc;
+	size_t			idle;
+	size_t			rounding;
+};
+
+/*
+ * Initialize 'sm' to get pages of 'pgsiz' bytes (PC_DEF_SIZE if 0) and
+ * large blocks from 'pgmm'.  The manager to use is '&sm->mm'.
+ */
+void slab_init(struct slabmm *sm, size_t pgsiz, struct memmgr *pgmm);
+
+/* Free all pages.  Large blocks still allocated are not released. */
+void slab_fini(struct slabmm *sm);
+
+void *slab_alloc(struct slabmm *sm, size_t len);
+void *slab_resize(struct slabmm *sm, void *mem, size_t len);
+void slab_free(struct slabmm *sm, void *mem);
+
+/* Returns the size class for 'len' or -1 if 'len' is a large request */
+int slab_class(size_t len);
+
+/* Fill in 'st' with the statistics for class 'cls' */
+void slab_stats(struct slabmm *sm, int cls, struct slab_stats *st);
+
+#endif /* __cat_slab_h */
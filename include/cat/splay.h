@@ -65,6 +65,23 @@ DECL struct stnode * st_lkup(struct sptree *t, const void *key);
 /* Insert 'node' into 't'. */
 DECL struct stnode * st_ins(struct sptree *t, struct stnode *node);
 
+/*
+ * Works like avl_lkup() with a non-NULL 'dir':  returns the node matching
+ * 'key' with *dir set to CST_N (splaying it to the root) or the parent a
+ * new node with 'key' would get with *dir set to the side it would go on.
+ * A failed search does not splay so the result can go to st_ins_at().
+ * A caller that doesn't insert there must pass it to st_lkup_miss()
+ * instead or repeated misses lose the amortized bounds.
+ */
+DECL struct stnode * st_lkup_dir(struct sptree *t, const void *key, int *dir);
+
+/* Insert 'node' at a location returned by a failed st_lkup_dir() */
+DECL void st_ins_at(struct sptree *t, struct stnode *node, struct stnode *loc,
+		    int dir);
+
+/* Splay a location from a failed st_lkup_dir() that won't get a node */
+DECL void st_lkup_miss(struct sptree *t, struct stnode *loc);
+
 /* Remove 'node' from its tree. */
 DECL void st_rem(struct stnode *node);
 
@@ -83,6 +100,34 @@ DECL struct stnode * st_getmin(struct sptree *t);
 /* Return a pointer to the maximum node in 't' or NULL if the tree is empty */
 DECL struct stnode * st_getmax(struct sptree *t);
 
+/*
+ * Return the node after or before 'n' in key order or NULL if there is
+ * none.  Walking a whole tree this way costs O(1) amortized per node.
+ */
+DECL struct stnode * st_next(struct stnode *n);
+DECL struct stnode * st_prev(struct stnode *n);
+
+/* Return the first node in 't' whose key is >= 'key' or NULL if none is */
+DECL struct stnode * st_lbound(struct sptree *t, const void *key);
+
+/* Return the first node in 't' whose key is > 'key' or NULL if none is */
+DECL struct stnode * st_ubound(struct sptree *t, const void *key);
+
+/*
+ * Build 't' from the 'n' nodes in 'nodes' in O(n) time.  'nodes' must be
+ * sorted in strictly increasing key order, their keys must be set and 't'
+ * must be empty.  The resulting tree is perfectly balanced.
+ */
+DECL void st_build(struct sptree *t, struct stnode **nodes, ulong n);
+
+/*
+ * Store the nodes of 't' in key order in 'nodes' and return how many
+ * nodes the tree holds.  If that is no more than 'max' the nodes are also
+ * removed from 't' leaving it empty.  Otherwise 't' is unchanged and only
+ * the first 'max' nodes are stored.
+ */
+DECL ulong st_flatten(struct sptree *t, struct stnode **nodes, ulong max);
+
 
 /* ----- Auxiliary (helper) functions (don't use) outside the module ----- */
 DECL void st_findloc(struct sptree *t, const void *key, struct stnode **pn,
@@ -136,6 +181,44 @@ DECL struct stnode * st_lkup(struct sptree *t, const void *key)
 }
 
 
+DECL struct stnode * st_lkup_dir(struct sptree *t, const void *key, int *dir)
+{
+	struct stnode *n;
+
+	abort_unless(t);
+	abort_unless(dir);
+	st_findloc(t, key, &n, dir);
+	if ( *dir == CST_N )
+		st_splay(n);
+	return n;
+}
+
+
+DECL void st_ins_at(struct sptree *t, struct stnode *node, struct stnode *loc,
+		    int dir)
+{
+	abort_unless(t);
+	abort_unless(node);
+	abort_unless(loc);
+	abort_unless((dir == CST_L) || (dir == CST_R) ||
+		     ((dir == CST_P) && (loc == &t->root)));
+
+	node->tree = t;
+	st_fix(loc, node, dir);
+	if ( loc != &t->root )
+		st_splay(node);
+}
+
+
+DECL void st_lkup_miss(struct sptree *t, struct stnode *loc)
+{
+	abort_unless(t);
+	abort_unless(loc);
+	if ( loc != &t->root )
+		st_splay(loc);
+}
+
+
 DECL struct stnode * st_ins(struct sptree *t, struct stnode *node)
 {
 	struct stnode *n;
@@ -282,6 +365,162 @@ DECL struct stnode * st_getmax(struct sptree *t)
 }
 
 
+DECL struct stnode * st_next(struct stnode *n)
+{
+	abort_unless(n);
+	if ( n->p[CST_R] != NULL ) {
+		n = n->p[CST_R];
+		while ( n->p[CST_L] != NULL )
+			n = n->p[CST_L];
+		return n;
+	}
+	while ( n->pdir == CST_R )
+		n = n->p[CST_P];
+	return (n->pdir == CST_P) ? NULL : n->p[CST_P];
+}
+
+
+DECL struct stnode * st_prev(struct stnode *n)
+{
+	abort_unless(n);
+	if ( n->p[CST_L] != NULL ) {
+		n = n->p[CST_L];
+		while ( n->p[CST_R] != NULL )
+			n = n->p[CST_R];
+		return n;
+	}
+	while ( n->pdir == CST_L )
+		n = n->p[CST_P];
+	return (n->pdir == CST_P) ? NULL : n->p[CST_P];
+}
+
+
+DECL struct stnode * st_lbound(struct sptree *t, const void *key)
+{
+	struct stnode *node, *last = NULL, *best = NULL;
+	int rv;
+
+	abort_unless(t);
+	node = t->st_root;
+	while ( node != NULL ) {
+		last = node;
+		rv = (*t->cmp)(key, node->key);
+		if ( rv <= 0 ) {
+			best = node;
+			if ( rv == 0 )
+				break;
+			node = node->p[CST_L];
+		} else {
+			node = node->p[CST_R];
+		}
+	}
+	/* like st_lkup(), splay the deepest node visited even if none bounds */
+	if ( last != NULL )
+		st_splay(last);
+	return best;
+}
+
+
+DECL struct stnode * st_ubound(struct sptree *t, const void *key)
+{
+	struct stnode *node, *last = NULL, *best = NULL;
+
+	abort_unless(t);
+	node = t->st_root;
+	while ( node != NULL ) {
+		last = node;
+		if ( (*t->cmp)(key, node->key) < 0 ) {
+			best = node;
+			node = node->p[CST_L];
+		} else {
+			node = node->p[CST_R];
+		}
+	}
+	/* like st_lkup(), splay the deepest node visited even if none bounds */
+	if ( last != NULL )
+		st_splay(last);
+	return best;
+}
+
+
+DECL void st_build(struct sptree *t, struct stnode **nodes, ulong n)
+{
+	struct {
+		ulong		lo;
+		ulong		len;
+		struct stnode *	par;
+		int		dir;
+	} stk[sizeof(ulong) * 8 + 1];
+	struct stnode *node, *par;
+	ulong lo, len, l, r;
+	int top, dir;
+
+	abort_unless(t);
+	abort_unless(t->st_root == NULL);
+	abort_unless(nodes || n == 0);
+	if ( n == 0 )
+		return;
+
+	stk[0].lo = 0;
+	stk[0].len = n;
+	stk[0].par = &t->root;
+	stk[0].dir = CST_P;
+	top = 1;
+	while ( top > 0 ) {
+		--top;
+		lo = stk[top].lo;
+		len = stk[top].len;
+		par = stk[top].par;
+		dir = stk[top].dir;
+		/* the right subtree gets the extra node when 'len' is even */
+		l = (len - 1) / 2;
+		r = len - 1 - l;
+		node = nodes[lo + l];
+		st_ninit(node, node->key);
+		node->tree = t;
+		st_fix(par, node, dir);
+		if ( r > 0 ) {
+			stk[top].lo = lo + l + 1;
+			stk[top].len = r;
+			stk[top].par = node;
+			stk[top].dir = CST_R;
+			++top;
+		}
+		if ( l > 0 ) {
+			stk[top].lo = lo;
+			stk[top].len = l;
+			stk[top].par = node;
+			stk[top].dir = CST_L;
+			++top;
+		}
+	}
+}
+
+
+DECL ulong st_flatten(struct sptree *t, struct stnode **nodes, ulong max)
+{
+	struct stnode *trav;
+	ulong n = 0, i;
+
+	abort_unless(t);
+	abort_unless(nodes || max == 0);
+	for ( trav = st_getmin(t); trav != NULL; trav = st_next(trav) ) {
+		if ( n < max )
+			nodes[n] = trav;
+		++n;
+	}
+
+	if ( n <= max ) {
+		for ( i = 0; i < n; ++i ) {
+			st_ninit(nodes[i], nodes[i]->key);
+			nodes[i]->tree = NULL;
+		}
+		t->st_root = NULL;
+	}
+	return n;
+}
+
+
 DECL void st_findloc(struct sptree *t, const void *key, struct stnode **pn,
 		     int *pd)
 {
@@ -16,11 +16,19 @@
 
 /* Memory manager extras */
 #include <cat/mem.h>
+#include <cat/pcache.h>
 
 extern struct memmgr estdmm;
 
 struct raw *erawdup(struct raw const * const r);
 
+/*
+ * Copy 'r' and its data into one block from malloc() that free() releases.
+ * Unlike erawdup() an empty 'r' is allowed and gets NULL data.  Returns
+ * NULL if the block can't be allocated or its size overflows.
+ */
+struct raw *rawdup(struct raw const * const r);
+
 char *erawsdup(struct raw const * const r);
 
 
@@ -54,6 +62,7 @@ struct clist {
 	void 			(*node_free)(struct clist *list,
 					     struct clist_node *node);
 	attrib_t		ctx;
+	struct pcache *		pool;	/* node cache for cl_pool_attr */
 };
 
 #define l_to_cln(ln) 	container(ln, struct clist_node, entry)
@@ -68,6 +77,24 @@ struct clist {
 	      (node) != cl_end(list) ;	\
 	      (node) = cl_next(node) )
 
+/*
+ * The *_pool_attr_* attribute sets below draw fixed size nodes from a
+ * pcache private to each container instead of calling malloc() per node.
+ * A cache keeps at most STD_POOL_HIWAT completely free pages of
+ * STD_POOL_PGSIZE bytes (see pc_set_maxidle()) and returns pages that
+ * empty beyond those to the system.  Key copies for string and raw keyed
+ * containers still come from malloc().
+ */
+#ifndef STD_POOL_PGSIZE
+#define STD_POOL_PGSIZE		16384
+#endif /* STD_POOL_PGSIZE */
+
+#ifndef STD_POOL_HIWAT
+#define STD_POOL_HIWAT		4
+#endif /* STD_POOL_HIWAT */
+
+extern struct clist_attr cl_pool_attr;	/* pooled list nodes */
+
 struct clist *cl_new(const struct clist_attr *attr, int abort_on_fail);
 void   cl_free(struct clist *list);
 int    cl_isempty(struct clist *list);
@@ -123,6 +150,7 @@ struct chtab_attr {
 	struct chnode *	(*node_alloc)(struct chtab *, void *k);
 	void		(*node_free)(struct chtab *, struct chnode *);
 	void *		ctx;
+	ulong		seed;		/* see below */
 };
 
 struct chtab {
@@ -131,21 +159,130 @@ struct chtab {
 	struct chnode *	(*node_alloc)(struct chtab *t, void *k);
 	void		(*node_free)(struct chtab *t, struct chnode *n);
 	void *		ctx;
+
+	/* resizing state:  see cht_set_resize() */
+	struct htab	old;		/* table being drained into 'table' */
+	uint		mcursor;	/* next bucket in 'old' to migrate */
+	size_t		fill;
+	uint		maxload;
+	uint		minload;
+	uint		minbkts;
+	struct hnode **	ibkts;		/* buckets allocated with the table */
+	struct pcache *	pool;		/* node cache for *_pool_attr_* */
+	ulong		seed;		/* hash context when attr->seed != 0 */
+};
+
+/* Statistics for a chtab: see cht_stats() */
+struct cht_stats {
+	size_t		fill;		/* number of entries in the table */
+	uint		nbkts;		/* buckets in the current table */
+	uint		load;		/* 100 * fill / nbkts */
+	uint		old_nbkts;	/* buckets in the table being drained */
+	uint		mcursor;	/* next bucket to migrate from old table */
+	uint		maxchain;	/* longest chain in either table */
 };
 
+/*
+ * A non-zero 'seed' in the attributes becomes the hash context of tables
+ * created with an 'hctx_size' of 0.  The ht_fshash(), ht_frhash() and
+ * ht_fihash() functions of the std and pool sets then mix it into every
+ * hash, so a random seed per table makes the bucket of a key hard to
+ * predict.  Copy a std set, set 'seed' and pass the copy to cht_new().
+ * Leave it 0 for a user hash function that doesn't take a 'ulong' seed.
+ */
+
+#define CHT_DEF_MAXLOAD		100
+#define CHT_DEF_MINLOAD		25
+#define CHT_MIGRATE_NBKTS	4
+
 extern struct chtab_attr cht_std_attr_skey;	/* string key table */
 extern struct chtab_attr cht_std_attr_rkey;	/* raw key table */
 extern struct chtab_attr cht_std_attr_pkey;	/* ptr key table */
 extern struct chtab_attr cht_std_attr_bkey;	/* binary key table */
+extern struct chtab_attr cht_pool_attr_skey;	/* pooled string key table */
+extern struct chtab_attr cht_pool_attr_pkey;	/* pooled ptr key table */
+extern struct chtab_attr cht_pool_attr_bkey;	/* pooled binary key table */
+extern struct chtab_attr cht_pool_attr_rkey;	/* pooled raw key table */
 
 struct chtab *	cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 			int abort_on_fail);
 void		cht_free(struct chtab *t);
 void *		cht_get(struct chtab *t, void *key);
+
+/* Store the data for 'keys[i]' (or NULL) in 'data[i]' for 0 <= i < 'n'. */
+/* Faster than 'n' cht_get() calls on tables too large to stay in cache. */
+void		cht_get_batch(struct chtab *t, void * const *keys, uint n,
+			      void **data);
 int		cht_put(struct chtab *t, void *key, void *data);
+
+/*
+ * Returns a pointer to the data slot for 'key', adding 'key' with NULL data
+ * if it is not in the table, so read-modify-write updates (e.g. counting)
+ * take one search instead of a get and a put.  Sets *isnew (if not NULL)
+ * to 1 if 'key' was added or 0 if it was already there.  Returns NULL if
+ * 'key' is new and the entry can't be allocated (with 'abort_on_fail' 0).
+ * The slot stays valid until the next insertion or deletion.  Store
+ * non-NULL data in a new slot:  cht_get() can't tell NULL from absent.
+ * The coht_, cavl_, crb_ and cst_ versions work the same way.
+ */
+void **		cht_upsert(struct chtab *t, void *key, int *isnew);
 void *		cht_del(struct chtab *t, void *key);
 void		cht_apply(struct chtab *t, apply_f f, void *ctx);
 
+/*
+ * Make 't' resize itself when its load factor (entries per bucket as a
+ * percentage) goes above 'maxload' or below 'minload'.  The table never
+ * shrinks below the number of buckets it was created with.  Resizing is
+ * incremental:  the old and new bucket arrays both stay live and each
+ * cht_get(), cht_put() and cht_del() moves CHT_MIGRATE_NBKTS buckets from
+ * the old array to the new one until the old array drains.  A 'maxload'
+ * of 0 returns the table to a fixed size.  'minload' must be less than
+ * half of 'maxload' so a resize can't immediately trigger another.
+ */
+void		cht_set_resize(struct chtab *t, uint maxload, uint minload);
+
+/* Fill in 'stats' for 't'.  Finding the longest chain is O(nbkts). */
+void		cht_stats(struct chtab *t, struct cht_stats *stats);
+
+
+/* Application layer open addressing hash table:  grows as needed */
+#include <cat/ohash.h>
+
+struct cohtab;
+
+struct cohtab_attr {
+	cmp_f		kcmp;
+	hash_f		hash;
+	size_t		hctx_size;
+	void *		(*key_dup)(struct cohtab *t, void *k);
+	void		(*key_free)(struct cohtab *t, void *k);
+	void *		ctx;
+	ulong		seed;		/* as for struct chtab_attr */
+};
+
+struct cohtab {
+	struct ohtab	table;
+	int		abort_on_fail;
+	void *		(*key_dup)(struct cohtab *t, void *k);
+	void		(*key_free)(struct cohtab *t, void *k);
+	void *		ctx;
+	ulong		seed;		/* hash context when attr->seed != 0 */
+};
+
+extern struct cohtab_attr coht_std_attr_skey;	/* string key table */
+extern struct cohtab_attr coht_std_attr_rkey;	/* raw key table */
+extern struct cohtab_attr coht_std_attr_pkey;	/* ptr key table */
+extern struct cohtab_attr coht_std_attr_bkey;	/* binary key table */
+
+struct cohtab *	coht_new(size_t nslots, struct cohtab_attr *attr, void *hctx,
+			 int abort_on_fail);
+void		coht_free(struct cohtab *t);
+void *		coht_get(struct cohtab *t, void *key);
+int		coht_put(struct cohtab *t, void *key, void *data);
+void **		coht_upsert(struct cohtab *t, void *key, int *isnew);
+void *		coht_del(struct cohtab *t, void *key);
+void		coht_apply(struct cohtab *t, apply_f f, void *ctx);
+
 
 #include <cat/avl.h>
 
@@ -155,6 +292,7 @@ struct canode {
 };
 
 #define cavl_data(_n) (container((_n), struct canode, node)->data)
+#define cavl_key(_n) ((_n)->key)
 
 struct cavltree;
 
@@ -171,21 +309,39 @@ struct cavltree {
 	struct canode *	(*node_alloc)(struct cavltree *t, void *k);
 	void		(*node_free)(struct cavltree *t, struct canode *n);
 	void *		ctx;
+	struct pcache *	pool;		/* node cache for *_pool_attr_* */
 };
 
 extern struct cavltree_attr cavl_std_attr_skey;	/* string key table */
 extern struct cavltree_attr cavl_std_attr_rkey;	/* raw key table */
 extern struct cavltree_attr cavl_std_attr_pkey;	/* ptr key table */
 extern struct cavltree_attr cavl_std_attr_bkey;	/* binary key table */
+extern struct cavltree_attr cavl_pool_attr_skey;	/* pooled string key table */
+extern struct cavltree_attr cavl_pool_attr_pkey;	/* pooled ptr key table */
+extern struct cavltree_attr cavl_pool_attr_bkey;	/* pooled binary key table */
+extern struct cavltree_attr cavl_pool_attr_rkey;	/* pooled raw key table */
 
 
 struct cavltree * cavl_new(struct cavltree_attr *attr, int abort_on_fail);
 void		cavl_free(struct cavltree *t);
 void *		cavl_get(struct cavltree *t, void *key);
 int		cavl_put(struct cavltree *t, void *key, void *data);
+void **		cavl_upsert(struct cavltree *t, void *key, int *isnew);
 void *		cavl_del(struct cavltree *t, void *key);
 void		cavl_apply(struct cavltree *t, apply_f f, void *ctx);
 
+/*
+ * Ordered traversal:  these return NULL at the end of the tree.  Nodes
+ * work with cavl_data() and cavl_key() and stay valid until deleted, so get
+ * the next node before deleting the current one.
+ */
+struct anode *	cavl_first(struct cavltree *t);
+struct anode *	cavl_last(struct cavltree *t);
+struct anode *	cavl_lbound(struct cavltree *t, void *key);	/* first >= key */
+struct anode *	cavl_ubound(struct cavltree *t, void *key);	/* first > key */
+struct anode *	cavl_next(struct cavltree *t, struct anode *n);
+struct anode *	cavl_prev(struct cavltree *t, struct anode *n);
+
 
 #include <cat/rbtree.h>
 
@@ -195,6 +351,7 @@ struct crbnode {
 };
 
 #define crb_data(_n) (container((_n), struct crbnode, node)->data)
+#define crb_key(_n) ((_n)->key)
 
 struct crbtree;
 
@@ -211,21 +368,39 @@ struct crbtree {
 	struct crbnode *(*node_alloc)(struct crbtree *t, void *k);
 	void		(*node_free)(struct crbtree *t, struct crbnode *n);
 	void *		ctx;
+	struct pcache *	pool;		/* node cache for *_pool_attr_* */
 };
 
 extern struct crbtree_attr crb_std_attr_skey;	/* string key table */
 extern struct crbtree_attr crb_std_attr_rkey;	/* raw key table */
 extern struct crbtree_attr crb_std_attr_pkey;	/* ptr key table */
 extern struct crbtree_attr crb_std_attr_bkey;	/* binary key table */
+extern struct crbtree_attr crb_pool_attr_skey;	/* pooled string key table */
+extern struct crbtree_attr crb_pool_attr_pkey;	/* pooled ptr key table */
+extern struct crbtree_attr crb_pool_attr_bkey;	/* pooled binary key table */
+extern struct crbtree_attr crb_pool_attr_rkey;	/* pooled raw key table */
 
 
 struct crbtree *crb_new(struct crbtree_attr *attr, int abort_on_fail);
 void		crb_free(struct crbtree *t);
 void *		crb_get(struct crbtree *t, void *key);
 int		crb_put(struct crbtree *t, void *key, void *data);
+void **		crb_upsert(struct crbtree *t, void *key, int *isnew);
 void *		crb_del(struct crbtree *t, void *key);
 void		crb_apply(struct crbtree *t, apply_f f, void *ctx);
 
+/*
+ * Ordered traversal:  these return NULL at the end of the tree.  Nodes
+ * work with crb_data() and crb_key() and stay valid until deleted, so get
+ * the next node before deleting the current one.
+ */
+struct rbnode *	crb_first(struct crbtree *t);
+struct rbnode *	crb_last(struct crbtree *t);
+struct rbnode *	crb_lbound(struct crbtree *t, void *key);	/* first >= key */
+struct rbnode *	crb_ubound(struct crbtree *t, void *key);	/* first > key */
+struct rbnode *	crb_next(struct crbtree *t, struct rbnode *n);
+struct rbnode *	crb_prev(struct crbtree *t, struct rbnode *n);
+
 
 #include <cat/splay.h>
 
@@ -235,6 +410,7 @@ struct cstnode {
 };
 
 #define cst_data(_n) (container((_n), struct cstnode, node)->data)
+#define cst_key(_n) ((_n)->key)
 
 struct cstree;
 
@@ -251,21 +427,72 @@ struct cstree {
 	struct cstnode *(*node_alloc)(struct cstree *t, void *k);
 	void		(*node_free)(struct cstree *t, struct cstnode *n);
 	void *		ctx;
+	struct pcache *	pool;		/* node cache for *_pool_attr_* */
 };
 
 extern struct cstree_attr cst_std_attr_skey;	/* string key table */
 extern struct cstree_attr cst_std_attr_rkey;	/* raw key table */
 extern struct cstree_attr cst_std_attr_pkey;	/* ptr key table */
 extern struct cstree_attr cst_std_attr_bkey;	/* binary key table */
+extern struct cstree_attr cst_pool_attr_skey;	/* pooled string key table */
+extern struct cstree_attr cst_pool_attr_pkey;	/* pooled ptr key table */
+extern struct cstree_attr cst_pool_attr_bkey;	/* pooled binary key table */
+extern struct cstree_attr cst_pool_attr_rkey;	/* pooled raw key table */
 
 
 struct cstree * cst_new(struct cstree_attr *attr, int abort_on_fail);
 void		cst_free(struct cstree *t);
 void *		cst_get(struct cstree *t, void *key);
 int		cst_put(struct cstree *t, void *key, void *data);
+void **		cst_upsert(struct cstree *t, void *key, int *isnew);
 void *		cst_del(struct cstree *t, void *key);
 void		cst_apply(struct cstree *t, apply_f f, void *ctx);
 
+/*
+ * Ordered traversal:  these return NULL at the end of the tree.  Nodes
+ * work with cst_data() and cst_key() and stay valid until deleted, so get
+ * the next node before deleting the current one.
+ */
+struct stnode *	cst_first(struct cstree *t);
+struct stnode *	cst_last(struct cstree *t);
+struct stnode *	cst_lbound(struct cstree *t, void *key);	/* first >= key */
+struct stnode *	cst_ubound(struct cstree *t, void *key);	/* first > key */
+struct stnode *	cst_next(struct cstree *t, struct stnode *n);
+struct stnode *	cst_prev(struct cstree *t, struct stnode *n);
+
+
+#include <cat/bptree.h>
+
+struct cbptree;
+
+struct cbptree_attr {
+	cmp_f		kcmp;
+	void *		(*key_dup)(struct cbptree *t, void *k);
+	void		(*key_free)(struct cbptree *t, void *k);
+	void *		ctx;
+};
+
+struct cbptree {
+	struct bptree	tree;
+	int		abort_on_fail;
+	void *		(*key_dup)(struct cbptree *t, void *k);
+	void		(*key_free)(struct cbptree *t, void *k);
+	void *		ctx;
+};
+
+extern struct cbptree_attr cbpt_std_attr_skey;	/* string key table */
+extern struct cbptree_attr cbpt_std_attr_rkey;	/* raw key table */
+extern struct cbptree_attr cbpt_std_attr_pkey;	/* ptr key table */
+extern struct cbptree_attr cbpt_std_attr_bkey;	/* binary key table */
+
+
+struct cbptree *cbpt_new(struct cbptree_attr *attr, int abort_on_fail);
+void		cbpt_free(struct cbptree *t);
+void *		cbpt_get(struct cbptree *t, void *key);
+int		cbpt_put(struct cbptree *t, void *key, void *data);
+void *		cbpt_del(struct cbptree *t, void *key);
+void		cbpt_apply(struct cbptree *t, apply_f f, void *ctx);
+
 
 #include <cat/heap.h>
 
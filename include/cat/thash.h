@@ -0,0 +1,216 @@
+/*
+ * cat/thash.h -- Type specialized open addressing hash tables
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_thash_h
+#define __cat_thash_h
+
+#include <cat/cat.h>
+#include <cat/err.h>
+
+/*
+ * THASH_DEFINE(pfx, ktype, vtype, hashf, eqf) stamps out a hash table
+ * that stores keys of type 'ktype' and values of type 'vtype' directly in
+ * its slots.  'hashf(k)' must return a uint hash of key 'k' and 'eqf(a, b)'
+ * non-zero if keys 'a' and 'b' are equal.  Both may be macros or
+ * functions and get expanded in place so the compiler can inline them:
+ * there are no function pointers.  Keys are passed by value so 'ktype'
+ * should be a scalar or a small struct (e.g. a fixed size string buffer).
+ *
+ * Tables use linear probing starting at a Fibonacci hashed home slot.
+ * Removal shifts the following entries of the probe run back instead of
+ * leaving tombstones, so lookups never slow down as keys come and go.
+ * The caller supplies the slot array (a power of 2 in size) as with
+ * 'struct ohtab'.  A table holds at most 7/8ths of its slots and always
+ * leaves at least one slot empty.
+ *
+ * The definition generates:
+ *
+ *   struct pfx_slot;		a slot:  'key', 'val' and 'full'
+ *   struct pfx;		the table
+ *   void  pfx_init(struct pfx *t, struct pfx_slot *slots, uint nslots);
+ *   vtype *pfx_lkup(struct pfx *t, ktype key);
+ *	Returns a pointer to the value for 'key' or NULL if there is none.
+ *   vtype *pfx_ins(struct pfx *t, ktype key, vtype val);
+ *	Sets the value for 'key', adding it if needed, and returns a pointer
+ *	to the stored value or NULL if 'key' is new and the table is full.
+ *   int   pfx_rem(struct pfx *t, ktype key, vtype *oval);
+ *	Removes 'key' returning 1 (and its value in 'oval' if non-NULL)
+ *	or returns 0 if it was not in the table.
+ *   uint  pfx_count(struct pfx *t);
+ *   int   pfx_isfull(struct pfx *t);
+ *   void  pfx_apply(struct pfx *t,
+ *		     void (*f)(ktype *key, vtype *val, void *ctx), void *ctx);
+ *	Calls 'f' on each entry.  'f' must not add or remove entries.
+ *
+ * Pointers to values stay valid until the next insertion or removal.
+ */
+
+#if CAT_USE_INLINE && !CAT_ANSI89
+#define THASH_DECL static inline
+#else /* CAT_USE_INLINE && !CAT_ANSI89 */
+#define THASH_DECL static
+#endif /* CAT_USE_INLINE && !CAT_ANSI89 */
+
+#define THASH_MULT	0x9E3779B1u
+
+
+/* Avalanche mixes for integer keys:  the final mixes of MurmurHash3 */
+THASH_DECL uint thash_u32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x85EBCA6Bu;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35u;
+	x ^= x >> 16;
+	return x;
+}
+
+
+#if CAT_64BIT
+THASH_DECL uint thash_u64(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= ((uint64_t)0xFF51AFD7 << 32) | 0xED558CCD;
+	x ^= x >> 33;
+	x *= ((uint64_t)0xC4CEB9FE << 32) | 0x1A85EC53;
+	x ^= x >> 33;
+	return (uint)x;
+}
+#endif /* CAT_64BIT */
+
+
+#define THASH_DEFINE(_pfx, _kt, _vt, _hashf, _eqf)			\
+									\
+struct _pfx##_slot {							\
+	_kt			key;					\
+	_vt			val;					\
+	uchar			full;					\
+};									\
+									\
+struct _pfx {								\
+	struct _pfx##_slot *	slots;					\
+	uint			nslots;					\
+	uint			mask;					\
+	uint			shift;					\
+	uint			fill;					\
+	uint			maxfill;				\
+};									\
+									\
+THASH_DECL void _pfx##_init(struct _pfx *t, struct _pfx##_slot *slots,	\
+			    uint nslots)				\
+{									\
+	uint i;								\
+									\
+	abort_unless(t);						\
+	abort_unless(slots);						\
+	abort_unless(nslots >= 2 && (nslots & (nslots - 1)) == 0);	\
+	t->slots = slots;						\
+	t->nslots = nslots;						\
+	t->mask = nslots - 1;						\
+	for ( t->shift = 32, i = nslots; i > 1; i >>= 1 )		\
+		--t->shift;						\
+	t->fill = 0;							\
+	/* keep a slot empty so probes for absent keys always end */	\
+	t->maxfill = nslots - ((nslots >= 8) ? nslots / 8 : 1);		\
+	for ( i = 0; i < nslots; ++i )					\
+		slots[i].full = 0;					\
+}									\
+									\
+THASH_DECL uint _pfx##_home(struct _pfx *t, _kt key)			\
+{									\
+	return (uint)((uint32_t)((uint32_t)(_hashf(key)) * THASH_MULT) >> \
+		      t->shift);					\
+}									\
+									\
+THASH_DECL _vt *_pfx##_lkup(struct _pfx *t, _kt key)			\
+{									\
+	struct _pfx##_slot *s;						\
+	uint i;								\
+									\
+	i = _pfx##_home(t, key);					\
+	for ( s = &t->slots[i]; s->full; s = &t->slots[i] ) {		\
+		if ( _eqf(s->key, key) )				\
+			return &s->val;					\
+		i = (i + 1) & t->mask;					\
+	}								\
+	return NULL;							\
+}									\
+									\
+THASH_DECL _vt *_pfx##_ins(struct _pfx *t, _kt key, _vt val)		\
+{									\
+	struct _pfx##_slot *s;						\
+	uint i;								\
+									\
+	i = _pfx##_home(t, key);					\
+	for ( s = &t->slots[i]; s->full; s = &t->slots[i] ) {		\
+		if ( _eqf(s->key, key) ) {				\
+			s->val = val;					\
+			return &s->val;					\
+		}							\
+		i = (i + 1) & t->mask;					\
+	}								\
+	if ( t->fill >= t->maxfill )					\
+		return NULL;						\
+	s->key = key;							\
+	s->val = val;							\
+	s->full = 1;							\
+	++t->fill;							\
+	return &s->val;							\
+}									\
+									\
+THASH_DECL int _pfx##_rem(struct _pfx *t, _kt key, _vt *oval)		\
+{									\
+	struct _pfx##_slot *s;						\
+	uint i, j, h;							\
+									\
+	i = _pfx##_home(t, key);					\
+	for ( s = &t->slots[i]; s->full; s = &t->slots[i] ) {		\
+		if ( _eqf(s->key, key) )				\
+			break;						\
+		i = (i + 1) & t->mask;					\
+	}								\
+	if ( !s->full )							\
+		return 0;						\
+	if ( oval != NULL )						\
+		*oval = s->val;						\
+									\
+	/* pull back each later entry of the run that may fill the hole */ \
+	for ( j = (i + 1) & t->mask; t->slots[j].full;			\
+	      j = (j + 1) & t->mask ) {					\
+		h = _pfx##_home(t, t->slots[j].key);			\
+		if ( ((j - h) & t->mask) >= ((j - i) & t->mask) ) {	\
+			t->slots[i] = t->slots[j];			\
+			i = j;						\
+		}							\
+	}								\
+	t->slots[i].full = 0;						\
+	--t->fill;							\
+	return 1;							\
+}									\
+									\
+THASH_DECL uint _pfx##_count(struct _pfx *t)				\
+{									\
+	return t->fill;							\
+}									\
+									\
+THASH_DECL int _pfx##_isfull(struct _pfx *t)				\
+{									\
+	return t->fill >= t->maxfill;					\
+}									\
+									\
+THASH_DECL void _pfx##_apply(struct _pfx *t,				\
+			     void (*f)(_kt *, _vt *, void *), void *ctx)\
+{									\
+	uint i;								\
+									\
+	for ( i = 0; i < t->nslots; ++i )				\
+		if ( t->slots[i].full )					\
+			(*f)(&t->slots[i].key, &t->slots[i].val, ctx);	\
+}
+
+#endif /* __cat_thash_h */
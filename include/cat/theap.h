@@ -0,0 +1,165 @@
+/*
+ * cat/theap.h -- Type specialized array-based heap
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_theap_h
+#define __cat_theap_h
+
+#include <cat/cat.h>
+#include <cat/mem.h>
+
+/*
+ * THEAP_DEFINE(pfx, etype, cmpf) generates a binary min-heap that stores
+ * elements of type 'etype' by value in its array.  'cmpf(a, b)' takes two
+ * elements by value and returns < 0, 0 or > 0 like a cmp_f:  the least
+ * element is at the top.  'cmpf' may be a macro or a function and gets
+ * expanded in place.  Elements move by assignment into a hole rather than
+ * by swapping so 'etype' should be small (e.g. a priority and a pointer).
+ *
+ * The definition generates functions that mirror those of 'struct heap':
+ *
+ *   struct pfx;		'elem', 'size', 'fill' and 'mm'
+ *   void pfx_init(struct pfx *hp, etype *elem, int size, int fill,
+ *		   struct memmgr *mm);
+ *	'elem' holds room for 'size' elements of which the first 'fill'
+ *	are populated.  If 'mm' is non-NULL it resizes 'elem' as needed.
+ *   int  pfx_add(struct pfx *hp, etype e, int *pos);
+ *	Returns 0 on success (storing the position in *pos if 'pos' is not
+ *	NULL) or -1 if the heap is full and can not grow.
+ *   etype *pfx_top(struct pfx *hp);	  NULL if the heap is empty
+ *   int  pfx_extract(struct pfx *hp, etype *e);
+ *	Removes the top element storing it in *e if 'e' is not NULL.
+ *	Returns 0 on success or -1 if the heap is empty.
+ *   int  pfx_rem(struct pfx *hp, int pos, etype *e);
+ *	The same for the element at position 'pos'.
+ */
+
+#if CAT_USE_INLINE && !CAT_ANSI89
+#define THEAP_DECL static inline
+#else /* CAT_USE_INLINE && !CAT_ANSI89 */
+#define THEAP_DECL static
+#endif /* CAT_USE_INLINE && !CAT_ANSI89 */
+
+
+#define THEAP_DEFINE(_pfx, _et, _cmpf)					\
+									\
+struct _pfx {								\
+	int			size;					\
+	int			fill;					\
+	_et *			elem;					\
+	struct memmgr *		mm;					\
+};									\
+									\
+/* Move 'e' up from the hole at 'pos' and return where it ends up */	\
+THEAP_DECL int _pfx##_up(struct _pfx *hp, int pos, _et e)		\
+{									\
+	int ppos;							\
+									\
+	while ( pos > 0 ) {						\
+		ppos = (pos - 1) >> 1;					\
+		if ( _cmpf(hp->elem[ppos], e) <= 0 )			\
+			break;						\
+		hp->elem[pos] = hp->elem[ppos];				\
+		pos = ppos;						\
+	}								\
+	hp->elem[pos] = e;						\
+	return pos;							\
+}									\
+									\
+/* Move 'e' down from the hole at 'pos' and return where it ends up */	\
+THEAP_DECL int _pfx##_down(struct _pfx *hp, int pos, _et e)		\
+{									\
+	int cld;							\
+									\
+	while ( (cld = (pos << 1) + 1) < hp->fill ) {			\
+		if ( cld + 1 < hp->fill &&				\
+		     _cmpf(hp->elem[cld], hp->elem[cld + 1]) > 0 )	\
+			cld += 1;					\
+		if ( _cmpf(e, hp->elem[cld]) <= 0 )			\
+			break;						\
+		hp->elem[pos] = hp->elem[cld];				\
+		pos = cld;						\
+	}								\
+	hp->elem[pos] = e;						\
+	return pos;							\
+}									\
+									\
+THEAP_DECL void _pfx##_init(struct _pfx *hp, _et *elem, int size,	\
+			    int fill, struct memmgr *mm)		\
+{									\
+	int i;								\
+									\
+	abort_unless(hp);						\
+	abort_unless(size >= 0);					\
+	abort_unless(fill >= 0);					\
+	hp->size = size;						\
+	hp->elem = elem;						\
+	hp->mm = mm;							\
+	hp->fill = (fill > size) ? size : fill;				\
+	for ( i = (hp->fill >> 1) - 1; i >= 0; --i )			\
+		_pfx##_down(hp, i, hp->elem[i]);			\
+}									\
+									\
+THEAP_DECL int _pfx##_add(struct _pfx *hp, _et e, int *pos)		\
+{									\
+	void *p;							\
+	int n;								\
+									\
+	abort_unless(hp);						\
+	if ( hp->fill == hp->size ) {					\
+		if ( hp->mm == NULL )					\
+			return -1;					\
+		n = (hp->size == 0) ? 32 : hp->size << 1;		\
+		if ( n < hp->size )					\
+			return -1;					\
+		p = mem_resize(hp->mm, hp->elem, n * sizeof(_et));	\
+		if ( p == NULL )					\
+			return -1;					\
+		hp->elem = p;						\
+		hp->size = n;						\
+	}								\
+	n = _pfx##_up(hp, hp->fill++, e);				\
+	if ( pos != NULL )						\
+		*pos = n;						\
+	return 0;							\
+}									\
+									\
+THEAP_DECL _et *_pfx##_top(struct _pfx *hp)				\
+{									\
+	abort_unless(hp);						\
+	return (hp->fill == 0) ? NULL : &hp->elem[0];			\
+}									\
+									\
+THEAP_DECL int _pfx##_rem(struct _pfx *hp, int pos, _et *e)		\
+{									\
+	_et last;							\
+									\
+	abort_unless(hp);						\
+	abort_unless(pos >= 0);						\
+	if ( pos >= hp->fill )						\
+		return -1;						\
+	if ( e != NULL )						\
+		*e = hp->elem[pos];					\
+	last = hp->elem[--hp->fill];					\
+	if ( pos < hp->fill && _pfx##_up(hp, pos, last) == pos )	\
+		_pfx##_down(hp, pos, last);				\
+	return 0;							\
+}									\
+									\
+THEAP_DECL int _pfx##_extract(struct _pfx *hp, _et *e)			\
+{									\
+	abort_unless(hp);						\
+	if ( hp->fill == 0 )						\
+		return -1;						\
+	if ( e != NULL )						\
+		*e = hp->elem[0];					\
+	if ( --hp->fill > 0 )						\
+		_pfx##_down(hp, 0, hp->elem[hp->fill]);			\
+	return 0;							\
+}
+
+#endif /* __cat_theap_h */
@@ -0,0 +1,193 @@
+/*
+ * cat/ttree.h -- Type specialized AVL and red-black tree searches
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_ttree_h
+#define __cat_ttree_h
+
+#include <cat/cat.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+
+/*
+ * TAVL_DEFINE(pfx, ktype, cmpf) and TRB_DEFINE(pfx, ktype, cmpf) generate
+ * a node type holding a key of type 'ktype' along with lookup, insert and
+ * bound functions whose searches expand 'cmpf(a, b)' in place.  'cmpf'
+ * takes two keys by value and returns < 0, 0 or > 0 like a cmp_f.  It
+ * may be a macro or a function.
+ *
+ * The trees are ordinary 'struct avltree' and 'struct rbtree' trees:  only
+ * the searches are specialized.  Rebalancing, removal and traversal use
+ * the regular avl_*() and rb_*() functions, which also work on these trees
+ * as usual (each node's 'key' pointer refers to its typed key).  Embed the
+ * generated node in a larger structure to attach data to it.
+ *
+ * The definition generates, with 'tree' and 'node' standing for the AVL
+ * or RB structures:
+ *
+ *   struct pfx_node;		'node' and a typed 'key'
+ *   void  pfx_init(struct tree *t);
+ *   void  pfx_ninit(struct pfx_node *n, ktype key);
+ *   struct pfx_node *pfx_entry(struct node *n);	 NULL if 'n' is NULL
+ *   struct pfx_node *pfx_lkup(struct tree *t, ktype key);
+ *   struct pfx_node *pfx_ins(struct tree *t, struct pfx_node *n);
+ *	Inserts 'n' returning the node with the same key that it replaced
+ *	or NULL if there was none.
+ *   void  pfx_rem(struct pfx_node *n);
+ *   struct pfx_node *pfx_lbound(struct tree *t, ktype key);	 first >=
+ *   struct pfx_node *pfx_ubound(struct tree *t, ktype key);	 first >
+ *   struct pfx_node *pfx_min(struct tree *t), *pfx_max(struct tree *t);
+ *   struct pfx_node *pfx_next(struct pfx_node *n), *pfx_prev(...);
+ */
+
+#if CAT_USE_INLINE && !CAT_ANSI89
+#define TTREE_DECL static inline
+#else /* CAT_USE_INLINE && !CAT_ANSI89 */
+#define TTREE_DECL static
+#endif /* CAT_USE_INLINE && !CAT_ANSI89 */
+
+
+#define TAVL_DEFINE(_pfx, _kt, _cmpf)					\
+	TTREE_DEFINE(_pfx, _kt, _cmpf, anode, avltree, avl, CA_L, CA_R,	\
+		     CA_P, CA_N)
+
+#define TRB_DEFINE(_pfx, _kt, _cmpf)					\
+	TTREE_DEFINE(_pfx, _kt, _cmpf, rbnode, rbtree, rb, CRB_L, CRB_R,	\
+		     CRB_P, CRB_N)
+
+
+/* The body shared by both tree types (don't use directly) */
+#define TTREE_DEFINE(_pfx, _kt, _cmpf, _nt, _tt, _op, _L, _R, _P, _N)	\
+									\
+struct _pfx##_node {							\
+	struct _nt		node;					\
+	_kt			key;					\
+};									\
+									\
+TTREE_DECL int _pfx##_cmpk(const void *a, const void *b)		\
+{									\
+	return _cmpf(*(const _kt *)a, *(const _kt *)b);			\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_entry(struct _nt *n)		\
+{									\
+	return (n == NULL) ? NULL : container(n, struct _pfx##_node, node); \
+}									\
+									\
+TTREE_DECL void _pfx##_init(struct _tt *t)				\
+{									\
+	_op##_init(t, &_pfx##_cmpk);					\
+}									\
+									\
+TTREE_DECL void _pfx##_ninit(struct _pfx##_node *n, _kt key)		\
+{									\
+	n->key = key;							\
+	_op##_ninit(&n->node, &n->key);					\
+}									\
+									\
+/* Returns the match with *dir == N or where 'key' would go */		\
+TTREE_DECL struct _nt *_pfx##_findloc(struct _tt *t, _kt key, int *dir)	\
+{									\
+	struct _nt *par = &t->root, *n;					\
+	int d = _P, rv;							\
+									\
+	while ( (n = par->p[d]) != NULL ) {				\
+		par = n;						\
+		rv = _cmpf(key, _pfx##_entry(n)->key);			\
+		if ( rv < 0 ) {						\
+			d = _L;						\
+		} else if ( rv > 0 ) {					\
+			d = _R;						\
+		} else {						\
+			d = _N;						\
+			break;						\
+		}							\
+	}								\
+	*dir = d;							\
+	return par;							\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_lkup(struct _tt *t, _kt key)	\
+{									\
+	struct _nt *n = t->root.p[_P];					\
+	int rv;								\
+									\
+	while ( n != NULL ) {						\
+		rv = _cmpf(key, _pfx##_entry(n)->key);			\
+		if ( rv == 0 )						\
+			return _pfx##_entry(n);				\
+		n = n->p[(rv < 0) ? _L : _R];				\
+	}								\
+	return NULL;							\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_ins(struct _tt *t,		\
+					  struct _pfx##_node *n)	\
+{									\
+	struct _nt *loc;						\
+	int dir;							\
+									\
+	loc = _pfx##_findloc(t, n->key, &dir);				\
+	return _pfx##_entry(_op##_ins(t, &n->node, loc, dir));		\
+}									\
+									\
+TTREE_DECL void _pfx##_rem(struct _pfx##_node *n)			\
+{									\
+	_op##_rem(&n->node);						\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_lbound(struct _tt *t, _kt key)	\
+{									\
+	struct _nt *n = t->root.p[_P], *lb = NULL;			\
+									\
+	while ( n != NULL ) {						\
+		if ( _cmpf(key, _pfx##_entry(n)->key) <= 0 ) {		\
+			lb = n;						\
+			n = n->p[_L];					\
+		} else {						\
+			n = n->p[_R];					\
+		}							\
+	}								\
+	return _pfx##_entry(lb);					\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_ubound(struct _tt *t, _kt key)	\
+{									\
+	struct _nt *n = t->root.p[_P], *ub = NULL;			\
+									\
+	while ( n != NULL ) {						\
+		if ( _cmpf(key, _pfx##_entry(n)->key) < 0 ) {		\
+			ub = n;						\
+			n = n->p[_L];					\
+		} else {						\
+			n = n->p[_R];					\
+		}							\
+	}								\
+	return _pfx##_entry(ub);					\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_min(struct _tt *t)		\
+{									\
+	return _pfx##_entry(_op##_getmin(t));				\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_max(struct _tt *t)		\
+{									\
+	return _pfx##_entry(_op##_getmax(t));				\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_next(struct _pfx##_node *n)	\
+{									\
+	return _pfx##_entry(_op##_next(&n->node));			\
+}									\
+									\
+TTREE_DECL struct _pfx##_node *_pfx##_prev(struct _pfx##_node *n)	\
+{									\
+	return _pfx##_entry(_op##_prev(&n->node));			\
+}
+
+#endif /* __cat_ttree_h */
@@ -0,0 +1,89 @@
+/*
+ * cat/twheel.h -- Hierarchical timing wheel
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_twheel_h
+#define __cat_twheel_h
+
+#include <cat/cat.h>
+#include <cat/list.h>
+
+/*
+ * Timers expire at an absolute tick.  Level 0 of the wheel has a slot for
+ * each of the next TW_NSLOTS ticks and each higher level has slots that
+ * span TW_NSLOTS times as many ticks as those of the level below.  As the
+ * wheel turns, the timers in a higher level slot move down ("cascade")
+ * when its span begins.  Adding and removing a timer and expiring it are
+ * O(1) (each timer cascades at most once per level).  Timers further out
+ * than TW_MAXTTL ticks wait in the top level and get placed again as the
+ * wheel reaches them.
+ *
+ * A wheel may have a timer slack:  if 'slack' is non-zero each expiry
+ * time is rounded up to a multiple of the largest power of 2 <= 'slack'.
+ * Timers then fire up to 'slack' ticks late but expire in batches and
+ * leave fewer distinct times to wake up for.
+ */
+
+#define TW_LVLBITS	6
+#define TW_NSLOTS	(1 << TW_LVLBITS)
+#define TW_MASK		(TW_NSLOTS - 1)
+#define TW_NLVLS	5
+#define TW_MAXTTL	((1ul << (TW_LVLBITS * TW_NLVLS)) - 1)
+#define TW_NONE		((ulong)-1)	/* "no timers" from tw_next() */
+
+struct twheel;
+
+struct twnode {
+	struct list		entry;
+	ulong			expire;	/* absolute tick */
+	struct twheel *		tw;	/* wheel the timer is on or NULL */
+};
+
+struct twheel {
+	ulong			now;	/* current tick */
+	ulong			gran;	/* expiry granularity from the slack */
+	ulong			count;	/* number of timers on the wheel */
+	struct list		slots[TW_NLVLS][TW_NSLOTS];
+};
+
+/* Initialize an empty wheel starting at tick 'now' with timer slack 'slack' */
+void tw_init(struct twheel *tw, ulong now, ulong slack);
+
+/* Change the timer slack of 'tw' for timers added after this. */
+void tw_set_slack(struct twheel *tw, ulong slack);
+
+/* Initialize a timer node */
+void tw_ninit(struct twnode *n);
+
+/* Add 'n' (which must not be on a wheel) to expire 'ttl' ticks from now */
+void tw_add(struct twheel *tw, struct twnode *n, ulong ttl);
+
+/* Remove 'n' from the wheel it is on, if any. */
+void tw_rem(struct twnode *n);
+
+/*
+ * Returns the number of ticks until the wheel next needs to be advanced
+ * (a timer expires or one of the slots holding timers cascades) or
+ * TW_NONE if the wheel is empty.  Returns 0 if timers are due now.
+ */
+ulong tw_next(struct twheel *tw);
+
+/*
+ * Advance 'tw' by 'nticks' ticks and move the timers that expire by the
+ * new time (including those that were due already) to 'out' in order of
+ * expiry.  The nodes are no longer on the wheel.
+ */
+void tw_adv(struct twheel *tw, ulong nticks, struct list *out);
+
+/* Move every timer on 'tw' to 'out' leaving the wheel empty. */
+void tw_drain(struct twheel *tw, struct list *out);
+
+#define tw_count(tw)	((tw)->count)
+#define tw_now(tw)	((tw)->now)
+#define l_to_twn(le)	container((le), struct twnode, entry)
+
+#endif /* __cat_twheel_h */
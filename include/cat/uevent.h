@@ -14,7 +14,7 @@
 #if CAT_HAS_POSIX
 #include <cat/mem.h>
 #include <cat/list.h>
-#include <cat/dlist.h>
+#include <cat/twheel.h>
 #include <cat/avl.h>
 #include <cat/cb.h>
 #include <sys/select.h>
@@ -35,7 +35,7 @@ struct ue_ioevent {
 
 
 struct ue_timer {
-	struct dlist		entry;
+	struct twnode		entry;
 	int 			flags;
 	ulong			orig;
 	struct callback		cb;
@@ -57,7 +57,7 @@ struct ue_sigevent {
 
 struct uemux {
 	struct memmgr *		mm;
-	struct dlist		timers;
+	struct twheel		timers;		/* in milliseconds */
 	int 			maxfd;
 	struct cavltree *	fdtab;
 	struct list		iolist;
@@ -83,6 +83,12 @@ void ue_tm_init(struct ue_timer *t, int type, ulong ttl, callback_f tof,
 int ue_tm_reg(struct uemux *mux, struct ue_timer *t);
 void ue_tm_cancel(struct ue_timer *t);
 
+/*
+ * Let timers registered from now on fire up to 'msec' milliseconds late
+ * so that they expire (and wake the mux) in batches.  The default is 0.
+ */
+void ue_tm_slack(struct uemux *mux, ulong msec);
+
 /* i/o events */
 void ue_io_init(struct ue_ioevent *io, int type, int fd, callback_f f, void *x);
 int ue_io_reg(struct uemux *mux, struct ue_ioevent *io);
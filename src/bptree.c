@@ -0,0 +1,588 @@
+/*
+ * bptree.c -- B+tree ordered map
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/bptree.h>
+
+#include <string.h>
+
+STATIC_BUG_ON(bpt_maxkeys_odd, (BPT_MAXKEYS & 1) != 0);
+STATIC_BUG_ON(bpt_maxkeys_small, BPT_MAXKEYS < 4);
+
+#define IN(n)	((struct bpinode *)(n))
+#define LF(n)	((struct bpleaf *)(n))
+
+
+/* Index of the first key in 'n' that is >= 'key' */
+static uint lbound(struct bptree *t, struct bpnode *n, const void *key)
+{
+	uint lo = 0, hi = n->nkeys, mid;
+
+	while ( lo < hi ) {
+		mid = (lo + hi) / 2;
+		if ( (*t->cmp)(key, n->keys[mid]) > 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+/* Index of the first key in 'n' that is > 'key':  ie. the child to take */
+static uint ubound(struct bptree *t, struct bpnode *n, const void *key)
+{
+	uint lo = 0, hi = n->nkeys, mid;
+
+	while ( lo < hi ) {
+		mid = (lo + hi) / 2;
+		if ( (*t->cmp)(key, n->keys[mid]) >= 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+/* Find the leaf that would hold 'key' recording the path if 'path' != NULL */
+static struct bpleaf *descend(struct bptree *t, const void *key,
+			      struct bpinode **path, uint *pidx)
+{
+	struct bpnode *n = t->root;
+	uint d = 0, i;
+
+	while ( !n->isleaf ) {
+		i = ubound(t, n, key);
+		if ( path != NULL ) {
+			path[d] = IN(n);
+			pidx[d] = i;
+		}
+		++d;
+		n = IN(n)->child[i];
+	}
+	return LF(n);
+}
+
+
+static struct bpleaf *new_leaf(struct bptree *t)
+{
+	struct bpleaf *leaf;
+
+	leaf = mem_get(t->mm, sizeof(*leaf));
+	if ( leaf == NULL )
+		return NULL;
+	leaf->hdr.nkeys = 0;
+	leaf->hdr.isleaf = 1;
+	leaf->prev = NULL;
+	leaf->next = NULL;
+	return leaf;
+}
+
+
+static struct bpinode *new_inode(struct bptree *t)
+{
+	struct bpinode *in;
+
+	in = mem_get(t->mm, sizeof(*in));
+	if ( in == NULL )
+		return NULL;
+	in->hdr.nkeys = 0;
+	in->hdr.isleaf = 0;
+	return in;
+}
+
+
+void bpt_init(struct bptree *t, cmp_f cmp, struct memmgr *mm)
+{
+	abort_unless(t != NULL);
+	abort_unless(cmp != NULL);
+	abort_unless(mm != NULL);
+
+	t->root = NULL;
+	t->first = NULL;
+	t->last = NULL;
+	t->height = 0;
+	t->nkeys = 0;
+	t->cmp = cmp;
+	t->mm = mm;
+}
+
+
+static void free_node(struct bptree *t, struct bpnode *n)
+{
+	uint i;
+
+	if ( !n->isleaf )
+		for ( i = 0 ; i <= n->nkeys ; ++i )
+			free_node(t, IN(n)->child[i]);
+	mem_free(t->mm, n);
+}
+
+
+void bpt_fini(struct bptree *t)
+{
+	abort_unless(t != NULL);
+
+	if ( t->root != NULL )
+		free_node(t, t->root);
+	t->root = NULL;
+	t->first = NULL;
+	t->last = NULL;
+	t->height = 0;
+	t->nkeys = 0;
+}
+
+
+void **bpt_lkup(struct bptree *t, const void *key)
+{
+	struct bpleaf *leaf;
+	uint i;
+
+	abort_unless(t != NULL);
+
+	if ( t->root == NULL )
+		return NULL;
+	leaf = descend(t, key, NULL, NULL);
+	i = lbound(t, &leaf->hdr, key);
+	if ( i < leaf->hdr.nkeys && (*t->cmp)(key, leaf->hdr.keys[i]) == 0 )
+		return &leaf->data[i];
+	return NULL;
+}
+
+
+static void leaf_ins_at(struct bpleaf *leaf, uint i, void *key, void *data)
+{
+	uint n = leaf->hdr.nkeys;
+
+	memmove(&leaf->hdr.keys[i + 1], &leaf->hdr.keys[i],
+		(n - i) * sizeof(void *));
+	memmove(&leaf->data[i + 1], &leaf->data[i], (n - i) * sizeof(void *));
+	leaf->hdr.keys[i] = key;
+	leaf->data[i] = data;
+	leaf->hdr.nkeys = n + 1;
+}
+
+
+/* Insert 'key' at index 'i' with 'right' as the child just after it */
+static void inode_ins_at(struct bpinode *in, uint i, void *key,
+			 struct bpnode *right)
+{
+	uint n = in->hdr.nkeys;
+
+	memmove(&in->hdr.keys[i + 1], &in->hdr.keys[i],
+		(n - i) * sizeof(void *));
+	memmove(&in->child[i + 2], &in->child[i + 1],
+		(n - i) * sizeof(struct bpnode *));
+	in->hdr.keys[i] = key;
+	in->child[i + 1] = right;
+	in->hdr.nkeys = n + 1;
+}
+
+
+/* Split full 'leaf' into 'leaf' and 'nleaf' while inserting at 'i' */
+static void split_leaf(struct bptree *t, struct bpleaf *leaf,
+		       struct bpleaf *nleaf, uint i, void *key, void *data)
+{
+	void *keys[BPT_MAXKEYS + 1];
+	void *vals[BPT_MAXKEYS + 1];
+	uint m = (BPT_MAXKEYS + 1) / 2;
+
+	memcpy(keys, leaf->hdr.keys, i * sizeof(void *));
+	memcpy(vals, leaf->data, i * sizeof(void *));
+	keys[i] = key;
+	vals[i] = data;
+	memcpy(&keys[i + 1], &leaf->hdr.keys[i],
+	       (BPT_MAXKEYS - i) * sizeof(void *));
+	memcpy(&vals[i + 1], &leaf->data[i],
+	       (BPT_MAXKEYS - i) * sizeof(void *));
+
+	memcpy(leaf->hdr.keys, keys, m * sizeof(void *));
+	memcpy(leaf->data, vals, m * sizeof(void *));
+	leaf->hdr.nkeys = m;
+	memcpy(nleaf->hdr.keys, &keys[m], (BPT_MAXKEYS + 1 - m) * sizeof(void *));
+	memcpy(nleaf->data, &vals[m], (BPT_MAXKEYS + 1 - m) * sizeof(void *));
+	nleaf->hdr.nkeys = BPT_MAXKEYS + 1 - m;
+
+	nleaf->prev = leaf;
+	nleaf->next = leaf->next;
+	if ( leaf->next != NULL )
+		leaf->next->prev = nleaf;
+	else
+		t->last = nleaf;
+	leaf->next = nleaf;
+}
+
+
+/*
+ * Split full 'in' into 'in' and 'nin' while inserting '*keyp' at index 'i'
+ * with '*rightp' after it.  Returns the key to promote to the parent in
+ * '*keyp' and 'nin' in '*rightp'.
+ */
+static void split_inode(struct bpinode *in, struct bpinode *nin, uint i,
+			void **keyp, struct bpnode **rightp)
+{
+	void *keys[BPT_MAXKEYS + 1];
+	struct bpnode *child[BPT_MAXKEYS + 2];
+	uint m = (BPT_MAXKEYS + 1) / 2;
+
+	memcpy(keys, in->hdr.keys, i * sizeof(void *));
+	keys[i] = *keyp;
+	memcpy(&keys[i + 1], &in->hdr.keys[i],
+	       (BPT_MAXKEYS - i) * sizeof(void *));
+	memcpy(child, in->child, (i + 1) * sizeof(struct bpnode *));
+	child[i + 1] = *rightp;
+	memcpy(&child[i + 2], &in->child[i + 1],
+	       (BPT_MAXKEYS - i) * sizeof(struct bpnode *));
+
+	memcpy(in->hdr.keys, keys, m * sizeof(void *));
+	memcpy(in->child, child, (m + 1) * sizeof(struct bpnode *));
+	in->hdr.nkeys = m;
+	memcpy(nin->hdr.keys, &keys[m + 1], (BPT_MAXKEYS - m) * sizeof(void *));
+	memcpy(nin->child, &child[m + 1],
+	       (BPT_MAXKEYS - m + 1) * sizeof(struct bpnode *));
+	nin->hdr.nkeys = BPT_MAXKEYS - m;
+
+	*keyp = keys[m];
+	*rightp = &nin->hdr;
+}
+
+
+int bpt_ins(struct bptree *t, void *key, void *data, void **odata)
+{
+	struct bpinode *path[BPT_MAXDEPTH];
+	uint pidx[BPT_MAXDEPTH];
+	struct bpinode *spare[BPT_MAXDEPTH + 1];
+	struct bpleaf *leaf, *nleaf;
+	struct bpnode *right;
+	uint i, d, nspare, ns;
+
+	abort_unless(t != NULL);
+
+	if ( t->root == NULL ) {
+		if ( (leaf = new_leaf(t)) == NULL )
+			return -1;
+		leaf_ins_at(leaf, 0, key, data);
+		t->root = &leaf->hdr;
+		t->first = t->last = leaf;
+		t->height = 1;
+		t->nkeys = 1;
+		return 0;
+	}
+
+	leaf = descend(t, key, path, pidx);
+	d = t->height - 1;
+	i = lbound(t, &leaf->hdr, key);
+	if ( i < leaf->hdr.nkeys && (*t->cmp)(key, leaf->hdr.keys[i]) == 0 ) {
+		if ( odata != NULL )
+			*odata = leaf->data[i];
+		leaf->data[i] = data;
+		return 1;
+	}
+
+	if ( leaf->hdr.nkeys < BPT_MAXKEYS ) {
+		leaf_ins_at(leaf, i, key, data);
+		t->nkeys += 1;
+		return 0;
+	}
+
+	/* allocate every node the splits need first so failure is harmless */
+	for ( nspare = 0 ; nspare < d ; ++nspare )
+		if ( path[d - 1 - nspare]->hdr.nkeys < BPT_MAXKEYS )
+			break;
+	if ( nspare == d )
+		nspare += 1;	/* for a new root */
+	abort_unless(t->height + 1 <= BPT_MAXDEPTH);
+	nleaf = new_leaf(t);
+	for ( ns = 0 ; nleaf != NULL && ns < nspare ; ++ns )
+		if ( (spare[ns] = new_inode(t)) == NULL )
+			break;
+	if ( nleaf == NULL || ns < nspare ) {
+		while ( ns > 0 )
+			mem_free(t->mm, spare[--ns]);
+		if ( nleaf != NULL )
+			mem_free(t->mm, nleaf);
+		return -1;
+	}
+
+	split_leaf(t, leaf, nleaf, i, key, data);
+	key = nleaf->hdr.keys[0];
+	right = &nleaf->hdr;
+	t->nkeys += 1;
+
+	while ( d > 0 ) {
+		--d;
+		if ( path[d]->hdr.nkeys < BPT_MAXKEYS ) {
+			inode_ins_at(path[d], pidx[d], key, right);
+			abort_unless(ns == 0);
+			return 0;
+		}
+		split_inode(path[d], spare[--ns], pidx[d], &key, &right);
+	}
+
+	abort_unless(ns == 1);
+	spare[0]->hdr.keys[0] = key;
+	spare[0]->child[0] = t->root;
+	spare[0]->child[1] = right;
+	spare[0]->hdr.nkeys = 1;
+	t->root = &spare[0]->hdr;
+	t->height += 1;
+
+	return 0;
+}
+
+
+/* Move the last entry of child 'ci - 1' of 'p' to the front of child 'ci' */
+static void borrow_left(struct bpinode *p, uint ci)
+{
+	struct bpnode *l = p->child[ci - 1];
+	struct bpnode *c = p->child[ci];
+	uint ln = l->nkeys;
+
+	memmove(&c->keys[1], &c->keys[0], c->nkeys * sizeof(void *));
+	if ( c->isleaf ) {
+		memmove(&LF(c)->data[1], &LF(c)->data[0],
+			c->nkeys * sizeof(void *));
+		c->keys[0] = l->keys[ln - 1];
+		LF(c)->data[0] = LF(l)->data[ln - 1];
+		p->hdr.keys[ci - 1] = c->keys[0];
+	} else {
+		memmove(&IN(c)->child[1], &IN(c)->child[0],
+			(c->nkeys + 1) * sizeof(struct bpnode *));
+		c->keys[0] = p->hdr.keys[ci - 1];
+		IN(c)->child[0] = IN(l)->child[ln];
+		p->hdr.keys[ci - 1] = l->keys[ln - 1];
+	}
+	l->nkeys -= 1;
+	c->nkeys += 1;
+}
+
+
+/* Move the first entry of child 'ci + 1' of 'p' to the end of child 'ci' */
+static void borrow_right(struct bpinode *p, uint ci)
+{
+	struct bpnode *c = p->child[ci];
+	struct bpnode *r = p->child[ci + 1];
+	uint cn = c->nkeys;
+
+	if ( c->isleaf ) {
+		c->keys[cn] = r->keys[0];
+		LF(c)->data[cn] = LF(r)->data[0];
+		memmove(&LF(r)->data[0], &LF(r)->data[1],
+			(r->nkeys - 1) * sizeof(void *));
+		memmove(&r->keys[0], &r->keys[1],
+			(r->nkeys - 1) * sizeof(void *));
+		p->hdr.keys[ci] = r->keys[0];
+	} else {
+		c->keys[cn] = p->hdr.keys[ci];
+		IN(c)->child[cn + 1] = IN(r)->child[0];
+		p->hdr.keys[ci] = r->keys[0];
+		memmove(&r->keys[0], &r->keys[1],
+			(r->nkeys - 1) * sizeof(void *));
+		memmove(&IN(r)->child[0], &IN(r)->child[1],
+			r->nkeys * sizeof(struct bpnode *));
+	}
+	r->nkeys -= 1;
+	c->nkeys += 1;
+}
+
+
+/* Fold child 'li + 1' of 'p' into child 'li' and free it */
+static void merge(struct bptree *t, struct bpinode *p, uint li)
+{
+	struct bpnode *l = p->child[li];
+	struct bpnode *r = p->child[li + 1];
+	uint ln = l->nkeys;
+
+	if ( l->isleaf ) {
+		memcpy(&l->keys[ln], r->keys, r->nkeys * sizeof(void *));
+		memcpy(&LF(l)->data[ln], LF(r)->data,
+		       r->nkeys * sizeof(void *));
+		l->nkeys = ln + r->nkeys;
+		LF(l)->next = LF(r)->next;
+		if ( LF(r)->next != NULL )
+			LF(r)->next->prev = LF(l);
+		else
+			t->last = LF(l);
+	} else {
+		l->keys[ln] = p->hdr.keys[li];
+		memcpy(&l->keys[ln + 1], r->keys, r->nkeys * sizeof(void *));
+		memcpy(&IN(l)->child[ln + 1], IN(r)->child,
+		       (r->nkeys + 1) * sizeof(struct bpnode *));
+		l->nkeys = ln + 1 + r->nkeys;
+	}
+	mem_free(t->mm, r);
+
+	memmove(&p->hdr.keys[li], &p->hdr.keys[li + 1],
+		(p->hdr.nkeys - li - 1) * sizeof(void *));
+	memmove(&p->child[li + 1], &p->child[li + 2],
+		(p->hdr.nkeys - li - 1) * sizeof(struct bpnode *));
+	p->hdr.nkeys -= 1;
+}
+
+
+/* Refill child 'ci' of 'p'.  Returns 1 if 'p' lost a key doing so. */
+static int fix_underflow(struct bptree *t, struct bpinode *p, uint ci)
+{
+	if ( ci > 0 && p->child[ci - 1]->nkeys > BPT_MINKEYS ) {
+		borrow_left(p, ci);
+		return 0;
+	}
+	if ( ci < p->hdr.nkeys && p->child[ci + 1]->nkeys > BPT_MINKEYS ) {
+		borrow_right(p, ci);
+		return 0;
+	}
+	merge(t, p, (ci > 0) ? ci - 1 : ci);
+	return 1;
+}
+
+
+int bpt_rem(struct bptree *t, const void *key, void **okey, void **odata)
+{
+	struct bpinode *path[BPT_MAXDEPTH];
+	uint pidx[BPT_MAXDEPTH];
+	struct bpleaf *leaf;
+	struct bpnode *n;
+	uint i, d;
+
+	abort_unless(t != NULL);
+
+	if ( t->root == NULL )
+		return -1;
+
+	leaf = descend(t, key, path, pidx);
+	d = t->height - 1;
+	i = lbound(t, &leaf->hdr, key);
+	if ( i >= leaf->hdr.nkeys || (*t->cmp)(key, leaf->hdr.keys[i]) != 0 )
+		return -1;
+
+	if ( okey != NULL )
+		*okey = leaf->hdr.keys[i];
+	if ( odata != NULL )
+		*odata = leaf->data[i];
+	memmove(&leaf->hdr.keys[i], &leaf->hdr.keys[i + 1],
+		(leaf->hdr.nkeys - i - 1) * sizeof(void *));
+	memmove(&leaf->data[i], &leaf->data[i + 1],
+		(leaf->hdr.nkeys - i - 1) * sizeof(void *));
+	leaf->hdr.nkeys -= 1;
+	t->nkeys -= 1;
+
+	/* separators above may still name the removed key:  that's fine */
+	/* since they only route searches and remain correctly ordered */
+	n = &leaf->hdr;
+	while ( d > 0 && n->nkeys < BPT_MINKEYS ) {
+		--d;
+		if ( !fix_underflow(t, path[d], pidx[d]) )
+			break;
+		n = &path[d]->hdr;
+	}
+
+	n = t->root;
+	if ( n->nkeys == 0 ) {
+		if ( n->isleaf ) {
+			t->root = NULL;
+			t->first = NULL;
+			t->last = NULL;
+		} else {
+			t->root = IN(n)->child[0];
+		}
+		t->height -= 1;
+		mem_free(t->mm, n);
+	}
+
+	return 0;
+}
+
+
+void bpt_apply(struct bptree *t, apply_f f, void *ctx)
+{
+	struct bpleaf *leaf, *next;
+	uint i;
+
+	abort_unless(t != NULL);
+	abort_unless(f != NULL);
+
+	for ( leaf = t->first ; leaf != NULL ; leaf = next ) {
+		next = leaf->next;
+		for ( i = 0 ; i < leaf->hdr.nkeys ; ++i )
+			(*f)(leaf->data[i], ctx);
+	}
+}
+
+
+int bpt_first(struct bptree *t, struct bpt_cursor *c)
+{
+	abort_unless(t != NULL);
+	abort_unless(c != NULL);
+
+	c->leaf = t->first;
+	c->idx = 0;
+	return c->leaf != NULL;
+}
+
+
+int bpt_last(struct bptree *t, struct bpt_cursor *c)
+{
+	abort_unless(t != NULL);
+	abort_unless(c != NULL);
+
+	c->leaf = t->last;
+	c->idx = (c->leaf != NULL) ? c->leaf->hdr.nkeys - 1 : 0;
+	return c->leaf != NULL;
+}
+
+
+int bpt_lbound(struct bptree *t, const void *key, struct bpt_cursor *c)
+{
+	abort_unless(t != NULL);
+	abort_unless(c != NULL);
+
+	if ( t->root == NULL ) {
+		c->leaf = NULL;
+		c->idx = 0;
+		return 0;
+	}
+	c->leaf = descend(t, key, NULL, NULL);
+	c->idx = lbound(t, &c->leaf->hdr, key);
+	if ( c->idx < c->leaf->hdr.nkeys )
+		return 1;
+	c->leaf = c->leaf->next;
+	c->idx = 0;
+	return c->leaf != NULL;
+}
+
+
+int bpt_next(struct bpt_cursor *c)
+{
+	abort_unless(c != NULL);
+
+	if ( c->leaf == NULL )
+		return 0;
+	if ( ++c->idx < c->leaf->hdr.nkeys )
+		return 1;
+	c->leaf = c->leaf->next;
+	c->idx = 0;
+	return c->leaf != NULL;
+}
+
+
+int bpt_prev(struct bpt_cursor *c)
+{
+	abort_unless(c != NULL);
+
+	if ( c->leaf == NULL )
+		return 0;
+	if ( c->idx > 0 ) {
+		c->idx -= 1;
+		return 1;
+	}
+	c->leaf = c->leaf->prev;
+	c->idx = (c->leaf != NULL) ? c->leaf->hdr.nkeys - 1 : 0;
+	return c->leaf != NULL;
+}
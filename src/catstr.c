@@ -476,7 +476,7 @@ int cs_grow(struct catstr *cs, size_t minlen)
 	abort_unless(minlen <= CS_MAXLEN);
 	abort_unless(cs->cs_dynamic);
 
-	csp = (byte_t *)&cs->cs_data;
+	csp = (byte_t *)cs->cs_data;
 	tlen = olen = cs_alloc_size(cs->cs_size);
 	if ( mm_grow(cs_mmp, &csp, &tlen, cs_alloc_size(minlen)) < 0 )
 		return -1;
@@ -0,0 +1,316 @@
+/*
+ * cnhash.c -- Concurrent hash table with lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/cnhash.h>
+#include <cat/err.h>
+#include <cat/stduse.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOADP(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STOREP(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+#define SMAX (~(size_t)0)
+
+
+static void *cnht_key_dup_skey(struct cnhtab *t, void *key)
+{
+	return strdup(key);
+}
+
+
+static void cnht_key_free_skey(struct cnhtab *t, void *key)
+{
+	free(key);
+}
+
+
+struct cnhtab_attr cnht_std_attr_skey = {
+	&cmp_str,
+	&ht_fshash,
+	0,
+	&cnht_key_dup_skey,
+	&cnht_key_free_skey,
+	NULL,
+};
+
+
+static void *cnht_key_dup_rkey(struct cnhtab *t, void *key)
+{
+	return rawdup(key);
+}
+
+
+struct cnhtab_attr cnht_std_attr_rkey = {
+	&cmp_raw,
+	&ht_frhash,
+	0,
+	&cnht_key_dup_rkey,
+	&cnht_key_free_skey,
+	NULL,
+};
+
+
+static void *cnht_key_dup_pkey(struct cnhtab *t, void *key)
+{
+	return key;
+}
+
+
+static void cnht_key_free_pkey(struct cnhtab *t, void *key)
+{
+}
+
+
+struct cnhtab_attr cnht_std_attr_pkey = {
+	&cmp_ptr,
+	&ht_fihash,
+	0,
+	&cnht_key_dup_pkey,
+	&cnht_key_free_pkey,
+	NULL,
+};
+
+
+struct cnhtab_attr cnht_std_attr_bkey = {
+	NULL,		/* Must be supplied by user */
+	NULL,		/* Must be supplied by user */
+	0,		/* Must be supplied by user */
+	&cnht_key_dup_pkey,
+	&cnht_key_free_pkey,
+	NULL,
+};
+
+
+static void cnht_node_free(struct ebr_node *en, void *ctx)
+{
+	struct cnhtab *t = ctx;
+	struct cnhnode *n = container(en, struct cnhnode, ebr);
+	(*t->key_free)(t, n->key);
+	free(n);
+}
+
+
+static pthread_mutex_t *bkt_lock(struct cnhtab *t, uint idx)
+{
+	return &t->locks[idx & (t->nlocks - 1)];
+}
+
+
+struct cnhtab *cnht_new(size_t nbkts, struct cnhtab_attr *attr, void *hctx,
+			int abort_on_fail)
+{
+	size_t tsize;
+	size_t hctx_size;
+	uint n, i;
+	struct cnhtab *t;
+
+	if ( attr == NULL )
+		attr = &cnht_std_attr_skey;
+
+	abort_unless(attr->kcmp != NULL);
+	abort_unless(attr->hash != NULL);
+	abort_unless(attr->key_dup != NULL);
+	abort_unless(attr->key_free != NULL);
+	abort_unless(nbkts <= ((uint)-1 >> 1) + 1);
+
+	for ( n = 1 ; n < nbkts ; n <<= 1 )
+		;
+
+	tsize = CAT_ALIGN_SIZE(sizeof(struct cnhtab));
+	hctx_size = CAT_ALIGN_SIZE(attr->hctx_size);
+	abort_unless(hctx_size >= attr->hctx_size);
+	abort_unless(SMAX - hctx_size >= tsize);
+
+	t = malloc(tsize + hctx_size);
+	if ( t == NULL )
+		goto err;
+	t->nbkts = n;
+	t->nlocks = (n < CNHT_MAXLOCKS) ? n : CNHT_MAXLOCKS;
+	t->bkts = calloc(n, sizeof(struct cnhnode *));
+	t->locks = malloc(sizeof(pthread_mutex_t) * t->nlocks);
+	if ( t->bkts == NULL || t->locks == NULL )
+		goto err_free;
+	if ( ebr_init(&t->ebr, t) < 0 )
+		goto err_free;
+	for ( i = 0 ; i < t->nlocks ; ++i )
+		pthread_mutex_init(&t->locks[i], NULL);
+
+	if ( hctx_size != 0 ) {
+		t->hctx = (byte_t *)t + tsize;
+		memmove(t->hctx, hctx, attr->hctx_size);
+	} else {
+		t->hctx = NULL;
+	}
+	t->cmp = attr->kcmp;
+	t->hash = attr->hash;
+	t->abort_on_fail = abort_on_fail;
+	t->key_dup = attr->key_dup;
+	t->key_free = attr->key_free;
+	t->ctx = attr->ctx;
+
+	return t;
+
+err_free:
+	free(t->bkts);
+	free(t->locks);
+	free(t);
+err:
+	if ( abort_on_fail )
+		err("cnht_new: unable to allocate table\n");
+	return NULL;
+}
+
+
+void cnht_free(struct cnhtab *t)
+{
+	uint i;
+	struct cnhnode *n, *next;
+
+	abort_unless(t != NULL);
+
+	for ( i = 0 ; i < t->nbkts ; ++i ) {
+		for ( n = t->bkts[i] ; n != NULL ; n = next ) {
+			next = n->next;
+			cnht_node_free(&n->ebr, t);
+		}
+	}
+	ebr_fini(&t->ebr);
+	for ( i = 0 ; i < t->nlocks ; ++i )
+		pthread_mutex_destroy(&t->locks[i]);
+	free(t->locks);
+	free(t->bkts);
+	free(t);
+}
+
+
+void *cnht_get(struct cnhtab *t, void *key)
+{
+	struct cnhnode *n;
+	void *data = NULL;
+	uint h;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	h = (*t->hash)(key, t->hctx);
+
+	ebr_enter(&t->ebr);
+	for ( n = LOADP(&t->bkts[h & (t->nbkts - 1)]) ; n != NULL ;
+	      n = LOADP(&n->next) ) {
+		if ( n->hash == h && (*t->cmp)(n->key, key) == 0 ) {
+			data = LOADP(&n->data);
+			break;
+		}
+	}
+	ebr_exit(&t->ebr);
+
+	return data;
+}
+
+
+int cnht_put(struct cnhtab *t, void *key, void *data)
+{
+	struct cnhnode *n;
+	pthread_mutex_t *lock;
+	uint h, idx;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	abort_unless(data != NULL);
+
+	h = (*t->hash)(key, t->hctx);
+	idx = h & (t->nbkts - 1);
+	lock = bkt_lock(t, idx);
+
+	pthread_mutex_lock(lock);
+	for ( n = t->bkts[idx] ; n != NULL ; n = n->next ) {
+		if ( n->hash == h && (*t->cmp)(n->key, key) == 0 ) {
+			STOREP(&n->data, data);
+			pthread_mutex_unlock(lock);
+			return 1;
+		}
+	}
+
+	n = malloc(sizeof(*n));
+	if ( n == NULL || (n->key = (*t->key_dup)(t, key)) == NULL ) {
+		pthread_mutex_unlock(lock);
+		free(n);
+		if ( t->abort_on_fail )
+			err("cnht_put: unable to allocate node\n");
+		return -1;
+	}
+	n->data = data;
+	n->hash = h;
+	n->next = t->bkts[idx];
+
+	/* publish only after the node is fully initialized */
+	STOREP(&t->bkts[idx], n);
+	pthread_mutex_unlock(lock);
+
+	return 0;
+}
+
+
+void *cnht_del(struct cnhtab *t, void *key)
+{
+	struct cnhnode *n, **prev;
+	pthread_mutex_t *lock;
+	void *data;
+	uint h, idx;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	h = (*t->hash)(key, t->hctx);
+	idx = h & (t->nbkts - 1);
+	lock = bkt_lock(t, idx);
+
+	pthread_mutex_lock(lock);
+	for ( prev = &t->bkts[idx] ; (n = *prev) != NULL ; prev = &n->next ) {
+		if ( n->hash == h && (*t->cmp)(n->key, key) == 0 ) {
+			/* n->next stays intact for readers still on 'n' */
+			STOREP(prev, n->next);
+			pthread_mutex_unlock(lock);
+			data = n->data;
+			ebr_retire(&t->ebr, &n->ebr, &cnht_node_free);
+			return data;
+		}
+	}
+	pthread_mutex_unlock(lock);
+
+	return NULL;
+}
+
+
+void cnht_apply(struct cnhtab *t, apply_f f, void *ctx)
+{
+	uint i;
+	struct cnhnode *n, *next;
+	pthread_mutex_t *lock;
+
+	abort_unless(t != NULL);
+	abort_unless(f != NULL);
+
+	for ( i = 0 ; i < t->nbkts ; ++i ) {
+		lock = bkt_lock(t, i);
+		pthread_mutex_lock(lock);
+		for ( n = t->bkts[i] ; n != NULL ; n = next ) {
+			next = n->next;
+			(*f)(n->data, ctx);
+		}
+		pthread_mutex_unlock(lock);
+	}
+}
+
+#endif /* CAT_HAS_POSIX */
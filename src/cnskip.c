@@ -0,0 +1,493 @@
+/*
+ * cnskip.c -- Concurrent lock-free skiplist ordered map
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/cnskip.h>
+#include <cat/err.h>
+#include <cat/stduse.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOADP(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define CASP(p, o, n)	__atomic_compare_exchange_n((p), &(o), (n), 0, \
+						    __ATOMIC_ACQ_REL, \
+						    __ATOMIC_ACQUIRE)
+
+/* the low bit of a next pointer marks its node as deleted at that level */
+#define MARKED(p)	((ptr2uint(p) & 1) != 0)
+#define MARK(p)		((struct cnslnode *)int2ptr(ptr2uint(p) | 1))
+#define UNMARK(p)	((struct cnslnode *)int2ptr(ptr2uint(p) & ~(uintptr_t)1))
+
+#define NODESIZE(nlvl)	\
+	(offsetof(struct cnslnode, next) + (nlvl) * sizeof(struct cnslnode *))
+
+
+static void *cnsl_key_dup_skey(struct cnslist *t, void *key)
+{
+	return strdup(key);
+}
+
+
+static void cnsl_key_free_skey(struct cnslist *t, void *key)
+{
+	free(key);
+}
+
+
+struct cnslist_attr cnsl_std_attr_skey = {
+	&cmp_str,
+	&cnsl_key_dup_skey,
+	&cnsl_key_free_skey,
+	NULL,
+};
+
+
+static void *cnsl_key_dup_rkey(struct cnslist *t, void *key)
+{
+	return rawdup(key);
+}
+
+
+struct cnslist_attr cnsl_std_attr_rkey = {
+	&cmp_raw,
+	&cnsl_key_dup_rkey,
+	&cnsl_key_free_skey,
+	NULL,
+};
+
+
+static void *cnsl_key_dup_pkey(struct cnslist *t, void *key)
+{
+	return key;
+}
+
+
+static void cnsl_key_free_pkey(struct cnslist *t, void *key)
+{
+}
+
+
+struct cnslist_attr cnsl_std_attr_pkey = {
+	&cmp_ptr,
+	&cnsl_key_dup_pkey,
+	&cnsl_key_free_pkey,
+	NULL,
+};
+
+
+struct cnslist_attr cnsl_std_attr_bkey = {
+	NULL,		/* Must be supplied by user */
+	&cnsl_key_dup_pkey,
+	&cnsl_key_free_pkey,
+	NULL,
+};
+
+
+static void cnsl_node_free(struct ebr_node *en, void *ctx)
+{
+	struct cnslist *t = ctx;
+	struct cnslnode *n = container(en, struct cnslnode, ebr);
+	(*t->key_free)(t, n->key);
+	free(n);
+}
+
+
+/* Drop a reference:  the node is retired once it is both fully unlinked */
+/* and its inserter has stopped linking it into upper levels. */
+static void cnsl_release(struct cnslist *t, struct cnslnode *n)
+{
+	if ( __atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL) == 0 )
+		ebr_retire(&t->ebr, &n->ebr, &cnsl_node_free);
+}
+
+
+/* Levels are geometric with p = 1/4 from a mixed sequence number */
+static int cnsl_rand_lvl(struct cnslist *t)
+{
+	uint h;
+	int lvl;
+
+	h = __atomic_fetch_add(&t->seq, 1, __ATOMIC_RELAXED);
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	for ( lvl = 1 ; lvl < CNSL_MAXLVL && (h & 3) == 0 ; h >>= 2 )
+		++lvl;
+	return lvl;
+}
+
+
+/*
+ * Fill in the predecessor and successor of 'key' at each level unlinking
+ * any deleted nodes along the way.  'succs[i]' is the first live node at
+ * level 'i' whose key is >= 'key'.  Returns non-zero if 'succs[0]' has a
+ * key equal to 'key'.  Must be called inside a read section.
+ *
+ * With 'purge' set the search goes on past live nodes whose key equals
+ * 'key' so it also unlinks a deleted node with that key that a racing
+ * re-insert linked in behind its own node.  The results are then only
+ * good for cleaning up.
+ */
+static int cnsl_find(struct cnslist *t, const void *key,
+		     struct cnslnode **preds, struct cnslnode **succs,
+		     int purge)
+{
+	struct cnslnode *pred, *curr, *succ;
+	int lvl, rv = 1;
+
+retry:
+	pred = t->head;
+	for ( lvl = CNSL_MAXLVL - 1 ; lvl >= 0 ; --lvl ) {
+		curr = UNMARK(LOADP(&pred->next[lvl]));
+		rv = 1;
+		while ( curr != NULL ) {
+			succ = LOADP(&curr->next[lvl]);
+			if ( MARKED(succ) ) {
+				/* fails if 'pred' was deleted or changed */
+				if ( !CASP(&pred->next[lvl], curr, UNMARK(succ)) )
+					goto retry;
+				curr = UNMARK(succ);
+				continue;
+			}
+			rv = (*t->cmp)(key, curr->key);
+			if ( rv < 0 || (rv == 0 && !purge) )
+				break;
+			pred = curr;
+			curr = succ;
+		}
+		preds[lvl] = pred;
+		succs[lvl] = curr;
+	}
+
+	return curr != NULL && rv == 0;
+}
+
+
+/* Read-only search for the first live node whose key is >= 'key'.  With */
+/* 'key' == NULL return the first live node. */
+static struct cnslnode *cnsl_search(struct cnslist *t, const void *key,
+				    int *rvp)
+{
+	struct cnslnode *pred, *curr, *succ;
+	int lvl, rv = 1;
+
+	pred = t->head;
+	curr = NULL;
+	for ( lvl = (key == NULL) ? 0 : CNSL_MAXLVL - 1 ; lvl >= 0 ; --lvl ) {
+		curr = UNMARK(LOADP(&pred->next[lvl]));
+		rv = 1;
+		while ( curr != NULL ) {
+			succ = LOADP(&curr->next[lvl]);
+			if ( MARKED(succ) ) {
+				curr = UNMARK(succ);
+				continue;
+			}
+			if ( key == NULL )
+				break;
+			rv = (*t->cmp)(key, curr->key);
+			if ( rv <= 0 )
+				break;
+			pred = curr;
+			curr = succ;
+		}
+	}
+	if ( rvp != NULL )
+		*rvp = rv;
+	return curr;
+}
+
+
+struct cnslist *cnsl_new(struct cnslist_attr *attr, int abort_on_fail)
+{
+	struct cnslist *t;
+	int i;
+
+	if ( attr == NULL )
+		attr = &cnsl_std_attr_skey;
+
+	abort_unless(attr->kcmp != NULL);
+	abort_unless(attr->key_dup != NULL);
+	abort_unless(attr->key_free != NULL);
+
+	t = malloc(sizeof(*t));
+	if ( t == NULL )
+		goto err;
+	t->head = malloc(NODESIZE(CNSL_MAXLVL));
+	if ( t->head == NULL )
+		goto err_free;
+	if ( ebr_init(&t->ebr, t) < 0 )
+		goto err_free;
+
+	t->head->key = NULL;
+	t->head->data = NULL;
+	t->head->refs = 1;
+	t->head->nlvl = CNSL_MAXLVL;
+	for ( i = 0 ; i < CNSL_MAXLVL ; ++i )
+		t->head->next[i] = NULL;
+	t->cmp = attr->kcmp;
+	t->seq = 0;
+	t->abort_on_fail = abort_on_fail;
+	t->key_dup = attr->key_dup;
+	t->key_free = attr->key_free;
+	t->ctx = attr->ctx;
+
+	return t;
+
+err_free:
+	free(t->head);
+	free(t);
+err:
+	if ( abort_on_fail )
+		err("cnsl_new: unable to allocate list\n");
+	return NULL;
+}
+
+
+void cnsl_free(struct cnslist *t)
+{
+	struct cnslnode *n, *next;
+
+	abort_unless(t != NULL);
+
+	/* with no other users every deleted node is already unlinked */
+	for ( n = t->head->next[0] ; n != NULL ; n = next ) {
+		next = UNMARK(n->next[0]);
+		cnsl_node_free(&n->ebr, t);
+	}
+	ebr_fini(&t->ebr);
+	free(t->head);
+	free(t);
+}
+
+
+void *cnsl_get(struct cnslist *t, void *key)
+{
+	struct cnslnode *n;
+	void *data = NULL;
+	int rv;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	ebr_enter(&t->ebr);
+	n = cnsl_search(t, key, &rv);
+	if ( n != NULL && rv == 0 )
+		data = LOADP(&n->data);
+	ebr_exit(&t->ebr);
+
+	return data;
+}
+
+
+int cnsl_put(struct cnslist *t, void *key, void *data)
+{
+	struct cnslnode *preds[CNSL_MAXLVL], *succs[CNSL_MAXLVL];
+	struct cnslnode *n = NULL, *x, *succ;
+	void *odata;
+	int lvl, i;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	abort_unless(data != NULL);
+
+	ebr_enter(&t->ebr);
+	for ( ;; ) {
+		if ( cnsl_find(t, key, preds, succs, 0) ) {
+			/* a NULL data pointer means cnsl_del() got there first */
+			x = succs[0];
+			odata = LOADP(&x->data);
+			while ( odata != NULL && !CASP(&x->data, odata, data) )
+				;
+			if ( odata == NULL )
+				continue;
+			ebr_exit(&t->ebr);
+			if ( n != NULL ) {
+				(*t->key_free)(t, n->key);
+				free(n);
+			}
+			return 1;
+		}
+
+		if ( n == NULL ) {
+			lvl = cnsl_rand_lvl(t);
+			n = malloc(NODESIZE(lvl));
+			if ( n == NULL || (n->key = (*t->key_dup)(t, key)) == NULL ) {
+				ebr_exit(&t->ebr);
+				free(n);
+				if ( t->abort_on_fail )
+					err("cnsl_put: unable to allocate node\n");
+				return -1;
+			}
+			n->data = data;
+			n->refs = 2;
+			n->nlvl = lvl;
+		}
+
+		for ( i = 0 ; i < n->nlvl ; ++i )
+			n->next[i] = succs[i];
+		x = succs[0];
+		/* publish only after the node is fully initialized */
+		if ( CASP(&preds[0]->next[0], x, n) )
+			break;
+	}
+
+	/* the entry is in:  link the upper levels until done or deleted */
+	for ( i = 1 ; i < n->nlvl ; ++i ) {
+		for ( ;; ) {
+			/* never link in front of a node deleted since the search: */
+			/* its delete's cleanup would stop at this node */
+			x = succs[i];
+			if ( (x == NULL || !MARKED(LOADP(&x->next[i]))) &&
+			     CASP(&preds[i]->next[i], x, n) )
+				break;
+			cnsl_find(t, key, preds, succs, 0);
+			succ = LOADP(&n->next[i]);
+			if ( MARKED(succ) || !CASP(&n->next[i], succ, succs[i]) )
+				goto out;
+		}
+	}
+
+out:
+	/* a delete may have raced past levels linked after its own search */
+	if ( MARKED(LOADP(&n->next[0])) )
+		cnsl_find(t, key, preds, succs, 1);
+	cnsl_release(t, n);
+	ebr_exit(&t->ebr);
+
+	return 0;
+}
+
+
+void *cnsl_del(struct cnslist *t, void *key)
+{
+	struct cnslnode *preds[CNSL_MAXLVL], *succs[CNSL_MAXLVL];
+	struct cnslnode *n, *succ;
+	void *data;
+	int i;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	ebr_enter(&t->ebr);
+	if ( !cnsl_find(t, key, preds, succs, 0) ) {
+		ebr_exit(&t->ebr);
+		return NULL;
+	}
+	n = succs[0];
+
+	for ( i = n->nlvl - 1 ; i > 0 ; --i ) {
+		succ = LOADP(&n->next[i]);
+		while ( !MARKED(succ) && !CASP(&n->next[i], succ, MARK(succ)) )
+			;
+	}
+
+	/* whoever marks the bottom level owns the delete */
+	succ = LOADP(&n->next[0]);
+	for ( ;; ) {
+		if ( MARKED(succ) ) {
+			ebr_exit(&t->ebr);
+			return NULL;
+		}
+		if ( CASP(&n->next[0], succ, MARK(succ)) )
+			break;
+	}
+
+	data = __atomic_exchange_n(&n->data, NULL, __ATOMIC_ACQ_REL);
+	cnsl_find(t, key, preds, succs, 1);
+	cnsl_release(t, n);
+	ebr_exit(&t->ebr);
+
+	return data;
+}
+
+
+void cnsl_apply(struct cnslist *t, apply_f f, void *ctx)
+{
+	struct cnsl_cursor c;
+	int valid;
+
+	abort_unless(f != NULL);
+
+	for ( valid = cnsl_first(t, &c) ; valid ; valid = cnsl_next(&c) )
+		(*f)(c.data, ctx);
+	cnsl_cfini(&c);
+}
+
+
+/* Advance from 'n' to the first live node that still has data */
+static int cnsl_cset(struct cnsl_cursor *c, struct cnslnode *n)
+{
+	void *data;
+
+	while ( n != NULL ) {
+		data = LOADP(&n->data);
+		if ( data != NULL && !MARKED(LOADP(&n->next[0])) ) {
+			c->node = n;
+			c->key = n->key;
+			c->data = data;
+			return 1;
+		}
+		n = UNMARK(LOADP(&n->next[0]));
+	}
+	c->node = NULL;
+	c->key = NULL;
+	c->data = NULL;
+	return 0;
+}
+
+
+int cnsl_first(struct cnslist *t, struct cnsl_cursor *c)
+{
+	abort_unless(t != NULL);
+	abort_unless(c != NULL);
+
+	c->list = t;
+	ebr_enter(&t->ebr);
+	return cnsl_cset(c, cnsl_search(t, NULL, NULL));
+}
+
+
+int cnsl_lbound(struct cnslist *t, void *key, struct cnsl_cursor *c)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	abort_unless(c != NULL);
+
+	c->list = t;
+	ebr_enter(&t->ebr);
+	return cnsl_cset(c, cnsl_search(t, key, NULL));
+}
+
+
+int cnsl_next(struct cnsl_cursor *c)
+{
+	abort_unless(c != NULL);
+
+	if ( c->node == NULL )
+		return 0;
+	return cnsl_cset(c, UNMARK(LOADP(&c->node->next[0])));
+}
+
+
+void cnsl_cfini(struct cnsl_cursor *c)
+{
+	abort_unless(c != NULL);
+	abort_unless(c->list != NULL);
+
+	ebr_exit(&c->list->ebr);
+	c->list = NULL;
+	c->node = NULL;
+}
+
+#endif /* CAT_HAS_POSIX */
@@ -30,7 +30,7 @@ static struct htab dbg_htab = {
 	CAT_DBGMEM_NBUCKETS, 
 	CAT_DBGMEM_NBUCKETS - 1,
 	cmp_ptr,
-	ht_phash,
+	ht_fihash,
 	NULL
 };
 
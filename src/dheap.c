@@ -0,0 +1,292 @@
+/*
+ * dheap.c -- d-ary heap of elements stored by value
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/dheap.h>
+
+#include <string.h>
+
+
+/* Constant sized copies for the common sizes compile to plain moves */
+static void dh_cpy(struct dheap *hp, void *dst, const void *src)
+{
+	switch ( hp->esize ) {
+	case 4:  memcpy(dst, src, 4); break;
+	case 8:  memcpy(dst, src, 8); break;
+	case 16: memcpy(dst, src, 16); break;
+	default: memcpy(dst, src, hp->esize); break;
+	}
+}
+
+
+/*
+ * Place the elements in 'mem':  the top element sits 'arity - 1' elements
+ * past a DH_LINESZ boundary so the children of node 'i' start exactly
+ * 'arity * (i + 1)' elements past it.  The slot just before the top holds
+ * an element being sifted down by dh_heapify().
+ */
+static void dh_layout(struct dheap *hp, void *mem, size_t mlen)
+{
+	size_t pad, n;
+
+	hp->mem = mem;
+	hp->mlen = mlen;
+	hp->elem = NULL;
+	hp->size = 0;
+	if ( mem == NULL )
+		return;
+
+	pad = (DH_LINESZ - (ptr2uint(mem) & (DH_LINESZ - 1))) &
+	      (DH_LINESZ - 1);
+	pad += (hp->arity - 1) * hp->esize;
+	if ( mlen < pad + hp->esize )
+		return;
+
+	n = (mlen - pad) / hp->esize;
+	/* keep child position computations from overflowing */
+	if ( n > ((uint)-1 >> hp->ashift) - 1 )
+		n = ((uint)-1 >> hp->ashift) - 1;
+	hp->elem = (byte_t *)mem + pad;
+	hp->size = n;
+}
+
+
+void dh_init(struct dheap *hp, void *mem, size_t mlen, uint arity,
+	     size_t esize, cmp_f cmp, struct memmgr *mm)
+{
+	abort_unless(hp);
+	abort_unless(arity >= 2 && arity <= DH_MAXARITY);
+	abort_unless((arity & (arity - 1)) == 0);
+	abort_unless(esize > 0);
+	abort_unless(cmp);
+
+	hp->arity = arity;
+	for ( hp->ashift = 0; (1u << hp->ashift) < arity; ++hp->ashift )
+		;
+	hp->esize = esize;
+	hp->fill = 0;
+	hp->cmp = cmp;
+	hp->mm = mm;
+	dh_layout(hp, mem, mlen);
+}
+
+
+int dh_reserve(struct dheap *hp, uint n)
+{
+	void *omem, *mem;
+	byte_t *oelem;
+	size_t mlen;
+
+	abort_unless(hp);
+
+	if ( n <= hp->size )
+		return 0;
+	if ( hp->mm == NULL )
+		return -1;
+	if ( n > ((size_t)-1 - DH_LINESZ) / hp->esize - hp->arity ||
+	     n > ((uint)-1 >> hp->ashift) - 1 )
+		return -1;
+
+	mlen = DH_MEMLEN(n, hp->arity, hp->esize);
+	mem = mem_get(hp->mm, mlen);
+	if ( mem == NULL )
+		return -1;
+
+	/* a resize could shift the alignment:  copy to a fresh block */
+	omem = hp->mem;
+	oelem = hp->elem;
+	dh_layout(hp, mem, mlen);
+	abort_unless(hp->size >= n);
+	if ( hp->fill > 0 )
+		memcpy(hp->elem, oelem, hp->fill * hp->esize);
+	if ( omem != NULL )
+		mem_free(hp->mm, omem);
+
+	return 0;
+}
+
+
+/* Move 'e' up from the hole at 'pos' and return where it ends up */
+static uint dh_up(struct dheap *hp, uint pos, const void *e)
+{
+	uint ppos;
+
+	while ( pos > 0 ) {
+		ppos = (pos - 1) >> hp->ashift;
+		if ( (*hp->cmp)(dh_elem(hp, ppos), e) <= 0 )
+			break;
+		dh_cpy(hp, dh_elem(hp, pos), dh_elem(hp, ppos));
+		pos = ppos;
+	}
+	dh_cpy(hp, dh_elem(hp, pos), e);
+
+	return pos;
+}
+
+
+/* Move 'e' down from the hole at 'pos' and return where it ends up */
+static uint dh_down(struct dheap *hp, uint pos, const void *e)
+{
+	uint cld, end, min, i;
+
+	while ( (cld = (pos << hp->ashift) + 1) < hp->fill ) {
+		end = cld + hp->arity;
+		if ( end > hp->fill )
+			end = hp->fill;
+		for ( min = cld, i = cld + 1; i < end; ++i )
+			if ( (*hp->cmp)(dh_elem(hp, i), dh_elem(hp, min)) < 0 )
+				min = i;
+		if ( (*hp->cmp)(e, dh_elem(hp, min)) <= 0 )
+			break;
+		dh_cpy(hp, dh_elem(hp, pos), dh_elem(hp, min));
+		pos = min;
+	}
+	dh_cpy(hp, dh_elem(hp, pos), e);
+
+	return pos;
+}
+
+
+/* Restore the heap property over the whole array bottom up */
+static void dh_heapify(struct dheap *hp)
+{
+	byte_t *hold = hp->elem - hp->esize;
+	uint i;
+
+	if ( hp->fill < 2 )
+		return;
+
+	i = ((hp->fill - 2) >> hp->ashift) + 1;
+	while ( i-- > 0 ) {
+		dh_cpy(hp, hold, dh_elem(hp, i));
+		dh_down(hp, i, hold);
+	}
+}
+
+
+int dh_add(struct dheap *hp, const void *e, uint *pos)
+{
+	uint n;
+
+	abort_unless(hp);
+	abort_unless(e);
+
+	if ( hp->fill == hp->size ) {
+		n = (hp->size == 0) ? 32 : hp->size << 1;
+		if ( n < hp->size )
+			return -1;
+		if ( dh_reserve(hp, n) < 0 )
+			return -1;
+	}
+
+	n = dh_up(hp, hp->fill++, e);
+	if ( pos != NULL )
+		*pos = n;
+
+	return 0;
+}
+
+
+void *dh_top(struct dheap *hp)
+{
+	abort_unless(hp);
+	return (hp->fill == 0) ? NULL : hp->elem;
+}
+
+
+int dh_extract(struct dheap *hp, void *e)
+{
+	abort_unless(hp);
+
+	if ( hp->fill == 0 )
+		return -1;
+
+	if ( e != NULL )
+		dh_cpy(hp, e, hp->elem);
+	if ( --hp->fill > 0 )
+		dh_down(hp, 0, dh_elem(hp, hp->fill));
+
+	return 0;
+}
+
+
+int dh_rem(struct dheap *hp, uint pos, void *e)
+{
+	void *last;
+
+	abort_unless(hp);
+
+	if ( pos >= hp->fill )
+		return -1;
+
+	if ( e != NULL )
+		dh_cpy(hp, e, dh_elem(hp, pos));
+	last = dh_elem(hp, --hp->fill);
+	if ( pos < hp->fill && dh_up(hp, pos, last) == pos )
+		dh_down(hp, pos, last);
+
+	return 0;
+}
+
+
+int dh_add_n(struct dheap *hp, const void *ea, uint n)
+{
+	const byte_t *p = ea;
+	uint i;
+
+	abort_unless(hp);
+	abort_unless(ea != NULL || n == 0);
+
+	if ( n == 0 )
+		return 0;
+	if ( n > (uint)-1 - hp->fill )
+		return -1;
+	if ( hp->fill + n > hp->size ) {
+		i = hp->size;
+		while ( i < hp->fill + n && i <= ((uint)-1 >> 1) )
+			i = (i == 0) ? 32 : i << 1;
+		if ( i < hp->fill + n )
+			i = hp->fill + n;
+		if ( dh_reserve(hp, i) < 0 )
+			return -1;
+	}
+
+	/*
+	 * Sifting each new element up costs O(log(fill)) apiece while a
+	 * rebuild costs O(fill + n) for the lot.
+	 */
+	if ( n >= hp->fill ) {
+		memcpy(dh_elem(hp, hp->fill), p, (size_t)n * hp->esize);
+		hp->fill += n;
+		dh_heapify(hp);
+	} else {
+		for ( i = 0; i < n; ++i, p += hp->esize )
+			dh_up(hp, hp->fill++, p);
+	}
+
+	return 0;
+}
+
+
+uint dh_extract_n(struct dheap *hp, void *ea, uint n)
+{
+	byte_t *p = ea;
+	uint i;
+
+	abort_unless(hp);
+	abort_unless(ea != NULL || n == 0);
+
+	for ( i = 0; i < n && hp->fill > 0; ++i, p += hp->esize ) {
+		dh_cpy(hp, p, hp->elem);
+		if ( --hp->fill > 0 )
+			dh_down(hp, 0, dh_elem(hp, hp->fill));
+	}
+
+	return i;
+}
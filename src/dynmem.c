@@ -233,11 +233,14 @@ void dynmem_free(struct dynmem *dm, void *mem)
 	mb = ptr2mb(mem);
 	mark_free(mb);
 	coalesce(&mb);
-	/* if the following block was "dm_current" adjust */
+	/* if "dm_current" was merged into this block, start there instead */
 	if (((char *)dm->dm_current >= (char *)mb) && 
-			((char *)dm->dm_current <  ((char *)mb + MBSIZE(mb))))
+			((char *)dm->dm_current <  ((char *)mb + MBSIZE(mb)))) {
+		l_ins(&dm->dm_blocks, &mb->mb_entry);
 		dm->dm_current = &mb->mb_entry;
-	l_ins(dm->dm_current->prev, &mb->mb_entry);
+	} else {
+		l_ins(dm->dm_current->prev, &mb->mb_entry);
+	}
 }
 
 
@@ -259,13 +262,18 @@ static void shrink_alloc_block(struct dynmem *dm, struct memblk *mb, size_t sz)
 	unitp = PTR2U(mb, MBSIZE(mb));
 	if ( !(unitp->sz & ALLOC_BIT) ) {
 		/* expand the next block?  OK if small since no fragmentation */
-		nbsz += MBSIZE(unitp);
-		l_rem(&((struct memblk *)unitp)->mb_entry);
+		nmb = (struct memblk *)unitp;
+		nbsz += MBSIZE(nmb);
+		if ( dm->dm_current == &nmb->mb_entry )
+			dm->dm_current = nmb->mb_entry.next;
+		l_rem(&nmb->mb_entry);
 		/* remove the block and fall through to create the new one */
 	} else if ( nbsz < CAT_MIN_ALLOC_SHRINK ) {
 		/* only shrink current block if size savings is worth it */
 		return;
-	} 
+	} else {
+		unitp->sz &= ~PREV_ALLOC_BIT;
+	}
 	nmb = (struct memblk *)PTR2U(mb, sz);
 	set_free_mb(nmb, nbsz, PREV_ALLOC_BIT);
 	l_ins(dm->dm_current, &nmb->mb_entry);
@@ -293,6 +301,9 @@ void *dynmem_realloc(struct dynmem *dm, void *omem, size_t newamt)
 	if ( (tsz < newamt) || (tsz > MAX_ALLOC - UNITSIZE) )
 		return NULL;
 	newamt = tsz + UNITSIZE;
+	/* a block must be able to hold the free list links once freed */
+	if ( newamt < MINSZ )
+		newamt = MINSZ;
 
 	mb = ptr2mb(omem);
 	if ( mb->mb_len.sz >= newamt ) {
@@ -304,18 +315,30 @@ void *dynmem_realloc(struct dynmem *dm, void *omem, size_t newamt)
 	lenp = PTR2U(mb, MBSIZE(mb));
 	if ( !(lenp->sz & ALLOC_BIT) )  {
 		struct memblk *nmb = (struct memblk *)lenp;
+		struct list *prev = nmb->mb_entry.prev;
+		int wascur = dm->dm_current == &nmb->mb_entry;
 		tsz = MBSIZE(mb) + MBSIZE(nmb);
 		if ( tsz >= newamt ) {
 			size_t delta = tsz - newamt;
-			if ( MBSIZE(nmb) > delta + MINSZ )
-				nmb = split_block(nmb, delta);
-			/* remove the block and merge it with the alloced one */
+			/* remove the block before the new headers overwrite it */
 			l_rem(&nmb->mb_entry);
-			lenp = PTR2U(nmb, MBSIZE(nmb));
-			lenp->sz |= PREV_ALLOC_BIT;
-			/* addition doesn't colide with flags since they are */
-			/* in the low order bits */
-			mb->mb_len.sz += MBSIZE(nmb);
+			if ( delta >= MINSZ ) {
+				/* the excess stays free in the block's place */
+				nmb = (struct memblk *)PTR2U(mb, newamt);
+				set_free_mb(nmb, delta, PREV_ALLOC_BIT);
+				l_ins(prev, &nmb->mb_entry);
+				if ( wascur )
+					dm->dm_current = &nmb->mb_entry;
+				mb->mb_len.sz = newamt | (mb->mb_len.sz & CTLBMASK);
+			} else {
+				if ( wascur )
+					dm->dm_current = prev->next;
+				lenp = PTR2U(nmb, MBSIZE(nmb));
+				lenp->sz |= PREV_ALLOC_BIT;
+				/* addition doesn't colide with flags since */
+				/* they are in the low order bits */
+				mb->mb_len.sz += MBSIZE(nmb);
+			}
 			return mb2ptr(mb);
 		}
 	}
@@ -323,8 +346,7 @@ void *dynmem_realloc(struct dynmem *dm, void *omem, size_t newamt)
 	/* at this point we need a completely new block and must copy */
 	nmem = dynmem_malloc(dm, newamt);
 	if ( nmem ) { 
-		/* may copy more than the original alloc, but still in bounds */
-		memcpy(nmem, omem, MBSIZE(mb));
+		memcpy(nmem, omem, MBSIZE(mb) - UNITSIZE);
 		dynmem_free(dm, omem);
 	}
 
@@ -332,6 +354,63 @@ void *dynmem_realloc(struct dynmem *dm, void *omem, size_t newamt)
 }
 
 
+/*
+ * Returns the offset of the first address in 'mem' that is a multiple of
+ * 'align' and leaves either nothing or room for a free block of at least
+ * 'minsz' bytes in front of it.  The offset is less than align + minsz.
+ */
+static size_t align_gap(void *mem, size_t align, size_t minsz)
+{
+	size_t gap;
+
+	gap = (align - (ptr2uint(mem) & (align - 1))) & (align - 1);
+	if ( gap > 0 && gap < minsz )
+		gap += (minsz - gap + align - 1) & ~(align - 1);
+	return gap;
+}
+
+
+void *dynmem_memalign(struct dynmem *dm, size_t align, size_t amt)
+{
+	struct memblk *mb, *amb;
+	void *mem;
+	size_t sz, gap;
+
+	abort_unless(dm);
+	abort_unless(align > 0 && (align & (align - 1)) == 0);
+
+	if ( align <= UNITSIZE )
+		return dynmem_malloc(dm, amt);
+
+	/* the block size that dynmem_malloc() would use */
+	sz = amt + UNITSIZE;
+	if ( sz < UNITSIZE || sz > MAX_ALLOC - MINSZ )
+		return NULL;
+	sz = (sz < MINSZ) ? MINSZ : round2u(sz);
+	if ( align > MAX_ALLOC - MINSZ - sz )
+		return NULL;
+
+	/* leave room to move up to the aligned address past a free block */
+	mem = dynmem_malloc(dm, sz + align + MINSZ);
+	if ( mem == NULL )
+		return NULL;
+
+	mb = ptr2mb(mem);
+	gap = align_gap(mem, align, MINSZ);
+	if ( gap > 0 ) {
+		/* split off the front and free it */
+		amb = (struct memblk *)PTR2U(mb, gap);
+		amb->mb_len.sz = (MBSIZE(mb) - gap) | ALLOC_BIT | PREV_ALLOC_BIT;
+		mb->mb_len.sz = gap | (mb->mb_len.sz & CTLBMASK);
+		dynmem_free(dm, mem);
+		mb = amb;
+	}
+	shrink_alloc_block(dm, mb, sz);
+
+	return mb2ptr(mb);
+}
+
+
 void dynmem_each_pool(struct dynmem *dm, apply_f f, void *ctx)
 {
 	abort_unless(dm);
@@ -755,6 +834,9 @@ void *tlsf_realloc(struct tlsf *tlsf, void *omem, size_t newamt)
 	if ( (tsz < newamt) || (tsz > MAX_ALLOC - UNITSIZE) )
 		return NULL;
 	newamt = tsz + UNITSIZE;
+	/* a block must be able to hold the free list links once freed */
+	if ( newamt < TLSF_MINSZ )
+		newamt = TLSF_MINSZ;
 
 	mb = ptr2mb(omem);
 	osize = MBSIZE(mb) - sizeof(union align_u); 
@@ -795,6 +877,60 @@ void *tlsf_realloc(struct tlsf *tlsf, void *omem, size_t newamt)
 }
 
 
+void *tlsf_memalign(struct tlsf *tlsf, size_t align, size_t amt)
+{
+	struct memblk *mb, *amb;
+	void *mem;
+	size_t sz, gap;
+
+	ASSERT(tlsf);
+	abort_unless(align > 0 && (align & (align - 1)) == 0);
+
+	if ( align <= UNITSIZE )
+		return tlsf_malloc(tlsf, amt);
+
+	/* the block size that tlsf_malloc() would use */
+	if ( amt < (TLSF_MINSZ - UNITSIZE) ) {
+		sz = TLSF_MINSZ;
+	} else {
+		sz = (amt + (UNITSIZE << 1) - 1) & ~(UNITSIZE - 1);
+		if ( sz >= TLSF_ALIM - TLSF_MINSZ || sz < amt )
+			return NULL;
+	}
+	if ( align >= TLSF_ALIM - TLSF_MINSZ - sz )
+		return NULL;
+
+	/*
+	 * One search of the free lists:  leave room to move up to the
+	 * aligned address past a free block.  Splitting off the front and
+	 * trimming the back are constant time like any split.
+	 */
+	mem = tlsf_malloc(tlsf, sz + align + TLSF_MINSZ);
+	if ( mem == NULL )
+		return NULL;
+
+	mb = ptr2mb(mem);
+	gap = align_gap(mem, align, TLSF_MINSZ);
+	if ( gap > 0 ) {
+		amb = (struct memblk *)PTR2U(mb, gap);
+		amb->mb_len.sz = (MBSIZE(mb) - gap) | ALLOC_BIT | PREV_ALLOC_BIT;
+		mb->mb_len.sz = gap | (mb->mb_len.sz & CTLBMASK);
+		tlsf_coalesce_and_insert(tlsf, mb);
+		mb = amb;
+	}
+	tlsf_shrink_blk(tlsf, mb, sz);
+
+	return mb2ptr(mb);
+}
+
+
+size_t tlsf_usable_size(void *mem)
+{
+	ASSERT(mem);
+	return MBSIZE(ptr2mb(mem)) - UNITSIZE;
+}
+
+
 void tlsf_each_pool(struct tlsf *tlsf, apply_f f, void *ctx)
 {
 	ASSERT(tlsf);
@@ -0,0 +1,355 @@
+/*
+ * epoch.c -- Epoch based memory reclamation for lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/epoch.h>
+#include <cat/err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOAD(p)		__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define CAS(p, o, n)	__atomic_compare_exchange_n((p), (o), (n), 0, \
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+
+static void free_list(struct ebr *e, struct ebr_node *n)
+{
+	struct ebr_node *next;
+
+	for ( ; n != NULL ; n = next ) {
+		next = n->next;
+		(*n->free)(n, e->ctx);
+	}
+}
+
+
+/*
+ * A node retired while the global epoch was E can be freed once the
+ * epoch reaches E + 2:  every thread active at the time of its unlink
+ * has since been seen outside its read section.
+ */
+static void reclaim(struct ebr *e, struct ebr_thr *thr, ulong epoch)
+{
+	int i;
+	struct ebr_node *list;
+
+	for ( i = 0 ; i < array_length(thr->limbo) ; ++i ) {
+		if ( thr->limbo[i].list != NULL &&
+		     thr->limbo[i].epoch + 2 <= epoch ) {
+			list = thr->limbo[i].list;
+			thr->limbo[i].list = NULL;
+			free_list(e, list);
+		}
+	}
+}
+
+
+/* Orphaned nodes carry their own epochs:  free the ones that are safe */
+static void reclaim_orphans(struct ebr *e, ulong epoch)
+{
+	struct ebr_node *n, **prev, *dead = NULL;
+
+	if ( LOAD(&e->orphans) == NULL )
+		return;
+
+	pthread_mutex_lock(&e->lock);
+	prev = &e->orphans;
+	while ( (n = *prev) != NULL ) {
+		if ( n->epoch + 2 <= epoch ) {
+			*prev = n->next;
+			n->next = dead;
+			dead = n;
+		} else {
+			prev = &n->next;
+		}
+	}
+	pthread_mutex_unlock(&e->lock);
+
+	free_list(e, dead);
+}
+
+
+/*
+ * One process-wide thread key holds each thread's list of records, one
+ * per ebr instance it has used, so the number of instances is not limited
+ * by PTHREAD_KEYS_MAX.  'ebr_glock' orders thread exit against ebr_fini().
+ */
+static pthread_once_t ebr_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ebr_key;
+static int ebr_key_ok = 0;
+static pthread_mutex_t ebr_glock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Called with 'ebr_glock' held */
+static void thr_release(struct ebr_thr *thr)
+{
+	struct ebr *e = thr->ebr;
+	struct ebr_node *n, *next;
+	int i;
+
+	pthread_mutex_lock(&e->lock);
+	for ( i = 0 ; i < array_length(thr->limbo) ; ++i ) {
+		for ( n = thr->limbo[i].list ; n != NULL ; n = next ) {
+			next = n->next;
+			n->next = e->orphans;
+			e->orphans = n;
+		}
+		thr->limbo[i].list = NULL;
+	}
+	pthread_mutex_unlock(&e->lock);
+
+	thr->depth = 0;
+	thr->nretired = 0;
+	STORE(&thr->state, 0);
+	STORE(&thr->inuse, 0);
+}
+
+
+static void thr_exit(void *arg)
+{
+	struct ebr_thr *thr, *next;
+
+	pthread_mutex_lock(&ebr_glock);
+	for ( thr = arg ; thr != NULL ; thr = next ) {
+		next = thr->tnext;
+		thr->tnext = NULL;
+		if ( thr->ebr == NULL )
+			free(thr);
+		else
+			thr_release(thr);
+	}
+	pthread_mutex_unlock(&ebr_glock);
+}
+
+
+static void key_init(void)
+{
+	ebr_key_ok = (pthread_key_create(&ebr_key, &thr_exit) == 0);
+}
+
+
+/*
+ * Find the calling thread's record for 'e' or return NULL.  Moves the
+ * record to the front of the thread's list and frees records whose
+ * instance ebr_fini() has detached.
+ */
+static struct ebr_thr *find_thr(struct ebr *e)
+{
+	struct ebr_thr *orig, *head, *thr, **prev;
+	struct ebr *te;
+
+	head = orig = pthread_getspecific(ebr_key);
+	if ( head != NULL && LOAD(&head->ebr) == e )
+		return head;
+
+	prev = &head;
+	while ( (thr = *prev) != NULL ) {
+		te = LOAD(&thr->ebr);
+		if ( te == e )
+			break;
+		if ( te == NULL ) {
+			*prev = thr->tnext;
+			free(thr);
+		} else {
+			prev = &thr->tnext;
+		}
+	}
+
+	if ( thr != NULL && thr != head ) {
+		*prev = thr->tnext;
+		thr->tnext = head;
+		head = thr;
+	}
+	if ( head != orig && pthread_setspecific(ebr_key, head) != 0 )
+		err("ebr: unable to set thread records\n");
+
+	return thr;
+}
+
+
+static struct ebr_thr *get_thr(struct ebr *e)
+{
+	struct ebr_thr *thr;
+	int unused;
+
+	thr = find_thr(e);
+	if ( thr != NULL )
+		return thr;
+
+	for ( thr = LOAD(&e->threads) ; thr != NULL ; thr = thr->next ) {
+		unused = 0;
+		if ( LOAD(&thr->inuse) == 0 && CAS(&thr->inuse, &unused, 1) )
+			break;
+	}
+
+	if ( thr == NULL ) {
+		thr = malloc(sizeof(*thr));
+		if ( thr == NULL )
+			err("ebr: unable to allocate thread record\n");
+		memset(thr, 0, sizeof(*thr));
+		thr->inuse = 1;
+		thr->ebr = e;
+		thr->next = LOAD(&e->threads);
+		while ( !CAS(&e->threads, &thr->next, thr) )
+			;
+	}
+
+	thr->tnext = pthread_getspecific(ebr_key);
+	if ( pthread_setspecific(ebr_key, thr) != 0 )
+		err("ebr: unable to set thread records\n");
+
+	return thr;
+}
+
+
+int ebr_init(struct ebr *e, void *ctx)
+{
+	abort_unless(e != NULL);
+
+	if ( pthread_once(&ebr_once, &key_init) != 0 || !ebr_key_ok )
+		return -1;
+
+	e->epoch = 0;
+	e->threads = NULL;
+	e->orphans = NULL;
+	e->ctx = ctx;
+	if ( pthread_mutex_init(&e->lock, NULL) != 0 )
+		return -1;
+	return 0;
+}
+
+
+void ebr_fini(struct ebr *e)
+{
+	struct ebr_thr *thr, *next;
+	int i;
+
+	abort_unless(e != NULL);
+
+	/*
+	 * A record still on a live thread's list is detached rather than
+	 * freed:  that thread frees it on its next lookup or at exit.
+	 */
+	pthread_mutex_lock(&ebr_glock);
+	for ( thr = e->threads ; thr != NULL ; thr = next ) {
+		next = thr->next;
+		abort_unless(thr->depth == 0);
+		for ( i = 0 ; i < array_length(thr->limbo) ; ++i )
+			free_list(e, thr->limbo[i].list);
+		if ( thr->inuse )
+			STORE(&thr->ebr, NULL);
+		else
+			free(thr);
+	}
+	pthread_mutex_unlock(&ebr_glock);
+
+	free_list(e, e->orphans);
+	pthread_mutex_destroy(&e->lock);
+	e->threads = NULL;
+	e->orphans = NULL;
+}
+
+
+void ebr_enter(struct ebr *e)
+{
+	struct ebr_thr *thr;
+
+	abort_unless(e != NULL);
+
+	thr = get_thr(e);
+	if ( thr->depth++ == 0 )
+		STORE(&thr->state, (LOAD(&e->epoch) << 1) | 1);
+}
+
+
+void ebr_exit(struct ebr *e)
+{
+	struct ebr_thr *thr;
+
+	abort_unless(e != NULL);
+
+	thr = find_thr(e);
+	abort_unless(thr != NULL && thr->depth > 0);
+	if ( --thr->depth == 0 )
+		__atomic_store_n(&thr->state, 0, __ATOMIC_RELEASE);
+}
+
+
+/* Advance the global epoch if every active thread has observed it */
+static ulong try_advance(struct ebr *e)
+{
+	struct ebr_thr *thr;
+	ulong epoch, state;
+
+	epoch = LOAD(&e->epoch);
+	for ( thr = LOAD(&e->threads) ; thr != NULL ; thr = thr->next ) {
+		state = LOAD(&thr->state);
+		if ( (state & 1) && (state >> 1) != epoch )
+			return epoch;
+	}
+
+	if ( CAS(&e->epoch, &epoch, epoch + 1) )
+		return epoch + 1;
+	return epoch;
+}
+
+
+void ebr_retire(struct ebr *e, struct ebr_node *n,
+		void (*freef)(struct ebr_node *n, void *ctx))
+{
+	struct ebr_thr *thr;
+	struct ebr_limbo *lb;
+	ulong epoch;
+
+	abort_unless(e != NULL);
+	abort_unless(n != NULL);
+	abort_unless(freef != NULL);
+
+	thr = get_thr(e);
+	epoch = LOAD(&e->epoch);
+
+	/* a bucket holding an older epoch is at least 3 epochs stale */
+	lb = &thr->limbo[epoch % 3];
+	if ( lb->list != NULL && lb->epoch != epoch ) {
+		abort_unless(lb->epoch + 2 <= epoch);
+		free_list(e, lb->list);
+		lb->list = NULL;
+	}
+
+	n->free = freef;
+	n->epoch = epoch;
+	n->next = lb->list;
+	lb->list = n;
+	lb->epoch = epoch;
+
+	if ( ++thr->nretired >= EBR_RETIRE_BATCH ) {
+		thr->nretired = 0;
+		ebr_sync(e);
+	}
+}
+
+
+void ebr_sync(struct ebr *e)
+{
+	struct ebr_thr *thr;
+	ulong epoch;
+
+	abort_unless(e != NULL);
+
+	thr = get_thr(e);
+	epoch = try_advance(e);
+	reclaim(e, thr, epoch);
+	reclaim_orphans(e, epoch);
+}
+
+#endif /* CAT_HAS_POSIX */
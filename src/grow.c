@@ -93,7 +93,7 @@ int agrow(void **ptr, size_t ilen, size_t *lenp, size_t min)
 
 int mm_grow(struct memmgr *mm, byte_t **ptr, size_t *lenp, size_t min)
 {
-	void *p2 = ptr;
+	void *p2 = *ptr;
 	int rv;
 	rv = mm_agrow(mm, &p2, 1, lenp, min);
 	*ptr = p2;
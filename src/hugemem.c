@@ -0,0 +1,146 @@
+/*
+ * hugemem.c -- TLSF pools backed by transparent huge pages
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+/* MADV_HUGEPAGE is an extension:  strict ANSI builds hide it otherwise */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif /* _DEFAULT_SOURCE */
+#ifndef _BSD_SOURCE
+#define _BSD_SOURCE
+#endif /* _BSD_SOURCE */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/hugemem.h>
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS	MAP_ANON
+#endif /* !MAP_ANONYMOUS && MAP_ANON */
+
+/* Each mapping starts with this header and the pool follows it */
+union hm_map_u {
+	cat_align_t		align;
+	struct {
+		struct list	entry;
+		size_t		len;
+	} m;
+};
+
+
+static size_t hm_round(size_t len)
+{
+	if ( len > (size_t)~0 - HM_PGSIZE )
+		return 0;
+	return (len + HM_PGSIZE - 1) & ~(HM_PGSIZE - 1);
+}
+
+
+void *hm_map(size_t len, int *advised)
+{
+	byte_t *p, *a;
+	size_t mlen;
+	int ok = 0;
+
+	len = hm_round(len);
+	if ( len == 0 || len > (size_t)~0 - HM_PGSIZE )
+		return NULL;
+
+	/* map an extra huge page so an aligned span fits and trim the rest */
+	mlen = len + HM_PGSIZE;
+	p = mmap(NULL, mlen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+		 -1, 0);
+	if ( p == MAP_FAILED )
+		return NULL;
+	a = (byte_t *)((ptr2uint(p) + HM_PGSIZE - 1) & ~(uintptr_t)(HM_PGSIZE - 1));
+	if ( a > p )
+		munmap(p, a - p);
+	if ( a + len < p + mlen )
+		munmap(a + len, (p + mlen) - (a + len));
+
+#ifdef MADV_HUGEPAGE
+	ok = madvise(a, len, MADV_HUGEPAGE) == 0;
+#endif /* MADV_HUGEPAGE */
+	if ( advised != NULL )
+		*advised = ok;
+
+	return a;
+}
+
+
+void hm_unmap(void *mem, size_t len)
+{
+	if ( mem != NULL )
+		munmap(mem, hm_round(len));
+}
+
+
+void hm_init(struct hugemem *hm, struct tlsf *tlsf)
+{
+	abort_unless(hm);
+	abort_unless(tlsf);
+
+	hm->tlsf = tlsf;
+	l_init(&hm->maps);
+	hm->mapped = 0;
+	hm->npools = 0;
+	hm->nadvised = 0;
+}
+
+
+int hm_add_pool(struct hugemem *hm, size_t len)
+{
+	union hm_map_u *map;
+	int advised;
+
+	abort_unless(hm);
+
+	if ( len > (size_t)~0 - sizeof(*map) - TLSF_MINPOOL )
+		return -1;
+	if ( len < TLSF_MINPOOL )
+		len = TLSF_MINPOOL;
+	len = hm_round(len + sizeof(*map));
+	if ( len == 0 )
+		return -1;
+	map = hm_map(len, &advised);
+	if ( map == NULL )
+		return -1;
+
+	map->m.len = len;
+	l_ins(hm->maps.prev, &map->m.entry);
+	hm->mapped += len;
+	hm->npools += 1;
+	hm->nadvised += advised;
+	tlsf_add_pool(hm->tlsf, map + 1, len - sizeof(*map));
+
+	return 0;
+}
+
+
+void hm_fini(struct hugemem *hm)
+{
+	union hm_map_u *map;
+	struct list *l;
+
+	abort_unless(hm);
+
+	while ( !l_isempty(&hm->maps) ) {
+		l = l_head(&hm->maps);
+		l_rem(l);
+		map = container(l, union hm_map_u, m.entry);
+		hm_unmap(map, map->m.len);
+	}
+	hm->mapped = 0;
+	hm->npools = 0;
+	hm->nadvised = 0;
+}
+
+#endif /* CAT_HAS_POSIX */
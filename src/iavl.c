@@ -0,0 +1,491 @@
+/*
+ * iavl.c -- AVL tree linked by 32-bit indices
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/iavl.h>
+
+#define NODE(t, i)	iavl_node(t, i)
+#define KEY(t, i)	iavl_key(t, i)
+
+
+/* Same as avl_fix() except that a 'dir' of CA_P sets the root */
+static void fix(struct iavltree *t, uint32_t p, uint32_t c, int dir)
+{
+	struct ianode *cn;
+
+	if ( dir == CA_P ) {
+		abort_unless(p == IDX_NIL);
+		t->root = c;
+	} else {
+		abort_unless(p != IDX_NIL);
+		abort_unless(dir == CA_L || dir == CA_R);
+		NODE(t, p)->p[dir] = c;
+	}
+	if ( c != IDX_NIL ) {
+		cn = NODE(t, c);
+		cn->pdir = dir;
+		cn->p[CA_P] = p;
+	}
+}
+
+
+static void rleft(struct iavltree *t, uint32_t n1, uint32_t n2, int ins)
+{
+	struct ianode *a = NODE(t, n1), *b = NODE(t, n2);
+
+	fix(t, n1, b->p[CA_L], CA_R);
+	fix(t, a->p[CA_P], n2, a->pdir);
+	fix(t, n2, n1, CA_L);
+
+	if ( ins || (b->b > 0) ) {
+		a->b = 0;
+		b->b = 0;
+	} else {
+		a->b = 1;
+		b->b = -1;
+	}
+}
+
+
+static void rright(struct iavltree *t, uint32_t n1, uint32_t n2, int ins)
+{
+	struct ianode *a = NODE(t, n1), *b = NODE(t, n2);
+
+	fix(t, n1, b->p[CA_R], CA_L);
+	fix(t, a->p[CA_P], n2, a->pdir);
+	fix(t, n2, n1, CA_R);
+
+	if ( ins || (b->b < 0) ) {
+		a->b = 0;
+		b->b = 0;
+	} else {
+		a->b = -1;
+		b->b = 1;
+	}
+}
+
+
+static void zleft(struct iavltree *t, uint32_t n1, uint32_t n2, uint32_t n3)
+{
+	struct ianode *a = NODE(t, n1), *b = NODE(t, n2), *c = NODE(t, n3);
+
+	fix(t, n2, c->p[CA_R], CA_L);
+	fix(t, n1, c->p[CA_L], CA_R);
+	fix(t, a->p[CA_P], n3, a->pdir);
+	fix(t, n3, n1, CA_L);
+	fix(t, n3, n2, CA_R);
+
+	switch ( c->b ) {
+	case -1:
+		a->b = 0;
+		b->b = 1;
+		break;
+	case 0:
+		a->b = 0;
+		b->b = 0;
+		break;
+	case 1:
+		a->b = -1;
+		b->b = 0;
+		break;
+	}
+	c->b = 0;
+}
+
+
+static void zright(struct iavltree *t, uint32_t n1, uint32_t n2, uint32_t n3)
+{
+	struct ianode *a = NODE(t, n1), *b = NODE(t, n2), *c = NODE(t, n3);
+
+	fix(t, n2, c->p[CA_L], CA_R);
+	fix(t, n1, c->p[CA_R], CA_L);
+	fix(t, a->p[CA_P], n3, a->pdir);
+	fix(t, n3, n1, CA_R);
+	fix(t, n3, n2, CA_L);
+
+	switch ( c->b ) {
+	case -1:
+		a->b = 1;
+		b->b = 0;
+		break;
+	case 0:
+		a->b = 0;
+		b->b = 0;
+		break;
+	case 1:
+		a->b = 0;
+		b->b = -1;
+		break;
+	}
+	c->b = 0;
+}
+
+
+void iavl_init(struct iavltree *t, cmp_f cmp, void *base, size_t esize,
+	       size_t noff, size_t koff)
+{
+	abort_unless(t);
+	abort_unless(cmp);
+	abort_unless(esize >= sizeof(struct ianode));
+	abort_unless(noff <= esize - sizeof(struct ianode));
+	abort_unless(koff < esize);
+	t->cmp = cmp;
+	t->base = base;
+	t->esize = esize;
+	t->noff = noff;
+	t->koff = koff;
+	t->root = IDX_NIL;
+}
+
+
+void iavl_setbase(struct iavltree *t, void *base)
+{
+	abort_unless(t);
+	t->base = base;
+}
+
+
+uint32_t iavl_lkup(struct iavltree *t, const void *key, int *rdir)
+{
+	uint32_t par = IDX_NIL, trav;
+	int dir = CA_P, rv;
+
+	abort_unless(t);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		par = trav;
+		rv = (*t->cmp)(key, KEY(t, trav));
+		if ( rv < 0 ) {
+			dir = CA_L;
+		} else if ( rv > 0 ) {
+			dir = CA_R;
+		} else {
+			dir = CA_N;
+			break;
+		}
+		trav = NODE(t, trav)->p[dir];
+	}
+
+	if ( rdir ) {
+		*rdir = dir;
+		return par;
+	} else {
+		return (dir == CA_N) ? par : IDX_NIL;
+	}
+}
+
+
+uint32_t iavl_ins(struct iavltree *t, uint32_t n)
+{
+	struct ianode *nn, *pn;
+	uint32_t p;
+	int dir;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+
+	p = iavl_lkup(t, KEY(t, n), &dir);
+	if ( dir != CA_N ) {
+		iavl_ins_at(t, n, p, dir);
+		return IDX_NIL;
+	}
+
+	nn = NODE(t, n);
+	pn = NODE(t, p);
+	fix(t, n, pn->p[CA_L], CA_L);
+	fix(t, n, pn->p[CA_R], CA_R);
+	fix(t, pn->p[CA_P], n, pn->pdir);
+	nn->b = pn->b;
+	pn->p[0] = pn->p[1] = pn->p[2] = IDX_NIL;
+	pn->pdir = CA_P;
+	pn->b = 0;
+	return p;
+}
+
+
+void iavl_ins_at(struct iavltree *t, uint32_t n, uint32_t par, int dir)
+{
+	struct ianode *nn;
+	uint32_t tmp;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	abort_unless(((dir == CA_L || dir == CA_R) && par != IDX_NIL) ||
+		     (dir == CA_P && par == IDX_NIL && t->root == IDX_NIL));
+
+	nn = NODE(t, n);
+	nn->p[0] = nn->p[1] = nn->p[2] = IDX_NIL;
+	nn->b = 0;
+	fix(t, par, n, dir);
+
+	while ( (dir = nn->pdir) != CA_P ) {
+		n = nn->p[CA_P];
+		nn = NODE(t, n);
+		/* dir - 1 == -1 if dir == CA_L and 1 if dir == CA_R */
+		if ( nn->b += (dir - 1) ) {
+			if ( nn->b < -1 ) {
+				tmp = nn->p[CA_L];
+				if ( NODE(t, tmp)->b < 0 )
+					rright(t, n, tmp, 1);
+				else
+					zright(t, n, tmp, NODE(t, tmp)->p[CA_R]);
+				return;
+			} else if ( nn->b > 1 ) {
+				tmp = nn->p[CA_R];
+				if ( NODE(t, tmp)->b > 0 )
+					rleft(t, n, tmp, 1);
+				else
+					zleft(t, n, tmp, NODE(t, tmp)->p[CA_L]);
+				return;
+			}
+		} else /* balance is now 0 */
+			break;
+	}
+}
+
+
+static uint32_t findrep(struct iavltree *t, struct ianode *nn)
+{
+	uint32_t tmp;
+
+	tmp = nn->p[CA_L];
+	if ( tmp == IDX_NIL )
+		return nn->p[CA_R];
+	while ( NODE(t, tmp)->p[CA_R] != IDX_NIL )
+		tmp = NODE(t, tmp)->p[CA_R];
+	return tmp;
+}
+
+
+void iavl_rem(struct iavltree *t, uint32_t n)
+{
+	struct ianode *nn, *rn, *tn;
+	uint32_t rep, par, trav, tmp, tmp2;
+	int dir;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+
+	nn = NODE(t, n);
+	par = nn->p[CA_P];
+	rep = findrep(t, nn);
+
+	/* if replacement is not a direct child and is not NIL */
+	if ( rep != IDX_NIL && nn->p[CA_L] != rep && nn->p[CA_R] != rep ) {
+		rn = NODE(t, rep);
+		trav = rn->p[CA_P];
+		dir  = rn->pdir;
+		fix(t, rn->p[CA_P], rn->p[CA_L], rn->pdir);
+		fix(t, rep, nn->p[CA_L], CA_L);
+		fix(t, rep, nn->p[CA_R], CA_R);
+		fix(t, nn->p[CA_P], rep, nn->pdir);
+		rn->b = nn->b;
+	} else {
+		trav = par;
+		dir = nn->pdir;
+		fix(t, par, rep, dir);
+
+		/* rep is the left child only if the node had two children */
+		if ( rep != IDX_NIL && nn->p[CA_L] == rep ) {
+			rn = NODE(t, rep);
+			trav = rep;
+			dir = CA_L;
+			rn->b = nn->b;
+			fix(t, rep, nn->p[CA_R], CA_R);
+		}
+	}
+
+	nn->p[0] = nn->p[1] = nn->p[2] = IDX_NIL;
+	nn->pdir = CA_P;
+	nn->b = 0;
+
+	/* now traverse up the tree */
+	while ( dir != CA_P ) {
+		tn = NODE(t, trav);
+		if ( tn->b -= (dir - 1) ) {
+			if ( tn->b < -1 ) {
+				tmp = tn->p[CA_L];
+				if ( NODE(t, tmp)->b <= 0 ) {
+					rright(t, trav, tmp, 0);
+					if ( NODE(t, tmp)->b )
+						break;
+					trav = tmp;
+				} else {
+					tmp2 = NODE(t, tmp)->p[CA_R];
+					zright(t, trav, tmp, tmp2);
+					trav = tmp2;
+				}
+			} else if ( tn->b > 1 ) {
+				tmp = tn->p[CA_R];
+				if ( NODE(t, tmp)->b >= 0 ) {
+					rleft(t, trav, tmp, 0);
+					if ( NODE(t, tmp)->b )
+						break;
+					trav = tmp;
+				} else {
+					tmp2 = NODE(t, tmp)->p[CA_L];
+					zleft(t, trav, tmp, tmp2);
+					trav = tmp2;
+				}
+			} else /* unbalanced but no height change */
+				break;
+		}
+
+		tn = NODE(t, trav);
+		dir  = tn->pdir;
+		trav = tn->p[CA_P];
+	}
+}
+
+
+/* Like avl_apply() this visits a node's children before the node itself */
+void iavl_apply(struct iavltree *t, apply_f func, void *ctx)
+{
+	struct ianode *tn;
+	uint32_t trav, cur;
+	int dir = CA_P;
+
+	abort_unless(t);
+	abort_unless(func);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		tn = NODE(t, trav);
+		if ( dir == CA_P && tn->p[CA_L] != IDX_NIL ) {
+			trav = tn->p[CA_L];
+		} else if ( dir != CA_R && tn->p[CA_R] != IDX_NIL ) {
+			dir  = CA_P;
+			trav = tn->p[CA_R];
+		} else {
+			cur  = trav;
+			dir  = tn->pdir;
+			trav = tn->p[CA_P];
+			func(iavl_elem(t, cur), ctx);
+		}
+	}
+}
+
+
+int iavl_isempty(struct iavltree *t)
+{
+	abort_unless(t);
+	return t->root == IDX_NIL;
+}
+
+
+uint32_t iavl_getroot(struct iavltree *t)
+{
+	abort_unless(t);
+	return t->root;
+}
+
+
+uint32_t iavl_getmin(struct iavltree *t)
+{
+	uint32_t trav;
+
+	abort_unless(t);
+	trav = t->root;
+	if ( trav != IDX_NIL ) {
+		while ( NODE(t, trav)->p[CA_L] != IDX_NIL )
+			trav = NODE(t, trav)->p[CA_L];
+	}
+	return trav;
+}
+
+
+uint32_t iavl_getmax(struct iavltree *t)
+{
+	uint32_t trav;
+
+	abort_unless(t);
+	trav = t->root;
+	if ( trav != IDX_NIL ) {
+		while ( NODE(t, trav)->p[CA_R] != IDX_NIL )
+			trav = NODE(t, trav)->p[CA_R];
+	}
+	return trav;
+}
+
+
+uint32_t iavl_next(struct iavltree *t, uint32_t n)
+{
+	struct ianode *nn;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	nn = NODE(t, n);
+	if ( nn->p[CA_R] != IDX_NIL ) {
+		n = nn->p[CA_R];
+		while ( NODE(t, n)->p[CA_L] != IDX_NIL )
+			n = NODE(t, n)->p[CA_L];
+		return n;
+	}
+	while ( nn->pdir == CA_R )
+		nn = NODE(t, nn->p[CA_P]);
+	return nn->p[CA_P];
+}
+
+
+uint32_t iavl_prev(struct iavltree *t, uint32_t n)
+{
+	struct ianode *nn;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	nn = NODE(t, n);
+	if ( nn->p[CA_L] != IDX_NIL ) {
+		n = nn->p[CA_L];
+		while ( NODE(t, n)->p[CA_R] != IDX_NIL )
+			n = NODE(t, n)->p[CA_R];
+		return n;
+	}
+	while ( nn->pdir == CA_L )
+		nn = NODE(t, nn->p[CA_P]);
+	return nn->p[CA_P];
+}
+
+
+uint32_t iavl_lbound(struct iavltree *t, const void *key)
+{
+	uint32_t trav, best = IDX_NIL;
+	int rv;
+
+	abort_unless(t);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		rv = (*t->cmp)(key, KEY(t, trav));
+		if ( rv <= 0 ) {
+			best = trav;
+			if ( rv == 0 )
+				break;
+			trav = NODE(t, trav)->p[CA_L];
+		} else {
+			trav = NODE(t, trav)->p[CA_R];
+		}
+	}
+	return best;
+}
+
+
+uint32_t iavl_ubound(struct iavltree *t, const void *key)
+{
+	uint32_t trav, best = IDX_NIL;
+
+	abort_unless(t);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		if ( (*t->cmp)(key, KEY(t, trav)) < 0 ) {
+			best = trav;
+			trav = NODE(t, trav)->p[CA_L];
+		} else {
+			trav = NODE(t, trav)->p[CA_R];
+		}
+	}
+	return best;
+}
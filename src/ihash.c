@@ -0,0 +1,144 @@
+/*
+ * ihash.c -- Chained hash table linked by 32-bit indices
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/ihash.h>
+
+#define NODE(t, i)	iht_node(t, i)
+#define KEY(t, i)	iht_key(t, i)
+
+
+void iht_init(struct ihtab *t, uint32_t *bkts, uint nbkts, cmp_f cmp,
+	      hash_f hash, void *hctx, void *base, size_t esize,
+	      size_t noff, size_t koff)
+{
+	uint i;
+
+	abort_unless(t);
+	abort_unless(bkts);
+	abort_unless(nbkts > 0 && (nbkts & (nbkts - 1)) == 0);
+	abort_unless(cmp);
+	abort_unless(hash);
+	abort_unless(esize >= sizeof(struct ihnode));
+	abort_unless(noff <= esize - sizeof(struct ihnode));
+	abort_unless(koff < esize);
+
+	for ( i = 0; i < nbkts; ++i )
+		bkts[i] = IDX_NIL;
+	t->bkts = bkts;
+	t->nbkts = nbkts;
+	t->mask = nbkts - 1;
+	t->cmp = cmp;
+	t->hash = hash;
+	t->hctx = hctx;
+	t->base = base;
+	t->esize = esize;
+	t->noff = noff;
+	t->koff = koff;
+}
+
+
+void iht_setbase(struct ihtab *t, void *base)
+{
+	abort_unless(t);
+	t->base = base;
+}
+
+
+uint iht_hash(struct ihtab *t, const void *key)
+{
+	abort_unless(t);
+	return (*t->hash)(key, t->hctx);
+}
+
+
+uint32_t iht_lkup(struct ihtab *t, const void *key, uint *hp)
+{
+	uint hash;
+
+	abort_unless(t);
+	hash = (*t->hash)(key, t->hctx);
+	if ( hp )
+		*hp = hash;
+	return iht_hlkup(t, key, hash);
+}
+
+
+uint32_t iht_hlkup(struct ihtab *t, const void *key, uint hash)
+{
+	struct ihnode *nn;
+	uint32_t trav;
+
+	abort_unless(t);
+	for ( trav = t->bkts[hash & t->mask]; trav != IDX_NIL;
+	      trav = nn->next ) {
+		nn = NODE(t, trav);
+		if ( nn->hash == (uint32_t)hash &&
+		     (*t->cmp)(key, KEY(t, trav)) == 0 )
+			break;
+	}
+	return trav;
+}
+
+
+void iht_ins(struct ihtab *t, uint32_t n, uint hash)
+{
+	struct ihnode *nn;
+	uint32_t *bkt;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	nn = NODE(t, n);
+	bkt = &t->bkts[hash & t->mask];
+	nn->hash = hash;
+	nn->next = *bkt;
+	*bkt = n;
+}
+
+
+void iht_ins_h(struct ihtab *t, uint32_t n)
+{
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	iht_ins(t, n, (*t->hash)(KEY(t, n), t->hctx));
+}
+
+
+void iht_rem(struct ihtab *t, uint32_t n)
+{
+	struct ihnode *nn;
+	uint32_t *linkp;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	nn = NODE(t, n);
+	linkp = &t->bkts[nn->hash & t->mask];
+	while ( *linkp != n ) {
+		abort_unless(*linkp != IDX_NIL);
+		linkp = &NODE(t, *linkp)->next;
+	}
+	*linkp = nn->next;
+	nn->next = IDX_NIL;
+}
+
+
+void iht_apply(struct ihtab *t, apply_f func, void *ctx)
+{
+	uint i;
+	uint32_t trav, next;
+
+	abort_unless(t);
+	abort_unless(func);
+	for ( i = 0; i < t->nbkts; ++i ) {
+		for ( trav = t->bkts[i]; trav != IDX_NIL; trav = next ) {
+			next = NODE(t, trav)->next;
+			func(iht_elem(t, trav), ctx);
+		}
+	}
+}
@@ -0,0 +1,486 @@
+/*
+ * irbtree.c -- Red-Black tree linked by 32-bit indices
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/irbtree.h>
+
+#define NODE(t, i)	irb_node(t, i)
+#define KEY(t, i)	irb_key(t, i)
+#define COL(t, i)	(((i) != IDX_NIL) ? NODE(t, i)->col : CRB_BLACK)
+
+
+/* Same as rb_fix() except that a 'dir' of CRB_P sets the root */
+static void fix(struct irbtree *t, uint32_t p, uint32_t c, int dir)
+{
+	struct irbnode *cn;
+
+	if ( dir == CRB_P ) {
+		abort_unless(p == IDX_NIL);
+		t->root = c;
+	} else {
+		abort_unless(p != IDX_NIL);
+		abort_unless(dir == CRB_L || dir == CRB_R);
+		NODE(t, p)->p[dir] = c;
+	}
+	if ( c != IDX_NIL ) {
+		cn = NODE(t, c);
+		cn->pdir = dir;
+		cn->p[CRB_P] = p;
+	}
+}
+
+
+static uint32_t child(struct irbtree *t, uint32_t p, int dir)
+{
+	return (dir == CRB_P) ? t->root : NODE(t, p)->p[dir];
+}
+
+
+static void rleft(struct irbtree *t, uint32_t n)
+{
+	struct irbnode *nn = NODE(t, n);
+	uint32_t c = nn->p[CRB_R];
+
+	abort_unless(c != IDX_NIL);
+	fix(t, n, NODE(t, c)->p[CRB_L], CRB_R);
+	fix(t, nn->p[CRB_P], c, nn->pdir);
+	fix(t, c, n, CRB_L);
+}
+
+
+static void rright(struct irbtree *t, uint32_t n)
+{
+	struct irbnode *nn = NODE(t, n);
+	uint32_t c = nn->p[CRB_L];
+
+	abort_unless(c != IDX_NIL);
+	fix(t, n, NODE(t, c)->p[CRB_R], CRB_L);
+	fix(t, nn->p[CRB_P], c, nn->pdir);
+	fix(t, c, n, CRB_R);
+}
+
+
+void irb_init(struct irbtree *t, cmp_f cmp, void *base, size_t esize,
+	      size_t noff, size_t koff)
+{
+	abort_unless(t);
+	abort_unless(cmp);
+	abort_unless(esize >= sizeof(struct irbnode));
+	abort_unless(noff <= esize - sizeof(struct irbnode));
+	abort_unless(koff < esize);
+	t->cmp = cmp;
+	t->base = base;
+	t->esize = esize;
+	t->noff = noff;
+	t->koff = koff;
+	t->root = IDX_NIL;
+}
+
+
+void irb_setbase(struct irbtree *t, void *base)
+{
+	abort_unless(t);
+	t->base = base;
+}
+
+
+uint32_t irb_lkup(struct irbtree *t, const void *key, int *rdir)
+{
+	uint32_t par = IDX_NIL, trav;
+	int dir = CRB_P, rv;
+
+	abort_unless(t);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		par = trav;
+		rv = (*t->cmp)(key, KEY(t, trav));
+		if ( rv < 0 ) {
+			dir = CRB_L;
+		} else if ( rv > 0 ) {
+			dir = CRB_R;
+		} else {
+			dir = CRB_N;
+			break;
+		}
+		trav = NODE(t, trav)->p[dir];
+	}
+
+	if ( rdir ) {
+		*rdir = dir;
+		return par;
+	} else {
+		return (dir == CRB_N) ? par : IDX_NIL;
+	}
+}
+
+
+uint32_t irb_ins(struct irbtree *t, uint32_t n)
+{
+	struct irbnode *nn, *pn;
+	uint32_t p;
+	int dir;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+
+	p = irb_lkup(t, KEY(t, n), &dir);
+	if ( dir != CRB_N ) {
+		irb_ins_at(t, n, p, dir);
+		return IDX_NIL;
+	}
+
+	nn = NODE(t, n);
+	pn = NODE(t, p);
+	fix(t, n, pn->p[CRB_L], CRB_L);
+	fix(t, n, pn->p[CRB_R], CRB_R);
+	fix(t, pn->p[CRB_P], n, pn->pdir);
+	nn->col = pn->col;
+	pn->p[0] = pn->p[1] = pn->p[2] = IDX_NIL;
+	pn->pdir = CRB_P;
+	pn->col = CRB_RED;
+	return p;
+}
+
+
+void irb_ins_at(struct irbtree *t, uint32_t n, uint32_t par, int dir)
+{
+	struct irbnode *nn, *pn, *gn;
+	uint32_t gp, unc, tmp;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	abort_unless(((dir == CRB_L || dir == CRB_R) && par != IDX_NIL) ||
+		     (dir == CRB_P && par == IDX_NIL && t->root == IDX_NIL));
+
+	nn = NODE(t, n);
+	nn->p[0] = nn->p[1] = nn->p[2] = IDX_NIL;
+	nn->col = CRB_RED;
+	fix(t, par, n, dir);
+
+	while ( n != t->root &&
+		(pn = NODE(t, par = NODE(t, n)->p[CRB_P]))->col == CRB_RED ) {
+		/* the parent is red so it is not the root */
+		gp = pn->p[CRB_P];
+		gn = NODE(t, gp);
+		if ( pn->pdir == CRB_L ) {
+			unc = gn->p[CRB_R];
+			if ( COL(t, unc) == CRB_RED ) {
+				pn->col = CRB_BLACK;
+				NODE(t, unc)->col = CRB_BLACK;
+				gn->col = CRB_RED;
+				n = gp;
+			} else {
+				if ( NODE(t, n)->pdir == CRB_R ) {
+					tmp = n;
+					n = par;
+					par = tmp;
+					rleft(t, n);
+				}
+				NODE(t, par)->col = CRB_BLACK;
+				gn->col = CRB_RED;
+				rright(t, gp);
+			}
+		} else {
+			unc = gn->p[CRB_L];
+			if ( COL(t, unc) == CRB_RED ) {
+				pn->col = CRB_BLACK;
+				NODE(t, unc)->col = CRB_BLACK;
+				gn->col = CRB_RED;
+				n = gp;
+			} else {
+				if ( NODE(t, n)->pdir == CRB_L ) {
+					tmp = n;
+					n = par;
+					par = tmp;
+					rright(t, n);
+				}
+				NODE(t, par)->col = CRB_BLACK;
+				gn->col = CRB_RED;
+				rleft(t, gp);
+			}
+		}
+	}
+
+	NODE(t, t->root)->col = CRB_BLACK;
+}
+
+
+static uint32_t findrep(struct irbtree *t, struct irbnode *nn)
+{
+	uint32_t tmp;
+
+	tmp = nn->p[CRB_L];
+	if ( tmp == IDX_NIL )
+		return nn->p[CRB_R];
+	while ( NODE(t, tmp)->p[CRB_R] != IDX_NIL )
+		tmp = NODE(t, tmp)->p[CRB_R];
+	return tmp;
+}
+
+
+void irb_rem(struct irbtree *t, uint32_t n)
+{
+	struct irbnode *nn, *pn, *tn;
+	uint32_t tmp, par;
+	int cdir, oldc;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+
+	nn = NODE(t, n);
+	tmp = findrep(t, nn);
+	if ( tmp == IDX_NIL ) {
+		par = nn->p[CRB_P];
+		cdir = nn->pdir;
+		fix(t, par, IDX_NIL, cdir);
+		oldc = nn->col;
+	} else if ( tmp == nn->p[CRB_L] || tmp == nn->p[CRB_R] ) {
+		tn = NODE(t, tmp);
+		par = tmp;
+		if ( tmp == nn->p[CRB_L] ) {
+			fix(t, tmp, nn->p[CRB_R], CRB_R);
+			cdir = CRB_L;
+		} else {
+			cdir = CRB_R;
+		}
+		fix(t, nn->p[CRB_P], tmp, nn->pdir);
+		oldc = tn->col;
+		tn->col = nn->col;
+	} else {
+		tn = NODE(t, tmp);
+		cdir = tn->pdir;
+		par = tn->p[CRB_P];
+		fix(t, par, tn->p[CRB_L], cdir);
+		oldc = tn->col;
+		tn->col = nn->col;
+		fix(t, tmp, nn->p[CRB_L], CRB_L);
+		fix(t, tmp, nn->p[CRB_R], CRB_R);
+		fix(t, nn->p[CRB_P], tmp, nn->pdir);
+	}
+	nn->p[0] = nn->p[1] = nn->p[2] = IDX_NIL;
+	nn->pdir = CRB_P;
+	nn->col = CRB_RED;
+	if ( oldc == CRB_RED )
+		return;
+
+	while ( cdir != CRB_P && COL(t, child(t, par, cdir)) == CRB_BLACK ) {
+		pn = NODE(t, par);
+		if ( cdir == CRB_L ) {
+			tmp = pn->p[CRB_R];
+			if ( NODE(t, tmp)->col == CRB_RED ) {
+				NODE(t, tmp)->col = CRB_BLACK;
+				pn->col = CRB_RED;
+				rleft(t, par);
+				tmp = pn->p[CRB_R];
+			}
+			tn = NODE(t, tmp);
+
+			if ( COL(t, tn->p[CRB_L]) == CRB_BLACK &&
+			     COL(t, tn->p[CRB_R]) == CRB_BLACK ) {
+				tn->col = CRB_RED;
+				cdir = pn->pdir;
+				par = pn->p[CRB_P];
+			} else {
+				if ( COL(t, tn->p[CRB_R]) == CRB_BLACK ) {
+					NODE(t, tn->p[CRB_L])->col = CRB_BLACK;
+					tn->col = CRB_RED;
+					rright(t, tmp);
+					tmp = pn->p[CRB_R];
+					tn = NODE(t, tmp);
+				}
+				tn->col = pn->col;
+				pn->col = CRB_BLACK;
+				NODE(t, tn->p[CRB_R])->col = CRB_BLACK;
+				rleft(t, par);
+				par = IDX_NIL;
+				cdir = CRB_P;
+			}
+		} else {
+			tmp = pn->p[CRB_L];
+			if ( NODE(t, tmp)->col == CRB_RED ) {
+				NODE(t, tmp)->col = CRB_BLACK;
+				pn->col = CRB_RED;
+				rright(t, par);
+				tmp = pn->p[CRB_L];
+			}
+			tn = NODE(t, tmp);
+
+			if ( COL(t, tn->p[CRB_L]) == CRB_BLACK &&
+			     COL(t, tn->p[CRB_R]) == CRB_BLACK ) {
+				tn->col = CRB_RED;
+				cdir = pn->pdir;
+				par = pn->p[CRB_P];
+			} else {
+				if ( COL(t, tn->p[CRB_L]) == CRB_BLACK ) {
+					NODE(t, tn->p[CRB_R])->col = CRB_BLACK;
+					tn->col = CRB_RED;
+					rleft(t, tmp);
+					tmp = pn->p[CRB_L];
+					tn = NODE(t, tmp);
+				}
+				tn->col = pn->col;
+				pn->col = CRB_BLACK;
+				NODE(t, tn->p[CRB_L])->col = CRB_BLACK;
+				rright(t, par);
+				par = IDX_NIL;
+				cdir = CRB_P;
+			}
+		}
+	}
+
+	tmp = child(t, par, cdir);
+	if ( tmp != IDX_NIL )
+		NODE(t, tmp)->col = CRB_BLACK;
+}
+
+
+void irb_apply(struct irbtree *t, apply_f func, void *ctx)
+{
+	struct irbnode *tn;
+	uint32_t trav, cur;
+	int dir = CRB_P;
+
+	abort_unless(t);
+	abort_unless(func);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		tn = NODE(t, trav);
+		if ( dir == CRB_P && tn->p[CRB_L] != IDX_NIL ) {
+			trav = tn->p[CRB_L];
+		} else if ( dir != CRB_R && tn->p[CRB_R] != IDX_NIL ) {
+			dir  = CRB_P;
+			trav = tn->p[CRB_R];
+		} else {
+			cur  = trav;
+			dir  = tn->pdir;
+			trav = tn->p[CRB_P];
+			func(irb_elem(t, cur), ctx);
+		}
+	}
+}
+
+
+int irb_isempty(struct irbtree *t)
+{
+	abort_unless(t);
+	return t->root == IDX_NIL;
+}
+
+
+uint32_t irb_getroot(struct irbtree *t)
+{
+	abort_unless(t);
+	return t->root;
+}
+
+
+uint32_t irb_getmin(struct irbtree *t)
+{
+	uint32_t trav;
+
+	abort_unless(t);
+	trav = t->root;
+	if ( trav != IDX_NIL ) {
+		while ( NODE(t, trav)->p[CRB_L] != IDX_NIL )
+			trav = NODE(t, trav)->p[CRB_L];
+	}
+	return trav;
+}
+
+
+uint32_t irb_getmax(struct irbtree *t)
+{
+	uint32_t trav;
+
+	abort_unless(t);
+	trav = t->root;
+	if ( trav != IDX_NIL ) {
+		while ( NODE(t, trav)->p[CRB_R] != IDX_NIL )
+			trav = NODE(t, trav)->p[CRB_R];
+	}
+	return trav;
+}
+
+
+uint32_t irb_next(struct irbtree *t, uint32_t n)
+{
+	struct irbnode *nn;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	nn = NODE(t, n);
+	if ( nn->p[CRB_R] != IDX_NIL ) {
+		n = nn->p[CRB_R];
+		while ( NODE(t, n)->p[CRB_L] != IDX_NIL )
+			n = NODE(t, n)->p[CRB_L];
+		return n;
+	}
+	while ( nn->pdir == CRB_R )
+		nn = NODE(t, nn->p[CRB_P]);
+	return nn->p[CRB_P];
+}
+
+
+uint32_t irb_prev(struct irbtree *t, uint32_t n)
+{
+	struct irbnode *nn;
+
+	abort_unless(t);
+	abort_unless(n != IDX_NIL);
+	nn = NODE(t, n);
+	if ( nn->p[CRB_L] != IDX_NIL ) {
+		n = nn->p[CRB_L];
+		while ( NODE(t, n)->p[CRB_R] != IDX_NIL )
+			n = NODE(t, n)->p[CRB_R];
+		return n;
+	}
+	while ( nn->pdir == CRB_L )
+		nn = NODE(t, nn->p[CRB_P]);
+	return nn->p[CRB_P];
+}
+
+
+uint32_t irb_lbound(struct irbtree *t, const void *key)
+{
+	uint32_t trav, best = IDX_NIL;
+	int rv;
+
+	abort_unless(t);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		rv = (*t->cmp)(key, KEY(t, trav));
+		if ( rv <= 0 ) {
+			best = trav;
+			if ( rv == 0 )
+				break;
+			trav = NODE(t, trav)->p[CRB_L];
+		} else {
+			trav = NODE(t, trav)->p[CRB_R];
+		}
+	}
+	return best;
+}
+
+
+uint32_t irb_ubound(struct irbtree *t, const void *key)
+{
+	uint32_t trav, best = IDX_NIL;
+
+	abort_unless(t);
+	trav = t->root;
+	while ( trav != IDX_NIL ) {
+		if ( (*t->cmp)(key, KEY(t, trav)) < 0 ) {
+			best = trav;
+			trav = NODE(t, trav)->p[CRB_L];
+		} else {
+			trav = NODE(t, trav)->p[CRB_R];
+		}
+	}
+	return best;
+}
@@ -10,6 +10,7 @@
 #include <cat/cat.h>
 #include <cat/mem.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 void *mem_get(struct memmgr *mm, size_t len)
@@ -36,6 +37,34 @@ void mem_free(struct memmgr *mm, void *mem)
 }
 
 
+void *mem_get_aligned(struct memmgr *mm, size_t align, size_t len)
+{
+	byte_t *p;
+	uintptr_t a;
+
+	abort_unless(align > 0 && (align & (align - 1)) == 0);
+
+	if ( align < sizeof(void *) )
+		align = sizeof(void *);
+	if ( len > (size_t)~0 - align - sizeof(void *) )
+		return NULL;
+	p = mem_get(mm, len + align - 1 + sizeof(void *));
+	if ( p == NULL )
+		return NULL;
+	a = (ptr2uint(p) + sizeof(void *) + align - 1) & ~(uintptr_t)(align - 1);
+	((void **)a)[-1] = p;
+	return (void *)a;
+}
+
+
+void mem_free_aligned(struct memmgr *mm, void *mem)
+{
+	if ( mem == NULL )
+		return;
+	mem_free(mm, ((void **)mem)[-1]);
+}
+
+
 void applyfree(void *data, void *mp)
 {
 	struct memmgr *mm = mp;
@@ -114,6 +143,206 @@ size_t amm_get_avail(struct arraymm *amm)
 }
 
 
+struct rgnblk {
+	struct rgnblk *		next;
+	size_t			len;
+};
+
+union rgnblk_u {
+	cat_align_t		align;
+	struct rgnblk		blk;
+};
+
+#define RGN_DATA(b)	((byte_t *)(b) + sizeof(union rgnblk_u))
+#define RGN_ALIGN	(sizeof(cat_align_t) - 1)
+
+
+static void *rgn_mm_alloc(struct memmgr *mm, size_t len)
+{
+	return rgn_alloc(container(mm, struct region, mm), len);
+}
+
+
+static void *rgn_mm_resize(struct memmgr *mm, void *mem, size_t len)
+{
+	return rgn_resize(container(mm, struct region, mm), mem, len);
+}
+
+
+static void rgn_mm_free(struct memmgr *mm, void *mem)
+{
+	rgn_free(container(mm, struct region, mm), mem);
+}
+
+
+static void rgn_use(struct region *rg, struct rgnblk *b, size_t fill)
+{
+	rg->cur = b;
+	amm_init(&rg->amm, RGN_DATA(b), b->len, 0, 0);
+	rg->amm.fill = fill;
+	rg->last = NULL;
+}
+
+
+void rgn_init(struct region *rg, struct memmgr *bmm, size_t bsize)
+{
+	abort_unless(rg);
+	abort_unless(bmm);
+	abort_unless(bsize > 0);
+
+	rg->mm.mm_alloc = &rgn_mm_alloc;
+	rg->mm.mm_resize = &rgn_mm_resize;
+	rg->mm.mm_free = &rgn_mm_free;
+	rg->mm.mm_ctx = rg;
+	rg->bmm = bmm;
+	rg->bsize = (bsize + RGN_ALIGN) & ~RGN_ALIGN;
+	rg->first = NULL;
+	rg->cur = NULL;
+	rg->last = NULL;
+}
+
+
+void rgn_fini(struct region *rg)
+{
+	abort_unless(rg);
+
+	rgn_reset(rg);
+	mem_free(rg->bmm, rg->first);
+	rg->first = NULL;
+	rg->cur = NULL;
+}
+
+
+void *rgn_alloc(struct region *rg, size_t len)
+{
+	struct rgnblk *b;
+	size_t blen;
+	void *p;
+
+	abort_unless(rg);
+
+	if ( len > (size_t)~0 - RGN_ALIGN - sizeof(union rgnblk_u) )
+		return NULL;
+	if ( rg->cur == NULL || (p = mem_get(&rg->amm.mm, len)) == NULL ) {
+		blen = (len + RGN_ALIGN) & ~RGN_ALIGN;
+		if ( blen < rg->bsize )
+			blen = rg->bsize;
+		b = mem_get(rg->bmm, blen + sizeof(union rgnblk_u));
+		if ( b == NULL )
+			return NULL;
+		b->next = NULL;
+		b->len = blen;
+		if ( rg->cur == NULL )
+			rg->first = b;
+		else
+			rg->cur->next = b;
+		rgn_use(rg, b, 0);
+		p = mem_get(&rg->amm.mm, len);
+		abort_unless(p != NULL);
+	}
+
+	rg->last = p;
+	return p;
+}
+
+
+void *rgn_resize(struct region *rg, void *mem, size_t len)
+{
+	struct rgnblk *b;
+	size_t off, olen;
+	void *nmem;
+
+	abort_unless(rg);
+
+	if ( mem == NULL )
+		return rgn_alloc(rg, len);
+	if ( len == 0 ) {
+		rgn_free(rg, mem);
+		return NULL;
+	}
+
+	if ( mem == rg->last ) {
+		off = (byte_t *)mem - rg->amm.mem;
+		if ( len <= (rg->amm.mlen << rg->amm.alignp2) - off ) {
+			rg->amm.fill = (off + len + RGN_ALIGN) >> rg->amm.alignp2;
+			return mem;
+		}
+		olen = (rg->amm.fill << rg->amm.alignp2) - off;
+	} else {
+		/*
+		 * The size is unknown:  copy up to the end of the block's
+		 * allocated memory which may include later allocations.
+		 */
+		for ( b = rg->first; b != NULL; b = b->next )
+			if ( (byte_t *)mem >= RGN_DATA(b) &&
+			     (byte_t *)mem < RGN_DATA(b) + b->len )
+				break;
+		abort_unless(b != NULL);
+		if ( b == rg->cur )
+			olen = rg->amm.mem + (rg->amm.fill << rg->amm.alignp2) -
+			       (byte_t *)mem;
+		else
+			olen = RGN_DATA(b) + b->len - (byte_t *)mem;
+	}
+
+	nmem = rgn_alloc(rg, len);
+	if ( nmem != NULL )
+		memcpy(nmem, mem, (len < olen) ? len : olen);
+	return nmem;
+}
+
+
+void rgn_free(struct region *rg, void *mem)
+{
+	abort_unless(rg);
+
+	if ( mem == NULL || mem != rg->last )
+		return;
+	rg->amm.fill = ((byte_t *)mem - rg->amm.mem) >> rg->amm.alignp2;
+	rg->last = NULL;
+}
+
+
+void rgn_mark(struct region *rg, struct rgn_mark *m)
+{
+	abort_unless(rg);
+	abort_unless(m);
+
+	m->blk = rg->cur;
+	m->fill = (rg->cur == NULL) ? 0 : rg->amm.fill;
+}
+
+
+void rgn_release(struct region *rg, struct rgn_mark *m)
+{
+	struct rgnblk *b, *next;
+
+	abort_unless(rg);
+	abort_unless(m);
+
+	b = (m->blk == NULL) ? rg->first : m->blk;
+	if ( b == NULL )
+		return;
+	for ( next = b->next; next != NULL; next = b->next ) {
+		b->next = next->next;
+		mem_free(rg->bmm, next);
+	}
+	rgn_use(rg, b, (m->blk == NULL) ? 0 : m->fill);
+}
+
+
+void rgn_reset(struct region *rg)
+{
+	struct rgn_mark m;
+
+	abort_unless(rg);
+
+	m.blk = NULL;
+	m.fill = 0;
+	rgn_release(rg, &m);
+}
+
+
 static void * std_alloc(struct memmgr *mm, size_t size) 
 {
 	abort_unless(mm && size > 0);
@@ -0,0 +1,278 @@
+/*
+ * mtlsf.c -- Thread caching front end for the TLSF allocator
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/mtlsf.h>
+#include <cat/err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEXT(p)		(*(void **)(p))
+
+
+static void mt_lock(struct mtlsf *mt)
+{
+	pthread_mutex_lock(&mt->lock);
+	mt->nlocks += 1;
+}
+
+
+static void mt_unlock(struct mtlsf *mt)
+{
+	pthread_mutex_unlock(&mt->lock);
+}
+
+
+/* Hand up to 'n' blocks from 'mag' back to the heap:  lock must be held */
+static void mag_drain(struct mtlsf *mt, struct mt_mag *mag, uint n)
+{
+	void *p;
+
+	while ( n-- > 0 && (p = mag->head) != NULL ) {
+		mag->head = NEXT(p);
+		mag->count -= 1;
+		tlsf_free(mt->tlsf, p);
+	}
+}
+
+
+static void thr_flush(struct mt_thr *thr)
+{
+	int i;
+
+	for ( i = 0 ; i < MT_NCLASS ; ++i )
+		mag_drain(thr->mt, &thr->mags[i], thr->mags[i].count);
+}
+
+
+static void thr_release(void *arg)
+{
+	struct mt_thr *thr = arg;
+	struct mtlsf *mt = thr->mt;
+
+	mt_lock(mt);
+	thr_flush(thr);
+	thr->inuse = 0;
+	mt_unlock(mt);
+}
+
+
+static struct mt_thr *get_thr(struct mtlsf *mt)
+{
+	struct mt_thr *thr;
+
+	thr = pthread_getspecific(mt->key);
+	if ( thr != NULL )
+		return thr;
+
+	mt_lock(mt);
+	for ( thr = mt->threads ; thr != NULL ; thr = thr->next )
+		if ( !thr->inuse )
+			break;
+	if ( thr == NULL ) {
+		thr = malloc(sizeof(*thr));
+		if ( thr == NULL )
+			err("mtlsf: unable to allocate thread record\n");
+		memset(thr, 0, sizeof(*thr));
+		thr->mt = mt;
+		thr->next = mt->threads;
+		mt->threads = thr;
+	}
+	thr->inuse = 1;
+	mt_unlock(mt);
+
+	if ( pthread_setspecific(mt->key, thr) != 0 )
+		err("mtlsf: unable to set thread record\n");
+
+	return thr;
+}
+
+
+static void *mt_mm_alloc(struct memmgr *mm, size_t len)
+{
+	return mtlsf_malloc(container(mm, struct mtlsf, mm), len);
+}
+
+
+static void *mt_mm_resize(struct memmgr *mm, void *mem, size_t len)
+{
+	return mtlsf_realloc(container(mm, struct mtlsf, mm), mem, len);
+}
+
+
+static void mt_mm_free(struct memmgr *mm, void *mem)
+{
+	mtlsf_free(container(mm, struct mtlsf, mm), mem);
+}
+
+
+int mtlsf_init(struct mtlsf *mt, struct tlsf *tlsf)
+{
+	abort_unless(mt != NULL);
+	abort_unless(tlsf != NULL);
+
+	mt->mm.mm_alloc = &mt_mm_alloc;
+	mt->mm.mm_resize = &mt_mm_resize;
+	mt->mm.mm_free = &mt_mm_free;
+	mt->mm.mm_ctx = mt;
+	mt->tlsf = tlsf;
+	mt->threads = NULL;
+	mt->nlocks = 0;
+	if ( pthread_key_create(&mt->key, &thr_release) != 0 )
+		return -1;
+	if ( pthread_mutex_init(&mt->lock, NULL) != 0 ) {
+		pthread_key_delete(mt->key);
+		return -1;
+	}
+	return 0;
+}
+
+
+void mtlsf_fini(struct mtlsf *mt)
+{
+	struct mt_thr *thr, *next;
+
+	abort_unless(mt != NULL);
+
+	pthread_key_delete(mt->key);
+	for ( thr = mt->threads ; thr != NULL ; thr = next ) {
+		next = thr->next;
+		thr_flush(thr);
+		free(thr);
+	}
+	pthread_mutex_destroy(&mt->lock);
+	mt->threads = NULL;
+}
+
+
+void *mtlsf_malloc(struct mtlsf *mt, size_t len)
+{
+	struct mt_mag *mag;
+	void *p;
+	size_t csz;
+	uint n;
+
+	abort_unless(mt != NULL);
+
+	if ( len == 0 || len > MT_MAXSMALL ) {
+		mt_lock(mt);
+		p = tlsf_malloc(mt->tlsf, len);
+		mt_unlock(mt);
+		return p;
+	}
+
+	mag = &get_thr(mt)->mags[(len - 1) / MT_CLASSSZ];
+	if ( mag->head == NULL ) {
+		csz = ((len - 1) / MT_CLASSSZ + 1) * MT_CLASSSZ;
+		mt_lock(mt);
+		for ( n = 0 ; n < MT_BATCH ; ++n ) {
+			if ( (p = tlsf_malloc(mt->tlsf, csz)) == NULL )
+				break;
+			NEXT(p) = mag->head;
+			mag->head = p;
+		}
+		mt_unlock(mt);
+		if ( n == 0 )
+			return NULL;
+		mag->count = n;
+	}
+
+	p = mag->head;
+	mag->head = NEXT(p);
+	mag->count -= 1;
+	return p;
+}
+
+
+void mtlsf_free(struct mtlsf *mt, void *mem)
+{
+	struct mt_mag *mag;
+	size_t usz;
+
+	abort_unless(mt != NULL);
+
+	if ( mem == NULL )
+		return;
+
+	/*
+	 * A block serves every class up to its usable size.  Reading it
+	 * without the lock is safe:  while the block is allocated other
+	 * threads only flip the "previous block allocated" flag in the
+	 * same header word, never the size bits.
+	 */
+	usz = tlsf_usable_size(mem);
+	if ( usz > MT_MAXSMALL ) {
+		mt_lock(mt);
+		tlsf_free(mt->tlsf, mem);
+		mt_unlock(mt);
+		return;
+	}
+
+	mag = &get_thr(mt)->mags[usz / MT_CLASSSZ - 1];
+	NEXT(mem) = mag->head;
+	mag->head = mem;
+	if ( ++mag->count >= 2 * MT_BATCH ) {
+		mt_lock(mt);
+		mag_drain(mt, mag, MT_BATCH);
+		mt_unlock(mt);
+	}
+}
+
+
+void *mtlsf_realloc(struct mtlsf *mt, void *mem, size_t len)
+{
+	void *nmem;
+	size_t usz;
+
+	abort_unless(mt != NULL);
+
+	if ( mem == NULL )
+		return mtlsf_malloc(mt, len);
+	if ( len == 0 ) {
+		mtlsf_free(mt, mem);
+		return NULL;
+	}
+
+	usz = tlsf_usable_size(mem);
+	if ( usz > MT_MAXSMALL && len > MT_MAXSMALL ) {
+		mt_lock(mt);
+		nmem = tlsf_realloc(mt->tlsf, mem, len);
+		mt_unlock(mt);
+		return nmem;
+	}
+	if ( usz <= MT_MAXSMALL && len <= usz )
+		return mem;
+
+	nmem = mtlsf_malloc(mt, len);
+	if ( nmem != NULL ) {
+		memcpy(nmem, mem, (len < usz) ? len : usz);
+		mtlsf_free(mt, mem);
+	}
+	return nmem;
+}
+
+
+void mtlsf_flush(struct mtlsf *mt)
+{
+	struct mt_thr *thr;
+
+	abort_unless(mt != NULL);
+
+	thr = pthread_getspecific(mt->key);
+	if ( thr == NULL )
+		return;
+	mt_lock(mt);
+	thr_flush(thr);
+	mt_unlock(mt);
+}
+
+#endif /* CAT_HAS_POSIX */
@@ -0,0 +1,250 @@
+/*
+ * ohash.c -- Open addressing hash table with grouped control bytes
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/ohash.h>
+#include <cat/archops.h>
+
+#if defined(__SSE2__) && CAT_USE_STDLIB && !CAT_ANSI89
+#define CAT_OHT_SSE2 1
+#include <emmintrin.h>
+#else
+#define CAT_OHT_SSE2 0
+#endif
+
+
+/*
+ * Fibonacci hashing multiplier:  spreads weak hashes across the table.
+ * The control byte tag comes from a second multiply so that it stays
+ * independent of the bits that chose the probe position.
+ */
+#define OHT_MULT	0x9E3779B1u
+#define OHT_TMULT	0x85EBCA6Bu
+#define OHT_GRPMASK	((1u << OHT_GRPSZ) - 1)
+
+
+#if CAT_OHT_SSE2
+
+/* Bitmask of the slots in the group at 'p' whose control byte is 'c' */
+static uint grp_match(const uchar *p, uchar c)
+{
+	__m128i ctl = _mm_loadu_si128((const __m128i *)p);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctl, _mm_set1_epi8((char)c)));
+}
+
+
+/* Bitmask of the slots in the group at 'p' that are empty or deleted */
+static uint grp_avail(const uchar *p)
+{
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p));
+}
+
+#else /* CAT_OHT_SSE2 */
+
+static uint grp_match(const uchar *p, uchar c)
+{
+	uint i;
+	uint m = 0;
+	for ( i = 0 ; i < OHT_GRPSZ ; ++i )
+		if ( p[i] == c )
+			m |= (1u << i);
+	return m;
+}
+
+
+static uint grp_avail(const uchar *p)
+{
+	uint i;
+	uint m = 0;
+	for ( i = 0 ; i < OHT_GRPSZ ; ++i )
+		if ( (p[i] & 0x80) )
+			m |= (1u << i);
+	return m;
+}
+
+#endif /* CAT_OHT_SSE2 */
+
+
+static void set_ctl(struct ohtab *t, uint i, uchar c)
+{
+	t->ctl[i] = c;
+	if ( i < OHT_GRPSZ )
+		t->ctl[t->nslots + i] = c;
+}
+
+
+static uint probe_start(struct ohtab *t, uint h)
+{
+	return ((uint)(h * OHT_MULT) >> t->shift) & t->mask;
+}
+
+
+static uchar hash_tag(uint h)
+{
+	return ((uint)((h ^ (h >> 16)) * OHT_TMULT) >> 25) & 0x7F;
+}
+
+
+void oht_init(struct ohtab *t, struct ohslot *slots, uchar *ctl, uint nslots,
+	      cmp_f cmp, hash_f hash, void *hctx)
+{
+	uint i;
+
+	abort_unless(t != NULL);
+	abort_unless(slots != NULL);
+	abort_unless(ctl != NULL);
+	abort_unless(cmp != NULL);
+	abort_unless(hash != NULL);
+	abort_unless(nslots >= OHT_GRPSZ);
+	abort_unless((nslots & (nslots - 1)) == 0);
+
+	t->slots = slots;
+	t->ctl = ctl;
+	t->nslots = nslots;
+	t->mask = nslots - 1;
+	t->fill = 0;
+	t->ndel = 0;
+	t->maxfill = nslots - nslots / 8;
+	t->cmp = cmp;
+	t->hash = hash;
+	t->hctx = hctx;
+
+	for ( i = 0, t->shift = 32 ; (1u << i) < nslots ; ++i )
+		t->shift -= 1;
+
+	for ( i = 0 ; i < OHT_CTLLEN(nslots) ; ++i )
+		ctl[i] = OHT_EMPTY;
+	for ( i = 0 ; i < nslots ; ++i ) {
+		slots[i].key = NULL;
+		slots[i].data = NULL;
+	}
+}
+
+
+uint oht_hash(struct ohtab *t, const void *key)
+{
+	abort_unless(t != NULL);
+	return (*t->hash)(key, t->hctx);
+}
+
+
+struct ohslot *oht_lkup(struct ohtab *t, const void *key, uint *hashp)
+{
+	uint h, pos, step, m;
+	uchar *p, tag;
+	struct ohslot *s;
+
+	abort_unless(t != NULL);
+
+	h = (*t->hash)(key, t->hctx);
+	if ( hashp != NULL )
+		*hashp = h;
+
+	pos = probe_start(t, h);
+	tag = hash_tag(h);
+	step = 0;
+	do {
+		p = t->ctl + pos;
+		m = grp_match(p, tag);
+		while ( m != 0 ) {
+			s = &t->slots[(pos + ntz_32(m)) & t->mask];
+			if ( (*t->cmp)(s->key, key) == 0 )
+				return s;
+			m &= m - 1;
+		}
+		if ( grp_match(p, OHT_EMPTY) != 0 )
+			return NULL;
+		step += OHT_GRPSZ;
+		pos = (pos + step) & t->mask;
+	} while ( step < t->nslots );
+
+	return NULL;
+}
+
+
+struct ohslot *oht_ins(struct ohtab *t, void *key, void *data, uint h)
+{
+	uint pos, step, m, i;
+	struct ohslot *s;
+
+	abort_unless(t != NULL);
+
+	if ( oht_isfull(t) )
+		return NULL;
+
+	pos = probe_start(t, h);
+	step = 0;
+	while ( (m = grp_avail(t->ctl + pos)) == 0 ) {
+		step += OHT_GRPSZ;
+		pos = (pos + step) & t->mask;
+		abort_unless(step < t->nslots);
+	}
+
+	i = (pos + ntz_32(m)) & t->mask;
+	if ( t->ctl[i] == OHT_DELETED )
+		t->ndel -= 1;
+	t->fill += 1;
+	set_ctl(t, i, hash_tag(h));
+	s = &t->slots[i];
+	s->key = key;
+	s->data = data;
+
+	return s;
+}
+
+
+void oht_rem(struct ohtab *t, struct ohslot *s)
+{
+	uint i, before, after;
+
+	abort_unless(t != NULL);
+	abort_unless(s >= t->slots && s < t->slots + t->nslots);
+
+	i = s - t->slots;
+	abort_unless((t->ctl[i] & 0x80) == 0);
+
+	/*
+	 * The slot can go back to empty if no probe could ever have found
+	 * a full group containing it:  ie. there is an empty slot within
+	 * every window of OHT_GRPSZ slots that covers it.
+	 */
+	before = grp_match(t->ctl + ((i - OHT_GRPSZ) & t->mask), OHT_EMPTY);
+	after = grp_match(t->ctl + i, OHT_EMPTY);
+	if ( before != 0 && after != 0 &&
+	     ntz_32(after) + (nlz_32(before) - (32 - OHT_GRPSZ)) < OHT_GRPSZ ) {
+		set_ctl(t, i, OHT_EMPTY);
+	} else {
+		set_ctl(t, i, OHT_DELETED);
+		t->ndel += 1;
+	}
+
+	t->fill -= 1;
+	s->key = NULL;
+	s->data = NULL;
+}
+
+
+int oht_isfull(struct ohtab *t)
+{
+	abort_unless(t != NULL);
+	return t->fill + t->ndel >= t->maxfill;
+}
+
+
+void oht_apply(struct ohtab *t, apply_f f, void *ctx)
+{
+	uint i;
+
+	abort_unless(t != NULL);
+	abort_unless(f != NULL);
+
+	for ( i = 0 ; i < t->nslots ; ++i )
+		if ( (t->ctl[i] & 0x80) == 0 )
+			(*f)(&t->slots[i], ctx);
+}
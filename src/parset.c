@@ -0,0 +1,323 @@
+/*
+ * parset.c -- Parallel set operations on balanced trees
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/parset.h>
+#include <pthread.h>
+
+/*
+ * One half of a divide and conquer step.  't2' is a tree for unions and
+ * the root of the subtree of keys to intersect with or remove otherwise.
+ * 'depth' is the number of levels left that may still fork.
+ */
+struct psjob {
+	void *		t1;
+	void *		t2;
+	void *		own;
+	apply_f		func;
+	void *		ctx;
+	int		depth;
+};
+
+
+static void psjob_init(struct psjob *j, void *t1, void *t2, void *own,
+		       struct psjob *par)
+{
+	j->t1 = t1;
+	j->t2 = t2;
+	j->own = own;
+	j->func = par->func;
+	j->ctx = par->ctx;
+	j->depth = par->depth - 1;
+}
+
+
+/* Run 'j1' in a new thread (if possible) and 'j2' in this one */
+static void fork2(void *(*run)(void *), struct psjob *j1, struct psjob *j2)
+{
+	pthread_t tid;
+
+	if ( pthread_create(&tid, NULL, run, j1) != 0 ) {
+		(*run)(j1);
+		(*run)(j2);
+		return;
+	}
+	(*run)(j2);
+	pthread_join(tid, NULL);
+}
+
+
+static int nt2depth(int nthreads)
+{
+	int depth = 0;
+
+	while ( nthreads > 1 ) {
+		++depth;
+		nthreads = (nthreads + 1) / 2;
+	}
+	return depth;
+}
+
+
+static void *avl_punion_r(void *arg)
+{
+	struct psjob *j = arg, j1, j2;
+	struct avltree *t1 = j->t1, *t2 = j->t2, l2, r1;
+	struct anode *k, *b;
+	int lh, gh;
+
+	k = t2->avl_root;
+	if ( j->depth <= 0 || k == NULL || t1->avl_root == NULL ) {
+		avl_union_r(t1, t2, j->own, j->func, j->ctx);
+		return NULL;
+	}
+
+	avl_init(&l2, t2->cmp);
+	avl_init(&r1, t1->cmp);
+	avl_fix(&l2.root, k->p[CA_L], CA_P);
+	avl_fix(&t2->root, k->p[CA_R], CA_P);
+	b = avl_split_h(t1, avl_height(t1), k->key, &r1, &lh, &gh);
+	psjob_init(&j1, t1, &l2, j->own, j);
+	psjob_init(&j2, &r1, t2, j->own, j);
+	fork2(&avl_punion_r, &j1, &j2);
+	if ( b != NULL ) {
+		avl_join_h(t1, avl_height(t1), b, &r1, avl_height(&r1));
+		avl_ninit(k, k->key);
+		k->tree = NULL;
+		if ( j->func != NULL )
+			(*j->func)(k, j->ctx);
+	} else {
+		k->tree = j->own;
+		avl_join_h(t1, avl_height(t1), k, &r1, avl_height(&r1));
+	}
+	return NULL;
+}
+
+
+static void *avl_pinter_r(void *arg)
+{
+	struct psjob *j = arg, j1, j2;
+	struct avltree *t1 = j->t1, r1;
+	struct anode *n2 = j->t2, *b;
+	int lh, gh;
+
+	if ( j->depth <= 0 || n2 == NULL || t1->avl_root == NULL ) {
+		avl_inter_r(t1, n2, j->func, j->ctx);
+		return NULL;
+	}
+
+	avl_init(&r1, t1->cmp);
+	b = avl_split_h(t1, avl_height(t1), n2->key, &r1, &lh, &gh);
+	psjob_init(&j1, t1, n2->p[CA_L], NULL, j);
+	psjob_init(&j2, &r1, n2->p[CA_R], NULL, j);
+	fork2(&avl_pinter_r, &j1, &j2);
+	if ( b != NULL )
+		avl_join_h(t1, avl_height(t1), b, &r1, avl_height(&r1));
+	else
+		avl_concat(t1, &r1);
+	return NULL;
+}
+
+
+static void *avl_pdiff_r(void *arg)
+{
+	struct psjob *j = arg, j1, j2;
+	struct avltree *t1 = j->t1, r1;
+	struct anode *n2 = j->t2, *b;
+	int lh, gh;
+
+	if ( j->depth <= 0 || n2 == NULL || t1->avl_root == NULL ) {
+		avl_diff_r(t1, n2, j->func, j->ctx);
+		return NULL;
+	}
+
+	avl_init(&r1, t1->cmp);
+	b = avl_split_h(t1, avl_height(t1), n2->key, &r1, &lh, &gh);
+	psjob_init(&j1, t1, n2->p[CA_L], NULL, j);
+	psjob_init(&j2, &r1, n2->p[CA_R], NULL, j);
+	fork2(&avl_pdiff_r, &j1, &j2);
+	avl_concat(t1, &r1);
+	if ( b != NULL ) {
+		b->tree = NULL;
+		if ( j->func != NULL )
+			(*j->func)(b, j->ctx);
+	}
+	return NULL;
+}
+
+
+static void *rb_punion_r(void *arg)
+{
+	struct psjob *j = arg, j1, j2;
+	struct rbtree *t1 = j->t1, *t2 = j->t2, l2, r1;
+	struct rbnode *k, *b;
+	int lh, gh;
+
+	k = t2->rb_root;
+	if ( j->depth <= 0 || k == NULL || t1->rb_root == NULL ) {
+		rb_union_r(t1, t2, j->own, j->func, j->ctx);
+		return NULL;
+	}
+
+	rb_init(&l2, t2->cmp);
+	rb_init(&r1, t1->cmp);
+	rb_fix(&l2.root, k->p[CRB_L], CRB_P);
+	rb_fix(&t2->root, k->p[CRB_R], CRB_P);
+	b = rb_split_h(t1, rb_bheight(t1), k->key, &r1, &lh, &gh);
+	psjob_init(&j1, t1, &l2, j->own, j);
+	psjob_init(&j2, &r1, t2, j->own, j);
+	fork2(&rb_punion_r, &j1, &j2);
+	if ( b != NULL ) {
+		rb_join_h(t1, rb_bheight(t1), b, &r1, rb_bheight(&r1));
+		rb_ninit(k, k->key);
+		k->tree = NULL;
+		if ( j->func != NULL )
+			(*j->func)(k, j->ctx);
+	} else {
+		k->tree = j->own;
+		rb_join_h(t1, rb_bheight(t1), k, &r1, rb_bheight(&r1));
+	}
+	return NULL;
+}
+
+
+static void *rb_pinter_r(void *arg)
+{
+	struct psjob *j = arg, j1, j2;
+	struct rbtree *t1 = j->t1, r1;
+	struct rbnode *n2 = j->t2, *b;
+	int lh, gh;
+
+	if ( j->depth <= 0 || n2 == NULL || t1->rb_root == NULL ) {
+		rb_inter_r(t1, n2, j->func, j->ctx);
+		return NULL;
+	}
+
+	rb_init(&r1, t1->cmp);
+	b = rb_split_h(t1, rb_bheight(t1), n2->key, &r1, &lh, &gh);
+	psjob_init(&j1, t1, n2->p[CRB_L], NULL, j);
+	psjob_init(&j2, &r1, n2->p[CRB_R], NULL, j);
+	fork2(&rb_pinter_r, &j1, &j2);
+	if ( b != NULL )
+		rb_join_h(t1, rb_bheight(t1), b, &r1, rb_bheight(&r1));
+	else
+		rb_concat(t1, &r1);
+	return NULL;
+}
+
+
+static void *rb_pdiff_r(void *arg)
+{
+	struct psjob *j = arg, j1, j2;
+	struct rbtree *t1 = j->t1, r1;
+	struct rbnode *n2 = j->t2, *b;
+	int lh, gh;
+
+	if ( j->depth <= 0 || n2 == NULL || t1->rb_root == NULL ) {
+		rb_diff_r(t1, n2, j->func, j->ctx);
+		return NULL;
+	}
+
+	rb_init(&r1, t1->cmp);
+	b = rb_split_h(t1, rb_bheight(t1), n2->key, &r1, &lh, &gh);
+	psjob_init(&j1, t1, n2->p[CRB_L], NULL, j);
+	psjob_init(&j2, &r1, n2->p[CRB_R], NULL, j);
+	fork2(&rb_pdiff_r, &j1, &j2);
+	rb_concat(t1, &r1);
+	if ( b != NULL ) {
+		b->tree = NULL;
+		if ( j->func != NULL )
+			(*j->func)(b, j->ctx);
+	}
+	return NULL;
+}
+
+
+static void psrun(void *(*run)(void *), void *t1, void *t2, apply_f func,
+		  void *ctx, int nthreads)
+{
+	struct psjob j;
+
+	j.t1 = t1;
+	j.t2 = t2;
+	j.own = t1;
+	j.func = func;
+	j.ctx = ctx;
+	j.depth = nt2depth(nthreads);
+	(*run)(&j);
+}
+
+
+void avl_punion(struct avltree *t1, struct avltree *t2, apply_f func,
+		void *ctx, int nthreads)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	psrun(&avl_punion_r, t1, t2, func, ctx, nthreads);
+}
+
+
+void avl_pinter(struct avltree *t1, struct avltree *t2, apply_f func,
+		void *ctx, int nthreads)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	psrun(&avl_pinter_r, t1, t2->avl_root, func, ctx, nthreads);
+}
+
+
+void avl_pdiff(struct avltree *t1, struct avltree *t2, apply_f func,
+	       void *ctx, int nthreads)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	psrun(&avl_pdiff_r, t1, t2->avl_root, func, ctx, nthreads);
+}
+
+
+static void rb_blacken(struct rbtree *t)
+{
+	if ( t->rb_root != NULL )
+		t->rb_root->col = CRB_BLACK;
+}
+
+
+void rb_punion(struct rbtree *t1, struct rbtree *t2, apply_f func,
+	       void *ctx, int nthreads)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	psrun(&rb_punion_r, t1, t2, func, ctx, nthreads);
+	rb_blacken(t1);
+}
+
+
+void rb_pinter(struct rbtree *t1, struct rbtree *t2, apply_f func,
+	       void *ctx, int nthreads)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	psrun(&rb_pinter_r, t1, t2->rb_root, func, ctx, nthreads);
+	rb_blacken(t1);
+}
+
+
+void rb_pdiff(struct rbtree *t1, struct rbtree *t2, apply_f func,
+	      void *ctx, int nthreads)
+{
+	abort_unless(t1);
+	abort_unless(t2);
+	psrun(&rb_pdiff_r, t1, t2->rb_root, func, ctx, nthreads);
+	rb_blacken(t1);
+}
+
+#endif /* CAT_HAS_POSIX */
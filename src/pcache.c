@@ -26,6 +26,7 @@ void pc_init(struct pcache *pc, size_t asiz, size_t pgsiz, uint hiwat,
 	pc->mm       = mm;
 	pc->pgsiz    = pgsiz;
 	pc->hiwat    = hiwat;
+	pc->maxidle  = 0;
 	pc->maxpools = maxpools;
 	pc->npools   = 0;
 
@@ -45,6 +46,9 @@ void pc_freeall(struct pcache *pc)
 		mem_free(pc->mm, lp);
 	while ( (lp = l_pop(&pc->empty)) )
 		mem_free(pc->mm, lp);
+	while ( (lp = l_pop(&pc->full)) )
+		mem_free(pc->mm, lp);
+	pc->npools = 0;
 }
 
 
@@ -85,6 +89,25 @@ void * pc_alloc(struct pcache *pc)
 }
 
 
+/* Returns non-zero if a page that just emptied should be released */
+static int pc_release(struct pcache *pc)
+{
+	struct list *lp;
+	uint nidle;
+
+	if ( ! pc->mm )
+		return 0;
+	if ( pc->maxidle == 0 )
+		return (pc->hiwat > 0) && (pc->npools > pc->hiwat);
+
+	nidle = 0;
+	for ( lp = l_head(&pc->full) ; lp != l_end(&pc->full) ; lp = l_next(lp) )
+		if ( ++nidle >= pc->maxidle )
+			return 1;
+	return 0;
+}
+
+
 void pc_free(void *item)
 {
 	struct pcache *pc;
@@ -107,7 +130,7 @@ void pc_free(void *item)
 		pc = pcp->cache;
 
 		l_rem(&pcp->entry);
-		if ( pc->mm && (pc->hiwat > 0) && (pc->npools > pc->hiwat) ) {
+		if ( pc_release(pc) ) {
 			mem_free(pc->mm, pcp);
 			pc->npools -= 1;
 		} else {
@@ -117,6 +140,13 @@ void pc_free(void *item)
 }
 
 
+void pc_set_maxidle(struct pcache *pc, uint maxidle)
+{
+	abort_unless(pc);
+	pc->maxidle = maxidle;
+}
+
+
 void pc_addpg(struct pcache *pc, void *page, size_t pgsiz)
 {
 	struct pc_pool *pcp;
@@ -0,0 +1,661 @@
+/*
+ * prbtree.c -- Persistent red-black tree with lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+
+#if CAT_HAS_POSIX
+
+#include <cat/prbtree.h>
+#include <cat/err.h>
+#include <cat/stduse.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOADP(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STOREP(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define INCREF(p)	__atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define DECREF(p)	__atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+
+#define PRB_L		0
+#define PRB_R		1
+
+/* Upper bound on nodes copied per level of the tree by one update */
+#define PRB_COPIES	10
+
+struct prbent {
+	ulong			refs;
+};
+
+/* the tree's reference to a replaced root waiting for readers to leave */
+struct prbver {
+	struct ebr_node		ebr;
+	struct prbnode *	root;
+};
+
+/* state for one insert or delete */
+struct prbupd {
+	struct prbtree *	t;
+	const void *		key;
+	void *			nkey;
+	void *			data;
+	struct prbent *		ent;
+	int			found;
+};
+
+
+static void *prb_key_dup_skey(struct prbtree *t, void *key)
+{
+	return strdup(key);
+}
+
+
+static void prb_key_free_skey(struct prbtree *t, void *key)
+{
+	free(key);
+}
+
+
+struct prbtree_attr prb_std_attr_skey = {
+	&cmp_str,
+	&prb_key_dup_skey,
+	&prb_key_free_skey,
+	NULL,
+	NULL,
+};
+
+
+static void *prb_key_dup_rkey(struct prbtree *t, void *key)
+{
+	return rawdup(key);
+}
+
+
+struct prbtree_attr prb_std_attr_rkey = {
+	&cmp_raw,
+	&prb_key_dup_rkey,
+	&prb_key_free_skey,
+	NULL,
+	NULL,
+};
+
+
+static void *prb_key_dup_pkey(struct prbtree *t, void *key)
+{
+	return key;
+}
+
+
+static void prb_key_free_pkey(struct prbtree *t, void *key)
+{
+}
+
+
+struct prbtree_attr prb_std_attr_pkey = {
+	&cmp_ptr,
+	&prb_key_dup_pkey,
+	&prb_key_free_pkey,
+	NULL,
+	NULL,
+};
+
+
+struct prbtree_attr prb_std_attr_bkey = {
+	NULL,		/* Must be supplied by user */
+	&prb_key_dup_pkey,
+	&prb_key_free_pkey,
+	NULL,
+	NULL,
+};
+
+
+static void prb_entput(struct prbtree *t, struct prbent *ent, void *key,
+		       void *data)
+{
+	if ( DECREF(&ent->refs) == 0 ) {
+		(*t->key_free)(t, key);
+		if ( t->data_free != NULL )
+			(*t->data_free)(t, data);
+		free(ent);
+	}
+}
+
+
+/* Drop a reference to 'n' freeing everything only it kept alive */
+static void prb_decref(struct prbtree *t, struct prbnode *n)
+{
+	struct prbnode *next;
+
+	while ( n != NULL && DECREF(&n->refs) == 0 ) {
+		prb_decref(t, n->p[PRB_L]);
+		prb_entput(t, n->ent, n->key, n->data);
+		next = n->p[PRB_R];
+		free(n);
+		n = next;
+	}
+}
+
+
+static void prb_ver_free(struct ebr_node *en, void *ctx)
+{
+	struct prbver *v = container(en, struct prbver, ebr);
+	prb_decref(ctx, v->root);
+	free(v);
+}
+
+
+/* Make sure the next update can not run out of nodes part way through */
+static int prb_reserve(struct prbtree *t)
+{
+	struct prbnode *n;
+	size_t x;
+	uint need = 2;
+
+	for ( x = t->nkeys + 1 ; x > 0 ; x >>= 1 )
+		need += 2;
+	need *= PRB_COPIES;
+	while ( t->nspare < need ) {
+		n = malloc(sizeof(*n));
+		if ( n == NULL )
+			return -1;
+		n->p[PRB_L] = t->spare;
+		t->spare = n;
+		++t->nspare;
+	}
+	return 0;
+}
+
+
+static struct prbnode *prb_nalloc(struct prbtree *t)
+{
+	struct prbnode *n = t->spare;
+
+	abort_unless(n != NULL);
+	t->spare = n->p[PRB_L];
+	--t->nspare;
+	n->gen = t->gen;
+	n->refs = 1;
+	return n;
+}
+
+
+/*
+ * Return a version of 'h' that this update may modify.  The caller's
+ * reference to 'h' moves to the result.  Nodes created by this update
+ * are not yet visible to anyone so they get modified in place.
+ */
+static struct prbnode *prb_copy(struct prbtree *t, struct prbnode *h)
+{
+	struct prbnode *n;
+
+	if ( h->gen == t->gen )
+		return h;
+	n = prb_nalloc(t);
+	n->p[PRB_L] = h->p[PRB_L];
+	n->p[PRB_R] = h->p[PRB_R];
+	n->key = h->key;
+	n->data = h->data;
+	n->ent = h->ent;
+	n->col = h->col;
+	if ( n->p[PRB_L] != NULL )
+		INCREF(&n->p[PRB_L]->refs);
+	if ( n->p[PRB_R] != NULL )
+		INCREF(&n->p[PRB_R]->refs);
+	INCREF(&n->ent->refs);
+	/* never the last reference:  the current version still holds 'h' */
+	prb_decref(t, h);
+	return n;
+}
+
+
+static int prb_isred(struct prbnode *n)
+{
+	return n != NULL && n->col == PRB_RED;
+}
+
+
+/* The rotations and color flip expect 'h' to come from prb_copy() */
+static struct prbnode *prb_rotl(struct prbtree *t, struct prbnode *h)
+{
+	struct prbnode *x = prb_copy(t, h->p[PRB_R]);
+	h->p[PRB_R] = x->p[PRB_L];
+	x->p[PRB_L] = h;
+	x->col = h->col;
+	h->col = PRB_RED;
+	return x;
+}
+
+
+static struct prbnode *prb_rotr(struct prbtree *t, struct prbnode *h)
+{
+	struct prbnode *x = prb_copy(t, h->p[PRB_L]);
+	h->p[PRB_L] = x->p[PRB_R];
+	x->p[PRB_R] = h;
+	x->col = h->col;
+	h->col = PRB_RED;
+	return x;
+}
+
+
+static void prb_flip(struct prbtree *t, struct prbnode *h)
+{
+	h->p[PRB_L] = prb_copy(t, h->p[PRB_L]);
+	h->p[PRB_R] = prb_copy(t, h->p[PRB_R]);
+	h->col = !h->col;
+	h->p[PRB_L]->col = !h->p[PRB_L]->col;
+	h->p[PRB_R]->col = !h->p[PRB_R]->col;
+}
+
+
+static struct prbnode *prb_fixup(struct prbtree *t, struct prbnode *h)
+{
+	if ( prb_isred(h->p[PRB_R]) && !prb_isred(h->p[PRB_L]) )
+		h = prb_rotl(t, h);
+	if ( prb_isred(h->p[PRB_L]) && prb_isred(h->p[PRB_L]->p[PRB_L]) )
+		h = prb_rotr(t, h);
+	if ( prb_isred(h->p[PRB_L]) && prb_isred(h->p[PRB_R]) )
+		prb_flip(t, h);
+	return h;
+}
+
+
+static struct prbnode *prb_mvredl(struct prbtree *t, struct prbnode *h)
+{
+	prb_flip(t, h);
+	if ( prb_isred(h->p[PRB_R]->p[PRB_L]) ) {
+		h->p[PRB_R] = prb_rotr(t, h->p[PRB_R]);
+		h = prb_rotl(t, h);
+		prb_flip(t, h);
+	}
+	return h;
+}
+
+
+static struct prbnode *prb_mvredr(struct prbtree *t, struct prbnode *h)
+{
+	prb_flip(t, h);
+	if ( prb_isred(h->p[PRB_L]->p[PRB_L]) ) {
+		h = prb_rotr(t, h);
+		prb_flip(t, h);
+	}
+	return h;
+}
+
+
+/* Give 'h' the key and data of 'src' */
+static void prb_setent(struct prbtree *t, struct prbnode *h, void *key,
+		       void *data, struct prbent *ent)
+{
+	prb_entput(t, h->ent, h->key, h->data);
+	h->key = key;
+	h->data = data;
+	h->ent = ent;
+}
+
+
+static struct prbnode *prb_ins(struct prbupd *u, struct prbnode *h)
+{
+	struct prbtree *t = u->t;
+	int rv;
+
+	if ( h == NULL ) {
+		h = prb_nalloc(t);
+		h->p[PRB_L] = h->p[PRB_R] = NULL;
+		h->key = u->nkey;
+		h->data = u->data;
+		h->ent = u->ent;
+		h->col = PRB_RED;
+		return h;
+	}
+
+	rv = (*t->cmp)(u->key, h->key);
+	h = prb_copy(t, h);
+	if ( rv < 0 ) {
+		h->p[PRB_L] = prb_ins(u, h->p[PRB_L]);
+	} else if ( rv > 0 ) {
+		h->p[PRB_R] = prb_ins(u, h->p[PRB_R]);
+	} else {
+		prb_setent(t, h, u->nkey, u->data, u->ent);
+		u->found = 1;
+	}
+	return prb_fixup(t, h);
+}
+
+
+static struct prbnode *prb_delmin(struct prbupd *u, struct prbnode *h)
+{
+	struct prbtree *t = u->t;
+
+	if ( h->p[PRB_L] == NULL ) {
+		prb_decref(t, h);
+		return NULL;
+	}
+	h = prb_copy(t, h);
+	if ( !prb_isred(h->p[PRB_L]) && !prb_isred(h->p[PRB_L]->p[PRB_L]) )
+		h = prb_mvredl(t, h);
+	h->p[PRB_L] = prb_delmin(u, h->p[PRB_L]);
+	return prb_fixup(t, h);
+}
+
+
+/* 'u->key' must be in the subtree rooted at 'h' */
+static struct prbnode *prb_rem(struct prbupd *u, struct prbnode *h)
+{
+	struct prbtree *t = u->t;
+	struct prbnode *min;
+
+	h = prb_copy(t, h);
+	if ( (*t->cmp)(u->key, h->key) < 0 ) {
+		if ( !prb_isred(h->p[PRB_L]) &&
+		     !prb_isred(h->p[PRB_L]->p[PRB_L]) )
+			h = prb_mvredl(t, h);
+		h->p[PRB_L] = prb_rem(u, h->p[PRB_L]);
+	} else {
+		if ( prb_isred(h->p[PRB_L]) )
+			h = prb_rotr(t, h);
+		if ( h->p[PRB_R] == NULL && (*t->cmp)(u->key, h->key) == 0 ) {
+			prb_decref(t, h);
+			return NULL;
+		}
+		if ( !prb_isred(h->p[PRB_R]) &&
+		     !prb_isred(h->p[PRB_R]->p[PRB_L]) )
+			h = prb_mvredr(t, h);
+		if ( (*t->cmp)(u->key, h->key) == 0 ) {
+			/* take over the successor's entry and remove it */
+			for ( min = h->p[PRB_R] ; min->p[PRB_L] != NULL ; )
+				min = min->p[PRB_L];
+			INCREF(&min->ent->refs);
+			prb_setent(t, h, min->key, min->data, min->ent);
+			h->p[PRB_R] = prb_delmin(u, h->p[PRB_R]);
+		} else {
+			h->p[PRB_R] = prb_rem(u, h->p[PRB_R]);
+		}
+	}
+	return prb_fixup(t, h);
+}
+
+
+static struct prbnode *prb_lkup(struct prbtree *t, struct prbnode *n,
+				const void *key)
+{
+	int rv;
+
+	while ( n != NULL ) {
+		rv = (*t->cmp)(key, n->key);
+		if ( rv == 0 )
+			break;
+		n = n->p[rv > 0];
+	}
+	return n;
+}
+
+
+/* Publish 'root' as the new version retiring the old one */
+static void prb_publish(struct prbtree *t, struct prbnode *root,
+			struct prbver *v)
+{
+	if ( root != NULL && root->col != PRB_BLACK ) {
+		root = prb_copy(t, root);
+		root->col = PRB_BLACK;
+	}
+	v->root = t->root;
+	STOREP(&t->root, root);
+	ebr_retire(&t->ebr, &v->ebr, &prb_ver_free);
+}
+
+
+struct prbtree *prb_new(struct prbtree_attr *attr, int abort_on_fail)
+{
+	struct prbtree *t;
+
+	if ( attr == NULL )
+		attr = &prb_std_attr_skey;
+
+	abort_unless(attr->kcmp != NULL);
+	abort_unless(attr->key_dup != NULL);
+	abort_unless(attr->key_free != NULL);
+
+	t = malloc(sizeof(*t));
+	if ( t == NULL )
+		goto err;
+	if ( ebr_init(&t->ebr, t) < 0 ) {
+		free(t);
+		goto err;
+	}
+	pthread_mutex_init(&t->lock, NULL);
+	t->root = NULL;
+	t->gen = 0;
+	t->nkeys = 0;
+	t->spare = NULL;
+	t->nspare = 0;
+	t->cmp = attr->kcmp;
+	t->abort_on_fail = abort_on_fail;
+	t->key_dup = attr->key_dup;
+	t->key_free = attr->key_free;
+	t->data_free = attr->data_free;
+	t->ctx = attr->ctx;
+
+	return t;
+
+err:
+	if ( abort_on_fail )
+		err("prb_new: unable to allocate tree\n");
+	return NULL;
+}
+
+
+void prb_free(struct prbtree *t)
+{
+	struct prbnode *n;
+
+	abort_unless(t != NULL);
+
+	ebr_fini(&t->ebr);
+	prb_decref(t, t->root);
+	while ( (n = t->spare) != NULL ) {
+		t->spare = n->p[PRB_L];
+		free(n);
+	}
+	pthread_mutex_destroy(&t->lock);
+	free(t);
+}
+
+
+void *prb_get(struct prbtree *t, void *key)
+{
+	struct prbnode *n;
+	void *data = NULL;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	ebr_enter(&t->ebr);
+	n = prb_lkup(t, LOADP(&t->root), key);
+	if ( n != NULL )
+		data = n->data;
+	ebr_exit(&t->ebr);
+
+	return data;
+}
+
+
+int prb_put(struct prbtree *t, void *key, void *data)
+{
+	struct prbupd u;
+	struct prbver *v = NULL;
+	struct prbnode *root;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	u.t = t;
+	u.key = key;
+	u.data = data;
+	u.found = 0;
+	u.nkey = NULL;
+	u.ent = NULL;
+
+	pthread_mutex_lock(&t->lock);
+	if ( prb_reserve(t) < 0 || (v = malloc(sizeof(*v))) == NULL ||
+	     (u.ent = malloc(sizeof(*u.ent))) == NULL ||
+	     (u.nkey = (*t->key_dup)(t, key)) == NULL )
+		goto err;
+	u.ent->refs = 1;
+
+	++t->gen;
+	root = t->root;
+	if ( root != NULL )
+		INCREF(&root->refs);
+	root = prb_ins(&u, root);
+	if ( !u.found )
+		++t->nkeys;
+	prb_publish(t, root, v);
+	pthread_mutex_unlock(&t->lock);
+
+	return u.found;
+
+err:
+	pthread_mutex_unlock(&t->lock);
+	free(u.ent);
+	free(v);
+	if ( t->abort_on_fail )
+		err("prb_put: unable to allocate nodes\n");
+	return -1;
+}
+
+
+int prb_del(struct prbtree *t, void *key)
+{
+	struct prbupd u;
+	struct prbver *v;
+	struct prbnode *root;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	pthread_mutex_lock(&t->lock);
+	root = t->root;
+	if ( prb_lkup(t, root, key) == NULL ) {
+		pthread_mutex_unlock(&t->lock);
+		return 0;
+	}
+	if ( prb_reserve(t) < 0 || (v = malloc(sizeof(*v))) == NULL ) {
+		pthread_mutex_unlock(&t->lock);
+		if ( t->abort_on_fail )
+			err("prb_del: unable to allocate nodes\n");
+		return -1;
+	}
+
+	u.t = t;
+	u.key = key;
+	++t->gen;
+	INCREF(&root->refs);
+	if ( !prb_isred(root->p[PRB_L]) && !prb_isred(root->p[PRB_R]) ) {
+		root = prb_copy(t, root);
+		root->col = PRB_RED;
+	}
+	root = prb_rem(&u, root);
+	--t->nkeys;
+	prb_publish(t, root, v);
+	pthread_mutex_unlock(&t->lock);
+
+	return 1;
+}
+
+
+void prb_snap(struct prbtree *t, struct prbsnap *s)
+{
+	abort_unless(t != NULL);
+	abort_unless(s != NULL);
+
+	/* the root can't be freed until this thread leaves the section */
+	ebr_enter(&t->ebr);
+	s->tree = t;
+	s->root = LOADP(&t->root);
+	if ( s->root != NULL )
+		INCREF(&s->root->refs);
+	ebr_exit(&t->ebr);
+}
+
+
+void prb_srelease(struct prbsnap *s)
+{
+	abort_unless(s != NULL);
+	prb_decref(s->tree, s->root);
+	s->root = NULL;
+}
+
+
+void *prb_sget(struct prbsnap *s, void *key)
+{
+	struct prbnode *n;
+
+	abort_unless(s != NULL);
+	abort_unless(key != NULL);
+	n = prb_lkup(s->tree, s->root, key);
+	return (n != NULL) ? n->data : NULL;
+}
+
+
+/* Push 'n' and its chain of left children */
+static void prb_cpush(struct prb_cursor *c, struct prbnode *n)
+{
+	for ( ; n != NULL ; n = n->p[PRB_L] ) {
+		abort_unless(c->top < PRB_MAXDEPTH);
+		c->stk[c->top++] = n;
+	}
+}
+
+
+int prb_sfirst(struct prbsnap *s, struct prb_cursor *c)
+{
+	abort_unless(s != NULL);
+	abort_unless(c != NULL);
+
+	c->top = 0;
+	prb_cpush(c, s->root);
+	return c->top > 0;
+}
+
+
+int prb_slbound(struct prbsnap *s, void *key, struct prb_cursor *c)
+{
+	struct prbnode *n;
+
+	abort_unless(s != NULL);
+	abort_unless(key != NULL);
+	abort_unless(c != NULL);
+
+	/* the stack holds exactly the nodes where the search went left */
+	c->top = 0;
+	for ( n = s->root ; n != NULL ; ) {
+		if ( (*s->tree->cmp)(key, n->key) <= 0 ) {
+			abort_unless(c->top < PRB_MAXDEPTH);
+			c->stk[c->top++] = n;
+			n = n->p[PRB_L];
+		} else {
+			n = n->p[PRB_R];
+		}
+	}
+	return c->top > 0;
+}
+
+
+int prb_next(struct prb_cursor *c)
+{
+	struct prbnode *n;
+
+	abort_unless(c != NULL);
+	if ( c->top == 0 )
+		return 0;
+	n = c->stk[--c->top];
+	prb_cpush(c, n->p[PRB_R]);
+	return c->top > 0;
+}
+
+#endif /* CAT_HAS_POSIX */
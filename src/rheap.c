@@ -0,0 +1,176 @@
+/*
+ * rheap.c -- Monotone radix heap for integer keys
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/rheap.h>
+#include <cat/archops.h>
+
+#if CAT_64BIT
+#define rh_nlz(x)	nlz_64(x)
+#define rh_ntz(x)	ntz_64(x)
+#else /* CAT_64BIT */
+#define rh_nlz(x)	nlz_32(x)
+#define rh_ntz(x)	ntz_32(x)
+#endif /* CAT_64BIT */
+
+#define rh_entry(le)	container((le), struct rhnode, entry)
+
+
+/*
+ * Bucket 0 holds keys equal to 'last'.  Bucket 'i' holds keys whose
+ * highest bit that differs from 'last' is bit 'i - 1'.  Raising 'last' to
+ * the least key in a bucket leaves every key in a higher bucket where it
+ * was, so a key's bucket only changes when its own bucket gets split.
+ */
+static int rh_bkt(struct rheap *hp, rhkey_t key)
+{
+	rhkey_t x = key ^ hp->last;
+	return (x == 0) ? 0 : RH_KEYBITS - rh_nlz(x);
+}
+
+
+static void rh_ins(struct rheap *hp, struct rhnode *n)
+{
+	int b = rh_bkt(hp, n->key);
+
+	l_ins(&hp->bkts[b], &n->entry);
+	if ( b > 0 )
+		hp->bmap |= (rhkey_t)1 << (b - 1);
+}
+
+
+/* Returns the least node in the lowest used bucket above bucket 0 */
+static struct rhnode *rh_lowest(struct rheap *hp)
+{
+	struct list *l, *le;
+	struct rhnode *min;
+
+	abort_unless(hp->bmap != 0);
+
+	l = &hp->bkts[rh_ntz(hp->bmap) + 1];
+	min = rh_entry(l_head(l));
+	for ( le = l_next(l_head(l)); le != l_end(l); le = l_next(le) )
+		if ( rh_entry(le)->key < min->key )
+			min = rh_entry(le);
+	return min;
+}
+
+
+/* Empty the lowest used bucket into lower ones to refill bucket 0 */
+static void rh_split(struct rheap *hp, rhkey_t min)
+{
+	struct list *l, *le, *next;
+	int b;
+
+	b = rh_ntz(hp->bmap) + 1;
+	l = &hp->bkts[b];
+	hp->last = min;
+	hp->bmap &= ~((rhkey_t)1 << (b - 1));
+	for ( le = l_head(l); le != l_end(l); le = next ) {
+		next = l_next(le);
+		l_rem(le);
+		rh_ins(hp, rh_entry(le));
+	}
+}
+
+
+void rh_init(struct rheap *hp, rhkey_t base)
+{
+	int i;
+
+	abort_unless(hp);
+
+	hp->last = base;
+	hp->bmap = 0;
+	hp->top = NULL;
+	hp->fill = 0;
+	for ( i = 0; i < RH_NBKTS; ++i )
+		l_init(&hp->bkts[i]);
+}
+
+
+void rh_ninit(struct rhnode *n, rhkey_t key)
+{
+	abort_unless(n);
+	l_init(&n->entry);
+	n->key = key;
+}
+
+
+int rh_add(struct rheap *hp, struct rhnode *n)
+{
+	abort_unless(hp);
+	abort_unless(n);
+
+	if ( n->key < hp->last )
+		return -1;
+	rh_ins(hp, n);
+	hp->fill += 1;
+	if ( hp->top != NULL && n->key < hp->top->key )
+		hp->top = n;
+
+	return 0;
+}
+
+
+/*
+ * Finding the least node does not split a bucket:  that would raise
+ * 'last' and refuse keys that are still legal to add.  The node found is
+ * remembered until it is extracted or removed, or a lesser key arrives.
+ */
+struct rhnode *rh_top(struct rheap *hp)
+{
+	abort_unless(hp);
+
+	if ( hp->fill == 0 )
+		return NULL;
+	if ( hp->top == NULL ) {
+		if ( !l_isempty(&hp->bkts[0]) )
+			hp->top = rh_entry(l_head(&hp->bkts[0]));
+		else
+			hp->top = rh_lowest(hp);
+	}
+
+	return hp->top;
+}
+
+
+struct rhnode *rh_extract(struct rheap *hp)
+{
+	struct rhnode *n;
+
+	n = rh_top(hp);
+	if ( n != NULL ) {
+		if ( l_isempty(&hp->bkts[0]) )
+			rh_split(hp, n->key);
+		l_rem(&n->entry);
+		hp->fill -= 1;
+		hp->top = NULL;
+	}
+
+	return n;
+}
+
+
+void rh_rem(struct rheap *hp, struct rhnode *n)
+{
+	int b;
+
+	abort_unless(hp);
+	abort_unless(n);
+	abort_unless(hp->fill > 0);
+
+	if ( n == hp->top )
+		hp->top = NULL;
+	b = rh_bkt(hp, n->key);
+	l_rem(&n->entry);
+	if ( b > 0 && l_isempty(&hp->bkts[b]) )
+		hp->bmap &= ~((rhkey_t)1 << (b - 1));
+	hp->fill -= 1;
+}
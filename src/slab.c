@@ -0,0 +1,242 @@
+/*
+ * slab.c -- Slab memory manager with geometric size classes
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/slab.h>
+#include <cat/archops.h>
+#include <string.h>
+
+/*
+ * Large blocks start with their length and a NULL pool pointer where a
+ * pcache item would have the pointer to its pool.
+ */
+union slab_lghdr {
+	cat_align_t		align;
+	size_t			len;
+};
+
+#define LGHDRSZ		(sizeof(union slab_lghdr) + sizeof(cat_pcpad_t))
+#define PCPAD(mem)	((cat_pcpad_t *)(mem) - 1)
+
+
+static size_t class_size(int cls)
+{
+	int lg;
+
+	if ( cls == 0 )
+		return SLAB_MINSZ;
+	lg = (cls - 1) / 4 + SLAB_LG2MIN;
+	return ((size_t)1 << lg) + ((cls - 1) % 4 + 1) * ((size_t)1 << (lg - 2));
+}
+
+
+static void *mm_slab_alloc(struct memmgr *mm, size_t len)
+{
+	return slab_alloc(container(mm, struct slabmm, mm), len);
+}
+
+
+static void *mm_slab_resize(struct memmgr *mm, void *mem, size_t len)
+{
+	return slab_resize(container(mm, struct slabmm, mm), mem, len);
+}
+
+
+static void mm_slab_free(struct memmgr *mm, void *mem)
+{
+	slab_free(container(mm, struct slabmm, mm), mem);
+}
+
+
+int slab_class(size_t len)
+{
+	uint32_t x;
+	int lg;
+
+	if ( len <= SLAB_MINSZ )
+		return 0;
+	if ( len > SLAB_MAXSZ )
+		return -1;
+	x = len - 1;
+	lg = 31 - nlz_32(x);
+	return (lg - SLAB_LG2MIN) * 4 + ((x >> (lg - 2)) & 3) + 1;
+}
+
+
+void slab_init(struct slabmm *sm, size_t pgsiz, struct memmgr *pgmm)
+{
+	struct slab_class *sc;
+	int i;
+
+	abort_unless(sm);
+	abort_unless(pgmm);
+
+	if ( pgsiz == 0 )
+		pgsiz = PC_DEF_SIZE;
+
+	sm->mm.mm_alloc = &mm_slab_alloc;
+	sm->mm.mm_resize = &mm_slab_resize;
+	sm->mm.mm_free = &mm_slab_free;
+	sm->mm.mm_ctx = sm;
+	sm->pgmm = pgmm;
+	sm->pgsiz = pgsiz;
+	sm->nlarge = 0;
+	sm->lgbytes = 0;
+	for ( i = 0; i < SLAB_NCLASS; ++i ) {
+		sc = &sm->classes[i];
+		sc->isize = class_size(i);
+		sc->nitems = 0;
+		sc->nalloc = 0;
+		sc->reqbytes = 0;
+		pc_init(&sc->pc, sc->isize, pgsiz, 0, 0, pgmm);
+		pc_set_maxidle(&sc->pc, SLAB_HIWAT);
+	}
+}
+
+
+void slab_fini(struct slabmm *sm)
+{
+	int i;
+
+	abort_unless(sm);
+
+	for ( i = 0; i < SLAB_NCLASS; ++i ) {
+		pc_freeall(&sm->classes[i].pc);
+		sm->classes[i].nitems = 0;
+	}
+}
+
+
+void *slab_alloc(struct slabmm *sm, size_t len)
+{
+	struct slab_class *sc;
+	union slab_lghdr *hdr;
+	void *mem;
+	int cls;
+
+	abort_unless(sm);
+
+	cls = slab_class(len);
+	if ( cls < 0 ) {
+		if ( len > (size_t)~0 - LGHDRSZ )
+			return NULL;
+		hdr = mem_get(sm->pgmm, len + LGHDRSZ);
+		if ( hdr == NULL )
+			return NULL;
+		hdr->len = len;
+		mem = (byte_t *)hdr + LGHDRSZ;
+		PCPAD(mem)->pool = NULL;
+		sm->nlarge += 1;
+		sm->lgbytes += len;
+		return mem;
+	}
+
+	sc = &sm->classes[cls];
+	mem = pc_alloc(&sc->pc);
+	if ( mem == NULL )
+		return NULL;
+	sc->nitems += 1;
+	sc->nalloc += 1;
+	sc->reqbytes += len;
+	return mem;
+}
+
+
+void slab_free(struct slabmm *sm, void *mem)
+{
+	union slab_lghdr *hdr;
+	struct pc_pool *pcp;
+
+	abort_unless(sm);
+
+	if ( mem == NULL )
+		return;
+
+	pcp = PCPAD(mem)->pool;
+	if ( pcp == NULL ) {
+		hdr = (union slab_lghdr *)((byte_t *)mem - LGHDRSZ);
+		sm->nlarge -= 1;
+		sm->lgbytes -= hdr->len;
+		mem_free(sm->pgmm, hdr);
+		return;
+	}
+
+	container(pcp->cache, struct slab_class, pc)->nitems -= 1;
+	pc_free(mem);
+}
+
+
+void *slab_resize(struct slabmm *sm, void *mem, size_t len)
+{
+	union slab_lghdr *hdr;
+	struct pc_pool *pcp;
+	struct slab_class *sc;
+	size_t olen;
+	void *nmem;
+
+	abort_unless(sm);
+
+	if ( mem == NULL )
+		return slab_alloc(sm, len);
+	if ( len == 0 ) {
+		slab_free(sm, mem);
+		return NULL;
+	}
+
+	pcp = PCPAD(mem)->pool;
+	if ( pcp == NULL ) {
+		hdr = (union slab_lghdr *)((byte_t *)mem - LGHDRSZ);
+		olen = hdr->len;
+		if ( len > SLAB_MAXSZ ) {
+			if ( len > (size_t)~0 - LGHDRSZ )
+				return NULL;
+			hdr = mem_resize(sm->pgmm, hdr, len + LGHDRSZ);
+			if ( hdr == NULL )
+				return NULL;
+			hdr->len = len;
+			sm->lgbytes += len - olen;
+			return (byte_t *)hdr + LGHDRSZ;
+		}
+	} else {
+		sc = container(pcp->cache, struct slab_class, pc);
+		olen = sc->isize;
+		/* stay put unless the request belongs in a smaller class */
+		if ( len <= olen && slab_class(len) == sc - sm->classes )
+			return mem;
+	}
+
+	nmem = slab_alloc(sm, len);
+	if ( nmem != NULL ) {
+		memcpy(nmem, mem, (len < olen) ? len : olen);
+		slab_free(sm, mem);
+	}
+	return nmem;
+}
+
+
+void slab_stats(struct slabmm *sm, int cls, struct slab_stats *st)
+{
+	struct slab_class *sc;
+	ulong perpg;
+
+	abort_unless(sm);
+	abort_unless(cls >= 0 && cls < SLAB_NCLASS);
+	abort_unless(st);
+
+	sc = &sm->classes[cls];
+	perpg = (sm->pgsiz - sizeof(union pc_pool_u)) /
+		pl_isiz(sc->pc.asiz, -1);
+	st->isize = sc->isize;
+	st->npages = sc->pc.npools;
+	st->capacity = st->npages * perpg;
+	st->nitems = sc->nitems;
+	st->nalloc = sc->nalloc;
+	st->idle = st->npages * sm->pgsiz - st->nitems * sc->isize;
+	st->rounding = st->nalloc * sc->isize - sc->reqbytes;
+}
@@ -93,6 +93,30 @@ struct raw *erawdup(struct raw const * const r)
 }
 
 
+struct raw *rawdup(struct raw const * const r)
+{
+	size_t s;
+	struct raw *rnew;
+
+	abort_unless(r != NULL);
+	abort_unless(r->data != NULL || r->len == 0);
+	s = r->len + sizeof(union raw_u);
+	if ( s < sizeof(union raw_u) )
+		return NULL;
+	rnew = malloc(s);
+	if ( rnew == NULL )
+		return NULL;
+	rnew->len = r->len;
+	if ( r->len > 0 ) {
+		rnew->data = (byte_t *)((union raw_u *)rnew + 1);
+		memcpy(rnew->data, r->data, r->len);
+	} else {
+		rnew->data = NULL;
+	}
+	return rnew;
+}
+
+
 char *erawsdup(struct raw const * const r)
 {
 	char *s;
@@ -105,6 +129,33 @@ char *erawsdup(struct raw const * const r)
 }
 
 
+/*
+ * Node caches for the *_pool_attr_* attribute sets.  Each container gets its
+ * own pcache, created on the first node allocation, so nodes of one
+ * container pack together in memory and no allocator lock is shared.
+ */
+static void *std_pool_alloc(struct pcache **pcp, size_t nsize)
+{
+	if ( *pcp == NULL ) {
+		*pcp = malloc(sizeof(struct pcache));
+		if ( *pcp == NULL )
+			return NULL;
+		pc_init(*pcp, nsize, STD_POOL_PGSIZE, 0, 0, &stdmm);
+		pc_set_maxidle(*pcp, STD_POOL_HIWAT);
+	}
+	return pc_alloc(*pcp);
+}
+
+
+static void std_pool_free(struct pcache *pc)
+{
+	if ( pc != NULL ) {
+		pc_freeall(pc);
+		free(pc);
+	}
+}
+
+
 /* List operations */
 
 
@@ -127,6 +178,25 @@ static struct clist_attr cl_def_attr = {
 };
 
 
+static struct clist_node *cl_pool_node_alloc(struct clist *list)
+{
+	return std_pool_alloc(&list->pool, sizeof(struct clist_node));
+}
+
+
+static void cl_pool_node_free(struct clist *list, struct clist_node *node)
+{
+	pc_free(node);
+}
+
+
+struct clist_attr cl_pool_attr = {
+	cl_pool_node_alloc,
+	cl_pool_node_free,
+	{ 0 }
+};
+
+
 struct clist *cl_new(const struct clist_attr *attr, int abort_on_fail)
 {
 	struct clist *list;
@@ -151,6 +221,7 @@ struct clist *cl_new(const struct clist_attr *attr, int abort_on_fail)
 	list->node_alloc = attr->node_alloc;
 	list->node_free = attr->node_free;
 	list->ctx = attr->ctx;
+	list->pool = NULL;
 
 	return list;
 }
@@ -160,6 +231,7 @@ void cl_free(struct clist *list)
 {
 	while ( !cl_isempty(list) )
 		cl_del(list, cl_first(list));
+	std_pool_free(list->pool);
 	free(list);
 }
 
@@ -462,7 +534,7 @@ static void cht_node_free_skey(struct chtab *t, struct chnode *chn)
 
 struct chtab_attr cht_std_attr_skey = {
 	&cmp_str,
-	&ht_shash,
+	&ht_fshash,
 	0,
 	&cht_node_alloc_skey,
 	&cht_node_free_skey,
@@ -504,7 +576,7 @@ static void cht_node_free_rkey(struct chtab *t, struct chnode *chn)
 
 struct chtab_attr cht_std_attr_rkey = {
 	&cmp_raw,
-	&ht_rhash,
+	&ht_frhash,
 	0,
 	&cht_node_alloc_rkey,
 	&cht_node_free_rkey,
@@ -531,7 +603,7 @@ static void cht_node_free_pkey(struct chtab *t, struct chnode *chn)
 
 struct chtab_attr cht_std_attr_pkey = {
 	&cmp_ptr,
-	&ht_phash,
+	&ht_fihash,
 	0,
 	&cht_node_alloc_pkey,
 	&cht_node_free_pkey,
@@ -549,6 +621,115 @@ struct chtab_attr cht_std_attr_bkey = {
 };
 
 
+static struct chnode *cht_pool_node_alloc_skey(struct chtab *t, void *key)
+{
+	char *kcpy;
+	struct chnode *chn;
+	kcpy = strdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	chn = std_pool_alloc(&t->pool, sizeof(*chn));
+	if ( chn == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	ht_ninit(&chn->node, kcpy);
+	return chn;
+}
+
+
+static void cht_pool_node_free_skey(struct chtab *t, struct chnode *chn)
+{
+	abort_unless(chn != NULL);
+	abort_unless(chn->node.key != NULL);
+	free(chn->node.key);
+	pc_free(chn);
+}
+
+
+struct chtab_attr cht_pool_attr_skey = {
+	&cmp_str,
+	&ht_fshash,
+	0,
+	&cht_pool_node_alloc_skey,
+	&cht_pool_node_free_skey,
+	NULL,
+};
+
+
+static struct chnode *cht_pool_node_alloc_rkey(struct chtab *t, void *key)
+{
+	struct raw *kcpy;
+	struct chnode *chn;
+	kcpy = rawdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	chn = std_pool_alloc(&t->pool, sizeof(*chn));
+	if ( chn == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	ht_ninit(&chn->node, kcpy);
+	return chn;
+}
+
+
+static void cht_pool_node_free_rkey(struct chtab *t, struct chnode *chn)
+{
+	abort_unless(chn != NULL);
+	abort_unless(chn->node.key != NULL);
+	free(chn->node.key);
+	pc_free(chn);
+}
+
+
+struct chtab_attr cht_pool_attr_rkey = {
+	&cmp_raw,
+	&ht_frhash,
+	0,
+	&cht_pool_node_alloc_rkey,
+	&cht_pool_node_free_rkey,
+	NULL,
+};
+
+
+static struct chnode *cht_pool_node_alloc_pkey(struct chtab *t, void *key)
+{
+	struct chnode *chn;
+	chn = std_pool_alloc(&t->pool, sizeof(*chn));
+	if ( chn == NULL )
+		return NULL;
+	ht_ninit(&chn->node, key);
+	return chn;
+}
+
+
+static void cht_pool_node_free_pkey(struct chtab *t, struct chnode *chn)
+{
+	pc_free(chn);
+}
+
+
+struct chtab_attr cht_pool_attr_pkey = {
+	&cmp_ptr,
+	&ht_fihash,
+	0,
+	&cht_pool_node_alloc_pkey,
+	&cht_pool_node_free_pkey,
+	NULL,
+};
+
+
+struct chtab_attr cht_pool_attr_bkey = {
+	NULL,		/* Must be supplied by user */
+	NULL,		/* Must be supplied by user */
+	0,		/* Must be supplied by user */
+	&cht_pool_node_alloc_pkey,
+	&cht_pool_node_free_pkey,
+	NULL,
+};
+
+
 struct chtab *cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 		      int abort_on_fail)
 {
@@ -585,8 +766,11 @@ struct chtab *cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 	new_hctx = (byte_t *)t + tsize;
 	buckets = (struct hnode **)((byte_t *)new_hctx + hctx_size);
 
+	t->seed = attr->seed;
 	if (hctx_size != 0)
 		memmove(new_hctx, hctx, attr->hctx_size);
+	else if ( attr->seed != 0 )
+		new_hctx = &t->seed;
 	else
 		new_hctx = NULL;
 
@@ -595,29 +779,152 @@ struct chtab *cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->pool = NULL;
+
+	memset(&t->old, 0, sizeof(t->old));
+	t->mcursor = 0;
+	t->fill = 0;
+	t->maxload = 0;
+	t->minload = 0;
+	t->minbkts = nbkts;
+	t->ibkts = buckets;
 
 	return t;
 }
 
 
-void cht_free(struct chtab *t)
+static void cht_free_bkts(struct chtab *t, struct hnode **bkts)
+{
+	if ( bkts != t->ibkts )
+		free(bkts);
+}
+
+
+static void cht_free_nodes(struct chtab *t, struct htab *ht)
 {
 	unsigned i;
 	struct chnode *chn;
 
-	abort_unless(t != NULL);
-
-	for ( i = 0; i < t->table.nbkts ; ++i ) {
-		while ( t->table.bkts[i] != NULL ) {
-			chn = container(t->table.bkts[i], struct chnode, node);
+	for ( i = 0; i < ht->nbkts ; ++i ) {
+		while ( ht->bkts[i] != NULL ) {
+			chn = container(ht->bkts[i], struct chnode, node);
 			ht_rem(&chn->node);
 			(*t->node_free)(t, chn);
 		}
 	}
+}
+
+
+void cht_free(struct chtab *t)
+{
+	abort_unless(t != NULL);
+
+	cht_free_nodes(t, &t->table);
+	cht_free_bkts(t, t->table.bkts);
+	if ( t->old.bkts != NULL ) {
+		cht_free_nodes(t, &t->old);
+		cht_free_bkts(t, t->old.bkts);
+	}
+	std_pool_free(t->pool);
 	free(t);
 }
 
 
+/* Move up to CHT_MIGRATE_NBKTS buckets from the old table to the new one */
+static void cht_migrate(struct chtab *t)
+{
+	uint n;
+	struct hnode *hn;
+
+	if ( t->old.bkts == NULL )
+		return;
+
+	for ( n = 0 ; n < CHT_MIGRATE_NBKTS && t->mcursor < t->old.nbkts ; ++n ) {
+		while ( (hn = t->old.bkts[t->mcursor]) != NULL ) {
+			ht_rem(hn);
+			ht_ins_h(&t->table, hn);
+		}
+		t->mcursor += 1;
+	}
+
+	if ( t->mcursor == t->old.nbkts ) {
+		cht_free_bkts(t, t->old.bkts);
+		memset(&t->old, 0, sizeof(t->old));
+		t->mcursor = 0;
+	}
+}
+
+
+/* Start draining the current table into a new one with 'nbkts' buckets */
+static void cht_resize(struct chtab *t, uint nbkts)
+{
+	struct hnode **bkts;
+
+	abort_unless(t->old.bkts == NULL);
+
+	/* If we can't get the memory, just stay at the current size */
+	abort_unless((nbkts & (nbkts - 1)) == 0);
+	bkts = calloc(nbkts, sizeof(struct hnode *));
+	if ( bkts == NULL )
+		return;
+
+	/*
+	 * calloc() already emptied the buckets.  Skipping ht_init() avoids
+	 * touching every page of a large array in this one call.
+	 */
+	t->old = t->table;
+	t->mcursor = 0;
+	t->table.bkts = bkts;
+	t->table.nbkts = nbkts;
+	t->table.po2mask = nbkts - 1;
+}
+
+
+static void cht_check_load(struct chtab *t)
+{
+	uint nbkts, n;
+
+	if ( t->maxload == 0 || t->old.bkts != NULL )
+		return;
+
+	nbkts = t->table.nbkts;
+	if ( t->fill * 100 > (size_t)t->maxload * nbkts ) {
+		if ( nbkts > ((uint)-1 >> 1) )
+			return;
+		for ( n = 1 ; n <= nbkts ; n <<= 1 )
+			;
+		cht_resize(t, n);
+	} else if ( t->fill * 100 < (size_t)t->minload * nbkts ) {
+		for ( n = 1 ; n <= nbkts / 2 ; n <<= 1 )
+			;
+		n >>= 1;
+		if ( n >= t->minbkts && n < nbkts )
+			cht_resize(t, n);
+	}
+}
+
+
+/* Find 'key' in either the old or the current table */
+static struct hnode *cht_find(struct chtab *t, const void *key, uint *hp)
+{
+	struct hnode *hn;
+	uint h;
+
+	h = ht_hash(&t->table, key);
+	if ( hp != NULL )
+		*hp = h;
+
+	/* buckets below the cursor have already moved to the new table */
+	if ( t->old.bkts != NULL && ht_bktidx(&t->old, h) >= t->mcursor ) {
+		hn = ht_hlkup(&t->old, key, h);
+		if ( hn != NULL )
+			return hn;
+	}
+
+	return ht_hlkup(&t->table, key, h);
+}
+
+
 void *cht_get(struct chtab *t, void *key)
 {
 	struct hnode *hn;
@@ -625,14 +932,48 @@ void *cht_get(struct chtab *t, void *key)
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-	hn = ht_lkup(&t->table, key, NULL);
+	cht_migrate(t);
+	hn = cht_find(t, key, NULL);
 	if ( hn != NULL )
 		return container(hn, struct chnode, node)->data;
 	return NULL;
 }
 
 
-int cht_put(struct chtab *t, void *key, void *data)
+void cht_get_batch(struct chtab *t, void * const *keys, uint n, void **data)
+{
+	struct hnode *nodes[HT_BATCH_SIZE];
+	uint hashes[HT_BATCH_SIZE];
+	uint i, j, nb;
+
+	abort_unless(t != NULL);
+	abort_unless(n == 0 || (keys != NULL && data != NULL));
+
+	cht_migrate(t);
+	for ( i = 0 ; i < n ; i += nb ) {
+		nb = (n - i < HT_BATCH_SIZE) ? n - i : HT_BATCH_SIZE;
+		ht_lkup_batch(&t->table, keys + i, nb, nodes, hashes);
+		for ( j = 0 ; j < nb ; ++j ) {
+			/* a key lives in only one table:  check the old one */
+			/* only if the new one missed and its bucket remains */
+			if ( nodes[j] == NULL && t->old.bkts != NULL &&
+			     ht_bktidx(&t->old, hashes[j]) >= t->mcursor )
+				nodes[j] = ht_hlkup(&t->old, keys[i + j],
+						    hashes[j]);
+			data[i + j] = (nodes[j] == NULL) ? NULL :
+				container(nodes[j], struct chnode, node)->data;
+		}
+	}
+}
+
+
+/*
+ * Find or add the entry for 'key' and return its data slot, setting
+ * *isnew to 1 if it was added with NULL data.  'fn' names the caller in
+ * error messages.  Shared by cht_put() and cht_upsert().
+ */
+static void **cht_slot(struct chtab *t, void *key, int *isnew,
+		       const char *fn)
 {
 	struct hnode *hn;
 	struct chnode *chn;
@@ -640,25 +981,50 @@ int cht_put(struct chtab *t, void *key, void *data)
 
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
-	abort_unless(data != NULL);
 
-	hn = ht_lkup(&t->table, key, &h);
+	cht_migrate(t);
+	hn = cht_find(t, key, &h);
 	if ( hn != NULL ) {
-		chn = container(hn, struct chnode, node);
-		chn->data = data;
-		return 1;
+		*isnew = 0;
+		return &container(hn, struct chnode, node)->data;
 	}
 
 	chn = (*t->node_alloc)(t, key);
 	if ( chn == NULL ) {
 		if ( t->abort_on_fail )
-			err("cht_put: unable to allocate node\n");
-		return -1;
+			err("%s: unable to allocate node\n", fn);
+		return NULL;
 	}
 
-	chn->data = data;
+	chn->data = NULL;
 	ht_ins(&t->table, &chn->node, h);
-	return 0;
+	t->fill += 1;
+	cht_check_load(t);
+	*isnew = 1;
+	return &chn->data;
+}
+
+
+int cht_put(struct chtab *t, void *key, void *data)
+{
+	void **dp;
+	int isnew;
+
+	abort_unless(data != NULL);
+	dp = cht_slot(t, key, &isnew, "cht_put");
+	if ( dp == NULL )
+		return -1;
+	*dp = data;
+	return !isnew;
+}
+
+
+void **cht_upsert(struct chtab *t, void *key, int *isnew)
+{
+	int dummy;
+
+	return cht_slot(t, key, (isnew != NULL) ? isnew : &dummy,
+			"cht_upsert");
 }
 
 
@@ -671,12 +1037,15 @@ void *cht_del(struct chtab *t, void *key)
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-	hn = ht_lkup(&t->table, key, NULL);
+	cht_migrate(t);
+	hn = cht_find(t, key, NULL);
 	if ( hn != NULL ) {
 		ht_rem(hn);
 		chn = container(hn, struct chnode, node);
 		data = chn->data;
 		(*t->node_free)(t, chn);
+		t->fill -= 1;
+		cht_check_load(t);
 	}
 	return data;
 }
@@ -695,75 +1064,435 @@ void cht_apply(struct chtab *t, apply_f f, void *ctx)
 	struct apply_ctx ac;
 	ac.ctx = t->ctx;
 	ac.f = f;
+	if ( t->old.bkts != NULL )
+		ht_apply(&t->old, &cht_apply_wrap, &ac);
 	ht_apply(&t->table, &cht_apply_wrap, &ac);
 }
 
 
+void cht_set_resize(struct chtab *t, uint maxload, uint minload)
+{
+	abort_unless(t != NULL);
+	abort_unless(maxload == 0 || minload < maxload / 2);
 
+	t->maxload = maxload;
+	t->minload = minload;
+}
 
-/* AVL Trees */
 
-static struct canode *cavl_node_alloc_skey(struct cavltree *t, void *key)
+static uint cht_maxchain(struct htab *ht)
 {
-	char *kcpy;
-	struct canode *can;
-	kcpy = strdup(key);
-	if ( kcpy == NULL )
-		return NULL;
-	can = malloc(sizeof(*can));
-	if ( can == NULL ) {
-		free(kcpy);
-		return NULL;
+	uint i, len, max = 0;
+	struct hnode *hn;
+
+	for ( i = 0 ; i < ht->nbkts ; ++i ) {
+		len = 0;
+		for ( hn = ht->bkts[i] ; hn != NULL ; hn = hn->next )
+			++len;
+		if ( len > max )
+			max = len;
 	}
-	avl_ninit(&can->node, kcpy);
-	return can;
+	return max;
 }
 
 
-static void cavl_node_free_skey(struct cavltree *t, struct canode *can)
+void cht_stats(struct chtab *t, struct cht_stats *stats)
 {
-	abort_unless(can != NULL);
-	abort_unless(can->node.key != NULL);
-	free(can->node.key);
-	free(can);
+	uint len;
+
+	abort_unless(t != NULL);
+	abort_unless(stats != NULL);
+
+	stats->fill = t->fill;
+	stats->nbkts = t->table.nbkts;
+	stats->load = t->fill * 100 / t->table.nbkts;
+	stats->old_nbkts = t->old.nbkts;
+	stats->mcursor = t->mcursor;
+	stats->maxchain = cht_maxchain(&t->table);
+	if ( t->old.bkts != NULL ) {
+		len = cht_maxchain(&t->old);
+		if ( len > stats->maxchain )
+			stats->maxchain = len;
+	}
 }
 
 
-struct cavltree_attr cavl_std_attr_skey = {
-	&cmp_str,
-	&cavl_node_alloc_skey,
-	&cavl_node_free_skey,
-	0,
-};
 
+/* Open addressing hash table functions */
 
-static struct canode *cavl_node_alloc_rkey(struct cavltree *t, void *key)
+static void *coht_key_dup_skey(struct cohtab *t, void *key)
 {
-	struct canode *can;
-	struct raw *rkey = key;
-	struct raw *rnode;
+	return strdup(key);
+}
 
-	abort_unless(rkey != NULL);
-	can = malloc(CAT_ALIGN_SIZE(sizeof(*can)) +
-		     CAT_ALIGN_SIZE(sizeof(*rnode)) +
-		     rkey->len);
-	if ( can == NULL )
-		return NULL;
 
-	rnode = (struct raw *)((byte_t *)can + CAT_ALIGN_SIZE(sizeof(*can)));
-	rnode->len = rkey->len;
-	if ( rkey->len > 0 ) {
-		rnode->data = (byte_t *)rnode + CAT_ALIGN_SIZE(sizeof(*rnode));
-		memmove(rnode->data, rkey->data, rkey->len);
-	} else {
-		rnode->data = NULL;
-	}
-	avl_ninit(&can->node, rnode);
-	return can;
+static void coht_key_free_skey(struct cohtab *t, void *key)
+{
+	abort_unless(key != NULL);
+	free(key);
 }
 
 
-static void cavl_node_free_rkey(struct cavltree *t, struct canode *can)
+struct cohtab_attr coht_std_attr_skey = {
+	&cmp_str,
+	&ht_fshash,
+	0,
+	&coht_key_dup_skey,
+	&coht_key_free_skey,
+	NULL,
+};
+
+
+static void *coht_key_dup_rkey(struct cohtab *t, void *key)
+{
+	return rawdup(key);
+}
+
+
+static void coht_key_free_rkey(struct cohtab *t, void *key)
+{
+	free(key);
+}
+
+
+struct cohtab_attr coht_std_attr_rkey = {
+	&cmp_raw,
+	&ht_frhash,
+	0,
+	&coht_key_dup_rkey,
+	&coht_key_free_rkey,
+	NULL,
+};
+
+
+static void *coht_key_dup_pkey(struct cohtab *t, void *key)
+{
+	return key;
+}
+
+
+static void coht_key_free_pkey(struct cohtab *t, void *key)
+{
+}
+
+
+struct cohtab_attr coht_std_attr_pkey = {
+	&cmp_ptr,
+	&ht_fihash,
+	0,
+	&coht_key_dup_pkey,
+	&coht_key_free_pkey,
+	NULL,
+};
+
+
+struct cohtab_attr coht_std_attr_bkey = {
+	NULL,		/* Must be supplied by user */
+	NULL,		/* Must be supplied by user */
+	0,		/* Must be supplied by user */
+	&coht_key_dup_pkey,
+	&coht_key_free_pkey,
+	NULL,
+};
+
+
+static struct ohslot *coht_slots_alloc(uint nslots)
+{
+	abort_unless((SMAX - OHT_CTLLEN(nslots)) / sizeof(struct ohslot) >=
+		     nslots);
+	return malloc(sizeof(struct ohslot) * nslots + OHT_CTLLEN(nslots));
+}
+
+
+static void coht_move_slot(void *sp, void *ctx)
+{
+	struct ohslot *s = sp;
+	struct ohtab *nt = ctx;
+	oht_ins(nt, s->key, s->data, oht_hash(nt, s->key));
+}
+
+
+/* Rebuild the table with 'nslots' slots dropping all deleted markers */
+static int coht_resize(struct cohtab *t, uint nslots)
+{
+	struct ohtab nt;
+	struct ohslot *slots;
+
+	slots = coht_slots_alloc(nslots);
+	if ( slots == NULL )
+		return -1;
+	oht_init(&nt, slots, (uchar *)(slots + nslots), nslots, t->table.cmp,
+		 t->table.hash, t->table.hctx);
+	oht_apply(&t->table, &coht_move_slot, &nt);
+	free(t->table.slots);
+	t->table = nt;
+	return 0;
+}
+
+
+struct cohtab *coht_new(size_t nslots, struct cohtab_attr *attr, void *hctx,
+			int abort_on_fail)
+{
+	size_t n;
+	size_t tsize;
+	size_t hctx_size;
+	uint nsl;
+	struct cohtab *t;
+	struct ohslot *slots;
+	void *new_hctx;
+
+	if ( attr == NULL )
+		attr = &coht_std_attr_skey;
+
+	abort_unless(attr->kcmp != NULL);
+	abort_unless(attr->hash != NULL);
+	abort_unless(attr->key_dup != NULL);
+	abort_unless(attr->key_free != NULL);
+	abort_unless(nslots <= ((uint)-1 >> 1) + 1);
+
+	for ( nsl = OHT_GRPSZ ; nsl < nslots ; nsl <<= 1 )
+		;
+
+	tsize = CAT_ALIGN_SIZE(sizeof(struct cohtab));
+	hctx_size = CAT_ALIGN_SIZE(attr->hctx_size);
+	abort_unless(hctx_size >= attr->hctx_size);
+	abort_unless(SMAX - hctx_size >= tsize);
+	n = hctx_size + tsize;
+
+	t = malloc(n);
+	slots = coht_slots_alloc(nsl);
+	if ( t == NULL || slots == NULL ) {
+		free(t);
+		free(slots);
+		if ( abort_on_fail )
+			err("coht_new: unable to allocate table\n");
+		return NULL;
+	}
+
+	new_hctx = (byte_t *)t + tsize;
+	t->seed = attr->seed;
+	if ( hctx_size != 0 )
+		memmove(new_hctx, hctx, attr->hctx_size);
+	else if ( attr->seed != 0 )
+		new_hctx = &t->seed;
+	else
+		new_hctx = NULL;
+
+	oht_init(&t->table, slots, (uchar *)(slots + nsl), nsl, attr->kcmp,
+		 attr->hash, new_hctx);
+	t->abort_on_fail = abort_on_fail;
+	t->key_dup = attr->key_dup;
+	t->key_free = attr->key_free;
+	t->ctx = attr->ctx;
+
+	return t;
+}
+
+
+static void coht_free_slot(void *sp, void *ctx)
+{
+	struct ohslot *s = sp;
+	struct cohtab *t = ctx;
+	(*t->key_free)(t, s->key);
+}
+
+
+void coht_free(struct cohtab *t)
+{
+	abort_unless(t != NULL);
+
+	oht_apply(&t->table, &coht_free_slot, t);
+	free(t->table.slots);
+	free(t);
+}
+
+
+void *coht_get(struct cohtab *t, void *key)
+{
+	struct ohslot *s;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	s = oht_lkup(&t->table, key, NULL);
+	if ( s != NULL )
+		return s->data;
+	return NULL;
+}
+
+
+/*
+ * Find or add the entry for 'key' and return its data slot, setting
+ * *isnew to 1 if it was added with NULL data.  Doubles the table before
+ * adding if it is mostly live entries or else just purges deletions.
+ */
+static void **coht_slot(struct cohtab *t, void *key, int *isnew,
+			const char *fn)
+{
+	struct ohslot *s;
+	void *kcpy;
+	uint h;
+	uint nslots;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	s = oht_lkup(&t->table, key, &h);
+	if ( s != NULL ) {
+		*isnew = 0;
+		return &s->data;
+	}
+
+	if ( oht_isfull(&t->table) ) {
+		nslots = t->table.nslots;
+		if ( t->table.fill >= t->table.maxfill / 2 ) {
+			abort_unless(nslots <= ((uint)-1 >> 1));
+			nslots <<= 1;
+		}
+		if ( coht_resize(t, nslots) < 0 ) {
+			if ( t->abort_on_fail )
+				err("%s: unable to grow table\n", fn);
+			return NULL;
+		}
+	}
+
+	kcpy = (*t->key_dup)(t, key);
+	if ( kcpy == NULL ) {
+		if ( t->abort_on_fail )
+			err("%s: unable to allocate key\n", fn);
+		return NULL;
+	}
+
+	s = oht_ins(&t->table, kcpy, NULL, h);
+	abort_unless(s != NULL);
+	*isnew = 1;
+	return &s->data;
+}
+
+
+int coht_put(struct cohtab *t, void *key, void *data)
+{
+	void **dp;
+	int isnew;
+
+	abort_unless(data != NULL);
+	dp = coht_slot(t, key, &isnew, "coht_put");
+	if ( dp == NULL )
+		return -1;
+	*dp = data;
+	return !isnew;
+}
+
+
+void **coht_upsert(struct cohtab *t, void *key, int *isnew)
+{
+	int dummy;
+
+	return coht_slot(t, key, (isnew != NULL) ? isnew : &dummy,
+			"coht_upsert");
+}
+
+
+void *coht_del(struct cohtab *t, void *key)
+{
+	struct ohslot *s;
+	void *data = NULL;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	s = oht_lkup(&t->table, key, NULL);
+	if ( s != NULL ) {
+		data = s->data;
+		(*t->key_free)(t, s->key);
+		oht_rem(&t->table, s);
+	}
+	return data;
+}
+
+
+static void coht_apply_wrap(void *p, void *ctx)
+{
+	struct ohslot *s = p;
+	struct apply_ctx *ac = ctx;
+	(*ac->f)(s->data, ac->ctx);
+}
+
+
+void coht_apply(struct cohtab *t, apply_f f, void *ctx)
+{
+	struct apply_ctx ac;
+	ac.ctx = ctx;
+	ac.f = f;
+	oht_apply(&t->table, &coht_apply_wrap, &ac);
+}
+
+
+
+
+/* AVL Trees */
+
+static struct canode *cavl_node_alloc_skey(struct cavltree *t, void *key)
+{
+	char *kcpy;
+	struct canode *can;
+	kcpy = strdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	can = malloc(sizeof(*can));
+	if ( can == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	avl_ninit(&can->node, kcpy);
+	return can;
+}
+
+
+static void cavl_node_free_skey(struct cavltree *t, struct canode *can)
+{
+	abort_unless(can != NULL);
+	abort_unless(can->node.key != NULL);
+	free(can->node.key);
+	free(can);
+}
+
+
+struct cavltree_attr cavl_std_attr_skey = {
+	&cmp_str,
+	&cavl_node_alloc_skey,
+	&cavl_node_free_skey,
+	0,
+};
+
+
+static struct canode *cavl_node_alloc_rkey(struct cavltree *t, void *key)
+{
+	struct canode *can;
+	struct raw *rkey = key;
+	struct raw *rnode;
+
+	abort_unless(rkey != NULL);
+	can = malloc(CAT_ALIGN_SIZE(sizeof(*can)) +
+		     CAT_ALIGN_SIZE(sizeof(*rnode)) +
+		     rkey->len);
+	if ( can == NULL )
+		return NULL;
+
+	rnode = (struct raw *)((byte_t *)can + CAT_ALIGN_SIZE(sizeof(*can)));
+	rnode->len = rkey->len;
+	if ( rkey->len > 0 ) {
+		rnode->data = (byte_t *)rnode + CAT_ALIGN_SIZE(sizeof(*rnode));
+		memmove(rnode->data, rkey->data, rkey->len);
+	} else {
+		rnode->data = NULL;
+	}
+	avl_ninit(&can->node, rnode);
+	return can;
+}
+
+
+static void cavl_node_free_rkey(struct cavltree *t, struct canode *can)
 {
 	free(can);
 }
@@ -810,6 +1539,107 @@ struct cavltree_attr cavl_std_attr_bkey = {
 };
 
 
+static struct canode *cavl_pool_node_alloc_skey(struct cavltree *t, void *key)
+{
+	char *kcpy;
+	struct canode *can;
+	kcpy = strdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	can = std_pool_alloc(&t->pool, sizeof(*can));
+	if ( can == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	avl_ninit(&can->node, kcpy);
+	return can;
+}
+
+
+static void cavl_pool_node_free_skey(struct cavltree *t, struct canode *can)
+{
+	abort_unless(can != NULL);
+	abort_unless(can->node.key != NULL);
+	free(can->node.key);
+	pc_free(can);
+}
+
+
+struct cavltree_attr cavl_pool_attr_skey = {
+	&cmp_str,
+	&cavl_pool_node_alloc_skey,
+	&cavl_pool_node_free_skey,
+	0,
+};
+
+
+static struct canode *cavl_pool_node_alloc_rkey(struct cavltree *t, void *key)
+{
+	struct raw *kcpy;
+	struct canode *can;
+	kcpy = rawdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	can = std_pool_alloc(&t->pool, sizeof(*can));
+	if ( can == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	avl_ninit(&can->node, kcpy);
+	return can;
+}
+
+
+static void cavl_pool_node_free_rkey(struct cavltree *t, struct canode *can)
+{
+	abort_unless(can != NULL);
+	abort_unless(can->node.key != NULL);
+	free(can->node.key);
+	pc_free(can);
+}
+
+
+struct cavltree_attr cavl_pool_attr_rkey = {
+	&cmp_raw,
+	&cavl_pool_node_alloc_rkey,
+	&cavl_pool_node_free_rkey,
+	0,
+};
+
+
+static struct canode *cavl_pool_node_alloc_pkey(struct cavltree *t, void *key)
+{
+	struct canode *can;
+	can = std_pool_alloc(&t->pool, sizeof(*can));
+	if ( can == NULL )
+		return NULL;
+	avl_ninit(&can->node, key);
+	return can;
+}
+
+
+static void cavl_pool_node_free_pkey(struct cavltree *t, struct canode *can)
+{
+	pc_free(can);
+}
+
+
+struct cavltree_attr cavl_pool_attr_pkey = {
+	&cmp_ptr,
+	&cavl_pool_node_alloc_pkey,
+	&cavl_pool_node_free_pkey,
+	0,
+};
+
+
+struct cavltree_attr cavl_pool_attr_bkey = {
+	NULL,			/* Must be supplied by user */
+	&cavl_pool_node_alloc_pkey,
+	&cavl_pool_node_free_pkey,
+	0,
+};
+
+
 struct cavltree *cavl_new(struct cavltree_attr *attr, int abort_on_fail)
 {
 	struct cavltree *t;
@@ -833,6 +1663,7 @@ struct cavltree *cavl_new(struct cavltree_attr *attr, int abort_on_fail)
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->pool = NULL;
 
 	return t;
 }
@@ -850,6 +1681,7 @@ void cavl_free(struct cavltree *t)
 		can = container(an, struct canode, node);
 		(*t->node_free)(t, can);
 	}
+	std_pool_free(t->pool);
 	free(t);
 }
 
@@ -868,7 +1700,9 @@ void *cavl_get(struct cavltree *t, void *key)
 }
 
 
-int cavl_put(struct cavltree *t, void *key, void *data)
+/* Find or add the node for 'key' and return its data slot (see cht_slot()) */
+static void **cavl_slot(struct cavltree *t, void *key, int *isnew,
+			const char *fn)
 {
 	int dir;
 	struct anode *an;
@@ -877,24 +1711,45 @@ int cavl_put(struct cavltree *t, void *key, void *data)
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-
 	an = avl_lkup(&t->tree, key, &dir);
 	if ( dir == CA_N ) {
-		can = container(an, struct canode, node);
-		can->data = data;
-		return 1;
+		*isnew = 0;
+		return &container(an, struct canode, node)->data;
 	}
 
 	can = (*t->node_alloc)(t, key);
 	if ( can == NULL ) {
 		if ( t->abort_on_fail )
-			err("cavl_put: unable to allocate node\n");
-		return -1;
+			err("%s: unable to allocate node\n", fn);
+		return NULL;
 	}
 
-	can->data = data;
+	can->data = NULL;
 	avl_ins(&t->tree, &can->node, an, dir);
-	return 0;
+	*isnew = 1;
+	return &can->data;
+}
+
+
+int cavl_put(struct cavltree *t, void *key, void *data)
+{
+	void **dp;
+	int isnew;
+
+	dp = cavl_slot(t, key, &isnew, "cavl_put");
+	if ( dp == NULL )
+		return -1;
+	*dp = data;
+	return !isnew;
+}
+
+
+void **cavl_upsert(struct cavltree *t, void *key, int *isnew)
+{
+	int dummy;
+
+	return cavl_slot(t, key, (isnew != NULL) ? isnew : &dummy,
+			"cavl_upsert");
 }
 
 
@@ -935,6 +1790,52 @@ void cavl_apply(struct cavltree *t, apply_f f, void *ctx)
 }
 
 
+struct anode *cavl_first(struct cavltree *t)
+{
+	abort_unless(t != NULL);
+	return avl_getmin(&t->tree);
+}
+
+
+struct anode *cavl_last(struct cavltree *t)
+{
+	abort_unless(t != NULL);
+	return avl_getmax(&t->tree);
+}
+
+
+struct anode *cavl_lbound(struct cavltree *t, void *key)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	return avl_lbound(&t->tree, key);
+}
+
+
+struct anode *cavl_ubound(struct cavltree *t, void *key)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	return avl_ubound(&t->tree, key);
+}
+
+
+struct anode *cavl_next(struct cavltree *t, struct anode *n)
+{
+	abort_unless(t != NULL);
+	abort_unless(n != NULL && n->tree == &t->tree);
+	return avl_next(n);
+}
+
+
+struct anode *cavl_prev(struct cavltree *t, struct anode *n)
+{
+	abort_unless(t != NULL);
+	abort_unless(n != NULL && n->tree == &t->tree);
+	return avl_prev(n);
+}
+
+
 
 
 /* Red-Black Trees */
@@ -1046,6 +1947,107 @@ struct crbtree_attr crb_std_attr_bkey = {
 };
 
 
+static struct crbnode *crb_pool_node_alloc_skey(struct crbtree *t, void *key)
+{
+	char *kcpy;
+	struct crbnode *crn;
+	kcpy = strdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	crn = std_pool_alloc(&t->pool, sizeof(*crn));
+	if ( crn == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	rb_ninit(&crn->node, kcpy);
+	return crn;
+}
+
+
+static void crb_pool_node_free_skey(struct crbtree *t, struct crbnode *crn)
+{
+	abort_unless(crn != NULL);
+	abort_unless(crn->node.key != NULL);
+	free(crn->node.key);
+	pc_free(crn);
+}
+
+
+struct crbtree_attr crb_pool_attr_skey = {
+	&cmp_str,
+	&crb_pool_node_alloc_skey,
+	&crb_pool_node_free_skey,
+	0,
+};
+
+
+static struct crbnode *crb_pool_node_alloc_rkey(struct crbtree *t, void *key)
+{
+	struct raw *kcpy;
+	struct crbnode *crn;
+	kcpy = rawdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	crn = std_pool_alloc(&t->pool, sizeof(*crn));
+	if ( crn == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	rb_ninit(&crn->node, kcpy);
+	return crn;
+}
+
+
+static void crb_pool_node_free_rkey(struct crbtree *t, struct crbnode *crn)
+{
+	abort_unless(crn != NULL);
+	abort_unless(crn->node.key != NULL);
+	free(crn->node.key);
+	pc_free(crn);
+}
+
+
+struct crbtree_attr crb_pool_attr_rkey = {
+	&cmp_raw,
+	&crb_pool_node_alloc_rkey,
+	&crb_pool_node_free_rkey,
+	0,
+};
+
+
+static struct crbnode *crb_pool_node_alloc_pkey(struct crbtree *t, void *key)
+{
+	struct crbnode *crn;
+	crn = std_pool_alloc(&t->pool, sizeof(*crn));
+	if ( crn == NULL )
+		return NULL;
+	rb_ninit(&crn->node, key);
+	return crn;
+}
+
+
+static void crb_pool_node_free_pkey(struct crbtree *t, struct crbnode *crn)
+{
+	pc_free(crn);
+}
+
+
+struct crbtree_attr crb_pool_attr_pkey = {
+	&cmp_ptr,
+	&crb_pool_node_alloc_pkey,
+	&crb_pool_node_free_pkey,
+	0,
+};
+
+
+struct crbtree_attr crb_pool_attr_bkey = {
+	NULL,			/* Must be supplied by user */
+	&crb_pool_node_alloc_pkey,
+	&crb_pool_node_free_pkey,
+	0,
+};
+
+
 struct crbtree *crb_new(struct crbtree_attr *attr, int abort_on_fail)
 {
 	struct crbtree *t;
@@ -1069,6 +2071,7 @@ struct crbtree *crb_new(struct crbtree_attr *attr, int abort_on_fail)
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->pool = NULL;
 
 	return t;
 }
@@ -1086,6 +2089,7 @@ void crb_free(struct crbtree *t)
 		crn = container(rn, struct crbnode, node);
 		(*t->node_free)(t, crn);
 	}
+	std_pool_free(t->pool);
 	free(t);
 }
 
@@ -1104,7 +2108,9 @@ void *crb_get(struct crbtree *t, void *key)
 }
 
 
-int crb_put(struct crbtree *t, void *key, void *data)
+/* Find or add the node for 'key' and return its data slot (see cht_slot()) */
+static void **crb_slot(struct crbtree *t, void *key, int *isnew,
+		       const char *fn)
 {
 	int dir;
 	struct rbnode *rn;
@@ -1113,24 +2119,45 @@ int crb_put(struct crbtree *t, void *key, void *data)
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-
 	rn = rb_lkup(&t->tree, key, &dir);
 	if ( dir == CRB_N ) {
-		crn = container(rn, struct crbnode, node);
-		crn->data = data;
-		return 1;
+		*isnew = 0;
+		return &container(rn, struct crbnode, node)->data;
 	}
 
 	crn = (*t->node_alloc)(t, key);
 	if ( crn == NULL ) {
 		if ( t->abort_on_fail )
-			err("crb_put: unable to allocate node\n");
-		return -1;
+			err("%s: unable to allocate node\n", fn);
+		return NULL;
 	}
 
-	crn->data = data;
+	crn->data = NULL;
 	rb_ins(&t->tree, &crn->node, rn, dir);
-	return 0;
+	*isnew = 1;
+	return &crn->data;
+}
+
+
+int crb_put(struct crbtree *t, void *key, void *data)
+{
+	void **dp;
+	int isnew;
+
+	dp = crb_slot(t, key, &isnew, "crb_put");
+	if ( dp == NULL )
+		return -1;
+	*dp = data;
+	return !isnew;
+}
+
+
+void **crb_upsert(struct crbtree *t, void *key, int *isnew)
+{
+	int dummy;
+
+	return crb_slot(t, key, (isnew != NULL) ? isnew : &dummy,
+			"crb_upsert");
 }
 
 
@@ -1154,20 +2181,66 @@ void *crb_del(struct crbtree *t, void *key)
 }
 
 
-static void crb_apply_wrap(void *p, void *ctx)
+static void crb_apply_wrap(void *p, void *ctx)
+{
+	struct crbnode *crn = p;
+	struct apply_ctx *ac = ctx;
+	(*ac->f)(crn->data, ac->ctx);
+}
+
+
+void crb_apply(struct crbtree *t, apply_f f, void *ctx)
+{
+	struct apply_ctx ac;
+	ac.ctx = t->ctx;
+	ac.f = f;
+	rb_apply(&t->tree, &crb_apply_wrap, &ac);
+}
+
+
+struct rbnode *crb_first(struct crbtree *t)
+{
+	abort_unless(t != NULL);
+	return rb_getmin(&t->tree);
+}
+
+
+struct rbnode *crb_last(struct crbtree *t)
+{
+	abort_unless(t != NULL);
+	return rb_getmax(&t->tree);
+}
+
+
+struct rbnode *crb_lbound(struct crbtree *t, void *key)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	return rb_lbound(&t->tree, key);
+}
+
+
+struct rbnode *crb_ubound(struct crbtree *t, void *key)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	return rb_ubound(&t->tree, key);
+}
+
+
+struct rbnode *crb_next(struct crbtree *t, struct rbnode *n)
 {
-	struct crbnode *crn = p;
-	struct apply_ctx *ac = ctx;
-	(*ac->f)(crn->data, ac->ctx);
+	abort_unless(t != NULL);
+	abort_unless(n != NULL && n->tree == &t->tree);
+	return rb_next(n);
 }
 
 
-void crb_apply(struct crbtree *t, apply_f f, void *ctx)
+struct rbnode *crb_prev(struct crbtree *t, struct rbnode *n)
 {
-	struct apply_ctx ac;
-	ac.ctx = t->ctx;
-	ac.f = f;
-	rb_apply(&t->tree, &crb_apply_wrap, &ac);
+	abort_unless(t != NULL);
+	abort_unless(n != NULL && n->tree == &t->tree);
+	return rb_prev(n);
 }
 
 
@@ -1282,6 +2355,107 @@ struct cstree_attr cst_std_attr_bkey = {
 };
 
 
+static struct cstnode *cst_pool_node_alloc_skey(struct cstree *t, void *key)
+{
+	char *kcpy;
+	struct cstnode *csn;
+	kcpy = strdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	csn = std_pool_alloc(&t->pool, sizeof(*csn));
+	if ( csn == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	st_ninit(&csn->node, kcpy);
+	return csn;
+}
+
+
+static void cst_pool_node_free_skey(struct cstree *t, struct cstnode *csn)
+{
+	abort_unless(csn != NULL);
+	abort_unless(csn->node.key != NULL);
+	free(csn->node.key);
+	pc_free(csn);
+}
+
+
+struct cstree_attr cst_pool_attr_skey = {
+	&cmp_str,
+	&cst_pool_node_alloc_skey,
+	&cst_pool_node_free_skey,
+	0,
+};
+
+
+static struct cstnode *cst_pool_node_alloc_rkey(struct cstree *t, void *key)
+{
+	struct raw *kcpy;
+	struct cstnode *csn;
+	kcpy = rawdup(key);
+	if ( kcpy == NULL )
+		return NULL;
+	csn = std_pool_alloc(&t->pool, sizeof(*csn));
+	if ( csn == NULL ) {
+		free(kcpy);
+		return NULL;
+	}
+	st_ninit(&csn->node, kcpy);
+	return csn;
+}
+
+
+static void cst_pool_node_free_rkey(struct cstree *t, struct cstnode *csn)
+{
+	abort_unless(csn != NULL);
+	abort_unless(csn->node.key != NULL);
+	free(csn->node.key);
+	pc_free(csn);
+}
+
+
+struct cstree_attr cst_pool_attr_rkey = {
+	&cmp_raw,
+	&cst_pool_node_alloc_rkey,
+	&cst_pool_node_free_rkey,
+	0,
+};
+
+
+static struct cstnode *cst_pool_node_alloc_pkey(struct cstree *t, void *key)
+{
+	struct cstnode *csn;
+	csn = std_pool_alloc(&t->pool, sizeof(*csn));
+	if ( csn == NULL )
+		return NULL;
+	st_ninit(&csn->node, key);
+	return csn;
+}
+
+
+static void cst_pool_node_free_pkey(struct cstree *t, struct cstnode *csn)
+{
+	pc_free(csn);
+}
+
+
+struct cstree_attr cst_pool_attr_pkey = {
+	&cmp_ptr,
+	&cst_pool_node_alloc_pkey,
+	&cst_pool_node_free_pkey,
+	0,
+};
+
+
+struct cstree_attr cst_pool_attr_bkey = {
+	NULL,			/* Must be supplied by user */
+	&cst_pool_node_alloc_pkey,
+	&cst_pool_node_free_pkey,
+	0,
+};
+
+
 struct cstree *cst_new(struct cstree_attr *attr, int abort_on_fail)
 {
 	struct cstree *t;
@@ -1305,6 +2479,7 @@ struct cstree *cst_new(struct cstree_attr *attr, int abort_on_fail)
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->pool = NULL;
 
 	return t;
 }
@@ -1322,6 +2497,7 @@ void cst_free(struct cstree *t)
 		csn = container(sn, struct cstnode, node);
 		(*t->node_free)(t, csn);
 	}
+	std_pool_free(t->pool);
 	free(t);
 }
 
@@ -1340,32 +2516,57 @@ void *cst_get(struct cstree *t, void *key)
 }
 
 
-int cst_put(struct cstree *t, void *key, void *data)
+/* Find or add the node for 'key' and return its data slot (see cht_slot()) */
+static void **cst_slot(struct cstree *t, void *key, int *isnew,
+		       const char *fn)
 {
+	int dir;
 	struct stnode *sn;
 	struct cstnode *csn;
 
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-
-	sn = st_lkup(&t->tree, key);
-	if ( sn != NULL ) {
-		csn = container(sn, struct cstnode, node);
-		csn->data = data;
-		return 1;
+	sn = st_lkup_dir(&t->tree, key, &dir);
+	if ( dir == CST_N ) {
+		*isnew = 0;
+		return &container(sn, struct cstnode, node)->data;
 	}
 
 	csn = (*t->node_alloc)(t, key);
 	if ( csn == NULL ) {
+		st_lkup_miss(&t->tree, sn);
 		if ( t->abort_on_fail )
-			err("cst_put: unable to allocate node\n");
-		return -1;
+			err("%s: unable to allocate node\n", fn);
+		return NULL;
 	}
 
-	csn->data = data;
-	st_ins(&t->tree, &csn->node);
-	return 0;
+	csn->data = NULL;
+	st_ins_at(&t->tree, &csn->node, sn, dir);
+	*isnew = 1;
+	return &csn->data;
+}
+
+
+int cst_put(struct cstree *t, void *key, void *data)
+{
+	void **dp;
+	int isnew;
+
+	dp = cst_slot(t, key, &isnew, "cst_put");
+	if ( dp == NULL )
+		return -1;
+	*dp = data;
+	return !isnew;
+}
+
+
+void **cst_upsert(struct cstree *t, void *key, int *isnew)
+{
+	int dummy;
+
+	return cst_slot(t, key, (isnew != NULL) ? isnew : &dummy,
+			"cst_upsert");
 }
 
 
@@ -1406,6 +2607,228 @@ void cst_apply(struct cstree *t, apply_f f, void *ctx)
 }
 
 
+struct stnode *cst_first(struct cstree *t)
+{
+	abort_unless(t != NULL);
+	return st_getmin(&t->tree);
+}
+
+
+struct stnode *cst_last(struct cstree *t)
+{
+	abort_unless(t != NULL);
+	return st_getmax(&t->tree);
+}
+
+
+struct stnode *cst_lbound(struct cstree *t, void *key)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	return st_lbound(&t->tree, key);
+}
+
+
+struct stnode *cst_ubound(struct cstree *t, void *key)
+{
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	return st_ubound(&t->tree, key);
+}
+
+
+struct stnode *cst_next(struct cstree *t, struct stnode *n)
+{
+	abort_unless(t != NULL);
+	abort_unless(n != NULL && n->tree == &t->tree);
+	return st_next(n);
+}
+
+
+struct stnode *cst_prev(struct cstree *t, struct stnode *n)
+{
+	abort_unless(t != NULL);
+	abort_unless(n != NULL && n->tree == &t->tree);
+	return st_prev(n);
+}
+
+
+
+
+/* B+trees */
+
+static void *cbpt_key_dup_skey(struct cbptree *t, void *key)
+{
+	return strdup(key);
+}
+
+
+static void cbpt_key_free_skey(struct cbptree *t, void *key)
+{
+	abort_unless(key != NULL);
+	free(key);
+}
+
+
+struct cbptree_attr cbpt_std_attr_skey = {
+	&cmp_str,
+	&cbpt_key_dup_skey,
+	&cbpt_key_free_skey,
+	NULL,
+};
+
+
+static void *cbpt_key_dup_rkey(struct cbptree *t, void *key)
+{
+	return rawdup(key);
+}
+
+
+static void cbpt_key_free_rkey(struct cbptree *t, void *key)
+{
+	free(key);
+}
+
+
+struct cbptree_attr cbpt_std_attr_rkey = {
+	&cmp_raw,
+	&cbpt_key_dup_rkey,
+	&cbpt_key_free_rkey,
+	NULL,
+};
+
+
+static void *cbpt_key_dup_pkey(struct cbptree *t, void *key)
+{
+	return key;
+}
+
+
+static void cbpt_key_free_pkey(struct cbptree *t, void *key)
+{
+}
+
+
+struct cbptree_attr cbpt_std_attr_pkey = {
+	&cmp_ptr,
+	&cbpt_key_dup_pkey,
+	&cbpt_key_free_pkey,
+	NULL,
+};
+
+
+struct cbptree_attr cbpt_std_attr_bkey = {
+	NULL,			/* Must be supplied by user */
+	&cbpt_key_dup_pkey,
+	&cbpt_key_free_pkey,
+	NULL,
+};
+
+
+struct cbptree *cbpt_new(struct cbptree_attr *attr, int abort_on_fail)
+{
+	struct cbptree *t;
+
+	if ( attr == NULL )
+		attr = &cbpt_std_attr_skey;
+
+	abort_unless(attr->kcmp != NULL);
+	abort_unless(attr->key_dup != NULL);
+	abort_unless(attr->key_free != NULL);
+
+	t = malloc(sizeof(*t));
+	if ( t == NULL ) {
+		if ( abort_on_fail )
+			err("cbpt_new: unable to allocate tree\n");
+		return NULL;
+	}
+
+	bpt_init(&t->tree, attr->kcmp, &stdmm);
+	t->abort_on_fail = abort_on_fail;
+	t->key_dup = attr->key_dup;
+	t->key_free = attr->key_free;
+	t->ctx = attr->ctx;
+
+	return t;
+}
+
+
+void cbpt_free(struct cbptree *t)
+{
+	struct bpt_cursor c;
+	int valid;
+
+	abort_unless(t != NULL);
+
+	for ( valid = bpt_first(&t->tree, &c) ; valid ; valid = bpt_next(&c) )
+		(*t->key_free)(t, bpt_ckey(&c));
+	bpt_fini(&t->tree);
+	free(t);
+}
+
+
+void *cbpt_get(struct cbptree *t, void *key)
+{
+	void **dp;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	dp = bpt_lkup(&t->tree, key);
+	return (dp != NULL) ? *dp : NULL;
+}
+
+
+int cbpt_put(struct cbptree *t, void *key, void *data)
+{
+	void *kcpy;
+	int rv;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	abort_unless(data != NULL);
+
+	kcpy = (*t->key_dup)(t, key);
+	if ( kcpy == NULL )
+		goto err;
+	rv = bpt_ins(&t->tree, kcpy, data, NULL);
+	if ( rv < 0 ) {
+		(*t->key_free)(t, kcpy);
+		goto err;
+	}
+	/* an existing entry keeps its original key */
+	if ( rv > 0 )
+		(*t->key_free)(t, kcpy);
+	return rv;
+
+err:
+	if ( t->abort_on_fail )
+		err("cbpt_put: unable to allocate node\n");
+	return -1;
+}
+
+
+void *cbpt_del(struct cbptree *t, void *key)
+{
+	void *okey, *data;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	if ( bpt_rem(&t->tree, key, &okey, &data) < 0 )
+		return NULL;
+	(*t->key_free)(t, okey);
+	return data;
+}
+
+
+void cbpt_apply(struct cbptree *t, apply_f f, void *ctx)
+{
+	abort_unless(t != NULL);
+	bpt_apply(&t->tree, f, ctx);
+}
+
+
 
 
 /* Heap operations */
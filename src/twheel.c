@@ -0,0 +1,202 @@
+/*
+ * twheel.c -- Hierarchical timing wheel
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+
+#include <cat/cat.h>
+#include <cat/twheel.h>
+
+#define TW_SHIFT(l)	((l) * TW_LVLBITS)
+
+
+/* Put 'n' in the slot for its expiry time relative to the current tick */
+static void tw_place(struct twheel *tw, struct twnode *n)
+{
+	ulong e = n->expire;
+	ulong delta = e - tw->now;
+	int l;
+
+	/* too far out for the wheel:  park at the far end of the top level */
+	if ( delta > TW_MAXTTL ) {
+		delta = TW_MAXTTL;
+		e = tw->now + TW_MAXTTL;
+	}
+	for ( l = 0; l < TW_NLVLS - 1 && (delta >> TW_SHIFT(l + 1)) != 0; ++l )
+		;
+	l_enq(&tw->slots[l][(e >> TW_SHIFT(l)) & TW_MASK], &n->entry);
+}
+
+
+/* Move the timers in 'slot' to 'out' */
+static void tw_collect(struct twheel *tw, struct list *slot, struct list *out)
+{
+	struct list *le;
+
+	for ( le = l_head(slot); le != l_end(slot); le = l_next(le) ) {
+		l_to_twn(le)->tw = NULL;
+		tw->count -= 1;
+	}
+	l_append(out, slot);
+}
+
+
+/* Spread the timers in a higher level 'slot' whose span just began */
+static void tw_cascade(struct twheel *tw, struct list *slot)
+{
+	struct list l, *le;
+
+	l_init(&l);
+	l_append(&l, slot);
+	while ( (le = l_deq(&l)) != NULL )
+		tw_place(tw, l_to_twn(le));
+}
+
+
+/* Move to the next tick, cascading and expiring as needed */
+static void tw_tick(struct twheel *tw, struct list *out)
+{
+	uint idx;
+	int l;
+
+	tw->now += 1;
+	idx = tw->now & TW_MASK;
+	for ( l = 1; idx == 0 && l < TW_NLVLS; ++l ) {
+		idx = (tw->now >> TW_SHIFT(l)) & TW_MASK;
+		tw_cascade(tw, &tw->slots[l][idx]);
+	}
+	tw_collect(tw, &tw->slots[0][tw->now & TW_MASK], out);
+}
+
+
+void tw_init(struct twheel *tw, ulong now, ulong slack)
+{
+	int l, i;
+
+	abort_unless(tw);
+
+	tw->now = now;
+	tw->count = 0;
+	tw_set_slack(tw, slack);
+	for ( l = 0; l < TW_NLVLS; ++l )
+		for ( i = 0; i < TW_NSLOTS; ++i )
+			l_init(&tw->slots[l][i]);
+}
+
+
+void tw_set_slack(struct twheel *tw, ulong slack)
+{
+	abort_unless(tw);
+
+	for ( tw->gran = 1; tw->gran <= (slack >> 1); tw->gran <<= 1 )
+		;
+}
+
+
+void tw_ninit(struct twnode *n)
+{
+	abort_unless(n);
+	l_init(&n->entry);
+	n->expire = 0;
+	n->tw = NULL;
+}
+
+
+void tw_add(struct twheel *tw, struct twnode *n, ulong ttl)
+{
+	abort_unless(tw);
+	abort_unless(n);
+	abort_unless(n->tw == NULL);
+
+	n->expire = tw->now + ttl;
+	if ( tw->gran > 1 )
+		n->expire = (n->expire + tw->gran - 1) & ~(tw->gran - 1);
+	n->tw = tw;
+	tw->count += 1;
+	tw_place(tw, n);
+}
+
+
+void tw_rem(struct twnode *n)
+{
+	abort_unless(n);
+
+	if ( n->tw == NULL )
+		return;
+	l_rem(&n->entry);
+	n->tw->count -= 1;
+	n->tw = NULL;
+}
+
+
+ulong tw_next(struct twheel *tw)
+{
+	ulong best = TW_NONE, t;
+	uint cur, j;
+	int l;
+
+	abort_unless(tw);
+
+	if ( tw->count == 0 )
+		return TW_NONE;
+	if ( !l_isempty(&tw->slots[0][tw->now & TW_MASK]) )
+		return 0;
+
+	for ( l = 0; l < TW_NLVLS; ++l ) {
+		cur = (tw->now >> TW_SHIFT(l)) & TW_MASK;
+		for ( j = 1; j <= TW_NSLOTS; ++j ) {
+			if ( l_isempty(&tw->slots[l][(cur + j) & TW_MASK]) )
+				continue;
+			t = (((tw->now >> TW_SHIFT(l)) + j) << TW_SHIFT(l)) -
+			    tw->now;
+			if ( t < best )
+				best = t;
+			break;
+		}
+		/* higher levels only change at the next level 0 wrap or later */
+		if ( l == 0 && best <= TW_NSLOTS - (tw->now & TW_MASK) )
+			break;
+	}
+
+	return best;
+}
+
+
+void tw_adv(struct twheel *tw, ulong nticks, struct list *out)
+{
+	ulong skip;
+
+	abort_unless(tw);
+	abort_unless(out);
+
+	tw_collect(tw, &tw->slots[0][tw->now & TW_MASK], out);
+
+	/* skip the ticks where nothing would happen */
+	while ( nticks > 0 ) {
+		skip = tw_next(tw);
+		if ( skip == TW_NONE || skip > nticks ) {
+			tw->now += nticks;
+			break;
+		}
+		abort_unless(skip > 0);
+		tw->now += skip - 1;
+		nticks -= skip;
+		tw_tick(tw, out);
+	}
+}
+
+
+void tw_drain(struct twheel *tw, struct list *out)
+{
+	int l, i;
+
+	abort_unless(tw);
+	abort_unless(out);
+
+	for ( l = 0; l < TW_NLVLS; ++l )
+		for ( i = 0; i < TW_NSLOTS; ++i )
+			tw_collect(tw, &tw->slots[l][i], out);
+}
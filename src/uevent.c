@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/time.h>
+#include <time.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -40,6 +41,33 @@ static int uemux_initialized = 0;
 #define IKEY(_i) (int2ptr((_i) + 1))
 
 
+/*
+ * The timer wheel turns once per millisecond.  Use the monotonic clock
+ * where there is one so steps of the wall clock do not move timers.
+ */
+static ulong ue_msec(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if ( clock_gettime(CLOCK_MONOTONIC, &ts) == 0 )
+		return (ulong)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif /* CLOCK_MONOTONIC */
+	{
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return (ulong)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	}
+}
+
+
+/* Milliseconds the wheel lags the clock:  0 if the clock went backwards */
+static ulong ue_elapsed(struct uemux *mux)
+{
+	ulong d = ue_msec() - tw_now(&mux->timers);
+	return ((long)d < 0) ? 0 : d;
+}
+
+
 static int fdmax(struct cavltree *a)
 {
 	struct anode *n = avl_getmax(&a->tree);
@@ -83,7 +111,7 @@ void ue_init(struct uemux *mux, struct memmgr *mm)
 	mux->done = 0;
 	mux->maxfd = -1;
 	mux->fdtab = cavl_new(&cavl_std_attr_pkey, 0);
-	dl_init(&mux->timers, tm_zero);
+	tw_init(&mux->timers, ue_msec(), 0);
 	l_init(&mux->iolist);
 	FD_ZERO(&mux->rset);
 	FD_ZERO(&mux->wset);
@@ -107,6 +135,7 @@ static void free_sigevent(void *sep, void *mmp)
 void ue_fini(struct uemux *mux)
 {
 	struct ue_timer *t;
+	struct list l, *le;
 
 	abort_unless(mux);
 
@@ -117,8 +146,10 @@ void ue_fini(struct uemux *mux)
 		cavl_apply(mux->sigtab, free_sigevent, NULL);
 	cavl_free(mux->sigtab);
 
-	while ( !dl_isempty(&mux->timers) ) {
-		t = container(dl_head(&mux->timers), struct ue_timer, entry);
+	l_init(&l);
+	tw_drain(&mux->timers, &l);
+	while ( (le = l_deq(&l)) != NULL ) {
+		t = container(l_to_twn(le), struct ue_timer, entry);
 		ue_tm_del(t);
 	}
 }
@@ -135,17 +166,15 @@ static void tdispatch(void *lp, void *muxp)
 	struct list *l = lp;
 	struct uemux *m = muxp;
 	struct ue_timer *t;
-	cat_time_t tout;
 
 	if ( m->done )
 		return;
 	l_rem(l);
-	t = container(container(l, struct dlist, entry), struct ue_timer,entry);
-	if ( t->flags & UE_PERIODIC ) {
-		tout = tm_lset(t->orig / 1000, (t->orig % 1000) * 1000000);
-		dl_init(&t->entry, tout);
-		dl_ins(&m->timers, &t->entry);
-	}
+	t = container(l_to_twn(l), struct ue_timer, entry);
+	if ( t->flags & UE_PERIODIC )
+		tw_add(&m->timers, &t->entry, t->orig);
+	else
+		t->flags &= ~UE_TREG;
 	cb_call(&t->cb, NULL);
 }
 
@@ -153,14 +182,12 @@ static void tdispatch(void *lp, void *muxp)
 void ue_tm_init(struct ue_timer *t, int flags, ulong ttl, callback_f func, 
 		void *ctx)
 {
-	cat_time_t tout;
 	abort_unless(t);
 	abort_unless(func);
 	t->flags = flags;
 	t->orig  = ttl;
 	cb_init(&t->cb, func, ctx);
-	tout = tm_lset(t->orig / 1000, (t->orig % 1000) * 1000000);
-	dl_init(&t->entry, tout);
+	tw_ninit(&t->entry);
 	t->mm = NULL;
 }
 
@@ -169,23 +196,30 @@ int ue_tm_reg(struct uemux *mux, struct ue_timer *t)
 {
 	abort_unless(t);
 	abort_unless(mux);
-	dl_ins(&mux->timers, &t->entry);
+	abort_unless(!(t->flags & UE_TREG));
+	tw_add(&mux->timers, &t->entry, t->orig);
 	t->flags |= UE_TREG;
 	return 0;
 }
 
 
-
 void ue_tm_cancel(struct ue_timer *t)
 {
 	abort_unless(t);
 	if ( !(t->flags & UE_TREG) )
 		return;
-	dl_rem(&t->entry);
+	tw_rem(&t->entry);
 	t->flags &= ~UE_TREG;
 }
 
 
+void ue_tm_slack(struct uemux *mux, ulong msec)
+{
+	abort_unless(mux);
+	tw_set_slack(&mux->timers, msec);
+}
+
+
 void ue_io_init(struct ue_ioevent *io, int type, int fd, callback_f f, void *a)
 {
 	cb_init(&io->cb, f, a);
@@ -438,10 +472,10 @@ void ue_next(struct uemux *mux)
 {
 	int i, maxsig;
 	fd_set rset, wset, eset;
-	struct timeval cur, delta, tv, *tvp;
+	struct timeval delta, *tvp;
 	struct ue_iorun_prm iorp;
 	struct list l;
-	cat_time_t ct;
+	ulong next, elapsed;
 	sigset_t save, fired;
 
 	abort_unless(mux);
@@ -453,11 +487,13 @@ void ue_next(struct uemux *mux)
 	wset = mux->wset;
 	eset = mux->eset;
 
-	dl_first(&mux->timers, &ct);
-	if ( tm_gez(ct) ) {
-		delta.tv_sec  = tm_sec(ct);
-		delta.tv_usec = tm_nsec(ct) / 1000;
-		gettimeofday(&cur, NULL);
+	next = tw_next(&mux->timers);
+	if ( next != TW_NONE ) {
+		/* the wheel lags the clock by the time since the last turn */
+		elapsed = ue_elapsed(mux);
+		next = (next > elapsed) ? next - elapsed : 0;
+		delta.tv_sec  = next / 1000;
+		delta.tv_usec = (next % 1000) * 1000;
 		tvp = &delta;
 	}
 
@@ -482,19 +518,9 @@ void ue_next(struct uemux *mux)
 	if ( i < 0 )
 		return;
 
-	if ( tvp ) { 
-		gettimeofday(&tv, NULL);
-		delta.tv_sec = tv.tv_sec - cur.tv_sec;
-		delta.tv_usec = tv.tv_usec - cur.tv_usec;
-		if (delta.tv_usec < 0) {
-			delta.tv_sec -= 1;
-			delta.tv_usec += 1000000;
-		}
-		ct = tm_lset(delta.tv_sec, delta.tv_usec * 1000);
-		l_init(&l);
-		dl_adv(&mux->timers, ct, &l);
-		l_apply(&l, tdispatch, mux);
-	}
+	l_init(&l);
+	tw_adv(&mux->timers, ue_elapsed(mux), &l);
+	l_apply(&l, tdispatch, mux);
 
 	iorp.mux  = mux;
 	iorp.rset = &rset;
@@ -507,7 +533,8 @@ void ue_next(struct uemux *mux)
 void ue_run(struct uemux *mux)
 {
 	abort_unless(mux);
-	while ( (!dl_isempty(&mux->timers) || (mux->maxfd >= 0)) && !mux->done )
+	while ( (tw_count(&mux->timers) > 0 || (mux->maxfd >= 0)) &&
+		!mux->done )
 		ue_next(mux);
 }
 
@@ -532,6 +559,7 @@ void ue_runfor(struct uemux *mux, ulong msec)
 
 	while ( !timeout && !mux->done )
 		ue_next(mux);
+	ue_tm_cancel(&timer);
 }
 
 
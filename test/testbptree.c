@@ -0,0 +1,272 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/bptree.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+#include <cat/stduse.h>
+
+#define NCHECK		20000
+#define NLKUP		(1024 * 1024)
+#define NRANGE		(64 * 1024)
+#define RANGELEN	64
+
+void **keys;
+uint nkeys = 1024 * 1024;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static void shuffle(void **arr, uint n)
+{
+  uint i, j;
+  void *x;
+
+  for (i = n - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    x = arr[i];
+    arr[i] = arr[j];
+    arr[j] = x;
+  }
+}
+
+
+/* random inserts and removals checked against a presence table */
+void check()
+{
+  struct bptree t;
+  struct bpt_cursor c;
+  static char present[NCHECK];
+  void *od, *ok;
+  uint i, k, n = 0, cnt;
+  int rv, valid;
+  long last;
+
+  bpt_init(&t, cmp_intptr, &stdmm);
+  for (i = 0; i < 40 * NCHECK; ++i) {
+    k = random() % NCHECK;
+    if (random() % 3 != 0) {
+      rv = bpt_ins(&t, int2ptr(k), int2ptr(k + 1), &od);
+      if (rv != present[k] || (rv == 1 && od != int2ptr(k + 1)))
+        err("bpt_ins: bad return for key %u\n", k);
+      if (!present[k])
+        ++n;
+      present[k] = 1;
+    } else {
+      rv = bpt_rem(&t, int2ptr(k), &ok, &od);
+      if ((rv == 0) != present[k] ||
+          (rv == 0 && (ok != int2ptr(k) || od != int2ptr(k + 1))))
+        err("bpt_rem: bad return for key %u\n", k);
+      if (present[k])
+        --n;
+      present[k] = 0;
+    }
+    if (i % 997 == 0) {
+      cnt = 0;
+      last = -1;
+      for (valid = bpt_first(&t, &c); valid; valid = bpt_next(&c)) {
+        if (ptr2int(bpt_ckey(&c)) <= last || !present[ptr2int(bpt_ckey(&c))])
+          err("bpt: tree out of order or has stale key\n");
+        last = ptr2int(bpt_ckey(&c));
+        ++cnt;
+      }
+      if (cnt != n || t.nkeys != n)
+        err("bpt: expected %u keys, found %u\n", n, cnt);
+    }
+  }
+
+  for (k = 0; k < NCHECK; ++k) {
+    if ((bpt_lkup(&t, int2ptr(k)) != NULL) != present[k])
+      err("bpt_lkup: wrong result for key %u\n", k);
+    valid = bpt_lbound(&t, int2ptr(k), &c);
+    for (i = k; i < NCHECK && !present[i]; ++i)
+      ;
+    if (valid != (i < NCHECK) || (valid && bpt_ckey(&c) != int2ptr(i)))
+      err("bpt_lbound: wrong result for key %u\n", k);
+  }
+
+  cnt = 0;
+  for (valid = bpt_last(&t, &c); valid; valid = bpt_prev(&c))
+    ++cnt;
+  if (cnt != n)
+    err("bpt_prev: walked %u of %u keys\n", cnt, n);
+
+  for (k = 0; k < NCHECK; ++k)
+    bpt_rem(&t, int2ptr(k), NULL, NULL);
+  if (t.root != NULL || t.nkeys != 0 || t.height != 0)
+    err("bpt: tree not empty after removing all keys\n");
+  bpt_fini(&t);
+  printf("B+tree random insert/remove checks passed\n");
+}
+
+
+void checkcbpt()
+{
+  struct cbptree *t;
+  char buf[32];
+  int i;
+
+  t = cbpt_new(&cbpt_std_attr_skey, 1);
+  for (i = 0; i < 1000; ++i) {
+    sprintf(buf, "key%04d", i);
+    if (cbpt_put(t, buf, int2ptr(i + 1)) != 0)
+      err("cbpt_put: key %d reported as present\n", i);
+  }
+  if (cbpt_put(t, "key0007", int2ptr(100)) != 1 ||
+      cbpt_get(t, "key0007") != int2ptr(100) ||
+      cbpt_del(t, "key0007") != int2ptr(100) ||
+      cbpt_get(t, "key0007") != NULL)
+    err("cbpt: replace/delete semantics wrong\n");
+  cbpt_free(t);
+  printf("Managed B+tree checks passed\n");
+}
+
+
+void timeit()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct bptree bt;
+  struct bpt_cursor c;
+  struct anode *anodes, *an;
+  struct rbnode *rnodes, *rn;
+  struct timeval start, end;
+  void **lkeys;
+  ulong sum;
+  uint i, j;
+
+  anodes = malloc(sizeof(struct anode) * nkeys);
+  rnodes = malloc(sizeof(struct rbnode) * nkeys);
+  keys = malloc(sizeof(void *) * nkeys);
+  lkeys = malloc(sizeof(void *) * NLKUP);
+  abort_unless(anodes && rnodes && keys && lkeys);
+
+  for (i = 0; i < nkeys; ++i)
+    keys[i] = int2ptr(i * 2 + 1);
+  shuffle(keys, nkeys);
+  for (i = 0; i < NLKUP; ++i)
+    lkeys[i] = keys[random() % nkeys];
+
+  avl_init(&at, cmp_intptr);
+  rb_init(&rt, cmp_intptr);
+  bpt_init(&bt, cmp_intptr, &stdmm);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nkeys; ++i) {
+    avl_ninit(&anodes[i], keys[i]);
+    avl_ins(&at, &anodes[i], NULL, 0);
+  }
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per avl_ins()\n", nkeys,
+         tdiff(&start, &end) * 1000.0 / nkeys);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nkeys; ++i) {
+    rb_ninit(&rnodes[i], keys[i]);
+    rb_ins(&rt, &rnodes[i], NULL, 0);
+  }
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per rb_ins()\n", nkeys,
+         tdiff(&start, &end) * 1000.0 / nkeys);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nkeys; ++i)
+    if (bpt_ins(&bt, keys[i], keys[i], NULL) < 0)
+      err("bpt_ins: out of memory\n");
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per bpt_ins() (height %u)\n", nkeys,
+         tdiff(&start, &end) * 1000.0 / nkeys, bt.height);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NLKUP; ++i)
+    if (avl_lkup(&at, lkeys[i], NULL) == NULL)
+      err("avl_lkup: key missing\n");
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per avl_lkup()\n", nkeys,
+         tdiff(&start, &end) * 1000.0 / NLKUP);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NLKUP; ++i)
+    if (rb_lkup(&rt, lkeys[i], NULL) == NULL)
+      err("rb_lkup: key missing\n");
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per rb_lkup()\n", nkeys,
+         tdiff(&start, &end) * 1000.0 / NLKUP);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NLKUP; ++i)
+    if (bpt_lkup(&bt, lkeys[i]) == NULL)
+      err("bpt_lkup: key missing\n");
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per bpt_lkup()\n", nkeys,
+         tdiff(&start, &end) * 1000.0 / NLKUP);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NRANGE; ++i) {
+    an = avl_lkup(&at, lkeys[i], NULL);
+    for (j = 0; an != NULL && j < RANGELEN; ++j, an = avl_next(an))
+      sum += ptr2uint(an->key);
+  }
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per %d key range scan in avl (%lu)\n",
+         nkeys, tdiff(&start, &end) * 1000.0 / NRANGE, RANGELEN, sum);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NRANGE; ++i) {
+    rn = rb_lkup(&rt, lkeys[i], NULL);
+    for (j = 0; rn != NULL && j < RANGELEN; ++j, rn = rb_next(rn))
+      sum += ptr2uint(rn->key);
+  }
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per %d key range scan in rb (%lu)\n",
+         nkeys, tdiff(&start, &end) * 1000.0 / NRANGE, RANGELEN, sum);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NRANGE; ++i) {
+    j = 0;
+    if (bpt_lbound(&bt, lkeys[i], &c)) {
+      do {
+        sum += ptr2uint(bpt_ckey(&c));
+      } while (++j < RANGELEN && bpt_next(&c));
+    }
+  }
+  gettimeofday(&end, NULL);
+  printf("%u keys: roughly %f nsec per %d key range scan in bpt (%lu)\n",
+         nkeys, tdiff(&start, &end) * 1000.0 / NRANGE, RANGELEN, sum);
+
+  bpt_fini(&bt);
+  free(lkeys);
+  free(keys);
+  free(rnodes);
+  free(anodes);
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1)
+    nkeys = strtoul(argv[1], NULL, 0);
+  if (nkeys < 1)
+    nkeys = 1;
+
+  check();
+  checkcbpt();
+  timeit();
+
+  return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+#include <cat/splay.h>
+
+#define NCHECK		600
+#define NTIME		(1024 * 1024)
+
+struct anode *anodes, **aptrs;
+struct rbnode *rnodes, **rptrs;
+struct stnode *snodes, **sptrs;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* returns the height of 'n' checking balance factors on the way */
+static int avl_check(struct anode *n)
+{
+  int lh, rh;
+
+  if (n == NULL)
+    return 0;
+  lh = avl_check(n->p[CA_L]);
+  rh = avl_check(n->p[CA_R]);
+  if (n->b != rh - lh || n->b < -1 || n->b > 1)
+    err("avl_build: bad balance %d (heights %d/%d)\n", n->b, lh, rh);
+  if ((n->p[CA_L] && n->p[CA_L]->p[CA_P] != n) ||
+      (n->p[CA_R] && n->p[CA_R]->p[CA_P] != n))
+    err("avl_build: bad parent pointer\n");
+  return (lh > rh ? lh : rh) + 1;
+}
+
+
+/* returns the black height of 'n' checking the rb invariants */
+static int rb_check(struct rbnode *n)
+{
+  int lh, rh;
+
+  if (n == NULL)
+    return 1;
+  lh = rb_check(n->p[CRB_L]);
+  rh = rb_check(n->p[CRB_R]);
+  if (lh != rh)
+    err("rb_build: black heights differ %d/%d\n", lh, rh);
+  if (n->col == CRB_RED &&
+      ((n->p[CRB_L] && n->p[CRB_L]->col == CRB_RED) ||
+       (n->p[CRB_R] && n->p[CRB_R]->col == CRB_RED)))
+    err("rb_build: red node with a red child\n");
+  return lh + (n->col == CRB_BLACK);
+}
+
+
+void check()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct sptree st;
+  struct anode *aflat[NCHECK];
+  struct rbnode *rflat[NCHECK];
+  struct stnode *sflat[NCHECK];
+  uint n, i, k;
+
+  for (n = 0; n < NCHECK; ++n) {
+    avl_init(&at, cmp_intptr);
+    rb_init(&rt, cmp_intptr);
+    st_init(&st, cmp_intptr);
+    avl_build(&at, aptrs, n);
+    rb_build(&rt, rptrs, n);
+    st_build(&st, sptrs, n);
+    avl_check(at.avl_root);
+    rb_check(rt.rb_root);
+    if (rt.rb_root && rt.rb_root->col != CRB_BLACK)
+      err("rb_build: red root\n");
+
+    /* the trees must remain usable for normal operations */
+    for (i = 0; i < n; ++i) {
+      k = random() % n;
+      if (avl_lkup(&at, anodes[k].key, NULL) != &anodes[k] ||
+          rb_lkup(&rt, rnodes[k].key, NULL) != &rnodes[k] ||
+          st_lkup(&st, snodes[k].key) != &snodes[k])
+        err("build: node %u not found in tree of %u\n", k, n);
+    }
+    for (i = 0; i < n; i += 3) {
+      avl_rem(&anodes[i]);
+      rb_rem(&rnodes[i]);
+      st_rem(&snodes[i]);
+    }
+    avl_check(at.avl_root);
+    rb_check(rt.rb_root);
+    for (i = 0; i < n; i += 3) {
+      avl_ninit(&anodes[i], anodes[i].key);
+      avl_ins(&at, &anodes[i], NULL, 0);
+      rb_ninit(&rnodes[i], rnodes[i].key);
+      rb_ins(&rt, &rnodes[i], NULL, 0);
+      st_ninit(&snodes[i], snodes[i].key);
+      st_ins(&st, &snodes[i]);
+    }
+
+    if (n > 0 && (avl_flatten(&at, aflat, n - 1) != n ||
+                  rb_flatten(&rt, rflat, n - 1) != n ||
+                  st_flatten(&st, sflat, n - 1) != n ||
+                  avl_isempty(&at) || rb_isempty(&rt) || st_isempty(&st)))
+      err("flatten: short array should leave the tree alone\n");
+    if (avl_flatten(&at, aflat, NCHECK) != n ||
+        rb_flatten(&rt, rflat, NCHECK) != n ||
+        st_flatten(&st, sflat, NCHECK) != n ||
+        !avl_isempty(&at) || !rb_isempty(&rt) || !st_isempty(&st))
+      err("flatten: wrong count or tree not emptied for %u nodes\n", n);
+    for (i = 0; i < n; ++i)
+      if (aflat[i] != &anodes[i] || rflat[i] != &rnodes[i] ||
+          sflat[i] != &snodes[i] || aflat[i]->tree != NULL)
+        err("flatten: node %u out of order\n", i);
+  }
+  printf("Bulk build and flatten checks passed\n");
+}
+
+
+void timeit()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct sptree st;
+  struct timeval start, end;
+  uint i;
+
+  avl_init(&at, cmp_intptr);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    avl_ins(&at, &anodes[i], NULL, 0);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for avl_ins()\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  avl_flatten(&at, aptrs, NTIME);
+  gettimeofday(&start, NULL);
+  avl_build(&at, aptrs, NTIME);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for avl_build()\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  gettimeofday(&start, NULL);
+  avl_flatten(&at, aptrs, NTIME);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for avl_flatten()\n",
+         NTIME, tdiff(&start, &end) * 1000.0 / NTIME);
+
+  rb_init(&rt, cmp_intptr);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    rb_ins(&rt, &rnodes[i], NULL, 0);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for rb_ins()\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  rb_flatten(&rt, rptrs, NTIME);
+  gettimeofday(&start, NULL);
+  rb_build(&rt, rptrs, NTIME);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for rb_build()\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  gettimeofday(&start, NULL);
+  rb_flatten(&rt, rptrs, NTIME);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for rb_flatten()\n",
+         NTIME, tdiff(&start, &end) * 1000.0 / NTIME);
+
+  st_init(&st, cmp_intptr);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    st_ins(&st, &snodes[i]);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for st_ins()\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  st_flatten(&st, sptrs, NTIME);
+  gettimeofday(&start, NULL);
+  st_build(&st, sptrs, NTIME);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for st_build()\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  gettimeofday(&start, NULL);
+  st_flatten(&st, sptrs, NTIME);
+  gettimeofday(&end, NULL);
+  printf("%u sorted nodes: roughly %f nsec per node for st_flatten()\n",
+         NTIME, tdiff(&start, &end) * 1000.0 / NTIME);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i;
+
+  anodes = malloc(sizeof(struct anode) * NTIME);
+  rnodes = malloc(sizeof(struct rbnode) * NTIME);
+  snodes = malloc(sizeof(struct stnode) * NTIME);
+  aptrs = malloc(sizeof(struct anode *) * NTIME);
+  rptrs = malloc(sizeof(struct rbnode *) * NTIME);
+  sptrs = malloc(sizeof(struct stnode *) * NTIME);
+  abort_unless(anodes && rnodes && snodes && aptrs && rptrs && sptrs);
+  for (i = 0; i < NTIME; ++i) {
+    avl_ninit(&anodes[i], int2ptr(i * 2 + 1));
+    rb_ninit(&rnodes[i], int2ptr(i * 2 + 1));
+    st_ninit(&snodes[i], int2ptr(i * 2 + 1));
+    aptrs[i] = &anodes[i];
+    rptrs[i] = &rnodes[i];
+    sptrs[i] = &snodes[i];
+  }
+
+  check();
+  timeit();
+
+  free(sptrs);
+  free(rptrs);
+  free(aptrs);
+  free(snodes);
+  free(rnodes);
+  free(anodes);
+  return 0;
+}
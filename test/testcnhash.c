@@ -0,0 +1,224 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <cat/cnhash.h>
+#include <cat/stduse.h>
+
+#define NKEYS		65536
+#define NLOOKUPS	(4 * 1024 * 1024)
+#define MAXTHR		64
+
+char *keys[NKEYS];
+struct cnhtab *cnt;
+struct chtab *cht;
+pthread_mutex_t chlock = PTHREAD_MUTEX_INITIALIZER;
+volatile int stop;
+
+
+struct reader {
+  pthread_t thr;
+  int locked;
+  unsigned seed;
+  ulong found;
+};
+
+
+void *reader(void *arg)
+{
+  struct reader *r = arg;
+  int i, k;
+  void *d;
+
+  for (i = 0; i < NLOOKUPS; ++i) {
+    k = rand_r(&r->seed) % NKEYS;
+    if (r->locked) {
+      pthread_mutex_lock(&chlock);
+      d = cht_get(cht, keys[k]);
+      pthread_mutex_unlock(&chlock);
+    } else {
+      d = cnht_get(cnt, keys[k]);
+    }
+    if (d != NULL)
+      ++r->found;
+  }
+  return NULL;
+}
+
+
+/* repeatedly deletes and re-adds keys so readers race with reclamation */
+void *writer(void *arg)
+{
+  int locked = *(int *)arg;
+  unsigned seed = 12345;
+  int k;
+
+  while (!stop) {
+    k = rand_r(&seed) % NKEYS;
+    if (locked) {
+      pthread_mutex_lock(&chlock);
+      cht_del(cht, keys[k]);
+      cht_put(cht, keys[k], keys[k]);
+      pthread_mutex_unlock(&chlock);
+    } else {
+      cnht_del(cnt, keys[k]);
+      cnht_put(cnt, keys[k], keys[k]);
+    }
+  }
+  return NULL;
+}
+
+
+double run(int nthr, int locked, int churn)
+{
+  struct reader r[MAXTHR];
+  pthread_t w;
+  struct timeval start, end;
+  double sec;
+  int i;
+
+  stop = 0;
+  if (churn)
+    pthread_create(&w, NULL, writer, &locked);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nthr; ++i) {
+    r[i].locked = locked;
+    r[i].seed = i + 1;
+    r[i].found = 0;
+    pthread_create(&r[i].thr, NULL, reader, &r[i]);
+  }
+  for (i = 0; i < nthr; ++i)
+    pthread_join(r[i].thr, NULL);
+  gettimeofday(&end, NULL);
+
+  if (churn) {
+    stop = 1;
+    pthread_join(w, NULL);
+  }
+
+  sec = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+  return (double)nthr * NLOOKUPS / sec;
+}
+
+
+void check_correct()
+{
+  int i;
+
+  for (i = 0; i < NKEYS; ++i)
+    if (cnht_get(cnt, keys[i]) != keys[i]) {
+      printf("key %s missing or wrong\n", keys[i]);
+      exit(1);
+    }
+  if (cnht_put(cnt, keys[0], keys[1]) != 1 ||
+      cnht_get(cnt, keys[0]) != keys[1] ||
+      cnht_del(cnt, keys[0]) != keys[1] ||
+      cnht_get(cnt, keys[0]) != NULL ||
+      cnht_put(cnt, keys[0], keys[0]) != 0) {
+    printf("put/del semantics are wrong\n");
+    exit(1);
+  }
+  printf("Concurrent hash table basic checks passed\n");
+}
+
+
+#define NTABLES		2048
+struct cnhtab *tables[NTABLES];
+
+void *use_tables(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NTABLES; ++i)
+    if (tables[i] != NULL && cnht_get(tables[i], keys[i]) != keys[i])
+      return arg;
+  return NULL;
+}
+
+
+/* more live tables than PTHREAD_KEYS_MAX, used by a thread that exits */
+void check_many()
+{
+  pthread_t t;
+  void *rv;
+  int i;
+
+  for (i = 0; i < NTABLES; ++i) {
+    tables[i] = cnht_new(16, &cnht_std_attr_skey, NULL, 0);
+    if (tables[i] == NULL) {
+      printf("unable to create table %d\n", i);
+      exit(1);
+    }
+    cnht_put(tables[i], keys[i], keys[i]);
+  }
+  for (i = 0; i < NTABLES; i += 2) {
+    cnht_free(tables[i]);
+    tables[i] = NULL;
+  }
+  if (pthread_create(&t, NULL, use_tables, &t) != 0 ||
+      pthread_join(t, &rv) != 0 || rv != NULL ||
+      use_tables(&t) != NULL) {
+    printf("lookups in many tables failed\n");
+    exit(1);
+  }
+  for (i = 1; i < NTABLES; i += 2) {
+    cnht_del(tables[i], keys[i]);
+    cnht_free(tables[i]);
+    tables[i] = NULL;
+  }
+  printf("Checks with %d live tables passed\n", NTABLES);
+}
+
+
+int main(int argc, char *argv[])
+{
+  int i, n, maxthr, churn;
+  char buf[32];
+
+  maxthr = sysconf(_SC_NPROCESSORS_ONLN);
+  if (maxthr < 1)
+    maxthr = 1;
+  if (maxthr > MAXTHR)
+    maxthr = MAXTHR;
+
+  cnt = cnht_new(NKEYS, &cnht_std_attr_skey, NULL, 1);
+  cht = cht_new(NKEYS, &cht_std_attr_skey, NULL, 1);
+  for (i = 0; i < NKEYS; ++i) {
+    sprintf(buf, "key%d", i);
+    keys[i] = strdup(buf);
+    cnht_put(cnt, keys[i], keys[i]);
+    cht_put(cht, keys[i], keys[i]);
+  }
+
+  check_correct();
+  check_many();
+
+  for (churn = 0; churn <= 1; ++churn) {
+    printf("\n%s:\n", churn ? "With a writer deleting and re-adding keys" :
+           "Read only");
+    for (n = 1; n <= maxthr; n *= 2) {
+      printf("%2d threads: %12.0f lookups/sec lock-free, "
+             "%12.0f lookups/sec global mutex\n", n, run(n, 0, churn),
+             run(n, 1, churn));
+      if (n < maxthr && n * 2 > maxthr)
+        n = maxthr / 2;
+    }
+  }
+
+  cnht_free(cnt);
+  cht_free(cht);
+  for (i = 0; i < NKEYS; ++i)
+    free(keys[i]);
+
+  return 0;
+}
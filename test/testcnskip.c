@@ -0,0 +1,321 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <cat/cnskip.h>
+#include <cat/stduse.h>
+#include <cat/err.h>
+
+#define NKEYS		65536
+#define NOPS		(1024 * 1024)
+#define MAXTHR		64
+#define NCHURN		4
+#define STABLE		16	/* every STABLE'th key never changes */
+#define NSAME		4	/* threads fighting over the same keys */
+#define NSAMEKEYS	8
+
+struct cnslist *csl;
+struct crbtree *crb;
+pthread_mutex_t rblock = PTHREAD_MUTEX_INITIALIZER;
+volatile int stop;
+
+
+struct worker {
+  pthread_t thr;
+  int id;
+  int locked;
+  unsigned seed;
+  ulong found;
+  char present[NKEYS];
+};
+
+
+/* 90% lookups, 5% inserts and 5% deletes of uniformly random keys */
+void *mixed(void *arg)
+{
+  struct worker *w = arg;
+  int i, k, op;
+  void *key;
+
+  for (i = 0; i < NOPS; ++i) {
+    k = rand_r(&w->seed) % NKEYS;
+    op = rand_r(&w->seed) % 20;
+    key = int2ptr(k + 1);
+    if (w->locked) {
+      pthread_mutex_lock(&rblock);
+      if (op == 0)
+        crb_put(crb, key, key);
+      else if (op == 1)
+        crb_del(crb, key);
+      else if (crb_get(crb, key) != NULL)
+        ++w->found;
+      pthread_mutex_unlock(&rblock);
+    } else {
+      if (op == 0)
+        cnsl_put(csl, key, key);
+      else if (op == 1)
+        cnsl_del(csl, key);
+      else if (cnsl_get(csl, key) != NULL)
+        ++w->found;
+    }
+  }
+  return NULL;
+}
+
+
+double run(int nthr, int locked)
+{
+  static struct worker w[MAXTHR];
+  struct timeval start, end;
+  double sec;
+  int i;
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nthr; ++i) {
+    w[i].locked = locked;
+    w[i].seed = i + 1;
+    w[i].found = 0;
+    pthread_create(&w[i].thr, NULL, mixed, &w[i]);
+  }
+  for (i = 0; i < nthr; ++i)
+    pthread_join(w[i].thr, NULL);
+  gettimeofday(&end, NULL);
+
+  sec = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+  return (double)nthr * NOPS / sec;
+}
+
+
+/* each churner owns the keys k where k % NCHURN == id */
+void *churn(void *arg)
+{
+  struct worker *w = arg;
+  int i, k, rv;
+  void *d;
+
+  for (i = 0; i < NOPS; ++i) {
+    k = rand_r(&w->seed) % (NKEYS / NCHURN) * NCHURN + w->id;
+    if (k % STABLE == 0)
+      continue;
+    if (rand_r(&w->seed) % 2) {
+      rv = cnsl_put(csl, int2ptr(k + 1), int2ptr(k + 1));
+      if (rv != w->present[k])
+        err("cnsl_put: returned %d for key %d\n", rv, k);
+      w->present[k] = 1;
+    } else {
+      d = cnsl_del(csl, int2ptr(k + 1));
+      if ((d != NULL) != w->present[k])
+        err("cnsl_del: wrong result for key %d\n", k);
+      w->present[k] = 0;
+    }
+  }
+  return NULL;
+}
+
+
+/* walk the list while it changes:  order must hold and no stable key */
+/* may go missing */
+void *walker(void *arg)
+{
+  struct cnsl_cursor c;
+  ulong *nwalks = arg;
+  long k, last;
+  int valid;
+
+  while (!stop) {
+    last = -1;
+    for (valid = cnsl_first(csl, &c); valid; valid = cnsl_next(&c)) {
+      k = ptr2int(c.key) - 1;
+      if (k <= last || c.data != c.key)
+        err("cnsl cursor: key %ld after %ld\n", k, last);
+      for (++last; last < k; ++last)
+        if (last % STABLE == 0)
+          err("cnsl cursor: skipped stable key %ld\n", last);
+    }
+    cnsl_cfini(&c);
+    for (++last; last < NKEYS; ++last)
+      if (last % STABLE == 0)
+        err("cnsl cursor: missed stable key %ld at the end\n", last);
+    ++*nwalks;
+  }
+  return NULL;
+}
+
+
+void check_concurrent()
+{
+  static struct worker w[NCHURN];
+  struct cnsl_cursor c;
+  pthread_t wt;
+  ulong nwalks = 0;
+  int i, k, valid;
+
+  csl = cnsl_new(&cnsl_std_attr_pkey, 1);
+  for (k = 0; k < NKEYS; k += STABLE)
+    cnsl_put(csl, int2ptr(k + 1), int2ptr(k + 1));
+
+  stop = 0;
+  pthread_create(&wt, NULL, walker, &nwalks);
+  for (i = 0; i < NCHURN; ++i) {
+    w[i].id = i;
+    w[i].seed = i + 100;
+    memset(w[i].present, 0, sizeof(w[i].present));
+    for (k = i; k < NKEYS; k += NCHURN)
+      w[i].present[k] = (k % STABLE == 0);
+    pthread_create(&w[i].thr, NULL, churn, &w[i]);
+  }
+  for (i = 0; i < NCHURN; ++i)
+    pthread_join(w[i].thr, NULL);
+  stop = 1;
+  pthread_join(wt, NULL);
+
+  /* the final contents must match what the churners think is there */
+  k = -1;
+  for (valid = cnsl_lbound(csl, int2ptr(1), &c); valid; valid = cnsl_next(&c)) {
+    for (++k; k < ptr2int(c.key) - 1; ++k)
+      if (w[k % NCHURN].present[k])
+        err("cnsl: key %d missing at the end\n", k);
+    if (!w[k % NCHURN].present[k])
+      err("cnsl: key %d should have been deleted\n", k);
+  }
+  cnsl_cfini(&c);
+  for (++k; k < NKEYS; ++k)
+    if (w[k % NCHURN].present[k])
+      err("cnsl: key %d missing at the end\n", k);
+
+  cnsl_free(csl);
+  printf("Concurrent skiplist checks passed (%lu walks during churn)\n",
+         nwalks);
+}
+
+
+/* delete and re-insert the same few keys from every thread at once */
+void *samekey(void *arg)
+{
+  struct worker *w = arg;
+  void *key;
+  int i;
+
+  for (i = 0; i < NOPS / 4; ++i) {
+    key = int2ptr(rand_r(&w->seed) % NSAMEKEYS + 1);
+    if (rand_r(&w->seed) % 2)
+      cnsl_put(csl, key, key);
+    else
+      cnsl_del(csl, key);
+  }
+  return NULL;
+}
+
+
+void check_samekey()
+{
+  static struct worker w[NSAME];
+  struct cnslnode *n, *next;
+  long last;
+  int i, lvl;
+
+  csl = cnsl_new(&cnsl_std_attr_pkey, 1);
+  for (i = 0; i < NSAME; ++i) {
+    w[i].seed = i + 200;
+    pthread_create(&w[i].thr, NULL, samekey, &w[i]);
+  }
+  for (i = 0; i < NSAME; ++i)
+    pthread_join(w[i].thr, NULL);
+
+  /* once quiet no level may still link a deleted (and freed) node */
+  for (lvl = 0; lvl < CNSL_MAXLVL; ++lvl) {
+    last = 0;
+    for (n = csl->head->next[lvl]; n != NULL; n = next) {
+      next = n->next[lvl];
+      if (((ulong)next & 1) || ((ulong)n->next[0] & 1) ||
+          ptr2int(n->key) <= last)
+        err("cnsl: level %d links a deleted or duplicate key %ld\n", lvl,
+            ptr2int(n->key));
+      last = ptr2int(n->key);
+    }
+  }
+  cnsl_free(csl);
+  printf("Same key delete/re-insert checks passed\n");
+}
+
+
+void check_basic()
+{
+  struct cnsl_cursor c;
+  char buf[32];
+  int i, valid;
+
+  csl = cnsl_new(&cnsl_std_attr_skey, 1);
+  for (i = 999; i >= 0; --i) {
+    sprintf(buf, "key%04d", i);
+    if (cnsl_put(csl, buf, int2ptr(i + 1)) != 0)
+      err("cnsl_put: key %d reported as present\n", i);
+  }
+  if (cnsl_put(csl, "key0007", int2ptr(100)) != 1 ||
+      cnsl_get(csl, "key0007") != int2ptr(100) ||
+      cnsl_del(csl, "key0007") != int2ptr(100) ||
+      cnsl_get(csl, "key0007") != NULL ||
+      cnsl_del(csl, "key0007") != NULL)
+    err("cnsl: replace/delete semantics wrong\n");
+
+  i = 500;
+  for (valid = cnsl_lbound(csl, "key0499x", &c); valid; valid = cnsl_next(&c)) {
+    sprintf(buf, "key%04d", i);
+    if (strcmp(c.key, buf) != 0 || c.data != int2ptr(i + 1))
+      err("cnsl cursor: expected %s got %s\n", buf, (char *)c.key);
+    ++i;
+  }
+  cnsl_cfini(&c);
+  if (i != 1000)
+    err("cnsl cursor: stopped at %d\n", i);
+  cnsl_free(csl);
+  printf("Skiplist basic checks passed\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+  int k, n, maxthr;
+
+  if (argc > 1)
+    maxthr = atoi(argv[1]);
+  else
+    maxthr = sysconf(_SC_NPROCESSORS_ONLN);
+  if (maxthr < 1)
+    maxthr = 1;
+  if (maxthr > MAXTHR)
+    maxthr = MAXTHR;
+
+  check_basic();
+  check_concurrent();
+  check_samekey();
+
+  csl = cnsl_new(&cnsl_std_attr_pkey, 1);
+  crb = crb_new(&crb_std_attr_pkey, 1);
+  for (k = 0; k < NKEYS; k += 2) {
+    cnsl_put(csl, int2ptr(k + 1), int2ptr(k + 1));
+    crb_put(crb, int2ptr(k + 1), int2ptr(k + 1));
+  }
+
+  printf("\n90%% lookups, 5%% inserts, 5%% deletes on %d keys:\n", NKEYS);
+  for (n = 1; n <= maxthr; n *= 2) {
+    printf("%2d threads: %12.0f ops/sec lock-free skiplist, "
+           "%12.0f ops/sec rbtree + mutex\n", n, run(n, 0), run(n, 1));
+    if (n < maxthr && n * 2 > maxthr)
+      n = maxthr / 2;
+  }
+
+  cnsl_free(csl);
+  crb_free(crb);
+
+  return 0;
+}
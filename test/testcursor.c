@@ -0,0 +1,292 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+#include <cat/splay.h>
+#include <cat/stduse.h>
+
+#define NCHECK		2000
+#define NTIME		(256 * 1024)
+#define NRANGE		4096
+#define RANGELEN	100
+
+struct anode anodes[NCHECK];
+struct rbnode rnodes[NCHECK];
+struct stnode snodes[NCHECK];
+char present[NCHECK];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* the expected result of a bound search in the presence table or -1 */
+static int bound(int k, int strict)
+{
+  if (k < 0)
+    k = 0;
+  else if (strict)
+    ++k;
+  while (k < NCHECK && !present[k])
+    ++k;
+  return k < NCHECK ? k : -1;
+}
+
+
+#define NKEY(n)	((n) == NULL ? -1 : (int)ptr2int((n)->key))
+
+static void verify(struct avltree *at, struct rbtree *rt, struct sptree *st)
+{
+  struct anode *an;
+  struct rbnode *rn;
+  struct stnode *sn;
+  int k, lb, ub, last;
+
+  for (k = -1; k <= NCHECK; ++k) {
+    lb = bound(k, 0);
+    ub = bound(k, 1);
+    if (NKEY(avl_lbound(at, int2ptr(k))) != lb ||
+        NKEY(rb_lbound(rt, int2ptr(k))) != lb ||
+        NKEY(st_lbound(st, int2ptr(k))) != lb)
+      err("lbound(%d): expected %d\n", k, lb);
+    if (NKEY(avl_ubound(at, int2ptr(k))) != ub ||
+        NKEY(rb_ubound(rt, int2ptr(k))) != ub ||
+        NKEY(st_ubound(st, int2ptr(k))) != ub)
+      err("ubound(%d): expected %d\n", k, ub);
+  }
+
+  last = -1;
+  an = avl_getmin(at);
+  rn = rb_getmin(rt);
+  sn = st_getmin(st);
+  while (an != NULL) {
+    if (NKEY(an) != bound(last, 1) || NKEY(rn) != NKEY(an) ||
+        NKEY(sn) != NKEY(an))
+      err("next: expected %d after %d\n", bound(last, 1), last);
+    last = NKEY(an);
+    an = avl_next(an);
+    rn = rb_next(rn);
+    sn = st_next(sn);
+  }
+  if (rn != NULL || sn != NULL || bound(last, 1) != -1)
+    err("next: walk ended early after %d\n", last);
+
+  an = avl_getmax(at);
+  rn = rb_getmax(rt);
+  sn = st_getmax(st);
+  for (k = NCHECK - 1; k >= 0; --k) {
+    if (!present[k])
+      continue;
+    if (NKEY(an) != k || NKEY(rn) != k || NKEY(sn) != k)
+      err("prev: expected %d\n", k);
+    an = avl_prev(an);
+    rn = rb_prev(rn);
+    sn = st_prev(sn);
+  }
+  if (an != NULL || rn != NULL || sn != NULL)
+    err("prev: walk went past the first node\n");
+}
+
+
+void check()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct sptree st;
+  int i, k;
+
+  avl_init(&at, cmp_intptr);
+  rb_init(&rt, cmp_intptr);
+  st_init(&st, cmp_intptr);
+  for (k = 0; k < NCHECK; ++k) {
+    avl_ninit(&anodes[k], int2ptr(k));
+    rb_ninit(&rnodes[k], int2ptr(k));
+    st_ninit(&snodes[k], int2ptr(k));
+  }
+  verify(&at, &rt, &st);
+  for (i = 0; i < 8; ++i) {
+    for (k = 0; k < NCHECK; ++k) {
+      if (random() % 2 == present[k])
+        continue;
+      if (present[k]) {
+        avl_rem(&anodes[k]);
+        rb_rem(&rnodes[k]);
+        st_rem(&snodes[k]);
+      } else {
+        avl_ins(&at, &anodes[k], NULL, 0);
+        rb_ins(&rt, &rnodes[k], NULL, 0);
+        st_ins(&st, &snodes[k]);
+      }
+      present[k] = !present[k];
+    }
+    verify(&at, &rt, &st);
+  }
+  printf("Tree cursor checks passed\n");
+}
+
+
+void checkstd()
+{
+  struct cavltree *at;
+  struct crbtree *rt;
+  struct cstree *st;
+  struct anode *an;
+  struct rbnode *rn;
+  struct stnode *sn;
+  int k;
+
+  at = cavl_new(&cavl_std_attr_pkey, 1);
+  rt = crb_new(&crb_std_attr_pkey, 1);
+  st = cst_new(&cst_std_attr_pkey, 1);
+  for (k = 10; k <= 100; k += 10) {
+    cavl_put(at, int2ptr(k), int2ptr(k + 1));
+    crb_put(rt, int2ptr(k), int2ptr(k + 1));
+    cst_put(st, int2ptr(k), int2ptr(k + 1));
+  }
+
+  /* delete while walking a range:  step first, then delete */
+  an = cavl_lbound(at, int2ptr(25));
+  rn = crb_lbound(rt, int2ptr(25));
+  sn = cst_lbound(st, int2ptr(25));
+  for (k = 30; k <= 60; k += 10) {
+    if (ptr2int(cavl_key(an)) != k || cavl_data(an) != int2ptr(k + 1) ||
+        ptr2int(crb_key(rn)) != k || crb_data(rn) != int2ptr(k + 1) ||
+        ptr2int(cst_key(sn)) != k || cst_data(sn) != int2ptr(k + 1))
+      err("std cursor: expected key %d\n", k);
+    an = cavl_next(at, an);
+    rn = crb_next(rt, rn);
+    sn = cst_next(st, sn);
+    cavl_del(at, int2ptr(k));
+    crb_del(rt, int2ptr(k));
+    cst_del(st, int2ptr(k));
+  }
+  if (cavl_ubound(at, int2ptr(20)) != an || crb_ubound(rt, int2ptr(20)) != rn ||
+      cst_ubound(st, int2ptr(20)) != sn || ptr2int(cavl_key(an)) != 70)
+    err("std cursor: ubound after deletes\n");
+  if (cavl_prev(at, an) != cavl_lbound(at, int2ptr(20)) ||
+      ptr2int(cavl_key(cavl_last(at))) != 100 ||
+      ptr2int(crb_key(crb_first(rt))) != 10 ||
+      cst_prev(st, cst_first(st)) != NULL)
+    err("std cursor: first/last/prev\n");
+
+  cst_free(st);
+  crb_free(rt);
+  cavl_free(at);
+  printf("Managed tree cursor checks passed\n");
+}
+
+
+static ulong ncmp;
+
+static int cmp_count(const void *a, const void *b)
+{
+  ++ncmp;
+  return cmp_intptr(a, b);
+}
+
+
+/* a past-the-end bound must still splay or a degenerate tree stays O(n) */
+void checkdegen()
+{
+  struct sptree st;
+  struct stnode *sn;
+  int i, k, dir;
+
+  st_init(&st, cmp_count);
+  for (k = NCHECK - 1; k >= 0; --k) {
+    st_ninit(&snodes[k], int2ptr(k));
+    st_ins(&st, &snodes[k]);
+  }
+  if (st_getroot(&st) != &snodes[0] || snodes[0].st_right == NULL)
+    err("degenerate splay tree: bad shape\n");
+
+  ncmp = 0;
+  for (i = 0; i < NCHECK; ++i) {
+    if (st_lbound(&st, int2ptr(NCHECK)) != NULL ||
+        st_ubound(&st, int2ptr(NCHECK - 1)) != NULL)
+      err("degenerate splay tree: bound past the end\n");
+  }
+  if (st_getroot(&st) != &snodes[NCHECK - 1])
+    err("degenerate splay tree: past-the-end bound did not splay\n");
+  sn = st_lkup_dir(&st, int2ptr(-1), &dir);
+  if (sn != &snodes[0] || dir != CST_L)
+    err("degenerate splay tree: bad miss location\n");
+  st_lkup_miss(&st, sn);
+  for (i = 0; i < NCHECK; ++i) {
+    sn = st_lkup_dir(&st, int2ptr(-1), &dir);
+    st_lkup_miss(&st, sn);
+  }
+  if (st_getroot(&st) != &snodes[0])
+    err("degenerate splay tree: missed lookup did not splay\n");
+  if (ncmp > 10 * NCHECK)
+    err("degenerate splay tree: %lu compares for %d searches\n", ncmp,
+        3 * NCHECK);
+  printf("Degenerate splay bound checks passed\n");
+}
+
+
+static void count(void *n, void *ctx)
+{
+  ++*(ulong *)ctx;
+}
+
+
+void timeit()
+{
+  struct avltree at;
+  struct anode *nodes, *an;
+  struct timeval start, end;
+  ulong sum;
+  uint i, j;
+
+  nodes = malloc(sizeof(struct anode) * NTIME);
+  abort_unless(nodes);
+  avl_init(&at, cmp_intptr);
+  for (i = 0; i < NTIME; ++i) {
+    avl_ninit(&nodes[i], int2ptr(random()));
+    avl_ins(&at, &nodes[i], NULL, 0);
+  }
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NRANGE; ++i) {
+    an = avl_lbound(&at, nodes[random() % NTIME].key);
+    for (j = 0; an != NULL && j < RANGELEN; ++j, an = avl_next(an))
+      sum += ptr2uint(an->key);
+  }
+  gettimeofday(&end, NULL);
+  printf("%u nodes: roughly %f nsec per %d item range scan with avl_next()"
+         " (%lu)\n", NTIME, tdiff(&start, &end) * 1000.0 / NRANGE, RANGELEN,
+         sum);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NRANGE / 64; ++i)
+    avl_apply(&at, count, &sum);
+  gettimeofday(&end, NULL);
+  printf("%u nodes: roughly %f nsec per full avl_apply() (%lu)\n", NTIME,
+         tdiff(&start, &end) * 1000.0 / (NRANGE / 64), sum);
+
+  free(nodes);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  checkstd();
+  checkdegen();
+  timeit();
+  return 0;
+}
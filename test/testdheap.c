@@ -0,0 +1,284 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/heap.h>
+#include <cat/dheap.h>
+
+#define NCHECK		3000
+#define NTIME		(1024 * 1024)
+#define NBATCH		64
+
+/* what a scheduler queues:  a deadline and the task it belongs to */
+struct event {
+  ulong when;
+  void *task;
+};
+
+/* the hold model:  each extracted event comes back this much later */
+#define HOLD(i)		((ulong)(((i) * 2654435761u) % 1000000))
+
+struct event *evs;
+ulong *keys;
+ulong ksum;			/* sum of the keys */
+ulong hsum;			/* sum of the keys the hold runs extracted */
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmpev(const void *a, const void *b)
+{
+  ulong x = ((const struct event *)a)->when;
+  ulong y = ((const struct event *)b)->when;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/*
+ * Random adds (single and batched), removals from the middle and
+ * extractions checked against a count of the live keys.  Each heap
+ * starts out tiny and fixed size and then grows through 'stdmm'.
+ */
+static void check(uint arity)
+{
+  static uint cnt[NCHECK];
+  static struct event batch[NBATCH];
+  struct dheap hp;
+  struct event e, *top;
+  ulong last;
+  uint i, j, n, live;
+  byte_t mem[DH_MEMLEN(4, 8, sizeof(struct event))];
+
+  memset(cnt, 0, sizeof(cnt));
+  dh_init(&hp, mem, sizeof(mem), arity, sizeof(struct event), cmpev, NULL);
+  if (hp.size < 4)
+    err("DH_MEMLEN(4) only holds %u elements\n", hp.size);
+  e.when = 0;
+  for (i = 0; i < hp.size; ++i)
+    if (dh_add(&hp, &e, NULL) < 0)
+      err("add into a fixed heap with room failed\n");
+  if (dh_add(&hp, &e, NULL) == 0)
+    err("fixed size heap grew\n");
+
+  dh_init(&hp, NULL, 0, arity, sizeof(struct event), cmpev, &stdmm);
+  live = 0;
+  for (i = 0; i < NCHECK * 4; ++i) {
+    switch (random() % 5) {
+    case 0:
+    case 1:
+      e.when = random() % NCHECK;
+      e.task = NULL;
+      if (dh_add(&hp, &e, &n) < 0 ||
+          ((struct event *)dh_elem(&hp, n))->when != e.when)
+        err("add of %lu failed\n", e.when);
+      ++cnt[e.when];
+      ++live;
+      break;
+    case 2:
+      /* sometimes as big as the heap to take the rebuild path */
+      n = random() % (live < NBATCH ? live + 1 : NBATCH);
+      for (j = 0; j < n; ++j) {
+        batch[j].when = random() % NCHECK;
+        ++cnt[batch[j].when];
+      }
+      if (dh_add_n(&hp, batch, n) < 0)
+        err("batch add of %u failed\n", n);
+      live += n;
+      break;
+    case 3:
+      if (live == 0)
+        break;
+      if (dh_rem(&hp, random() % live, &e) < 0 || cnt[e.when] == 0)
+        err("remove returned a missing element %lu\n", e.when);
+      --cnt[e.when];
+      --live;
+      break;
+    default:
+      top = dh_top(&hp);
+      if (dh_extract(&hp, &e) < 0) {
+        if (live != 0 || top != NULL)
+          err("extract from a non-empty heap failed\n");
+        break;
+      }
+      for (j = 0; j < e.when; ++j)
+        if (cnt[j] != 0)
+          err("extracted %lu while %u is in the heap\n", e.when, j);
+      if (cnt[e.when] == 0)
+        err("extracted a missing element %lu\n", e.when);
+      --cnt[e.when];
+      --live;
+      break;
+    }
+    if (hp.fill != live)
+      err("heap holds %u elements instead of %u\n", hp.fill, live);
+  }
+
+  last = 0;
+  while ((n = dh_extract_n(&hp, batch, NBATCH)) > 0) {
+    for (j = 0; j < n; ++j) {
+      if (batch[j].when < last || cnt[batch[j].when] == 0)
+        err("batch extract returned %lu after %lu\n", batch[j].when, last);
+      --cnt[batch[j].when];
+      last = batch[j].when;
+    }
+    live -= n;
+  }
+  if (live != 0 || dh_top(&hp) != NULL)
+    err("%u elements left in the heap\n", live);
+  mem_free(&stdmm, hp.mem);
+  printf("%u-ary heap checks passed\n", arity);
+}
+
+
+static void timehp(void)
+{
+  struct heap hp;
+  struct event *ev;
+  void **elems;
+  struct timeval start, end;
+  ulong sum = 0;
+  uint i;
+
+  elems = malloc(NTIME * sizeof(*elems));
+  if (!elems)
+    err("out of memory\n");
+  for (i = 0; i < NTIME; ++i)
+    evs[i].when = keys[i];
+  hp_init(&hp, elems, NTIME, 0, cmpev, NULL);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    hp_add(&hp, &evs[i], NULL);
+  for (i = 0; i < NTIME; ++i) {
+    ev = hp_extract(&hp);
+    sum += ev->when;
+  }
+  gettimeofday(&end, NULL);
+  printf("  heap (pointers):      roughly %f nsec per element\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  if (sum != ksum)
+    err("heap timing runs gave wrong results\n");
+
+  sum = 0;
+  hp_init(&hp, elems, NTIME, 0, cmpev, NULL);
+  for (i = 0; i < NTIME; ++i)
+    hp_add(&hp, &evs[i], NULL);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    ev = hp_extract(&hp);
+    sum += ev->when;
+    ev->when += HOLD(i);
+    hp_add(&hp, ev, NULL);
+  }
+  gettimeofday(&end, NULL);
+  printf("  heap (pointers):      roughly %f nsec per extract+add at %u\n",
+         tdiff(&start, &end) * 1000.0 / NTIME, NTIME);
+  hsum = sum;
+
+  free(elems);
+}
+
+
+static void timedh(uint arity)
+{
+  struct dheap hp;
+  struct event e, *batch;
+  struct timeval start, end;
+  ulong sum = 0;
+  uint i, j;
+
+  batch = malloc(NBATCH * sizeof(*batch));
+  if (!batch)
+    err("out of memory\n");
+  dh_init(&hp, NULL, 0, arity, sizeof(struct event), cmpev, &stdmm);
+  if (dh_reserve(&hp, NTIME) < 0)
+    err("out of memory\n");
+  for (i = 0; i < NTIME; ++i)
+    evs[i].when = keys[i];
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    dh_add(&hp, &evs[i], NULL);
+  for (i = 0; i < NTIME; ++i) {
+    dh_extract(&hp, &e);
+    sum += e.when;
+  }
+  gettimeofday(&end, NULL);
+  printf("  %u-ary heap (values):  roughly %f nsec per element\n",
+         arity, tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; i += NBATCH)
+    dh_add_n(&hp, &evs[i], NBATCH);
+  for (i = 0; i < NTIME; i += NBATCH) {
+    dh_extract_n(&hp, batch, NBATCH);
+    for (j = 0; j < NBATCH; ++j)
+      sum -= batch[j].when;
+  }
+  gettimeofday(&end, NULL);
+  printf("  %u-ary heap (batched): roughly %f nsec per element\n",
+         arity, tdiff(&start, &end) * 1000.0 / NTIME);
+
+  if (sum != 0)
+    err("%u-ary heap timing runs gave wrong results\n", arity);
+
+  dh_add_n(&hp, evs, NTIME);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    dh_extract(&hp, &e);
+    sum += e.when;
+    e.when += HOLD(i);
+    dh_add(&hp, &e, NULL);
+  }
+  gettimeofday(&end, NULL);
+  printf("  %u-ary heap (values):  roughly %f nsec per extract+add at %u\n",
+         arity, tdiff(&start, &end) * 1000.0 / NTIME, NTIME);
+  hp.fill = 0;
+
+  if (sum != hsum)
+    err("%u-ary heap hold run disagrees with the pointer heap\n", arity);
+  mem_free(&stdmm, hp.mem);
+  free(batch);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i;
+
+  check(2);
+  check(4);
+  check(8);
+
+  evs = malloc(NTIME * sizeof(*evs));
+  keys = malloc(NTIME * sizeof(*keys));
+  if (!evs || !keys)
+    err("out of memory\n");
+  for (i = 0; i < NTIME; ++i) {
+    keys[i] = random();
+    ksum += keys[i];
+    evs[i].task = &evs[i];
+  }
+
+  printf("Priority queues (%u events):\n", NTIME);
+  timehp();
+  timedh(2);
+  timedh(4);
+  timedh(8);
+  free(evs);
+  free(keys);
+  return 0;
+}
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <sys/time.h>
 #include <cat/hash.h>
+#include <cat/ohash.h>
 #include <cat/stduse.h>
 
 #define NUMSTR 4
@@ -18,6 +19,9 @@
 
 struct htab t; 
 struct hnode *buckets[128 * 1024];
+struct ohtab ot;
+struct ohslot oslots[128 * 1024];
+uchar octl[OHT_CTLLEN(128 * 1024)];
 
 void timeit()
 {
@@ -103,6 +107,364 @@ void timeit()
 }
 
 
+#define TIMESTART() gettimeofday(&start, NULL)
+#define TIMEEND(_what)							     \
+  do {									     \
+    gettimeofday(&end, NULL);						     \
+    usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;\
+    usec /= NITER;							     \
+    printf("Roughly %f nsec for %s w/%d elem\n", usec * 1000, _what, NOPS);  \
+    fflush(stdout);							     \
+  } while (0)
+
+void timeoht()
+{
+  static struct hnode nodes[NOPS];
+  static char *keys[NOPS], *misses[NOPS];
+  static struct ohslot *islots[NOPS];
+  static int order[NOPS];
+  struct ohslot *s;
+  int i, j, k;
+  struct timeval start, end;
+  double usec;
+  uint h;
+
+  ht_init(&t, buckets, array_length(buckets), cmp_str, ht_shash, NULL);
+  oht_init(&ot, oslots, octl, array_length(oslots), cmp_str, ht_shash, NULL);
+
+  for (i = 0; i < NOPS; i++) {
+    keys[i] = str_fmt_a("node%d", i);
+    misses[i] = str_fmt_a("miss%d", i);
+    ht_ninit(&nodes[i], keys[i]);
+    order[i] = i;
+  }
+
+  /* look keys up in random order so node layout doesn't help either table */
+  srand(1);
+  for (i = NOPS - 1; i > 0; i--) {
+    j = rand() % (i + 1);
+    k = order[i];
+    order[i] = order[j];
+    order[j] = k;
+  }
+
+  TIMESTART();
+  for (j = 0; j < NITER / NOPS; j++) {
+    for (i = 0; i < NOPS; i++) {
+      if (ht_lkup(&t, keys[i], &h))
+        err("iteration %d: duplicate node for key %d found\n", j, i);
+      ht_ins(&t, &nodes[i], h);
+    }
+    if (j < NITER / NOPS - 1)
+      for (i = 0; i < NOPS; i++)
+        ht_rem(&nodes[i]);
+  }
+  TIMEEND("chained insert");
+
+  TIMESTART();
+  for (j = 0; j < NITER / NOPS; j++) {
+    for (i = 0; i < NOPS; i++) {
+      if (oht_lkup(&ot, keys[i], &h))
+        err("iteration %d: duplicate slot for key %d found\n", j, i);
+      islots[i] = oht_ins(&ot, keys[i], keys[i], h);
+    }
+    if (j < NITER / NOPS - 1)
+      for (i = 0; i < NOPS; i++)
+        oht_rem(&ot, islots[i]);
+  }
+  TIMEEND("open addressing insert");
+
+  TIMESTART();
+  for (j = 0; j < NITER / NOPS; j++)
+    for (i = 0; i < NOPS; i++)
+      if (ht_lkup(&t, keys[order[i]], NULL) != &nodes[order[i]])
+        err("ht_lkup: key %d not found\n", order[i]);
+  TIMEEND("ht_lkup() hit");
+
+  TIMESTART();
+  for (j = 0; j < NITER / NOPS; j++)
+    for (i = 0; i < NOPS; i++) {
+      k = order[i];
+      if ((s = oht_lkup(&ot, keys[k], NULL)) == NULL || s->data != keys[k])
+        err("oht_lkup: key %d not found\n", k);
+    }
+  TIMEEND("oht_lkup() hit");
+
+  TIMESTART();
+  for (j = 0; j < NITER / NOPS; j++)
+    for (i = 0; i < NOPS; i++)
+      if (ht_lkup(&t, misses[order[i]], NULL) != NULL)
+        err("ht_lkup: found missing key %d\n", i);
+  TIMEEND("ht_lkup() miss");
+
+  TIMESTART();
+  for (j = 0; j < NITER / NOPS; j++)
+    for (i = 0; i < NOPS; i++)
+      if (oht_lkup(&ot, misses[order[i]], NULL) != NULL)
+        err("oht_lkup: found missing key %d\n", i);
+  TIMEEND("oht_lkup() miss");
+
+  for (i = 0; i < NOPS; i++) {
+    ht_rem(&nodes[i]);
+    oht_rem(&ot, oht_lkup(&ot, keys[i], NULL));
+    if (oht_lkup(&ot, keys[i], NULL) != NULL)
+      err("oht_rem: key %d still present\n", i);
+    free(keys[i]);
+    free(misses[i]);
+  }
+}
+
+
+void testcoht()
+{
+  struct cohtab *table;
+  char *key;
+  int i;
+
+  table = coht_new(0, NULL, NULL, 1);
+  for (i = 0; i < NOPS; i++) {
+    key = str_fmt_a("node%d", i);
+    if (coht_put(table, key, int2ptr(i + 1)) != 0)
+      err("coht_put: failed to add key %d\n", i);
+    free(key);
+  }
+  for (i = 0; i < NOPS; i += 2) {
+    key = str_fmt_a("node%d", i);
+    if (coht_del(table, key) != int2ptr(i + 1))
+      err("coht_del: wrong data for key %d\n", i);
+    free(key);
+  }
+  for (i = 0; i < NOPS; i++) {
+    key = str_fmt_a("node%d", i);
+    if (coht_get(table, key) != ((i & 1) ? int2ptr(i + 1) : NULL))
+      err("coht_get: wrong data for key %d\n", i);
+    free(key);
+  }
+  printf("coht: %u entries in %u slots after %d puts and %d deletes\n",
+         table->table.fill, table->table.nslots, NOPS, NOPS / 2);
+  coht_free(table);
+}
+
+
+static void print_cht_stats(struct chtab *table, const char *when)
+{
+  struct cht_stats st;
+  cht_stats(table, &st);
+  printf("%s: fill=%lu nbkts=%u load=%u%% old_nbkts=%u cursor=%u "
+         "maxchain=%u\n", when, (ulong)st.fill, st.nbkts, st.load,
+         st.old_nbkts, st.mcursor, st.maxchain);
+}
+
+
+void testchtresize()
+{
+  struct chtab *table;
+  static char *keys[NOPS * 4];
+  struct timeval start, end;
+  double usec, maxusec = 0.0;
+  int i, n = array_length(keys);
+
+  table = cht_new(16, NULL, NULL, 1);
+  cht_set_resize(table, CHT_DEF_MAXLOAD, CHT_DEF_MINLOAD);
+
+  for (i = 0; i < n; i++) {
+    keys[i] = str_fmt_a("node%d", i);
+    gettimeofday(&start, NULL);
+    cht_put(table, keys[i], keys[i]);
+    gettimeofday(&end, NULL);
+    usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+    if (usec > maxusec)
+      maxusec = usec;
+    if (i == n / 2)
+      print_cht_stats(table, "half full");
+  }
+  print_cht_stats(table, "full");
+  printf("Longest single cht_put() with resizing: %f usec\n", maxusec);
+
+  for (i = 0; i < n; i++)
+    if (cht_get(table, keys[i]) != keys[i])
+      err("cht_get: key %d missing after resize\n", i);
+
+  for (i = 0; i < n - 100; i++)
+    if (cht_del(table, keys[i]) != keys[i])
+      err("cht_del: key %d missing\n", i);
+  for (i = 0; i < 16; i++)
+    cht_get(table, keys[n - 1]);
+  print_cht_stats(table, "after deletes");
+
+  for (i = n - 100; i < n; i++)
+    if (cht_get(table, keys[i]) != keys[i])
+      err("cht_get: key %d missing after shrink\n", i);
+
+  cht_free(table);
+  for (i = 0; i < n; i++)
+    free(keys[i]);
+}
+
+
+#define NHBKTS 1024
+
+static double chisq(hash_f hf, void *keys[], int nkeys)
+{
+  static uint counts[NHBKTS];
+  double exp = (double)nkeys / NHBKTS, d, x = 0.0;
+  int i;
+
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < nkeys; i++)
+    ++counts[(*hf)(keys[i], NULL) & (NHBKTS - 1)];
+  for (i = 0; i < NHBKTS; i++) {
+    d = counts[i] - exp;
+    x += d * d / exp;
+  }
+  /* normalize by degrees of freedom:  ~1.0 means uniform */
+  return x / (NHBKTS - 1);
+}
+
+
+static void hash_tput(const char *name, hash_f hf, struct raw *r)
+{
+  struct timeval start, end;
+  double usec;
+  uint h = 0;
+  int i, n = (64 * 1024 * 1024) / r->len;
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < n; i++)
+    h += (*hf)(r, NULL);
+  gettimeofday(&end, NULL);
+  usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+  printf("%s: %5lu byte keys: %8.1f MB/s, %6.1f nsec/key (%x)\n", name,
+         (ulong)r->len, (double)n * r->len / usec, usec * 1000 / n, h & 1);
+}
+
+
+void testhashfuncs()
+{
+  static void *skeys[NOPS], *ikeys[NOPS], *pkeys[NOPS];
+  static byte_t buf[4096];
+  static size_t lens[] = { 8, 16, 32, 64, 256, 4096 };
+  struct raw r;
+  int i;
+
+  for (i = 0; i < NOPS; i++) {
+    skeys[i] = str_fmt_a("node%d", i);
+    ikeys[i] = int2ptr(i);
+    pkeys[i] = int2ptr(i * 16);
+  }
+
+  printf("chi-squared/dof over %d buckets (1.0 is uniform):\n", NHBKTS);
+  printf("  strings:  ht_shash %f, ht_fshash %f\n",
+         chisq(ht_shash, skeys, NOPS), chisq(ht_fshash, skeys, NOPS));
+  printf("  integers: ht_ihash %f, ht_fihash %f\n",
+         chisq(ht_ihash, ikeys, NOPS), chisq(ht_fihash, ikeys, NOPS));
+  printf("  pointers: ht_phash %f, ht_fihash %f\n",
+         chisq(ht_phash, pkeys, NOPS), chisq(ht_fihash, pkeys, NOPS));
+
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = i * 7 + 1;
+  r.data = buf;
+  for (i = 0; i < array_length(lens); i++) {
+    r.len = lens[i];
+    hash_tput("ht_rhash ", ht_rhash, &r);
+    hash_tput("ht_frhash", ht_frhash, &r);
+  }
+
+  for (i = 0; i < NOPS; i++)
+    free(skeys[i]);
+}
+
+
+#define NBATCH	64
+#define NBLKUP	(4 * 1024 * 1024)
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* single vs batched lookups for tables that outgrow L2 and then the LLC */
+void timebatch()
+{
+  static uint sizes[] = { 16 * 1024, 256 * 1024, 4 * 1024 * 1024 };
+  struct htab bt;
+  struct hnode **bkts, *nodes, *res[NBATCH];
+  struct chtab *cht;
+  void **keys, *data[NBATCH];
+  struct timeval start, end;
+  double single, batch;
+  uint i, j, k, n;
+
+  keys = malloc(sizeof(void *) * NBLKUP);
+  abort_unless(keys != NULL);
+
+  for (k = 0; k < array_length(sizes); ++k) {
+    n = sizes[k];
+    bkts = malloc(sizeof(struct hnode *) * n);
+    nodes = malloc(sizeof(struct hnode) * n);
+    abort_unless(bkts != NULL && nodes != NULL);
+    ht_init(&bt, bkts, n, cmp_intptr, ht_fihash, NULL);
+    cht = cht_new(n, &cht_std_attr_pkey, NULL, 1);
+    for (i = 0; i < n; ++i) {
+      ht_ninit(&nodes[i], int2ptr(i + 1));
+      ht_ins_h(&bt, &nodes[i]);
+      cht_put(cht, int2ptr(i + 1), &nodes[i]);
+    }
+    for (i = 0; i < NBLKUP; ++i)
+      keys[i] = int2ptr(random() % n + 1);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NBLKUP; ++i)
+      if (ht_lkup(&bt, keys[i], NULL) == NULL)
+        err("ht_lkup: key %lu missing\n", (ulong)ptr2uint(keys[i]));
+    gettimeofday(&end, NULL);
+    single = tdiff(&start, &end) * 1000.0 / NBLKUP;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NBLKUP; i += NBATCH) {
+      ht_lkup_batch(&bt, keys + i, NBATCH, res, NULL);
+      for (j = 0; j < NBATCH; ++j)
+        if (res[j] == NULL || res[j]->key != keys[i + j])
+          err("ht_lkup_batch: key %lu missing\n",
+              (ulong)ptr2uint(keys[i + j]));
+    }
+    gettimeofday(&end, NULL);
+    batch = tdiff(&start, &end) * 1000.0 / NBLKUP;
+    printf("%8u entries: roughly %f nsec per ht_lkup(), %f nsec per key "
+           "with ht_lkup_batch()\n", n, single, batch);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NBLKUP; ++i)
+      if (cht_get(cht, keys[i]) == NULL)
+        err("cht_get: key %lu missing\n", (ulong)ptr2uint(keys[i]));
+    gettimeofday(&end, NULL);
+    single = tdiff(&start, &end) * 1000.0 / NBLKUP;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NBLKUP; i += NBATCH) {
+      cht_get_batch(cht, keys + i, NBATCH, data);
+      for (j = 0; j < NBATCH; ++j)
+        if (data[j] != &nodes[ptr2uint(keys[i + j]) - 1])
+          err("cht_get_batch: key %lu missing\n",
+              (ulong)ptr2uint(keys[i + j]));
+    }
+    gettimeofday(&end, NULL);
+    batch = tdiff(&start, &end) * 1000.0 / NBLKUP;
+    printf("%8u entries: roughly %f nsec per cht_get(), %f nsec per key "
+           "with cht_get_batch()\n", n, single, batch);
+    fflush(stdout);
+
+    cht_free(cht);
+    free(nodes);
+    free(bkts);
+  }
+
+  free(keys);
+}
+
+
 int main() 
 { 
   int i;
@@ -155,6 +517,11 @@ int main()
   cht_free(table); 
 
   timeit();
+  testcoht();
+  testchtresize();
+  testhashfuncs();
+  timeoht();
+  timebatch();
 
   return 0;
 } 
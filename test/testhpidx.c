@@ -0,0 +1,201 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/heap.h>
+
+#define NCHECK		2000
+#define NTMR		(16 * 1024)
+#define NFIND		(16 * 1024)
+#define NTIME		(1024 * 1024)
+
+/* a timer that knows where it is in the heap */
+struct tmr {
+  ulong when;
+  int hpos;
+};
+
+struct tmr tmrs[NTMR];
+void *elems[NTMR];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmptmr(const void *a, const void *b)
+{
+  ulong x = ((const struct tmr *)a)->when;
+  ulong y = ((const struct tmr *)b)->when;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+static void chkpos(struct heap *hp)
+{
+  int i;
+
+  for (i = 0; i < hp->fill; ++i)
+    if (hp_pos(hp, hp->elem[i]) != i)
+      err("element at %d thinks it is at %d\n", i, hp_pos(hp, hp->elem[i]));
+  for (i = 0; i < hp->fill; ++i)
+    if (i > 0 && cmptmr(hp->elem[(i - 1) / 2], hp->elem[i]) > 0)
+      err("heap order broken at %d\n", i);
+}
+
+
+/*
+ * Random adds, cancels, reschedules (up and down) and expirations with
+ * the positions and heap order checked after every step.
+ */
+static void check(void)
+{
+  static struct tmr t[NCHECK];
+  static uchar in[NCHECK];
+  struct heap hp;
+  struct tmr *tp;
+  int i, n, live = 0;
+  ulong last;
+
+  for (i = 0; i < NCHECK / 2; ++i) {
+    t[i].when = random() % 10000;
+    elems[i] = &t[i];
+    in[i] = 1;
+    ++live;
+  }
+  /* start with some elements to make sure hp_set_posoff() catches up */
+  hp_init(&hp, elems, NTMR, NCHECK / 2, cmptmr, NULL);
+  hp_set_posoff(&hp, offsetof(struct tmr, hpos));
+  for (i = NCHECK / 2; i < NCHECK; ++i)
+    t[i].hpos = -1;
+  chkpos(&hp);
+
+  for (i = 0; i < NCHECK * 10; ++i) {
+    n = random() % NCHECK;
+    tp = &t[n];
+    switch (random() % 4) {
+    case 0:
+      if (in[n])
+        break;
+      tp->when = random() % 10000;
+      if (hp_add(&hp, tp, NULL) < 0)
+        err("add failed\n");
+      in[n] = 1;
+      ++live;
+      break;
+    case 1:
+      if (!in[n]) {
+        if (hp_pos(&hp, tp) != -1)
+          err("removed timer %d still has a position\n", n);
+        break;
+      }
+      if (hp_rem(&hp, hp_pos(&hp, tp)) != tp)
+        err("cancel of %d removed the wrong timer\n", n);
+      in[n] = 0;
+      --live;
+      break;
+    case 2:
+      if (!in[n])
+        break;
+      tp->when = random() % 10000;
+      if (hp_update(&hp, hp_pos(&hp, tp)) != hp_pos(&hp, tp))
+        err("update of %d returned the wrong position\n", n);
+      break;
+    default:
+      last = (hp.fill > 0) ? ((struct tmr *)hp.elem[0])->when : 0;
+      tp = hp_extract(&hp);
+      if (tp == NULL)
+        break;
+      if (tp->when != last || hp_pos(&hp, tp) != -1)
+        err("expired the wrong timer\n");
+      in[tp - t] = 0;
+      --live;
+      break;
+    }
+    if (hp.fill != live)
+      err("heap holds %d timers instead of %d\n", hp.fill, live);
+    chkpos(&hp);
+  }
+  printf("Indexed heap checks passed\n");
+}
+
+
+static void fill(struct heap *hp, int indexed)
+{
+  int i;
+
+  hp_init(hp, elems, NTMR, 0, cmptmr, NULL);
+  if (indexed)
+    hp_set_posoff(hp, offsetof(struct tmr, hpos));
+  for (i = 0; i < NTMR; ++i) {
+    /* keys stay unique (modulo NTMR) so hp_find() finds the right one */
+    tmrs[i].when = i;
+    hp_add(hp, &tmrs[i], NULL);
+  }
+}
+
+
+/* cancel and re-arm random timers in a heap of NTMR timers */
+static void timeit(void)
+{
+  struct heap hp;
+  struct timeval start, end;
+  struct tmr *tp;
+  int i;
+
+  printf("Cancel + re-arm of random timers among %d:\n", NTMR);
+
+  fill(&hp, 0);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NFIND; ++i) {
+    tp = &tmrs[random() % NTMR];
+    hp_rem(&hp, hp_find(&hp, tp));
+    tp->when += NTMR;
+    hp_add(&hp, tp, NULL);
+  }
+  gettimeofday(&end, NULL);
+  printf("  hp_find + hp_rem + hp_add: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NFIND);
+
+  fill(&hp, 1);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    tp = &tmrs[random() % NTMR];
+    hp_rem(&hp, hp_pos(&hp, tp));
+    tp->when += NTMR;
+    hp_add(&hp, tp, NULL);
+  }
+  gettimeofday(&end, NULL);
+  printf("  hp_pos + hp_rem + hp_add:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  fill(&hp, 1);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    tp = &tmrs[random() % NTMR];
+    tp->when += NTMR;
+    hp_update(&hp, hp_pos(&hp, tp));
+  }
+  gettimeofday(&end, NULL);
+  printf("  hp_pos + hp_update:        roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  chkpos(&hp);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  timeit();
+  return 0;
+}
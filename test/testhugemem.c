@@ -0,0 +1,417 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <cat/err.h>
+#include <cat/mem.h>
+#include <cat/dynmem.h>
+#include <cat/hugemem.h>
+#include <cat/stduse.h>
+
+#define POOLSZ		(16 * 1024 * 1024)
+#define NSLOTS		1024
+#define NCHECK		(256 * 1024)
+#define NTIME		(1024 * 1024)
+#define NODESZ		64
+#define NNODES		(2 * 1024 * 1024)
+#define NCHASE		(16 * 1024 * 1024)
+#define BIGPOOL		((size_t)NNODES * 2 * NODESZ + HM_PGSIZE)
+
+struct slot {
+  byte_t *p;
+  size_t len;
+};
+
+struct walk {
+  int prevalloc;
+  ulong npools;
+  ulong nalloc;
+  ulong nfree;
+};
+
+struct node {
+  struct node *next;
+  byte_t pad[NODESZ - sizeof(struct node *)];
+};
+
+struct slot slots[NSLOTS];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* alignments from below the unit size up to a few pages */
+static size_t ralign(void)
+{
+  return (size_t)1 << (random() % 14);
+}
+
+
+static size_t rsize(void)
+{
+  if (random() % 16 == 0)
+    return random() % 65536 + 1;
+  return random() % 512 + 1;
+}
+
+
+static void fill(struct slot *s)
+{
+  size_t i;
+  for (i = 0; i < s->len; ++i)
+    s->p[i] = (byte_t)((s - slots) + i);
+}
+
+
+static void verify(struct slot *s, size_t len)
+{
+  size_t i;
+  for (i = 0; i < len; ++i)
+    if (s->p[i] != (byte_t)((s - slots) + i))
+      err("slot %u corrupted at byte %lu\n", (uint)(s - slots), (ulong)i);
+}
+
+
+static void walkblk(int allocated, int prevalloc, struct walk *w)
+{
+  if (prevalloc != w->prevalloc)
+    err("block has the wrong previous allocated flag\n");
+  if (!allocated && !w->prevalloc)
+    err("two adjacent free blocks\n");
+  w->prevalloc = allocated;
+  if (allocated)
+    ++w->nalloc;
+  else
+    ++w->nfree;
+}
+
+
+static void tlsfblk(void *obj, void *ctx)
+{
+  struct tlsf_block_fake *b = obj;
+  walkblk(b->allocated, b->prev_allocated, ctx);
+}
+
+
+static void tlsfpool(void *obj, void *ctx)
+{
+  ((struct walk *)ctx)->prevalloc = 1;
+  ((struct walk *)ctx)->npools += 1;
+  tlsf_each_block(obj, tlsfblk, ctx);
+}
+
+
+static void dynblk(void *obj, void *ctx)
+{
+  struct dynmem_block_fake *b = obj;
+  walkblk(b->allocated, b->prev_allocated, ctx);
+}
+
+
+static void dynpool(void *obj, void *ctx)
+{
+  ((struct walk *)ctx)->prevalloc = 1;
+  ((struct walk *)ctx)->npools += 1;
+  dynmem_each_block(obj, dynblk, ctx);
+}
+
+
+/*
+ * Random aligned allocations, reallocations and frees on a TLSF heap
+ * (dm == NULL) or a dynmem heap.  The heap must stay consistent and
+ * must merge back into one free block per pool when all are freed.
+ */
+static void check_heap(struct tlsf *t, struct dynmem *dm, const char *name)
+{
+  struct walk w;
+  struct slot *s;
+  size_t align, len;
+  void *p;
+  uint i;
+
+  memset(slots, 0, sizeof(slots));
+  for (i = 0; i < NCHECK; ++i) {
+    s = &slots[random() % NSLOTS];
+    if (s->p != NULL) {
+      verify(s, s->len);
+      if (random() % 4 == 0) {
+        len = rsize();
+        p = dm ? dynmem_realloc(dm, s->p, len) : tlsf_realloc(t, s->p, len);
+        if (p == NULL)
+          err("%s: out of memory\n", name);
+        s->p = p;
+        verify(s, (len < s->len) ? len : s->len);
+        s->len = len;
+        fill(s);
+      } else {
+        if (dm)
+          dynmem_free(dm, s->p);
+        else
+          tlsf_free(t, s->p);
+        s->p = NULL;
+      }
+      continue;
+    }
+    align = ralign();
+    s->len = rsize();
+    s->p = dm ? dynmem_memalign(dm, align, s->len) :
+                tlsf_memalign(t, align, s->len);
+    if (s->p == NULL)
+      err("%s: out of memory\n", name);
+    if (((ulong)s->p & (align - 1)) != 0)
+      err("%s: %p is not aligned to %lu\n", name, s->p, (ulong)align);
+    if (!dm && tlsf_usable_size(s->p) < s->len)
+      err("%s: usable size is short\n", name);
+    fill(s);
+  }
+
+  memset(&w, 0, sizeof(w));
+  if (dm)
+    dynmem_each_pool(dm, dynpool, &w);
+  else
+    tlsf_each_pool(t, tlsfpool, &w);
+  for (i = 0; i < NSLOTS; ++i) {
+    s = &slots[i];
+    if (s->p == NULL)
+      continue;
+    verify(s, s->len);
+    if (dm)
+      dynmem_free(dm, s->p);
+    else
+      tlsf_free(t, s->p);
+    s->p = NULL;
+  }
+
+  memset(&w, 0, sizeof(w));
+  if (dm)
+    dynmem_each_pool(dm, dynpool, &w);
+  else
+    tlsf_each_pool(t, tlsfpool, &w);
+  if (w.nalloc != 0 || w.nfree != w.npools)
+    err("%s: %lu allocated and %lu free blocks after freeing all\n", name,
+        w.nalloc, w.nfree);
+}
+
+
+static void check(void)
+{
+  struct tlsf t;
+  struct dynmem dm;
+  struct hugemem hm;
+  void *pool, *p;
+  size_t align;
+  uint i;
+
+  pool = emalloc(POOLSZ);
+  tlsf_init(&t);
+  tlsf_add_pool(&t, pool, POOLSZ);
+  check_heap(&t, NULL, "tlsf");
+  free(pool);
+
+  pool = emalloc(POOLSZ);
+  dynmem_init(&dm);
+  dynmem_add_pool(&dm, pool, POOLSZ);
+  check_heap(NULL, &dm, "dynmem");
+  free(pool);
+
+  for (i = 0; i < NSLOTS; ++i) {
+    align = ralign();
+    slots[i].len = rsize();
+    slots[i].p = mem_get_aligned(&estdmm, align, slots[i].len);
+    if (slots[i].p == NULL)
+      err("mem_get_aligned: out of memory\n");
+    if (((ulong)slots[i].p & (align - 1)) != 0)
+      err("mem_get_aligned: %p is not aligned to %lu\n", slots[i].p,
+          (ulong)align);
+    fill(&slots[i]);
+  }
+  for (i = 0; i < NSLOTS; ++i) {
+    verify(&slots[i], slots[i].len);
+    mem_free_aligned(&estdmm, slots[i].p);
+  }
+
+  tlsf_init(&t);
+  hm_init(&hm, &t);
+  if (hm_add_pool(&hm, POOLSZ) < 0 || hm_add_pool(&hm, 1) < 0)
+    err("hm_add_pool failed\n");
+  if (hm.npools != 2 || hm.mapped != POOLSZ + 2 * HM_PGSIZE)
+    err("huge page pools have the wrong size\n");
+  p = tlsf_memalign(&t, HM_PGSIZE, POOLSZ / 2);
+  if (p == NULL || ((ulong)p & (HM_PGSIZE - 1)) != 0)
+    err("could not allocate a huge page aligned block\n");
+  memset(p, 0x5a, POOLSZ / 2);
+  tlsf_free(&t, p);
+  check_heap(&t, NULL, "huge page tlsf");
+  hm_fini(&hm);
+
+  printf("Aligned allocation checks passed\n");
+}
+
+
+static void time_alloc(void)
+{
+  struct tlsf t;
+  struct timeval start, end;
+  void *pool;
+  uint i, k;
+
+  printf("Allocate and free 64 to 576 bytes (%u ops):\n", NTIME);
+  for (k = 0; k < NSLOTS; ++k) {
+    slots[k].p = NULL;
+    slots[k].len = random() % 512 + 64;
+  }
+  pool = emalloc(POOLSZ);
+  tlsf_init(&t);
+  tlsf_add_pool(&t, pool, POOLSZ);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = i * 2654435761u % NSLOTS;
+    if (slots[k].p != NULL) {
+      tlsf_free(&t, slots[k].p);
+      slots[k].p = NULL;
+    } else {
+      slots[k].p = tlsf_malloc(&t, slots[k].len);
+    }
+  }
+  gettimeofday(&end, NULL);
+  printf("  tlsf_malloc: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  for (k = 0; k < NSLOTS; ++k) {
+    tlsf_free(&t, slots[k].p);
+    slots[k].p = NULL;
+  }
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = i * 2654435761u % NSLOTS;
+    if (slots[k].p != NULL) {
+      tlsf_free(&t, slots[k].p);
+      slots[k].p = NULL;
+    } else {
+      slots[k].p = tlsf_memalign(&t, 64, slots[k].len);
+    }
+  }
+  gettimeofday(&end, NULL);
+  printf("  tlsf_memalign(64): roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  for (k = 0; k < NSLOTS; ++k) {
+    tlsf_free(&t, slots[k].p);
+    slots[k].p = NULL;
+  }
+  free(pool);
+}
+
+
+/* bytes of this process' memory in transparent huge pages if known */
+static long thp_kb(void)
+{
+  char line[256];
+  long kb = -1;
+  FILE *fp;
+
+  if ((fp = fopen("/proc/self/smaps_rollup", "r")) == NULL)
+    return -1;
+  while (fgets(line, sizeof(line), fp) != NULL)
+    if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+      break;
+  fclose(fp);
+  return kb;
+}
+
+
+/*
+ * Chase pointers through a random cycle of cache line sized nodes
+ * allocated from 't'.  Nearly every step touches a different page so
+ * with base pages nearly every step misses the TLB.
+ */
+static void chase(struct tlsf *t, const char *name)
+{
+  struct node **nodes, *n;
+  struct timeval start, end;
+  ulong i, j;
+
+  nodes = emalloc(sizeof(*nodes) * NNODES);
+  for (i = 0; i < NNODES; ++i) {
+    nodes[i] = tlsf_memalign(t, NODESZ, sizeof(struct node));
+    if (nodes[i] == NULL)
+      err("%s: out of memory\n", name);
+    if (((ulong)nodes[i] & (NODESZ - 1)) != 0)
+      err("%s: node is not aligned\n", name);
+  }
+  for (i = NNODES - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    n = nodes[i];
+    nodes[i] = nodes[j];
+    nodes[j] = n;
+  }
+  for (i = 0; i < NNODES; ++i)
+    nodes[i]->next = nodes[(i + 1) % NNODES];
+
+  n = nodes[0];
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NCHASE; ++i)
+    n = n->next;
+  gettimeofday(&end, NULL);
+  if (n == NULL)
+    err("broken cycle\n");
+  printf("  %s: roughly %f nsec per access", name,
+         tdiff(&start, &end) * 1000.0 / NCHASE);
+  if (thp_kb() >= 0)
+    printf(", %ld kB in huge pages", thp_kb());
+  printf("\n");
+
+  for (i = 0; i < NNODES; ++i)
+    tlsf_free(t, nodes[i]);
+  free(nodes);
+}
+
+
+static void time_access(void)
+{
+  struct tlsf t;
+  struct hugemem hm;
+  void *pool;
+
+  printf("Random pointer chasing over %u %u-byte nodes (%u steps):\n",
+         NNODES, NODESZ, NCHASE);
+
+  /* the same mapping without the huge page request */
+  pool = hm_map(BIGPOOL, NULL);
+  if (pool == NULL)
+    err("unable to map %lu bytes\n", (ulong)BIGPOOL);
+#ifdef MADV_NOHUGEPAGE
+  madvise(pool, BIGPOOL, MADV_NOHUGEPAGE);
+#endif
+  tlsf_init(&t);
+  tlsf_add_pool(&t, pool, BIGPOOL);
+  chase(&t, "base pages");
+  hm_unmap(pool, BIGPOOL);
+
+  tlsf_init(&t);
+  hm_init(&hm, &t);
+  if (hm_add_pool(&hm, BIGPOOL) < 0)
+    err("unable to map %lu bytes\n", (ulong)BIGPOOL);
+  chase(&t, hm.nadvised ? "huge pages" : "huge pages (not supported)");
+  hm_fini(&hm);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  time_alloc();
+  time_access();
+  return 0;
+}
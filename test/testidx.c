@@ -0,0 +1,484 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+#include <cat/hash.h>
+#include <cat/iavl.h>
+#include <cat/irbtree.h>
+#include <cat/ihash.h>
+
+#define NCHECK		2000
+#define NTIME		(1024 * 1024)
+#define NBKTS		(1024 * 1024)
+
+struct aelem {
+  struct anode n;
+  uint key;
+};
+
+struct relem {
+  struct rbnode n;
+  uint key;
+};
+
+struct helem {
+  struct hnode n;
+  uint key;
+};
+
+struct iaelem {
+  struct ianode n;
+  uint key;
+};
+
+struct irelem {
+  struct irbnode n;
+  uint key;
+};
+
+struct ihelem {
+  struct ihnode n;
+  uint key;
+};
+
+uint *keys;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmpu(const void *a, const void *b)
+{
+  uint x = *(const uint *)a, y = *(const uint *)b;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+static uint hashu(const void *k, void *unused)
+{
+  return ht_hashbytes(k, sizeof(uint), 0);
+}
+
+
+static void countelem(void *e, void *ctx)
+{
+  ++*(uint *)ctx;
+}
+
+
+/* returns the height of 'n' checking balance factors and parent links */
+static int iavl_check(struct iavltree *t, uint32_t n)
+{
+  struct ianode *nn;
+  int lh, rh;
+
+  if (n == IDX_NIL)
+    return 0;
+  nn = iavl_node(t, n);
+  lh = iavl_check(t, nn->p[CA_L]);
+  rh = iavl_check(t, nn->p[CA_R]);
+  if (nn->b != rh - lh || nn->b < -1 || nn->b > 1)
+    err("iavl: bad balance %d (heights %d/%d)\n", nn->b, lh, rh);
+  if ((nn->p[CA_L] != IDX_NIL && iavl_node(t, nn->p[CA_L])->p[CA_P] != n) ||
+      (nn->p[CA_R] != IDX_NIL && iavl_node(t, nn->p[CA_R])->p[CA_P] != n))
+    err("iavl: bad parent link\n");
+  return (lh > rh ? lh : rh) + 1;
+}
+
+
+/* returns the black height of 'n' checking the rb invariants */
+static int irb_check(struct irbtree *t, uint32_t n)
+{
+  struct irbnode *nn;
+  int lh, rh;
+
+  if (n == IDX_NIL)
+    return 1;
+  nn = irb_node(t, n);
+  lh = irb_check(t, nn->p[CRB_L]);
+  rh = irb_check(t, nn->p[CRB_R]);
+  if (lh != rh)
+    err("irb: black heights differ %d/%d\n", lh, rh);
+  if (nn->col == CRB_RED &&
+      ((nn->p[CRB_L] != IDX_NIL && irb_node(t, nn->p[CRB_L])->col == CRB_RED) ||
+       (nn->p[CRB_R] != IDX_NIL && irb_node(t, nn->p[CRB_R])->col == CRB_RED)))
+    err("irb: red node with a red child\n");
+  if ((nn->p[CRB_L] != IDX_NIL && irb_node(t, nn->p[CRB_L])->p[CRB_P] != n) ||
+      (nn->p[CRB_R] != IDX_NIL && irb_node(t, nn->p[CRB_R])->p[CRB_P] != n))
+    err("irb: bad parent link\n");
+  return lh + (nn->col == CRB_BLACK);
+}
+
+
+/*
+ * Run the same random inserts (with duplicate keys) and removals against
+ * the index structures and a presence map, checking the invariants,
+ * lookups and in-order walks along the way.  The element arrays get moved
+ * halfway through to exercise the *_setbase() calls.
+ */
+void check()
+{
+  struct iavltree at;
+  struct irbtree rt;
+  struct ihtab ht;
+  struct iaelem *ae;
+  struct irelem *re;
+  struct ihelem *he;
+  uint32_t *bkts;
+  uint32_t *where;
+  uint32_t x, y, z;
+  uint i, j, k, n, last, cnt;
+  int first;
+
+  ae = calloc(NCHECK, sizeof(*ae));
+  re = calloc(NCHECK, sizeof(*re));
+  he = calloc(NCHECK, sizeof(*he));
+  bkts = calloc(64, sizeof(*bkts));
+  where = malloc(NCHECK * sizeof(*where));
+  if (!ae || !re || !he || !bkts || !where)
+    err("out of memory\n");
+  for (i = 0; i < NCHECK; ++i)
+    where[i] = IDX_NIL;
+
+  iavl_init(&at, cmpu, ae, sizeof(*ae), offsetof(struct iaelem, n),
+            offsetof(struct iaelem, key));
+  irb_init(&rt, cmpu, re, sizeof(*re), offsetof(struct irelem, n),
+           offsetof(struct irelem, key));
+  iht_init(&ht, bkts, 64, cmpu, hashu, NULL, he, sizeof(*he),
+           offsetof(struct ihelem, n), offsetof(struct ihelem, key));
+
+  /* element 'i' has key 'i % (NCHECK / 2)' so half the inserts replace */
+  for (j = 0; j < NCHECK; ++j) {
+    i = random() % NCHECK;
+    k = i % (NCHECK / 2);
+    if (where[k] == i)
+      continue;
+    ae[i].key = re[i].key = he[i].key = k;
+    x = iavl_ins(&at, i);
+    y = irb_ins(&rt, i);
+    z = iht_lkup(&ht, &k, NULL);
+    if (z != IDX_NIL)
+      iht_rem(&ht, z);
+    iht_ins_h(&ht, i);
+    if (x != where[k] || y != where[k] || z != where[k])
+      err("ins: replaced %u/%u/%u instead of %u\n", x, y, z, where[k]);
+    where[k] = i;
+
+    if (j == NCHECK / 2) {
+      ae = realloc(ae, NCHECK * sizeof(*ae));
+      re = realloc(re, NCHECK * sizeof(*re));
+      he = realloc(he, NCHECK * sizeof(*he));
+      if (!ae || !re || !he)
+        err("out of memory\n");
+      iavl_setbase(&at, ae);
+      irb_setbase(&rt, re);
+      iht_setbase(&ht, he);
+    }
+
+    if ((j % 7) == 0) {
+      k = random() % (NCHECK / 2);
+      if (where[k] != IDX_NIL) {
+        iavl_rem(&at, where[k]);
+        irb_rem(&rt, where[k]);
+        iht_rem(&ht, where[k]);
+        where[k] = IDX_NIL;
+      }
+    }
+  }
+
+  iavl_check(&at, at.root);
+  if (irb_check(&rt, rt.root) && rt.root != IDX_NIL &&
+      irb_node(&rt, rt.root)->col != CRB_BLACK)
+    err("irb: red root\n");
+
+  for (k = 0, n = 0; k < NCHECK / 2; ++k) {
+    if (where[k] != IDX_NIL)
+      ++n;
+    if (iavl_lkup(&at, &k, NULL) != where[k] ||
+        irb_lkup(&rt, &k, NULL) != where[k] ||
+        iht_lkup(&ht, &k, NULL) != where[k])
+      err("lkup: wrong element for key %u\n", k);
+  }
+
+  cnt = 0;
+  first = 1;
+  last = 0;
+  for (x = iavl_getmin(&at), y = irb_getmin(&rt); x != IDX_NIL;
+       x = iavl_next(&at, x), y = irb_next(&rt, y)) {
+    if (x != y || (!first && ae[x].key <= last))
+      err("next: walk out of order\n");
+    last = ae[x].key;
+    first = 0;
+    ++cnt;
+  }
+  if (y != IDX_NIL || cnt != n)
+    err("next: walked %u elements instead of %u\n", cnt, n);
+  for (x = iavl_getmax(&at), y = irb_getmax(&rt), cnt = 0; x != IDX_NIL;
+       x = iavl_prev(&at, x), y = irb_prev(&rt, y))
+    if (x != y || ++cnt > n)
+      err("prev: walk out of order\n");
+
+  cnt = 0;
+  iavl_apply(&at, countelem, &cnt);
+  irb_apply(&rt, countelem, &cnt);
+  iht_apply(&ht, countelem, &cnt);
+  if (cnt != 3 * n)
+    err("apply: visited %u elements instead of %u\n", cnt, 3 * n);
+
+  k = NCHECK / 4;
+  if (iavl_lbound(&at, &k) != irb_lbound(&rt, &k) ||
+      iavl_ubound(&at, &k) != irb_ubound(&rt, &k))
+    err("bound searches disagree\n");
+
+  for (k = 0; k < NCHECK / 2; ++k) {
+    if (where[k] != IDX_NIL) {
+      iavl_rem(&at, where[k]);
+      irb_rem(&rt, where[k]);
+      iht_rem(&ht, where[k]);
+      if ((k % 64) == 0) {
+        iavl_check(&at, at.root);
+        irb_check(&rt, rt.root);
+      }
+    }
+  }
+  cnt = 0;
+  iht_apply(&ht, countelem, &cnt);
+  if (!iavl_isempty(&at) || !irb_isempty(&rt) || cnt != 0)
+    err("rem: structures not empty at the end\n");
+
+  free(ae);
+  free(re);
+  free(he);
+  free(bkts);
+  free(where);
+  printf("Index tree and hash checks passed\n");
+}
+
+
+static void report(const char *name, double usec)
+{
+  printf("  %-12s roughly %f nsec per operation\n", name,
+         usec * 1000.0 / NTIME);
+}
+
+
+void timeit()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct htab ht;
+  struct iavltree iat;
+  struct irbtree irt;
+  struct ihtab iht;
+  struct aelem *ae;
+  struct relem *re;
+  struct helem *he;
+  struct iaelem *iae;
+  struct irelem *ire;
+  struct ihelem *ihe;
+  struct hnode **bkts;
+  uint32_t *ibkts;
+  struct timeval start, end;
+  uint i, k;
+
+  printf("Memory per element with a 'uint' key:\n");
+  printf("  avl %u bytes, iavl %u bytes\n", (uint)sizeof(struct aelem),
+         (uint)sizeof(struct iaelem));
+  printf("  rbtree %u bytes, irbtree %u bytes\n", (uint)sizeof(struct relem),
+         (uint)sizeof(struct irelem));
+  printf("  hash %u bytes + %u per bucket, ihash %u bytes + %u per bucket\n",
+         (uint)sizeof(struct helem), (uint)sizeof(struct hnode *),
+         (uint)sizeof(struct ihelem), (uint)sizeof(uint32_t));
+
+  ae = malloc(NTIME * sizeof(*ae));
+  re = malloc(NTIME * sizeof(*re));
+  he = malloc(NTIME * sizeof(*he));
+  iae = malloc(NTIME * sizeof(*iae));
+  ire = malloc(NTIME * sizeof(*ire));
+  ihe = malloc(NTIME * sizeof(*ihe));
+  bkts = malloc(NBKTS * sizeof(*bkts));
+  ibkts = malloc(NBKTS * sizeof(*ibkts));
+  if (!ae || !re || !he || !iae || !ire || !ihe || !bkts || !ibkts)
+    err("out of memory\n");
+
+  for (i = 0; i < NTIME; ++i) {
+    ae[i].key = re[i].key = he[i].key = keys[i];
+    iae[i].key = ire[i].key = ihe[i].key = keys[i];
+    avl_ninit(&ae[i].n, &ae[i].key);
+    rb_ninit(&re[i].n, &re[i].key);
+    ht_ninit(&he[i].n, &he[i].key);
+  }
+  avl_init(&at, cmpu);
+  rb_init(&rt, cmpu);
+  ht_init(&ht, bkts, NBKTS, cmpu, hashu, NULL);
+  iavl_init(&iat, cmpu, iae, sizeof(*iae), offsetof(struct iaelem, n),
+            offsetof(struct iaelem, key));
+  irb_init(&irt, cmpu, ire, sizeof(*ire), offsetof(struct irelem, n),
+           offsetof(struct irelem, key));
+  iht_init(&iht, ibkts, NBKTS, cmpu, hashu, NULL, ihe, sizeof(*ihe),
+           offsetof(struct ihelem, n), offsetof(struct ihelem, key));
+
+  printf("Inserting %u random keys:\n", NTIME);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    avl_ins(&at, &ae[i].n, NULL, 0);
+  gettimeofday(&end, NULL);
+  report("avl", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    iavl_ins(&iat, i);
+  gettimeofday(&end, NULL);
+  report("iavl", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    rb_ins(&rt, &re[i].n, NULL, 0);
+  gettimeofday(&end, NULL);
+  report("rbtree", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    irb_ins(&irt, i);
+  gettimeofday(&end, NULL);
+  report("irbtree", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    ht_ins_h(&ht, &he[i].n);
+  gettimeofday(&end, NULL);
+  report("hash", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    iht_ins_h(&iht, i);
+  gettimeofday(&end, NULL);
+  report("ihash", tdiff(&start, &end));
+
+  printf("Looking up %u random keys:\n", NTIME);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = keys[(i * 7919) % NTIME];
+    if (avl_lkup(&at, &k, NULL) == NULL)
+      err("avl: key %u missing\n", k);
+  }
+  gettimeofday(&end, NULL);
+  report("avl", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = keys[(i * 7919) % NTIME];
+    if (iavl_lkup(&iat, &k, NULL) == IDX_NIL)
+      err("iavl: key %u missing\n", k);
+  }
+  gettimeofday(&end, NULL);
+  report("iavl", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = keys[(i * 7919) % NTIME];
+    if (rb_lkup(&rt, &k, NULL) == NULL)
+      err("rbtree: key %u missing\n", k);
+  }
+  gettimeofday(&end, NULL);
+  report("rbtree", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = keys[(i * 7919) % NTIME];
+    if (irb_lkup(&irt, &k, NULL) == IDX_NIL)
+      err("irbtree: key %u missing\n", k);
+  }
+  gettimeofday(&end, NULL);
+  report("irbtree", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = keys[(i * 7919) % NTIME];
+    if (ht_lkup(&ht, &k, NULL) == NULL)
+      err("hash: key %u missing\n", k);
+  }
+  gettimeofday(&end, NULL);
+  report("hash", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = keys[(i * 7919) % NTIME];
+    if (iht_lkup(&iht, &k, NULL) == IDX_NIL)
+      err("ihash: key %u missing\n", k);
+  }
+  gettimeofday(&end, NULL);
+  report("ihash", tdiff(&start, &end));
+
+  printf("Removing %u elements:\n", NTIME);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    avl_rem(&ae[i].n);
+  gettimeofday(&end, NULL);
+  report("avl", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    iavl_rem(&iat, i);
+  gettimeofday(&end, NULL);
+  report("iavl", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    rb_rem(&re[i].n);
+  gettimeofday(&end, NULL);
+  report("rbtree", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    irb_rem(&irt, i);
+  gettimeofday(&end, NULL);
+  report("irbtree", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    ht_rem(&he[i].n);
+  gettimeofday(&end, NULL);
+  report("hash", tdiff(&start, &end));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    iht_rem(&iht, i);
+  gettimeofday(&end, NULL);
+  report("ihash", tdiff(&start, &end));
+
+  if (!avl_isempty(&at) || !iavl_isempty(&iat) || !rb_isempty(&rt) ||
+      !irb_isempty(&irt))
+    err("trees not empty after removing every element\n");
+
+  free(ae);
+  free(re);
+  free(he);
+  free(iae);
+  free(ire);
+  free(ihe);
+  free(bkts);
+  free(ibkts);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i, j, tmp;
+
+  keys = malloc(NTIME * sizeof(*keys));
+  if (!keys)
+    err("out of memory\n");
+  /* a random permutation keeps every key unique */
+  for (i = 0; i < NTIME; ++i)
+    keys[i] = i * 2654435761u;
+  for (i = NTIME - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+
+  check();
+  timeit();
+  free(keys);
+  return 0;
+}
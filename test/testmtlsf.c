@@ -0,0 +1,244 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/dynmem.h>
+#include <cat/mtlsf.h>
+
+#define POOLSZ		(256 * 1024 * 1024)
+#define NSLOTS		1024
+#define NOPS		(1024 * 1024)
+#define NXFER		(64 * 1024)
+#define MAXTHR		8
+
+struct tlsf tlsf;
+struct mtlsf mt;
+pthread_mutex_t biglock = PTHREAD_MUTEX_INITIALIZER;
+pthread_barrier_t barrier;
+int use_mt;
+void **xfer[MAXTHR];
+int nthr;
+
+
+struct worker {
+  pthread_t thr;
+  int id;
+  unsigned seed;
+};
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static void *get(size_t len)
+{
+  void *p;
+
+  if (use_mt)
+    return mem_get(&mt.mm, len);
+  pthread_mutex_lock(&biglock);
+  p = tlsf_malloc(&tlsf, len);
+  pthread_mutex_unlock(&biglock);
+  return p;
+}
+
+
+static void put(void *p)
+{
+  if (use_mt) {
+    mem_free(&mt.mm, p);
+  } else {
+    pthread_mutex_lock(&biglock);
+    tlsf_free(&tlsf, p);
+    pthread_mutex_unlock(&biglock);
+  }
+}
+
+
+/* mostly small blocks with a few large ones */
+static size_t rsize(unsigned *seed)
+{
+  if (rand_r(seed) % 16 == 0)
+    return MT_MAXSMALL + rand_r(seed) % 4096;
+  return rand_r(seed) % MT_MAXSMALL + 1;
+}
+
+
+static void stamp(void *p, size_t len, ulong tag)
+{
+  memcpy(p, &tag, sizeof(tag));
+  memcpy((char *)p + len - sizeof(tag), &tag, sizeof(tag));
+}
+
+
+static void verify(void *p, size_t len, ulong tag)
+{
+  ulong x, y;
+
+  memcpy(&x, p, sizeof(x));
+  memcpy(&y, (char *)p + len - sizeof(y), sizeof(y));
+  if (x != tag || y != tag)
+    err("block %p of length %lu was corrupted\n", p, (ulong)len);
+}
+
+
+/* random allocations and frees over a set of slots */
+static void churn(struct worker *w)
+{
+  void *slots[NSLOTS];
+  size_t lens[NSLOTS];
+  uint i, k;
+
+  memset(slots, 0, sizeof(slots));
+  for (i = 0; i < NOPS; ++i) {
+    k = rand_r(&w->seed) % NSLOTS;
+    if (slots[k] != NULL) {
+      verify(slots[k], lens[k], (ulong)k ^ w->id);
+      put(slots[k]);
+      slots[k] = NULL;
+    } else {
+      lens[k] = rsize(&w->seed);
+      if (lens[k] < 2 * sizeof(ulong))
+        lens[k] = 2 * sizeof(ulong);
+      if ((slots[k] = get(lens[k])) == NULL)
+        err("out of memory\n");
+      stamp(slots[k], lens[k], (ulong)k ^ w->id);
+    }
+  }
+  for (k = 0; k < NSLOTS; ++k)
+    if (slots[k] != NULL)
+      put(slots[k]);
+}
+
+
+/* every block gets freed by the next thread over */
+static void handoff(struct worker *w)
+{
+  void **mine = xfer[w->id], **theirs = xfer[(w->id + 1) % nthr];
+  uint i;
+
+  for (i = 0; i < NXFER; ++i) {
+    if ((mine[i] = get(sizeof(ulong) * 4)) == NULL)
+      err("out of memory\n");
+    stamp(mine[i], sizeof(ulong) * 4, i);
+  }
+  pthread_barrier_wait(&barrier);
+  for (i = 0; i < NXFER; ++i) {
+    verify(theirs[i], sizeof(ulong) * 4, i);
+    put(theirs[i]);
+  }
+}
+
+
+static void *work(void *arg)
+{
+  struct worker *w = arg;
+
+  churn(w);
+  handoff(w);
+  return NULL;
+}
+
+
+static void countalloc(void *obj, void *ctx)
+{
+  if (((struct tlsf_block_fake *)obj)->allocated)
+    ++*(ulong *)ctx;
+}
+
+
+static void countpool(void *obj, void *ctx)
+{
+  tlsf_each_block(obj, countalloc, ctx);
+}
+
+
+static ulong nallocated(void)
+{
+  ulong n = 0;
+  tlsf_each_pool(&tlsf, countpool, &n);
+  return n;
+}
+
+
+static void run(int n, int mtmode)
+{
+  struct worker w[MAXTHR];
+  struct timeval start, end;
+  ulong base;
+  double usec;
+  int i;
+
+  use_mt = mtmode;
+  nthr = n;
+  base = nallocated();
+  if (use_mt && mtlsf_init(&mt, &tlsf) < 0)
+    err("mtlsf_init failed\n");
+  pthread_barrier_init(&barrier, NULL, n);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < n; ++i) {
+    w[i].id = i;
+    w[i].seed = i + 1;
+    if (pthread_create(&w[i].thr, NULL, work, &w[i]) != 0)
+      err("pthread_create failed\n");
+  }
+  for (i = 0; i < n; ++i)
+    pthread_join(w[i].thr, NULL);
+  gettimeofday(&end, NULL);
+
+  usec = tdiff(&start, &end);
+  if (use_mt) {
+    printf("  mtlsf, %d thread(s): roughly %f nsec per op, "
+           "%f ops per lock\n", n,
+           usec * 1000.0 / ((ulong)(NOPS + 2 * NXFER) * n),
+           (double)(NOPS + 2 * NXFER) * n / mt.nlocks);
+    mtlsf_fini(&mt);
+  } else {
+    printf("  locked tlsf, %d thread(s): roughly %f nsec per op\n", n,
+           usec * 1000.0 / ((ulong)(NOPS + 2 * NXFER) * n));
+  }
+  pthread_barrier_destroy(&barrier);
+
+  if (nallocated() != base)
+    err("%lu blocks leaked\n", nallocated() - base);
+}
+
+
+int main(int argc, char *argv[])
+{
+  void *pool;
+  int i;
+
+  pool = malloc(POOLSZ);
+  if (!pool)
+    err("out of memory\n");
+  for (i = 0; i < MAXTHR; ++i)
+    if ((xfer[i] = malloc(NXFER * sizeof(void *))) == NULL)
+      err("out of memory\n");
+  tlsf_init(&tlsf);
+  tlsf_add_pool(&tlsf, pool, POOLSZ);
+
+  printf("Random allocs and frees and cross thread frees:\n");
+  for (i = 1; i <= MAXTHR; i *= 2) {
+    run(i, 0);
+    run(i, 1);
+  }
+
+  for (i = 0; i < MAXTHR; ++i)
+    free(xfer[i]);
+  free(pool);
+  return 0;
+}
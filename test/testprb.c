@@ -0,0 +1,264 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <cat/prbtree.h>
+#include <cat/stduse.h>
+#include <cat/err.h>
+
+#define NCHECK		2000
+#define NSNAPS		8
+#define NKEYS		65536
+#define NLOOKUPS	(2 * 1024 * 1024)
+#define MAXTHR		64
+
+struct prbtree *prb;
+struct crbtree *crb;
+pthread_mutex_t rblock = PTHREAD_MUTEX_INITIALIZER;
+volatile int stop;
+ulong nfreed;
+
+
+static void count_free(struct prbtree *t, void *d)
+{
+  ++nfreed;
+}
+
+
+/* returns the black height of 'n' checking the left-leaning invariants */
+static int check_llrb(struct prbnode *n, long lo, long hi)
+{
+  int lh, rh;
+
+  if (n == NULL)
+    return 1;
+  if (ptr2int(n->key) <= lo || ptr2int(n->key) >= hi)
+    err("prb: key %ld out of order\n", (long)ptr2int(n->key));
+  if (n->col == PRB_RED && (n->p[0] && n->p[0]->col == PRB_RED))
+    err("prb: red node with a red child\n");
+  if (n->p[1] && n->p[1]->col == PRB_RED)
+    err("prb: right leaning red link\n");
+  lh = check_llrb(n->p[0], lo, ptr2int(n->key));
+  rh = check_llrb(n->p[1], ptr2int(n->key), hi);
+  if (lh != rh)
+    err("prb: black heights differ %d/%d\n", lh, rh);
+  return lh + (n->col == PRB_BLACK);
+}
+
+
+/* the snapshot must hold exactly the keys set in 'present' */
+static void check_snap(struct prbsnap *s, const char *present)
+{
+  struct prb_cursor c;
+  long k = -1;
+  int valid;
+
+  check_llrb(s->root, -1, NCHECK + 2);
+  if (s->root != NULL && s->root->col != PRB_BLACK)
+    err("prb: red root\n");
+  for (valid = prb_sfirst(s, &c); valid; valid = prb_next(&c)) {
+    for (++k; k < ptr2int(prb_ckey(&c)) - 1; ++k)
+      if (present[k])
+        err("prb snapshot: key %ld missing\n", k);
+    if (!present[k] || prb_cdata(&c) != prb_ckey(&c))
+      err("prb snapshot: key %ld should not be present\n", k);
+  }
+  for (++k; k < NCHECK; ++k)
+    if (present[k])
+      err("prb snapshot: key %ld missing at the end\n", k);
+}
+
+
+void check()
+{
+  struct prbtree_attr attr = prb_std_attr_pkey;
+  static char present[NSNAPS + 1][NCHECK];
+  struct prbsnap snaps[NSNAPS];
+  struct prb_cursor c;
+  ulong nputs = 0;
+  int i, j, k, rv;
+
+  attr.data_free = &count_free;
+  prb = prb_new(&attr, 1);
+  for (i = 0; i < NSNAPS; ++i) {
+    for (j = 0; j < NCHECK; ++j) {
+      k = random() % NCHECK;
+      if (random() % 3 != 0) {
+        rv = prb_put(prb, int2ptr(k + 1), int2ptr(k + 1));
+        if (rv != present[NSNAPS][k])
+          err("prb_put: returned %d for key %d\n", rv, k);
+        present[NSNAPS][k] = 1;
+        ++nputs;
+      } else {
+        rv = prb_del(prb, int2ptr(k + 1));
+        if (rv != present[NSNAPS][k])
+          err("prb_del: returned %d for key %d\n", rv, k);
+        present[NSNAPS][k] = 0;
+      }
+      if ((prb_get(prb, int2ptr(k + 1)) != NULL) != present[NSNAPS][k])
+        err("prb_get: wrong result for key %d\n", k);
+    }
+    prb_snap(prb, &snaps[i]);
+    memcpy(present[i], present[NSNAPS], NCHECK);
+  }
+
+  /* every old version must be intact after all the later changes */
+  for (i = 0; i < NSNAPS; ++i) {
+    check_snap(&snaps[i], present[i]);
+    for (k = 0; k < NCHECK; ++k)
+      if ((prb_sget(&snaps[i], int2ptr(k + 1)) != NULL) != present[i][k])
+        err("prb_sget: wrong result for key %d\n", k);
+  }
+
+  k = NCHECK / 2;
+  if (prb_slbound(&snaps[0], int2ptr(k + 1), &c)) {
+    while (!present[0][k])
+      ++k;
+    if (prb_ckey(&c) != int2ptr(k + 1))
+      err("prb_slbound: expected key %d\n", k);
+  }
+
+  for (i = 0; i < NSNAPS; ++i)
+    prb_srelease(&snaps[i]);
+  for (k = 0; k < NCHECK; ++k)
+    prb_del(prb, int2ptr(k + 1));
+  if (prb->root != NULL || prb->nkeys != 0)
+    err("prb: tree not empty after removing all keys\n");
+  prb_free(prb);
+  if (nfreed != nputs)
+    err("prb: %lu entries added but %lu freed\n", nputs, nfreed);
+  printf("Persistent tree and snapshot checks passed\n");
+}
+
+
+struct reader {
+  pthread_t thr;
+  int locked;
+  unsigned seed;
+  ulong found;
+};
+
+
+void *reader(void *arg)
+{
+  struct reader *r = arg;
+  void *key;
+  int i;
+
+  for (i = 0; i < NLOOKUPS; ++i) {
+    key = int2ptr(rand_r(&r->seed) % NKEYS + 1);
+    if (r->locked) {
+      pthread_mutex_lock(&rblock);
+      if (crb_get(crb, key) != NULL)
+        ++r->found;
+      pthread_mutex_unlock(&rblock);
+    } else if (prb_get(prb, key) != NULL) {
+      ++r->found;
+    }
+  }
+  return NULL;
+}
+
+
+/* changes the map now and then like a routing table update */
+void *writer(void *arg)
+{
+  int locked = *(int *)arg;
+  unsigned seed = 12345;
+  void *key;
+
+  while (!stop) {
+    key = int2ptr(rand_r(&seed) % NKEYS + 1);
+    if (locked) {
+      pthread_mutex_lock(&rblock);
+      crb_del(crb, key);
+      crb_put(crb, key, key);
+      pthread_mutex_unlock(&rblock);
+    } else {
+      prb_del(prb, key);
+      prb_put(prb, key, key);
+    }
+    usleep(100);
+  }
+  return NULL;
+}
+
+
+double run(int nthr, int locked)
+{
+  struct reader r[MAXTHR];
+  pthread_t w;
+  struct timeval start, end;
+  double sec;
+  int i;
+
+  stop = 0;
+  pthread_create(&w, NULL, writer, &locked);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < nthr; ++i) {
+    r[i].locked = locked;
+    r[i].seed = i + 1;
+    r[i].found = 0;
+    pthread_create(&r[i].thr, NULL, reader, &r[i]);
+  }
+  for (i = 0; i < nthr; ++i)
+    pthread_join(r[i].thr, NULL);
+  gettimeofday(&end, NULL);
+  stop = 1;
+  pthread_join(w, NULL);
+
+  sec = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+  return (double)nthr * NLOOKUPS / sec;
+}
+
+
+int main(int argc, char *argv[])
+{
+  struct timeval start, end;
+  int k, n, maxthr;
+
+  if (argc > 1)
+    maxthr = atoi(argv[1]);
+  else
+    maxthr = sysconf(_SC_NPROCESSORS_ONLN);
+  if (maxthr < 1)
+    maxthr = 1;
+  if (maxthr > MAXTHR)
+    maxthr = MAXTHR;
+
+  check();
+
+  prb = prb_new(&prb_std_attr_pkey, 1);
+  crb = crb_new(&crb_std_attr_pkey, 1);
+  gettimeofday(&start, NULL);
+  for (k = 0; k < NKEYS; ++k)
+    prb_put(prb, int2ptr(k + 1), int2ptr(k + 1));
+  gettimeofday(&end, NULL);
+  for (k = 0; k < NKEYS; ++k)
+    crb_put(crb, int2ptr(k + 1), int2ptr(k + 1));
+  printf("Roughly %f nsec per prb_put() building %d keys\n",
+         ((end.tv_sec - start.tv_sec) * 1000000.0 +
+          end.tv_usec - start.tv_usec) * 1000.0 / NKEYS, NKEYS);
+
+  printf("\nLookups with a writer updating every 100 usec:\n");
+  for (n = 1; n <= maxthr; n *= 2) {
+    printf("%2d threads: %12.0f lookups/sec persistent, "
+           "%12.0f lookups/sec rbtree + mutex\n", n, run(n, 0), run(n, 1));
+    if (n < maxthr && n * 2 > maxthr)
+      n = maxthr / 2;
+  }
+
+  prb_free(prb);
+  crb_free(crb);
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+
+#if !CAT_AVL_RANK || !CAT_RB_RANK
+#error "testrank must be built with -DCAT_AVL_RANK=1 -DCAT_RB_RANK=1"
+#endif
+
+#define NCHECK		4000
+#define NTIME		(256 * 1024)
+
+struct anode anodes[2][NCHECK];
+struct rbnode rnodes[2][NCHECK];
+char present[NCHECK];
+char which[NCHECK];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* compare select() and rank() for every position against the table */
+static void verify(struct avltree *at, struct rbtree *rt, uint n)
+{
+  struct anode *an;
+  struct rbnode *rn;
+  uint k, i = 0;
+
+  if (avl_count(at) != n || rb_count(rt) != n)
+    err("count: expected %u, avl has %lu, rb has %lu\n", n, avl_count(at),
+        rb_count(rt));
+  for (k = 0; k < NCHECK; ++k) {
+    if (avl_rank(at, int2ptr(k)) != i)
+      err("avl_rank(%u): expected %u got %lu\n", k, i,
+          avl_rank(at, int2ptr(k)));
+    if (rb_rank(rt, int2ptr(k)) != i)
+      err("rb_rank(%u): expected %u got %lu\n", k, i,
+          rb_rank(rt, int2ptr(k)));
+    if (!present[k])
+      continue;
+    an = avl_select(at, i);
+    rn = rb_select(rt, i);
+    if (an == NULL || an->key != int2ptr(k))
+      err("avl_select(%u): expected key %u\n", i, k);
+    if (rn == NULL || rn->key != int2ptr(k))
+      err("rb_select(%u): expected key %u\n", i, k);
+    ++i;
+  }
+  if (avl_select(at, n) != NULL || rb_select(rt, n) != NULL)
+    err("select: found a node past the end\n");
+}
+
+
+void check()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct anode *an;
+  struct rbnode *rn;
+  uint i, k, w, n = 0;
+
+  avl_init(&at, cmp_intptr);
+  rb_init(&rt, cmp_intptr);
+  for (i = 0; i < 20 * NCHECK; ++i) {
+    k = random() % NCHECK;
+    if (random() % 3 != 0) {
+      /* replacing swaps in the spare node:  the count must carry over */
+      w = present[k] ? !which[k] : which[k];
+      avl_ninit(&anodes[w][k], int2ptr(k));
+      rb_ninit(&rnodes[w][k], int2ptr(k));
+      an = avl_ins(&at, &anodes[w][k], NULL, 0);
+      rn = rb_ins(&rt, &rnodes[w][k], NULL, 0);
+      if ((an != NULL) != present[k] || (rn != NULL) != present[k])
+        err("ins: wrong replace result for key %u\n", k);
+      if (!present[k])
+        ++n;
+      present[k] = 1;
+      which[k] = w;
+    } else if (present[k]) {
+      avl_rem(&anodes[which[k]][k]);
+      rb_rem(&rnodes[which[k]][k]);
+      present[k] = 0;
+      --n;
+    }
+    if (i % 499 == 0)
+      verify(&at, &rt, n);
+  }
+  verify(&at, &rt, n);
+
+  for (k = 0; k < NCHECK; ++k) {
+    if (present[k]) {
+      avl_rem(&anodes[which[k]][k]);
+      rb_rem(&rnodes[which[k]][k]);
+      present[k] = 0;
+    }
+  }
+  verify(&at, &rt, 0);
+  printf("Rank and select checks passed\n");
+}
+
+
+void timeit()
+{
+  struct avltree at;
+  struct rbtree rt;
+  struct anode *an;
+  struct rbnode *rn;
+  struct timeval start, end;
+  ulong sum;
+  uint i;
+
+  an = malloc(sizeof(struct anode) * NTIME);
+  rn = malloc(sizeof(struct rbnode) * NTIME);
+  abort_unless(an && rn);
+  avl_init(&at, cmp_intptr);
+  rb_init(&rt, cmp_intptr);
+  for (i = 0; i < NTIME; ++i) {
+    avl_ninit(&an[i], int2ptr(random()));
+    avl_ins(&at, &an[i], NULL, 0);
+    rb_ninit(&rn[i], an[i].key);
+    rb_ins(&rt, &rn[i], NULL, 0);
+  }
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += ptr2uint(avl_select(&at, random() % avl_count(&at))->key);
+  gettimeofday(&end, NULL);
+  printf("%lu nodes: roughly %f nsec per avl_select() (%lu)\n", avl_count(&at),
+         tdiff(&start, &end) * 1000.0 / NTIME, sum);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += ptr2uint(rb_select(&rt, random() % rb_count(&rt))->key);
+  gettimeofday(&end, NULL);
+  printf("%lu nodes: roughly %f nsec per rb_select() (%lu)\n", rb_count(&rt),
+         tdiff(&start, &end) * 1000.0 / NTIME, sum);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += avl_rank(&at, an[i].key);
+  gettimeofday(&end, NULL);
+  printf("%lu nodes: roughly %f nsec per avl_rank() (%lu)\n", avl_count(&at),
+         tdiff(&start, &end) * 1000.0 / NTIME, sum);
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += rb_rank(&rt, rn[i].key);
+  gettimeofday(&end, NULL);
+  printf("%lu nodes: roughly %f nsec per rb_rank() (%lu)\n", rb_count(&rt),
+         tdiff(&start, &end) * 1000.0 / NTIME, sum);
+
+  free(rn);
+  free(an);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  timeit();
+  return 0;
+}
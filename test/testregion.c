@@ -0,0 +1,235 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/mem.h>
+#include <cat/catstr.h>
+#include <cat/stduse.h>
+
+#define BSIZE		8192
+#define NLIVE		256
+#define NDEPTH		8
+#define NREQ		(64 * 1024)
+#define NPERREQ		64
+
+struct alloc {
+  byte_t *p;
+  size_t len;
+  int depth;
+};
+
+struct alloc live[NLIVE];
+uint nlive;
+ulong nblkget;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* counts the blocks a region asks for */
+static void *cnt_alloc(struct memmgr *mm, size_t len)
+{
+  ++nblkget;
+  return mem_get(&estdmm, len);
+}
+
+
+static void cnt_free(struct memmgr *mm, void *mem)
+{
+  mem_free(&estdmm, mem);
+}
+
+
+struct memmgr cntmm = { cnt_alloc, NULL, cnt_free, &cntmm };
+
+
+/* mostly small scratch requests with the odd one larger than a block */
+static size_t rsize(void)
+{
+  if (random() % 64 == 0)
+    return BSIZE + random() % (4 * BSIZE);
+  return random() % 256;
+}
+
+
+static void fill(struct alloc *a)
+{
+  size_t i;
+  for (i = 0; i < a->len; ++i)
+    a->p[i] = (byte_t)((a - live) + i);
+}
+
+
+static void verify(struct alloc *a, size_t len)
+{
+  size_t i;
+  for (i = 0; i < len; ++i)
+    if (a->p[i] != (byte_t)((a - live) + i))
+      err("allocation %u corrupted at byte %lu\n", (uint)(a - live),
+          (ulong)i);
+}
+
+
+/*
+ * Random allocations and resizes in nested scopes.  Leaving a scope
+ * releases its allocations and must leave those of the outer scopes
+ * intact.
+ */
+static void check(void)
+{
+  struct region rg;
+  struct rgn_mark marks[NDEPTH];
+  struct alloc *a;
+  void *first, *p;
+  size_t nlen;
+  int depth = 0;
+  uint i, j;
+
+  rgn_init(&rg, &cntmm, BSIZE);
+  for (i = 0; i < 50000; ++i) {
+    switch (random() % 8) {
+    case 0:
+      if (depth == NDEPTH)
+        break;
+      rgn_mark(&rg, &marks[depth++]);
+      break;
+    case 1:
+      if (depth == 0)
+        break;
+      rgn_release(&rg, &marks[--depth]);
+      while (nlive > 0 && live[nlive - 1].depth > depth)
+        --nlive;
+      for (j = 0; j < nlive; ++j)
+        verify(&live[j], live[j].len);
+      break;
+    case 2:
+      if (nlive == 0)
+        break;
+      /* resize the newest allocation or an older one */
+      a = &live[(random() % 2) ? nlive - 1 : random() % nlive];
+      if (a->depth != depth)
+        break;
+      nlen = rsize() + 1;
+      if ((p = rgn_resize(&rg, a->p, nlen)) == NULL)
+        err("out of memory\n");
+      a->p = p;
+      verify(a, (nlen < a->len) ? nlen : a->len);
+      a->len = nlen;
+      fill(a);
+      break;
+    default:
+      if (nlive == NLIVE)
+        break;
+      a = &live[nlive++];
+      a->len = rsize();
+      a->depth = depth;
+      if ((a->p = mem_get(&rg.mm, a->len)) == NULL)
+        err("out of memory\n");
+      if (((ulong)a->p & (sizeof(cat_align_t) - 1)) != 0)
+        err("misaligned allocation\n");
+      fill(a);
+      break;
+    }
+  }
+
+  /* freeing the newest allocation gives its space back */
+  p = rgn_alloc(&rg, 100);
+  rgn_free(&rg, p);
+  if (rgn_alloc(&rg, 100) != p)
+    err("freeing the last allocation did not reclaim it\n");
+
+  /* reset keeps the first block and needs no new memory below a block */
+  first = rg.first;
+  rgn_reset(&rg);
+  nlive = 0;
+  nblkget = 0;
+  if (rg.first != first || rgn_alloc(&rg, BSIZE / 2) == NULL || nblkget != 0)
+    err("reset did not keep the first block\n");
+  rgn_fini(&rg);
+  printf("Region checks passed\n");
+}
+
+
+static void timeit(void)
+{
+  struct region rg;
+  struct timeval start, end;
+  struct catstr *cs;
+  void *p[NPERREQ];
+  size_t lens[NPERREQ];
+  uint i, j;
+
+  for (j = 0; j < NPERREQ; ++j)
+    lens[j] = rsize() + 1;
+
+  printf("Requests of %u scratch allocations (%u requests):\n", NPERREQ,
+         NREQ);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NREQ; ++i) {
+    for (j = 0; j < NPERREQ; ++j)
+      p[j] = mem_get(&estdmm, lens[j]);
+    for (j = 0; j < NPERREQ; ++j)
+      mem_free(&estdmm, p[j]);
+  }
+  gettimeofday(&end, NULL);
+  printf("  malloc and free each: roughly %f nsec per request\n",
+         tdiff(&start, &end) * 1000.0 / NREQ);
+
+  rgn_init(&rg, &cntmm, BSIZE);
+  nblkget = 0;
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NREQ; ++i) {
+    for (j = 0; j < NPERREQ; ++j)
+      p[j] = mem_get(&rg.mm, lens[j]);
+    rgn_reset(&rg);
+  }
+  gettimeofday(&end, NULL);
+  printf("  region, reset per request: roughly %f nsec per request, "
+         "%f blocks per request\n", tdiff(&start, &end) * 1000.0 / NREQ,
+         (double)nblkget / NREQ);
+
+  printf("Building a 200 character catstr per request:\n");
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NREQ; ++i) {
+    cs = cs_alloc(16);
+    for (j = 0; j < 200; ++j)
+      cs_addch(cs, 'a' + j % 26);
+    cs_free(cs);
+  }
+  gettimeofday(&end, NULL);
+  printf("  stdmm: roughly %f nsec per request\n",
+         tdiff(&start, &end) * 1000.0 / NREQ);
+
+  cs_setmm(&rg.mm);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NREQ; ++i) {
+    cs = cs_alloc(16);
+    for (j = 0; j < 200; ++j)
+      cs_addch(cs, 'a' + j % 26);
+    rgn_reset(&rg);
+  }
+  gettimeofday(&end, NULL);
+  cs_setmm(&stdmm);
+  printf("  region: roughly %f nsec per request\n",
+         tdiff(&start, &end) * 1000.0 / NREQ);
+  rgn_fini(&rg);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  timeit();
+  return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/heap.h>
+#include <cat/rheap.h>
+
+#define NCHECK		2000
+#define NKEYS		4000
+#define NQ		(64 * 1024)
+#define NTIME		(1024 * 1024)
+
+/* the hold model:  each extracted element comes back this much later */
+#define HOLD(i)		((ulong)(((i) * 2654435761u) % 4096 + 1))
+
+struct elem {
+  struct rhnode rn;
+  ulong key;
+};
+
+struct elem *elems;
+ulong *ikeys;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmpelem(const void *a, const void *b)
+{
+  ulong x = ((const struct elem *)a)->key;
+  ulong y = ((const struct elem *)b)->key;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/*
+ * Random adds of keys at or after the last one extracted, removals and
+ * extractions checked against a count of the live keys.  Keys start well
+ * above 0 to exercise the upper buckets.
+ */
+static void check(void)
+{
+  static struct rhnode n[NCHECK];
+  static uchar in[NCHECK];
+  static uint cnt[NKEYS];
+  struct rheap hp;
+  struct rhnode *rn;
+  rhkey_t base = (rhkey_t)1 << (RH_KEYBITS - 2), last = base;
+  uint i, j, k, live = 0;
+
+  rh_init(&hp, base);
+  rh_ninit(&n[0], base - 1);
+  if (rh_add(&hp, &n[0]) == 0)
+    err("added a key below the base\n");
+
+  for (i = 0; i < NCHECK * 20; ++i) {
+    k = random() % NCHECK;
+    switch (random() % 4) {
+    case 0:
+      if (in[k] || last - base >= NKEYS - 100)
+        break;
+      rh_ninit(&n[k], last + random() % (NKEYS - (last - base)));
+      if (rh_add(&hp, &n[k]) < 0)
+        err("add of %lu failed\n", (ulong)(n[k].key - base));
+      ++cnt[n[k].key - base];
+      in[k] = 1;
+      ++live;
+      break;
+    case 1:
+      if (!in[k])
+        break;
+      rh_rem(&hp, &n[k]);
+      --cnt[n[k].key - base];
+      in[k] = 0;
+      --live;
+      break;
+    case 2:
+      /* looking at the top must not change what may be added */
+      if ((rn = rh_top(&hp)) == NULL)
+        break;
+      for (j = last - base; j < rn->key - base; ++j)
+        if (cnt[j] != 0)
+          err("top is %lu while %u is in the heap\n",
+              (ulong)(rn->key - base), j);
+      break;
+    default:
+      if ((rn = rh_extract(&hp)) == NULL) {
+        if (live != 0)
+          err("extract from a non-empty heap failed\n");
+        break;
+      }
+      for (j = last - base; j < rn->key - base; ++j)
+        if (cnt[j] != 0)
+          err("extracted %lu while %u is in the heap\n",
+              (ulong)(rn->key - base), j);
+      if (rn->key < last || cnt[rn->key - base] == 0)
+        err("extracted a bad key %lu\n", (ulong)(rn->key - base));
+      last = rn->key;
+      --cnt[rn->key - base];
+      in[rn - n] = 0;
+      --live;
+      break;
+    }
+    if (hp.fill != live)
+      err("heap holds %lu elements instead of %u\n", hp.fill, live);
+    /* start over once the keys run out */
+    if (last - base >= NKEYS - 100) {
+      while (rh_extract(&hp) != NULL)
+        ;
+      memset(in, 0, sizeof(in));
+      memset(cnt, 0, sizeof(cnt));
+      live = 0;
+      base = last = hp.last;
+    }
+  }
+
+  rh_init(&hp, 0);
+  rh_ninit(&n[0], 100);
+  rh_ninit(&n[1], 50);
+  rh_add(&hp, &n[0]);
+  if (rh_top(&hp) != &n[0] || rh_add(&hp, &n[1]) < 0 ||
+      rh_top(&hp) != &n[1] || rh_extract(&hp) != &n[1] ||
+      rh_extract(&hp) != &n[0] || rh_extract(&hp) != NULL)
+    err("rh_top refused a later key above the last extracted one\n");
+  printf("Radix heap checks passed\n");
+}
+
+
+/* Extract the minimum and add it back a bit later on a full queue */
+static void timeit(void)
+{
+  struct heap hp;
+  struct rheap rh;
+  struct elem *e;
+  void **hpelems;
+  struct timeval start, end;
+  ulong hsum = 0, rsum = 0;
+  uint i;
+
+  hpelems = malloc(NQ * sizeof(*hpelems));
+  if (!hpelems)
+    err("out of memory\n");
+
+  printf("Monotone hold model (%u elements, %u ops):\n", NQ, NTIME);
+
+  hp_init(&hp, hpelems, NQ, 0, cmpelem, NULL);
+  for (i = 0; i < NQ; ++i) {
+    elems[i].key = ikeys[i];
+    hp_add(&hp, &elems[i], NULL);
+  }
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    e = hp_extract(&hp);
+    hsum += e->key;
+    e->key += HOLD(i);
+    hp_add(&hp, e, NULL);
+  }
+  gettimeofday(&end, NULL);
+  printf("  hp_extract + hp_add: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  rh_init(&rh, 0);
+  for (i = 0; i < NQ; ++i) {
+    rh_ninit(&elems[i].rn, ikeys[i]);
+    rh_add(&rh, &elems[i].rn);
+  }
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    e = container(rh_extract(&rh), struct elem, rn);
+    rsum += e->rn.key;
+    e->rn.key += HOLD(i);
+    rh_add(&rh, &e->rn);
+  }
+  gettimeofday(&end, NULL);
+  printf("  rh_extract + rh_add: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  if (hsum != rsum)
+    err("the heaps extracted different keys\n");
+  free(hpelems);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i;
+
+  check();
+  elems = malloc(NQ * sizeof(*elems));
+  ikeys = malloc(NQ * sizeof(*ikeys));
+  if (!elems || !ikeys)
+    err("out of memory\n");
+  for (i = 0; i < NQ; ++i)
+    ikeys[i] = random() % NQ;
+  timeit();
+  free(elems);
+  free(ikeys);
+  return 0;
+}
@@ -0,0 +1,448 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+#include <cat/parset.h>
+
+#define UNIV		2000
+#define NROUNDS		30
+#define NTIME		(1024 * 1024)
+
+enum { OP_UNION, OP_INTER, OP_DIFF, OP_NUM };
+static const char *opnames[] = { "union", "intersection", "difference" };
+
+struct aelem {
+  struct anode n;
+  uint key;
+};
+
+struct relem {
+  struct rbnode n;
+  uint key;
+};
+
+struct aelem *aa, *ab;
+struct relem *ra, *rb;
+struct anode **aptrs;
+uchar ina[UNIV], inb[UNIV], want[UNIV];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmpu(const void *a, const void *b)
+{
+  uint x = *(const uint *)a, y = *(const uint *)b;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/* the parallel variants may call these from several threads at once */
+static void countnode(void *n, void *ctx)
+{
+  if (((struct anode *)n)->tree != NULL)
+    err("node handed back still has an owner\n");
+  __sync_fetch_and_add((uint *)ctx, 1);
+}
+
+
+static void rcountnode(void *n, void *ctx)
+{
+  if (((struct rbnode *)n)->tree != NULL)
+    err("node handed back still has an owner\n");
+  __sync_fetch_and_add((uint *)ctx, 1);
+}
+
+
+/* returns the height of 'n' checking balance, links and owners */
+static int avl_check(struct avltree *t, struct anode *n)
+{
+  int lh, rh;
+
+  if (n == NULL)
+    return 0;
+  if (n->tree != t)
+    err("avl: node %u has the wrong owner\n", *(uint *)n->key);
+  lh = avl_check(t, n->p[CA_L]);
+  rh = avl_check(t, n->p[CA_R]);
+  if (n->b != rh - lh || n->b < -1 || n->b > 1)
+    err("avl: bad balance %d (heights %d/%d)\n", n->b, lh, rh);
+  if ((n->p[CA_L] != NULL && n->p[CA_L]->p[CA_P] != n) ||
+      (n->p[CA_R] != NULL && n->p[CA_R]->p[CA_P] != n))
+    err("avl: bad parent link\n");
+  return (lh > rh ? lh : rh) + 1;
+}
+
+
+/* returns the black height of 'n' checking the rb invariants and owners */
+static int rb_check(struct rbtree *t, struct rbnode *n)
+{
+  int lh, rh;
+
+  if (n == NULL)
+    return 1;
+  if (n->tree != t)
+    err("rb: node %u has the wrong owner\n", *(uint *)n->key);
+  lh = rb_check(t, n->p[CRB_L]);
+  rh = rb_check(t, n->p[CRB_R]);
+  if (lh != rh)
+    err("rb: black heights differ %d/%d\n", lh, rh);
+  if (n->col == CRB_RED &&
+      ((n->p[CRB_L] != NULL && n->p[CRB_L]->col == CRB_RED) ||
+       (n->p[CRB_R] != NULL && n->p[CRB_R]->col == CRB_RED)))
+    err("rb: red node with a red child\n");
+  if ((n->p[CRB_L] != NULL && n->p[CRB_L]->p[CRB_P] != n) ||
+      (n->p[CRB_R] != NULL && n->p[CRB_R]->p[CRB_P] != n))
+    err("rb: bad parent link\n");
+  return lh + (n->col == CRB_BLACK);
+}
+
+
+/* check that 't' is valid and holds exactly the keys marked in 'set' */
+static void avl_verify(struct avltree *t, uchar *set, const char *what)
+{
+  struct anode *n;
+  uint i;
+
+  avl_check(t, t->avl_root);
+  n = avl_getmin(t);
+  for (i = 0; i < UNIV; ++i) {
+    if (!set[i])
+      continue;
+    if (n == NULL || *(uint *)n->key != i)
+      err("avl %s: missing key %u\n", what, i);
+    n = avl_next(n);
+  }
+  if (n != NULL)
+    err("avl %s: extra key %u\n", what, *(uint *)n->key);
+}
+
+
+static void rb_verify(struct rbtree *t, uchar *set, const char *what)
+{
+  struct rbnode *n;
+  uint i;
+
+  if (t->rb_root != NULL && t->rb_root->col != CRB_BLACK)
+    err("rb %s: red root\n", what);
+  rb_check(t, t->rb_root);
+  n = rb_getmin(t);
+  for (i = 0; i < UNIV; ++i) {
+    if (!set[i])
+      continue;
+    if (n == NULL || *(uint *)n->key != i)
+      err("rb %s: missing key %u\n", what, i);
+    n = rb_next(n);
+  }
+  if (n != NULL)
+    err("rb %s: extra key %u\n", what, *(uint *)n->key);
+}
+
+
+static void avl_load(struct avltree *t, struct aelem *e, uchar *set)
+{
+  uint i, n = 0;
+
+  avl_init(t, cmpu);
+  for (i = 0; i < UNIV; ++i) {
+    if (set[i]) {
+      avl_ninit(&e[i].n, &e[i].key);
+      aptrs[n++] = &e[i].n;
+    }
+  }
+  avl_build(t, aptrs, n);
+}
+
+
+/* inserts one at a time so the colors differ from those of rb_build() */
+static void rb_load(struct rbtree *t, struct relem *e, uchar *set)
+{
+  uint i;
+
+  rb_init(t, cmpu);
+  for (i = 0; i < UNIV; ++i) {
+    if (set[i]) {
+      rb_ninit(&e[i].n, &e[i].key);
+      rb_ins(t, &e[i].n, NULL, 0);
+    }
+  }
+}
+
+
+static void split_join_check(void)
+{
+  struct avltree at, agt, agt2;
+  struct rbtree rt, rgt, rgt2;
+  struct anode *an;
+  struct rbnode *rn;
+  uchar lo[UNIV], hi[UNIV];
+  uint s, i;
+
+  s = random() % UNIV;
+  for (i = 0; i < UNIV; ++i) {
+    lo[i] = ina[i] && i < s;
+    hi[i] = ina[i] && i > s;
+  }
+
+  avl_load(&at, aa, ina);
+  avl_init(&agt, cmpu);
+  an = avl_split(&at, &s, &agt);
+  if ((an != NULL) != ina[s] || (an != NULL && an->tree != NULL))
+    err("avl split: bad return for key %u\n", s);
+  avl_verify(&at, lo, "split low");
+  avl_verify(&agt, hi, "split high");
+  if (an == NULL && !avl_isempty(&agt)) {
+    avl_init(&agt2, cmpu);
+    an = avl_split(&agt, avl_getmin(&agt)->key, &agt2);
+    avl_join(&at, an, &agt2);
+  } else if (an != NULL) {
+    avl_join(&at, an, &agt);
+  }
+  if (!avl_isempty(&agt))
+    err("avl join: right tree not emptied\n");
+  avl_verify(&at, ina, "join");
+
+  rb_load(&rt, ra, ina);
+  rb_init(&rgt, cmpu);
+  rn = rb_split(&rt, &s, &rgt);
+  if ((rn != NULL) != ina[s] || (rn != NULL && rn->tree != NULL))
+    err("rb split: bad return for key %u\n", s);
+  rb_verify(&rt, lo, "split low");
+  rb_verify(&rgt, hi, "split high");
+  if (rn == NULL && !rb_isempty(&rgt)) {
+    rb_init(&rgt2, cmpu);
+    rn = rb_split(&rgt, rb_getmin(&rgt)->key, &rgt2);
+    rb_join(&rt, rn, &rgt2);
+  } else if (rn != NULL) {
+    rb_join(&rt, rn, &rgt);
+  }
+  if (!rb_isempty(&rgt))
+    err("rb join: right tree not emptied\n");
+  rb_verify(&rt, ina, "join");
+}
+
+
+static void setop_check(int op, int nthreads)
+{
+  struct avltree at1, at2;
+  struct rbtree rt1, rt2;
+  uint i, nrem = 0, expect = 0;
+
+  for (i = 0; i < UNIV; ++i) {
+    switch (op) {
+    case OP_UNION: want[i] = ina[i] || inb[i]; break;
+    case OP_INTER: want[i] = ina[i] && inb[i]; break;
+    default:       want[i] = ina[i] && !inb[i]; break;
+    }
+    /* a union hands back the nodes of 't2' that were already in 't1' */
+    if ((op == OP_INTER) ? (ina[i] && !want[i]) : (ina[i] && inb[i]))
+      ++expect;
+  }
+
+  avl_load(&at1, aa, ina);
+  avl_load(&at2, ab, inb);
+  switch (op) {
+  case OP_UNION:
+    if (nthreads > 0)
+      avl_punion(&at1, &at2, countnode, &nrem, nthreads);
+    else
+      avl_union(&at1, &at2, countnode, &nrem);
+    if (!avl_isempty(&at2))
+      err("avl union: second tree not emptied\n");
+    break;
+  case OP_INTER:
+    if (nthreads > 0)
+      avl_pinter(&at1, &at2, countnode, &nrem, nthreads);
+    else
+      avl_inter(&at1, &at2, countnode, &nrem);
+    avl_verify(&at2, inb, "intersection (second tree)");
+    break;
+  default:
+    if (nthreads > 0)
+      avl_pdiff(&at1, &at2, countnode, &nrem, nthreads);
+    else
+      avl_diff(&at1, &at2, countnode, &nrem);
+    avl_verify(&at2, inb, "difference (second tree)");
+    break;
+  }
+  avl_verify(&at1, want, opnames[op]);
+  if (nrem != expect)
+    err("avl %s: %u nodes handed back instead of %u\n", opnames[op], nrem,
+        expect);
+
+  nrem = 0;
+  rb_load(&rt1, ra, ina);
+  rb_load(&rt2, rb, inb);
+  switch (op) {
+  case OP_UNION:
+    if (nthreads > 0)
+      rb_punion(&rt1, &rt2, rcountnode, &nrem, nthreads);
+    else
+      rb_union(&rt1, &rt2, rcountnode, &nrem);
+    if (!rb_isempty(&rt2))
+      err("rb union: second tree not emptied\n");
+    break;
+  case OP_INTER:
+    if (nthreads > 0)
+      rb_pinter(&rt1, &rt2, rcountnode, &nrem, nthreads);
+    else
+      rb_inter(&rt1, &rt2, rcountnode, &nrem);
+    rb_verify(&rt2, inb, "intersection (second tree)");
+    break;
+  default:
+    if (nthreads > 0)
+      rb_pdiff(&rt1, &rt2, rcountnode, &nrem, nthreads);
+    else
+      rb_diff(&rt1, &rt2, rcountnode, &nrem);
+    rb_verify(&rt2, inb, "difference (second tree)");
+    break;
+  }
+  rb_verify(&rt1, want, opnames[op]);
+  if (nrem != expect)
+    err("rb %s: %u nodes handed back instead of %u\n", opnames[op], nrem,
+        expect);
+}
+
+
+/*
+ * Random sets of widely varying density (including empty and full ones)
+ * so that both small into large and large into small merges get covered.
+ */
+void check()
+{
+  uint i, r, pa, pb;
+  int op;
+
+  aa = calloc(UNIV, sizeof(*aa));
+  ab = calloc(UNIV, sizeof(*ab));
+  ra = calloc(UNIV, sizeof(*ra));
+  rb = calloc(UNIV, sizeof(*rb));
+  aptrs = malloc(UNIV * sizeof(*aptrs));
+  if (!aa || !ab || !ra || !rb || !aptrs)
+    err("out of memory\n");
+  for (i = 0; i < UNIV; ++i)
+    aa[i].key = ab[i].key = ra[i].key = rb[i].key = i;
+
+  for (r = 0; r < NROUNDS; ++r) {
+    pa = (r % 6 == 0) ? 0 : random() % 101;
+    pb = (r % 6 == 1) ? 100 : random() % 101;
+    if (r % 3 == 2)
+      pb = random() % 3;
+    for (i = 0; i < UNIV; ++i) {
+      ina[i] = random() % 100 < pa;
+      inb[i] = random() % 100 < pb;
+    }
+    split_join_check();
+    for (op = OP_UNION; op < OP_NUM; ++op) {
+      setop_check(op, 0);
+      setop_check(op, 4);
+    }
+  }
+
+  free(aa);
+  free(ab);
+  free(ra);
+  free(rb);
+  free(aptrs);
+  printf("split, join, union, intersection and difference checks passed\n");
+}
+
+
+/*
+ * Time merging a tree of 'm' nodes into one of NTIME nodes (half of the
+ * keys match) with avl_union() and with one avl_ins() per node.
+ */
+static void time_union(uint m)
+{
+  struct avltree t1, t2;
+  struct aelem *e1, *e2;
+  struct anode *n, *next;
+  struct timeval start, end;
+  uint i, stride;
+  int nt;
+  double usec;
+
+  e1 = calloc(NTIME, sizeof(*e1));
+  e2 = calloc(m, sizeof(*e2));
+  aptrs = malloc(NTIME * sizeof(*aptrs));
+  if (!e1 || !e2 || !aptrs)
+    err("out of memory\n");
+  stride = NTIME / m;
+  for (i = 0; i < NTIME; ++i)
+    e1[i].key = i * 2;
+  for (i = 0; i < m; ++i)
+    e2[i].key = i * stride * 2 + (i & 1);
+
+  for (nt = -1; nt <= 4; nt = (nt <= 0) ? nt + 1 : nt * 2) {
+    avl_init(&t1, cmpu);
+    avl_init(&t2, cmpu);
+    for (i = 0; i < NTIME; ++i) {
+      avl_ninit(&e1[i].n, &e1[i].key);
+      aptrs[i] = &e1[i].n;
+    }
+    avl_build(&t1, aptrs, NTIME);
+    for (i = 0; i < m; ++i) {
+      avl_ninit(&e2[i].n, &e2[i].key);
+      aptrs[i] = &e2[i].n;
+    }
+    avl_build(&t2, aptrs, m);
+
+    gettimeofday(&start, NULL);
+    if (nt < 0) {
+      for (n = avl_getmin(&t2); n != NULL; n = next) {
+        next = avl_next(n);
+        avl_rem(n);
+        avl_ins(&t1, n, NULL, 0);
+      }
+    } else if (nt == 0) {
+      avl_union(&t1, &t2, NULL, NULL);
+    } else {
+      avl_punion(&t1, &t2, NULL, NULL, nt);
+    }
+    gettimeofday(&end, NULL);
+    usec = tdiff(&start, &end);
+
+    if (nt < 0)
+      printf("  %u into %u by insertion: ", m, NTIME);
+    else if (nt == 0)
+      printf("  %u into %u by avl_union: ", m, NTIME);
+    else
+      printf("  %u into %u by avl_punion (%d threads): ", m, NTIME, nt);
+    printf("%f usec, roughly %f nsec per node merged\n", usec,
+           usec * 1000.0 / m);
+  }
+
+  free(e1);
+  free(e2);
+  free(aptrs);
+}
+
+
+void timeit()
+{
+  printf("Merging trees:\n");
+  time_union(1024);
+  time_union(64 * 1024);
+  time_union(NTIME);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  timeit();
+  return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/aux.h>
+#include <cat/bptree.h>
+#include <cat/slab.h>
+#include <cat/stduse.h>
+
+#define NSLOTS		4096
+#define NCHECK		(256 * 1024)
+#define NTIME		(4 * 1024 * 1024)
+#define NKEYS		(1024 * 1024)
+
+void *slots[NSLOTS];
+size_t lens[NSLOTS];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/* mostly small with a long tail of larger and a few large requests */
+static size_t rsize(void)
+{
+  switch (random() % 8) {
+  case 0:
+    return random() % (4 * SLAB_MAXSZ) + 1;
+  case 1:
+  case 2:
+    return random() % 1024 + 1;
+  default:
+    return random() % 128 + 1;
+  }
+}
+
+
+static void fill(byte_t *p, size_t len, uint k)
+{
+  size_t i;
+  for (i = 0; i < len; ++i)
+    p[i] = (byte_t)(k + i);
+}
+
+
+static void verify(byte_t *p, size_t len, uint k)
+{
+  size_t i;
+  for (i = 0; i < len; ++i)
+    if (p[i] != (byte_t)(k + i))
+      err("slot %u corrupted at byte %lu of %lu\n", k, (ulong)i,
+          (ulong)len);
+}
+
+
+static void check(void)
+{
+  struct slabmm sm;
+  struct slab_stats st;
+  ulong live = 0, n;
+  size_t len, nlen;
+  uint i, k;
+  int c;
+
+  slab_init(&sm, 0, &estdmm);
+
+  for (len = 0; len <= SLAB_MAXSZ; ++len) {
+    c = slab_class(len);
+    if (c < 0 || sm.classes[c].isize < len ||
+        (c > 0 && sm.classes[c - 1].isize >= len))
+      err("length %lu maps to the wrong class %d\n", (ulong)len, c);
+  }
+  if (slab_class(SLAB_MAXSZ + 1) != -1)
+    err("a large request maps to a size class\n");
+
+  for (i = 0; i < NCHECK; ++i) {
+    k = random() % NSLOTS;
+    switch (random() % 3) {
+    case 0:
+      if (slots[k] != NULL)
+        break;
+      lens[k] = rsize();
+      if ((slots[k] = mem_get(&sm.mm, lens[k])) == NULL)
+        err("out of memory\n");
+      fill(slots[k], lens[k], k);
+      ++live;
+      break;
+    case 1:
+      if (slots[k] == NULL)
+        break;
+      verify(slots[k], lens[k], k);
+      nlen = (random() % 16 == 0) ? 0 : rsize();
+      if ((slots[k] = mem_resize(&sm.mm, slots[k], nlen)) == NULL) {
+        if (nlen != 0)
+          err("out of memory\n");
+        --live;
+        break;
+      }
+      verify(slots[k], (nlen < lens[k]) ? nlen : lens[k], k);
+      lens[k] = nlen;
+      fill(slots[k], lens[k], k);
+      break;
+    default:
+      if (slots[k] == NULL)
+        break;
+      verify(slots[k], lens[k], k);
+      mem_free(&sm.mm, slots[k]);
+      slots[k] = NULL;
+      --live;
+      break;
+    }
+  }
+
+  n = sm.nlarge;
+  for (c = 0; c < SLAB_NCLASS; ++c) {
+    slab_stats(&sm, c, &st);
+    if (st.nitems > st.capacity)
+      err("class %d holds %lu items in room for %lu\n", c, st.nitems,
+          st.capacity);
+    n += st.nitems;
+  }
+  if (n != live)
+    err("the slab holds %lu blocks instead of %lu\n", n, live);
+
+  for (k = 0; k < NSLOTS; ++k) {
+    mem_free(&sm.mm, slots[k]);
+    slots[k] = NULL;
+  }
+  if (sm.nlarge != 0 || sm.lgbytes != 0)
+    err("large block accounting is off\n");
+  slab_fini(&sm);
+  printf("Slab checks passed\n");
+}
+
+
+static ulong npgget, npgfree;
+
+static void *cnt_alloc(struct memmgr *mm, size_t len)
+{
+  ++npgget;
+  return mem_get(&estdmm, len);
+}
+
+
+static void *cnt_resize(struct memmgr *mm, void *mem, size_t len)
+{
+  return mem_resize(&estdmm, mem, len);
+}
+
+
+static void cnt_free(struct memmgr *mm, void *mem)
+{
+  ++npgfree;
+  mem_free(&estdmm, mem);
+}
+
+
+/* freeing and reallocating across a page boundary must not thrash pages */
+static void checkchurn(void)
+{
+  struct memmgr cntmm = { &cnt_alloc, &cnt_resize, &cnt_free, NULL };
+  struct slabmm sm;
+  ulong ngot, i, n;
+  void *last;
+
+  slab_init(&sm, 16384, &cntmm);
+  npgget = npgfree = 0;
+  for (n = 0; npgget <= SLAB_HIWAT + 2; ++n) {
+    if (n >= NSLOTS)
+      err("churn: too many items per page\n");
+    if ((slots[n] = mem_get(&sm.mm, 64)) == NULL)
+      err("out of memory\n");
+  }
+
+  /* the last item is alone on its page:  free and get it back */
+  ngot = npgget;
+  for (i = 0; i < 1000; ++i) {
+    last = slots[n - 1];
+    mem_free(&sm.mm, last);
+    if ((slots[n - 1] = mem_get(&sm.mm, 64)) == NULL)
+      err("out of memory\n");
+  }
+  if (npgget != ngot || npgfree != 0)
+    err("churn: %lu pages got and %lu freed across a page boundary\n",
+        npgget - ngot, npgfree);
+
+  for (i = 0; i < n; ++i) {
+    mem_free(&sm.mm, slots[i]);
+    slots[i] = NULL;
+  }
+  if (npgfree != npgget - SLAB_HIWAT)
+    err("churn: %lu of %lu pages kept idle instead of %d\n",
+        npgget - npgfree, npgget, SLAB_HIWAT);
+  slab_fini(&sm);
+  printf("Slab page churn checks passed\n");
+}
+
+
+static void churn(struct memmgr *mm, const char *name)
+{
+  struct timeval start, end;
+  uint i, k;
+
+  memset(slots, 0, sizeof(slots));
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    k = i * 2654435761u % NSLOTS;
+    if (slots[k] != NULL) {
+      mem_free(mm, slots[k]);
+      slots[k] = NULL;
+    } else if ((slots[k] = mem_get(mm, lens[k])) == NULL) {
+      err("out of memory\n");
+    }
+  }
+  gettimeofday(&end, NULL);
+  printf("  %s: roughly %f nsec per op\n", name,
+         tdiff(&start, &end) * 1000.0 / NTIME);
+}
+
+
+static void timeit(void)
+{
+  struct slabmm sm;
+  struct slab_stats st;
+  struct bptree t;
+  struct timeval start, end;
+  uint i, k;
+  int c;
+
+  for (k = 0; k < NSLOTS; ++k)
+    lens[k] = rsize();
+
+  printf("Random allocations and frees (%u ops):\n", NTIME);
+  churn(&estdmm, "malloc/free");
+  for (k = 0; k < NSLOTS; ++k)
+    mem_free(&estdmm, slots[k]);
+  slab_init(&sm, 0, &estdmm);
+  churn(&sm.mm, "slab");
+
+  /* the churn frees everything:  populate the slots to look at */
+  for (k = 0; k < NSLOTS; ++k)
+    if ((slots[k] = mem_get(&sm.mm, lens[k])) == NULL)
+      err("out of memory\n");
+  printf("Size class statistics with %u blocks allocated:\n", NSLOTS);
+  printf("  %6s %6s %9s %9s %9s %10s %10s\n", "size", "pages", "capacity",
+         "items", "allocs", "idle", "rounding");
+  for (c = 0; c < SLAB_NCLASS; ++c) {
+    slab_stats(&sm, c, &st);
+    if (st.nalloc == 0)
+      continue;
+    printf("  %6lu %6lu %9lu %9lu %9lu %10lu %10lu\n", (ulong)st.isize,
+           st.npages, st.capacity, st.nitems, st.nalloc, (ulong)st.idle,
+           (ulong)st.rounding);
+  }
+  printf("  large: %lu blocks, %lu bytes\n", sm.nlarge, (ulong)sm.lgbytes);
+  for (k = 0; k < NSLOTS; ++k)
+    mem_free(&sm.mm, slots[k]);
+  slab_fini(&sm);
+
+  printf("B+tree of %u keys:\n", NKEYS);
+  bpt_init(&t, cmp_intptr, &estdmm);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NKEYS; ++i)
+    bpt_ins(&t, int2ptr(i * 2654435761u), NULL, NULL);
+  bpt_fini(&t);
+  gettimeofday(&end, NULL);
+  printf("  nodes from malloc: roughly %f nsec per insert\n",
+         tdiff(&start, &end) * 1000.0 / NKEYS);
+
+  slab_init(&sm, 0, &estdmm);
+  bpt_init(&t, cmp_intptr, &sm.mm);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NKEYS; ++i)
+    bpt_ins(&t, int2ptr(i * 2654435761u), NULL, NULL);
+  bpt_fini(&t);
+  gettimeofday(&end, NULL);
+  printf("  nodes from the slab: roughly %f nsec per insert\n",
+         tdiff(&start, &end) * 1000.0 / NKEYS);
+  slab_fini(&sm);
+}
+
+
+int main(int argc, char *argv[])
+{
+  check();
+  checkchurn();
+  timeit();
+  return 0;
+}
@@ -0,0 +1,357 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <cat/stduse.h>
+
+#define NKEYS	(256 * 1024)
+#define NROUNDS	4
+#define NWORDS	4096
+
+void *keys[NKEYS];
+char words[NWORDS][16];
+ushort wseq[NKEYS];		/* word counting input:  indices into words */
+ulong wcounts[NWORDS];
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static void report(const char *what, struct timeval *start,
+                   struct timeval *end)
+{
+  printf("Roughly %f nsec per insert+remove for %s\n",
+         tdiff(start, end) * 1000.0 / ((double)NKEYS * NROUNDS), what);
+}
+
+
+void timecl(struct clist_attr *attr, const char *what)
+{
+  struct clist *l;
+  struct timeval start, end;
+  int i, r;
+
+  l = cl_new(attr, 1);
+  gettimeofday(&start, NULL);
+  for (r = 0; r < NROUNDS; ++r) {
+    for (i = 0; i < NKEYS; ++i)
+      cl_enq(l, keys[i]);
+    for (i = 0; i < NKEYS; ++i)
+      if (cl_deq(l) != keys[i])
+        err("cl_deq: wrong item\n");
+  }
+  gettimeofday(&end, NULL);
+  cl_free(l);
+  report(what, &start, &end);
+}
+
+
+void timecht(struct chtab_attr *attr, const char *what)
+{
+  struct chtab *t;
+  struct timeval start, end;
+  int i, r;
+
+  t = cht_new(NKEYS, attr, NULL, 1);
+  gettimeofday(&start, NULL);
+  for (r = 0; r < NROUNDS; ++r) {
+    for (i = 0; i < NKEYS; ++i)
+      cht_put(t, keys[i], keys[i]);
+    for (i = NKEYS - 1; i >= 0; --i)
+      if (cht_del(t, keys[i]) != keys[i])
+        err("cht_del: missing key\n");
+  }
+  gettimeofday(&end, NULL);
+  cht_free(t);
+  report(what, &start, &end);
+}
+
+
+void timecavl(struct cavltree_attr *attr, const char *what)
+{
+  struct cavltree *t;
+  struct timeval start, end;
+  int i, r;
+
+  t = cavl_new(attr, 1);
+  gettimeofday(&start, NULL);
+  for (r = 0; r < NROUNDS; ++r) {
+    for (i = 0; i < NKEYS; ++i)
+      cavl_put(t, keys[i], keys[i]);
+    for (i = NKEYS - 1; i >= 0; --i)
+      if (cavl_del(t, keys[i]) != keys[i])
+        err("cavl_del: missing key\n");
+  }
+  gettimeofday(&end, NULL);
+  cavl_free(t);
+  report(what, &start, &end);
+}
+
+
+void timecrb(struct crbtree_attr *attr, const char *what)
+{
+  struct crbtree *t;
+  struct timeval start, end;
+  int i, r;
+
+  t = crb_new(attr, 1);
+  gettimeofday(&start, NULL);
+  for (r = 0; r < NROUNDS; ++r) {
+    for (i = 0; i < NKEYS; ++i)
+      crb_put(t, keys[i], keys[i]);
+    for (i = NKEYS - 1; i >= 0; --i)
+      if (crb_del(t, keys[i]) != keys[i])
+        err("crb_del: missing key\n");
+  }
+  gettimeofday(&end, NULL);
+  crb_free(t);
+  report(what, &start, &end);
+}
+
+
+void timecst(struct cstree_attr *attr, const char *what)
+{
+  struct cstree *t;
+  struct timeval start, end;
+  int i, r;
+
+  t = cst_new(attr, 1);
+  gettimeofday(&start, NULL);
+  for (r = 0; r < NROUNDS; ++r) {
+    for (i = 0; i < NKEYS; ++i)
+      cst_put(t, keys[i], keys[i]);
+    for (i = NKEYS - 1; i >= 0; --i)
+      if (cst_del(t, keys[i]) != keys[i])
+        err("cst_del: missing key\n");
+  }
+  gettimeofday(&end, NULL);
+  cst_free(t);
+  report(what, &start, &end);
+}
+
+
+/*
+ * Count word occurrences with a get and a put per word and then with one
+ * upsert per word and check that the counts (stored in the data pointers)
+ * agree with the real ones.
+ */
+#define TIMECOUNT(_pfx, _new, _what)					\
+void timecount_##_pfx(void)						\
+{									\
+  struct timeval start, end;						\
+  void *t, **dp;							\
+  char *w;								\
+  int i, isnew;								\
+									\
+  t = _new;								\
+  gettimeofday(&start, NULL);						\
+  for (i = 0; i < NKEYS; ++i) {						\
+    w = words[wseq[i]];							\
+    _pfx##_put(t, w, int2ptr(ptr2uint(_pfx##_get(t, w)) + 1));		\
+  }									\
+  gettimeofday(&end, NULL);						\
+  printf("Roughly %f nsec per count for %s get+put\n",			\
+         tdiff(&start, &end) * 1000.0 / NKEYS, _what);			\
+  _pfx##_free(t);							\
+									\
+  t = _new;								\
+  gettimeofday(&start, NULL);						\
+  for (i = 0; i < NKEYS; ++i) {						\
+    dp = _pfx##_upsert(t, words[wseq[i]], &isnew);			\
+    if (isnew != (*dp == NULL))						\
+      err(#_pfx "_upsert: wrong isnew for %s\n", words[wseq[i]]);	\
+    *dp = int2ptr(ptr2uint(*dp) + 1);					\
+  }									\
+  gettimeofday(&end, NULL);						\
+  printf("Roughly %f nsec per count for %s upsert\n",			\
+         tdiff(&start, &end) * 1000.0 / NKEYS, _what);			\
+  for (i = 0; i < NWORDS; ++i)						\
+    if (ptr2uint(_pfx##_get(t, words[i])) != wcounts[i])		\
+      err(#_pfx "_upsert: wrong count for %s\n", words[i]);		\
+  _pfx##_free(t);							\
+}
+
+TIMECOUNT(cht, cht_new(NWORDS, &cht_std_attr_skey, NULL, 1), "chtab")
+TIMECOUNT(coht, coht_new(NWORDS, &coht_std_attr_skey, NULL, 1), "cohtab")
+TIMECOUNT(cavl, cavl_new(&cavl_std_attr_skey, 1), "cavltree")
+TIMECOUNT(crb, crb_new(&crb_std_attr_skey, 1), "crbtree")
+TIMECOUNT(cst, cst_new(&cst_std_attr_skey, 1), "cstree")
+
+
+/* the pooled string key attributes must still copy and free their keys */
+void testpoolskey()
+{
+  struct chtab *t;
+  char buf[32];
+  int i;
+
+  t = cht_new(128, &cht_pool_attr_skey, NULL, 1);
+  for (i = 0; i < 10000; ++i) {
+    sprintf(buf, "key%d", i);
+    cht_put(t, buf, keys[i]);
+  }
+  for (i = 0; i < 10000; i += 2) {
+    sprintf(buf, "key%d", i);
+    if (cht_del(t, buf) != keys[i])
+      err("cht_del: pooled string key %d missing\n", i);
+  }
+  for (i = 1; i < 10000; i += 2) {
+    sprintf(buf, "key%d", i);
+    if (cht_get(t, buf) != keys[i])
+      err("cht_get: pooled string key %d missing\n", i);
+  }
+  cht_free(t);
+  printf("Pooled string key table checks passed\n");
+}
+
+
+/* the pooled raw key attributes copy the key bytes, not the caller's raw */
+void testpoolrkey()
+{
+  struct chtab *t;
+  struct cavltree *at;
+  struct raw r;
+  char buf[32];
+  int i;
+
+  t = cht_new(128, &cht_pool_attr_rkey, NULL, 1);
+  at = cavl_new(&cavl_pool_attr_rkey, 1);
+  r.data = (byte_t *)buf;
+  for (i = 0; i < 10000; ++i) {
+    r.len = sprintf(buf, "key%d", i);
+    cht_put(t, &r, keys[i]);
+    cavl_put(at, &r, keys[i]);
+  }
+  memset(buf, 0, sizeof(buf));
+  for (i = 0; i < 10000; i += 2) {
+    r.len = sprintf(buf, "key%d", i);
+    if (cht_del(t, &r) != keys[i])
+      err("cht_del: pooled raw key %d missing\n", i);
+    if (cavl_del(at, &r) != keys[i])
+      err("cavl_del: pooled raw key %d missing\n", i);
+  }
+  for (i = 1; i < 10000; i += 2) {
+    r.len = sprintf(buf, "key%d", i);
+    if (cht_get(t, &r) != keys[i])
+      err("cht_get: pooled raw key %d missing\n", i);
+    if (cavl_get(at, &r) != keys[i])
+      err("cavl_get: pooled raw key %d missing\n", i);
+  }
+  cavl_free(at);
+  cht_free(t);
+  printf("Pooled raw key table checks passed\n");
+}
+
+
+void testrawdup()
+{
+  struct raw r, *rp;
+
+  r.data = (byte_t *)"hello";
+  r.len = 5;
+  rp = rawdup(&r);
+  if (rp == NULL || rp->len != 5 || memcmp(rp->data, "hello", 5) != 0)
+    err("rawdup: bad copy\n");
+  free(rp);
+  r.data = NULL;
+  r.len = 0;
+  rp = rawdup(&r);
+  if (rp == NULL || rp->len != 0 || rp->data != NULL)
+    err("rawdup: bad empty copy\n");
+  free(rp);
+  r.data = (byte_t *)"x";
+  r.len = (size_t)-8;
+  if (rawdup(&r) != NULL)
+    err("rawdup: size overflow not caught\n");
+  printf("rawdup checks passed\n");
+}
+
+
+/* a seeded copy of a std attribute set must hash with that seed */
+void testseed()
+{
+  struct chtab_attr cha = cht_std_attr_skey;
+  struct cohtab_attr coa = coht_std_attr_skey;
+  struct chtab *t;
+  struct cohtab *ot;
+  char buf[32];
+  int i;
+
+  cha.seed = coa.seed = (ulong)random() | 1;
+  t = cht_new(128, &cha, NULL, 1);
+  ot = coht_new(128, &coa, NULL, 1);
+  if (t->table.hctx == NULL || *(ulong *)t->table.hctx != cha.seed)
+    err("cht_new: seed not used as the hash context\n");
+  if (ot->table.hctx == NULL || *(ulong *)ot->table.hctx != coa.seed)
+    err("coht_new: seed not used as the hash context\n");
+  for (i = 0; i < 10000; ++i) {
+    sprintf(buf, "key%d", i);
+    cht_put(t, buf, keys[i]);
+    coht_put(ot, buf, keys[i]);
+  }
+  for (i = 0; i < 10000; ++i) {
+    sprintf(buf, "key%d", i);
+    if (cht_get(t, buf) != keys[i])
+      err("cht_get: seeded key %d missing\n", i);
+    if (coht_get(ot, buf) != keys[i])
+      err("coht_get: seeded key %d missing\n", i);
+  }
+  coht_free(ot);
+  cht_free(t);
+  printf("Seeded table checks passed\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+  int i, j;
+  void *x;
+
+  for (i = 0; i < NKEYS; ++i)
+    keys[i] = int2ptr(i + 1);
+  for (i = NKEYS - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    x = keys[i];
+    keys[i] = keys[j];
+    keys[j] = x;
+  }
+
+  testpoolskey();
+  testrawdup();
+  testpoolrkey();
+  testseed();
+
+  for (i = 0; i < NWORDS; ++i)
+    sprintf(words[i], "word%d", i);
+  for (i = 0; i < NKEYS; ++i) {
+    wseq[i] = random() % NWORDS;
+    wcounts[wseq[i]] += 1;
+  }
+  timecount_cht();
+  timecount_coht();
+  timecount_cavl();
+  timecount_crb();
+  timecount_cst();
+
+  timecl(NULL, "clist (malloc)");
+  timecl(&cl_pool_attr, "clist (pool)");
+  timecht(&cht_std_attr_pkey, "chtab (malloc)");
+  timecht(&cht_pool_attr_pkey, "chtab (pool)");
+  timecavl(&cavl_std_attr_pkey, "cavltree (malloc)");
+  timecavl(&cavl_pool_attr_pkey, "cavltree (pool)");
+  timecrb(&crb_std_attr_pkey, "crbtree (malloc)");
+  timecrb(&crb_pool_attr_pkey, "crbtree (pool)");
+  timecst(&cst_std_attr_pkey, "cstree (malloc)");
+  timecst(&cst_pool_attr_pkey, "cstree (pool)");
+
+  return 0;
+}
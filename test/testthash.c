@@ -0,0 +1,363 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/aux.h>
+#include <cat/hash.h>
+#include <cat/thash.h>
+
+#define NCHECK		4000
+#define NTIME		(1024 * 1024)
+#define NSLOTS		(NTIME * 2)
+#define NBKTS		(NTIME * 2)
+
+/* short strings stored in place and zero padded so they compare as words */
+struct str16 {
+  char s[16];
+};
+
+#define U64EQ(a, b)	((a) == (b))
+
+static uint hash_str16(struct str16 k)
+{
+  uint64_t w[2];
+  memcpy(w, k.s, sizeof(w));
+  return thash_u64(w[0] * 0x9E3779B97F4A7C15ull + w[1]);
+}
+
+static int eq_str16(struct str16 a, struct str16 b)
+{
+  return memcmp(a.s, b.s, sizeof(a.s)) == 0;
+}
+
+THASH_DEFINE(u64map, uint64_t, uint64_t, thash_u64, U64EQ)
+THASH_DEFINE(strmap, struct str16, uint, hash_str16, eq_str16)
+
+struct u64elem {
+  struct hnode n;
+  uint64_t key;
+  uint64_t val;
+};
+
+struct strelem {
+  struct hnode n;
+  char key[16];
+  uint val;
+};
+
+uint64_t *ukeys;
+struct str16 *skeys;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmpu64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/* the same hash function the typed table uses, but called through 'hash' */
+static uint hashu64(const void *k, void *unused)
+{
+  return thash_u64(*(const uint64_t *)k);
+}
+
+
+static void sumval(uint64_t *k, uint64_t *v, void *ctx)
+{
+  *(uint64_t *)ctx += *v;
+}
+
+
+static void mkstr(struct str16 *k, uint i)
+{
+  memset(k, 0, sizeof(*k));
+  sprintf(k->s, "key-%u", i);
+}
+
+
+/*
+ * Random inserts, overwrites and removals on a small table with lots of
+ * collisions against a plain array.  Tightly packed runs exercise the
+ * backward shift on removal.
+ */
+static void check(void)
+{
+  static struct u64map_slot slots[64];
+  static struct strmap_slot sslots[64];
+  struct u64map t;
+  struct strmap st;
+  uint64_t model[100], *vp, v, sum, msum;
+  uchar in[100];
+  struct str16 sk;
+  uint *svp, sv;
+  uint i, k, n;
+
+  u64map_init(&t, slots, 64);
+  strmap_init(&st, sslots, 64);
+  memset(in, 0, sizeof(in));
+  for (i = 0; i < NCHECK * 10; ++i) {
+    k = random() % 100;
+    mkstr(&sk, k);
+    if (random() % 2) {
+      v = random();
+      if (!in[k] && u64map_isfull(&t)) {
+        if (u64map_ins(&t, k * 64, v) != NULL ||
+            strmap_ins(&st, sk, (uint)v) != NULL)
+          err("insert into a full table succeeded\n");
+        continue;
+      }
+      vp = u64map_ins(&t, k * 64, v);
+      svp = strmap_ins(&st, sk, (uint)v);
+      if (vp == NULL || *vp != v || svp == NULL || *svp != (uint)v)
+        err("insert of %u failed\n", k);
+      in[k] = 1;
+      model[k] = v;
+    } else {
+      if (u64map_rem(&t, k * 64, &v) != in[k] ||
+          strmap_rem(&st, sk, &sv) != in[k])
+        err("remove of %u: wrong presence\n", k);
+      if (in[k] && (v != model[k] || sv != (uint)model[k]))
+        err("remove of %u: wrong value\n", k);
+      in[k] = 0;
+    }
+    for (k = 0, n = 0; k < 100; ++k) {
+      mkstr(&sk, k);
+      vp = u64map_lkup(&t, k * 64);
+      svp = strmap_lkup(&st, sk);
+      if ((vp != NULL) != in[k] || (svp != NULL) != in[k])
+        err("lookup of %u: wrong presence\n", k);
+      if (in[k] && (*vp != model[k] || *svp != (uint)model[k]))
+        err("lookup of %u: wrong value\n", k);
+      n += in[k];
+    }
+    if (n != u64map_count(&t) || n != strmap_count(&st))
+      err("count mismatch %u vs %u\n", n, u64map_count(&t));
+  }
+
+  sum = msum = 0;
+  u64map_apply(&t, sumval, &sum);
+  for (k = 0; k < 100; ++k)
+    if (in[k])
+      msum += model[k];
+  if (sum != msum)
+    err("apply visited the wrong values\n");
+
+  /* a full table of every small size must still answer for absent keys */
+  for (n = 2; n <= 8; n *= 2) {
+    u64map_init(&t, slots, n);
+    for (k = 0; !u64map_isfull(&t); ++k)
+      if (u64map_ins(&t, k, k) == NULL)
+        err("insert into a %u slot table failed early\n", n);
+    if (k >= n)
+      err("a %u slot table filled every slot\n", n);
+    if (u64map_lkup(&t, k) != NULL || u64map_rem(&t, k, NULL) ||
+        u64map_ins(&t, k, k) != NULL)
+      err("a full %u slot table misreports an absent key\n", n);
+  }
+  printf("Typed hash table checks passed\n");
+}
+
+
+static void time_u64(void)
+{
+  struct u64map t;
+  struct u64map_slot *slots;
+  struct htab ht;
+  struct hnode **bkts, *hn;
+  struct u64elem *elems;
+  struct timeval start, end;
+  uint i, h;
+  uint64_t sum = 0;
+
+  slots = malloc(NSLOTS * sizeof(*slots));
+  bkts = malloc(NBKTS * sizeof(*bkts));
+  elems = malloc(NTIME * sizeof(*elems));
+  if (!slots || !bkts || !elems)
+    err("out of memory\n");
+  u64map_init(&t, slots, NSLOTS);
+  ht_init(&ht, bkts, NBKTS, cmpu64, hashu64, NULL);
+
+  printf("uint64_t keys (%u):\n", NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    u64map_ins(&t, ukeys[i], i);
+  gettimeofday(&end, NULL);
+  printf("  typed insert: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    elems[i].key = ukeys[i];
+    elems[i].val = i;
+    ht_ninit(&elems[i].n, &elems[i].key);
+    if (ht_lkup(&ht, &elems[i].key, &h) == NULL)
+      ht_ins(&ht, &elems[i].n, h);
+  }
+  gettimeofday(&end, NULL);
+  printf("  htab insert:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += *u64map_lkup(&t, ukeys[NTIME - 1 - i]);
+  gettimeofday(&end, NULL);
+  printf("  typed lookup: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    hn = ht_lkup(&ht, &ukeys[NTIME - 1 - i], NULL);
+    sum += container(hn, struct u64elem, n)->val;
+  }
+  gettimeofday(&end, NULL);
+  printf("  htab lookup:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    u64map_rem(&t, ukeys[i], NULL);
+  gettimeofday(&end, NULL);
+  printf("  typed remove: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    ht_rem(ht_lkup(&ht, &ukeys[i], NULL));
+  gettimeofday(&end, NULL);
+  printf("  htab remove:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  if (u64map_count(&t) != 0 || sum != (uint64_t)NTIME * (NTIME - 1))
+    err("uint64_t timing runs gave wrong results\n");
+  free(slots);
+  free(bkts);
+  free(elems);
+}
+
+
+static void time_str(void)
+{
+  struct strmap t;
+  struct strmap_slot *slots;
+  struct htab ht;
+  struct hnode **bkts, *hn;
+  struct strelem *elems;
+  struct timeval start, end;
+  uint i, h;
+  ulong sum = 0;
+
+  slots = malloc(NSLOTS * sizeof(*slots));
+  bkts = malloc(NBKTS * sizeof(*bkts));
+  elems = malloc(NTIME * sizeof(*elems));
+  if (!slots || !bkts || !elems)
+    err("out of memory\n");
+  strmap_init(&t, slots, NSLOTS);
+  ht_init(&ht, bkts, NBKTS, cmp_str, ht_fshash, NULL);
+
+  printf("short string keys (%u):\n", NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    strmap_ins(&t, skeys[i], i);
+  gettimeofday(&end, NULL);
+  printf("  typed insert: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    memcpy(elems[i].key, skeys[i].s, sizeof(elems[i].key));
+    elems[i].val = i;
+    ht_ninit(&elems[i].n, elems[i].key);
+    if (ht_lkup(&ht, elems[i].key, &h) == NULL)
+      ht_ins(&ht, &elems[i].n, h);
+  }
+  gettimeofday(&end, NULL);
+  printf("  htab insert:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += *strmap_lkup(&t, skeys[NTIME - 1 - i]);
+  gettimeofday(&end, NULL);
+  printf("  typed lookup: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    hn = ht_lkup(&ht, skeys[NTIME - 1 - i].s, NULL);
+    sum += container(hn, struct strelem, n)->val;
+  }
+  gettimeofday(&end, NULL);
+  printf("  htab lookup:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    strmap_rem(&t, skeys[i], NULL);
+  gettimeofday(&end, NULL);
+  printf("  typed remove: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    ht_rem(ht_lkup(&ht, skeys[i].s, NULL));
+  gettimeofday(&end, NULL);
+  printf("  htab remove:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  if (strmap_count(&t) != 0 || sum != (ulong)NTIME * (NTIME - 1))
+    err("string timing runs gave wrong results\n");
+  free(slots);
+  free(bkts);
+  free(elems);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i, j, tmp, *perm;
+
+  check();
+
+  ukeys = malloc(NTIME * sizeof(*ukeys));
+  skeys = malloc(NTIME * sizeof(*skeys));
+  perm = malloc(NTIME * sizeof(*perm));
+  if (!ukeys || !skeys || !perm)
+    err("out of memory\n");
+  /* unique keys in random order */
+  for (i = 0; i < NTIME; ++i)
+    perm[i] = i;
+  for (i = NTIME - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    tmp = perm[i];
+    perm[i] = perm[j];
+    perm[j] = tmp;
+  }
+  for (i = 0; i < NTIME; ++i) {
+    ukeys[i] = (uint64_t)perm[i] * 0x9E3779B97F4A7C15ull;
+    mkstr(&skeys[i], perm[i]);
+  }
+  free(perm);
+
+  time_u64();
+  time_str();
+  free(ukeys);
+  free(skeys);
+  return 0;
+}
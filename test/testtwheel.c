@@ -0,0 +1,236 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/dlist.h>
+#include <cat/twheel.h>
+#include <cat/uevent.h>
+#include <cat/stduse.h>
+
+#define NCHECK		4000
+#define MAXTTL		(1ul << 20)
+#define NTIME		(1024 * 1024)
+#define NDL		(16 * 1024)
+
+struct timer {
+  struct twnode tn;
+  ulong expire;
+  int live;
+};
+
+struct timer *timers;
+ulong *ttls;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+/*
+ * Expire the timers in 'l' checking that they came due between 'from' (the
+ * time before the wheel advanced) and the new time.
+ */
+static uint expire(struct twheel *tw, struct list *l, ulong from, ulong slack)
+{
+  struct list *le;
+  struct timer *t;
+  uint n = 0;
+
+  while ((le = l_deq(l)) != NULL) {
+    t = container(l_to_twn(le), struct timer, tn);
+    if (!t->live)
+      err("expired a timer that is not running\n");
+    if (t->expire > tw_now(tw) || t->expire + slack < from)
+      err("timer for %lu expired at %lu\n", t->expire, tw_now(tw));
+    t->live = 0;
+    ++n;
+  }
+  return n;
+}
+
+
+/*
+ * Random adds and cancels while advancing the wheel by random amounts.
+ * Each timer must expire on its tick (or within the slack) and tw_next()
+ * must never skip past one.
+ */
+static void check(ulong slack)
+{
+  struct twheel tw;
+  struct timer *t;
+  struct list l;
+  ulong ttl, next, adv, from;
+  uint i, live = 0;
+
+  tw_init(&tw, random(), slack);
+  l_init(&l);
+  for (i = 0; i < NCHECK * 50; ++i) {
+    t = &timers[random() % NCHECK];
+    switch (random() % 4) {
+    case 0:
+    case 1:
+      if (t->live)
+        break;
+      /* mostly short timers with some beyond the range of the wheel */
+      ttl = random() % ((random() % 8 == 0) ? TW_MAXTTL * 2 : 512);
+      tw_ninit(&t->tn);
+      tw_add(&tw, &t->tn, ttl);
+      t->expire = tw_now(&tw) + ttl;
+      t->live = 1;
+      ++live;
+      break;
+    case 2:
+      if (!t->live)
+        break;
+      tw_rem(&t->tn);
+      t->live = 0;
+      --live;
+      break;
+    default:
+      next = tw_next(&tw);
+      if (live == 0 && next != TW_NONE)
+        err("tw_next() on an empty wheel returned %lu\n", next);
+      if (next == TW_NONE)
+        break;
+      adv = random() % (next + 2);
+      from = tw_now(&tw);
+      tw_adv(&tw, adv, &l);
+      if (adv < next && !l_isempty(&l))
+        err("timers expired before tw_next() said they would\n");
+      live -= expire(&tw, &l, from, slack);
+      break;
+    }
+    if (tw_count(&tw) != live)
+      err("wheel holds %lu timers instead of %u\n", tw_count(&tw), live);
+  }
+
+  /* run the wheel out */
+  while ((next = tw_next(&tw)) != TW_NONE) {
+    from = tw_now(&tw);
+    tw_adv(&tw, next, &l);
+    live -= expire(&tw, &l, from, slack);
+  }
+  if (live != 0)
+    err("%u timers never expired\n", live);
+  printf("Timer wheel checks passed with slack %lu\n", slack);
+}
+
+
+static int nullcb(void *arg, struct callback *cb)
+{
+  return 0;
+}
+
+
+static void timeit(void)
+{
+  struct twheel tw;
+  struct dlist dl, *dln;
+  struct uemux mux;
+  struct ue_timer *uet;
+  struct timeval start, end;
+  struct list l;
+  ulong n;
+  uint i;
+
+  printf("Register + cancel of %u timers:\n", NTIME);
+
+  tw_init(&tw, 0, 0);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    tw_ninit(&timers[i].tn);
+    tw_add(&tw, &timers[i].tn, ttls[i]);
+  }
+  for (i = 0; i < NTIME; ++i)
+    tw_rem(&timers[i].tn);
+  gettimeofday(&end, NULL);
+  printf("  tw_add + tw_rem: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  uet = malloc(NTIME * sizeof(*uet));
+  if (!uet)
+    err("out of memory\n");
+  ue_init(&mux, &estdmm);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i) {
+    ue_tm_init(&uet[i], UE_TIMEOUT, ttls[i], nullcb, NULL);
+    ue_tm_reg(&mux, &uet[i]);
+  }
+  for (i = 0; i < NTIME; ++i)
+    ue_tm_cancel(&uet[i]);
+  gettimeofday(&end, NULL);
+  printf("  ue_tm_reg + ue_tm_cancel: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  ue_fini(&mux);
+  free(uet);
+
+  /* the delta list the wheel replaced is O(n) so use far fewer timers */
+  dln = malloc(NDL * sizeof(*dln));
+  if (!dln)
+    err("out of memory\n");
+  dl_init(&dl, tm_zero);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NDL; ++i) {
+    dl_init(&dln[i], tm_lset(ttls[i] / 1000, (ttls[i] % 1000) * 1000000));
+    dl_ins(&dl, &dln[i]);
+  }
+  for (i = 0; i < NDL; ++i)
+    dl_rem(&dln[i]);
+  gettimeofday(&end, NULL);
+  printf("  dl_ins + dl_rem (%u timers): roughly %f nsec per op\n", NDL,
+         tdiff(&start, &end) * 1000.0 / NDL);
+  free(dln);
+
+  /* register all then let them all expire */
+  tw_init(&tw, 0, 0);
+  l_init(&l);
+  for (i = 0; i < NTIME; ++i) {
+    tw_ninit(&timers[i].tn);
+    tw_add(&tw, &timers[i].tn, ttls[i]);
+  }
+  n = 0;
+  gettimeofday(&start, NULL);
+  while (tw_count(&tw) > 0) {
+    tw_adv(&tw, 1000, &l);
+    while (l_deq(&l) != NULL)
+      ++n;
+  }
+  gettimeofday(&end, NULL);
+  if (n != NTIME)
+    err("expired %lu timers instead of %u\n", n, NTIME);
+  printf("  expiry over %lu ticks: roughly %f nsec per timer\n",
+         tw_now(&tw), tdiff(&start, &end) * 1000.0 / NTIME);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i;
+
+  timers = calloc(NTIME, sizeof(*timers));
+  ttls = malloc(NTIME * sizeof(*ttls));
+  if (!timers || !ttls)
+    err("out of memory\n");
+
+  check(0);
+  memset(timers, 0, NCHECK * sizeof(*timers));
+  check(100);
+
+  for (i = 0; i < NTIME; ++i)
+    ttls[i] = random() % MAXTTL;
+  timeit();
+
+  free(timers);
+  free(ttls);
+  return 0;
+}
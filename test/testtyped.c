@@ -0,0 +1,335 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/avl.h>
+#include <cat/rbtree.h>
+#include <cat/heap.h>
+#include <cat/ttree.h>
+#include <cat/theap.h>
+
+#define NCHECK		3000
+#define NTIME		(1024 * 1024)
+#define NMAP		(64 * 1024)
+
+/* what a scheduler queues:  a deadline and the task it belongs to */
+struct event {
+  ulong when;
+  void *task;
+};
+
+#define CMPUL(a, b)	(((a) < (b)) ? -1 : (((a) > (b)) ? 1 : 0))
+#define CMPEV(a, b)	CMPUL((a).when, (b).when)
+
+TAVL_DEFINE(tavl, ulong, CMPUL)
+TRB_DEFINE(trb, ulong, CMPUL)
+THEAP_DEFINE(evq, struct event, CMPEV)
+
+struct anelem {
+  struct anode n;
+  ulong key;
+};
+
+struct rbelem {
+  struct rbnode n;
+  ulong key;
+};
+
+ulong *keys;
+
+
+static double tdiff(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         end->tv_usec - start->tv_usec;
+}
+
+
+static int cmpul(const void *a, const void *b)
+{
+  ulong x = *(const ulong *)a, y = *(const ulong *)b;
+  return CMPUL(x, y);
+}
+
+
+static int cmpev(const void *a, const void *b)
+{
+  return CMPEV(*(const struct event *)a, *(const struct event *)b);
+}
+
+
+/*
+ * Random inserts (with duplicates), removals and bound searches on the
+ * typed trees checked against a presence map and the generic functions.
+ * Then heap sorts with random removals from the middle.
+ */
+void check()
+{
+  static struct tavl_node an[NCHECK], *ap;
+  static struct trb_node rn[NCHECK], *rp;
+  static struct tavl_node adup;
+  static struct trb_node rdup;
+  static uchar in[NCHECK];
+  static struct event evs[NCHECK];
+  struct avltree at;
+  struct rbtree rt;
+  struct evq q;
+  struct event e;
+  ulong k, last;
+  uint i, n, cnt;
+
+  tavl_init(&at);
+  trb_init(&rt);
+  for (i = 0; i < NCHECK; ++i) {
+    tavl_ninit(&an[i], i * 2);
+    trb_ninit(&rn[i], i * 2);
+  }
+  for (i = 0; i < NCHECK * 4; ++i) {
+    n = random() % NCHECK;
+    if (random() % 3 != 0) {
+      if (in[n]) {
+        /* replacing a node hands back the old one */
+        tavl_ninit(&adup, n * 2);
+        trb_ninit(&rdup, n * 2);
+        if (tavl_ins(&at, &adup) != &an[n] || trb_ins(&rt, &rdup) != &rn[n])
+          err("replace of %u did not return the old node\n", n);
+        if (tavl_ins(&at, &an[n]) != &adup || trb_ins(&rt, &rn[n]) != &rdup)
+          err("replace back of %u did not return the old node\n", n);
+      } else {
+        if (tavl_ins(&at, &an[n]) != NULL || trb_ins(&rt, &rn[n]) != NULL)
+          err("insert of %u replaced a node\n", n);
+        in[n] = 1;
+      }
+    } else if (in[n]) {
+      tavl_rem(&an[n]);
+      trb_rem(&rn[n]);
+      in[n] = 0;
+    }
+    k = random() % (NCHECK * 2 + 2);
+    ap = tavl_lkup(&at, k);
+    rp = trb_lkup(&rt, k);
+    if ((ap != NULL) != (k % 2 == 0 && k / 2 < NCHECK && in[k / 2]) ||
+        (rp != NULL) != (ap != NULL))
+      err("lookup of %lu: wrong presence\n", k);
+    if (tavl_lbound(&at, k) != tavl_entry(avl_lbound(&at, &k)) ||
+        tavl_ubound(&at, k) != tavl_entry(avl_ubound(&at, &k)) ||
+        trb_lbound(&rt, k) != trb_entry(rb_lbound(&rt, &k)) ||
+        trb_ubound(&rt, k) != trb_entry(rb_ubound(&rt, &k)))
+      err("bound search for %lu disagrees with the generic one\n", k);
+  }
+  for (ap = tavl_min(&at), rp = trb_min(&rt), cnt = 0, i = 0; i < NCHECK; ++i) {
+    if (!in[i])
+      continue;
+    if (ap == NULL || ap->key != i * 2 || rp == NULL || rp->key != i * 2)
+      err("in-order walk missing %u\n", i * 2);
+    ap = tavl_next(ap);
+    rp = trb_next(rp);
+    ++cnt;
+  }
+  if (ap != NULL || rp != NULL)
+    err("in-order walk has extra nodes\n");
+
+  for (i = 0; i < NCHECK; ++i) {
+    evs[i].when = random() % 1000;
+    evs[i].task = &evs[i];
+  }
+  evq_init(&q, evs, NCHECK, NCHECK / 2, NULL);
+  for (i = NCHECK / 2; i < NCHECK; ++i)
+    if (evq_add(&q, evs[i], NULL) < 0)
+      err("heap add failed\n");
+  if (evq_add(&q, evs[0], NULL) == 0)
+    err("fixed size heap grew\n");
+  for (i = 0; i < NCHECK / 4; ++i)
+    evq_rem(&q, random() % q.fill, NULL);
+  last = 0;
+  n = 0;
+  while (evq_top(&q) != NULL) {
+    k = evq_top(&q)->when;
+    if (evq_extract(&q, &e) < 0 || e.when != k || k < last)
+      err("heap extracted %lu after %lu\n", k, last);
+    last = k;
+    ++n;
+  }
+  if (n != NCHECK - NCHECK / 4 || evq_extract(&q, NULL) == 0)
+    err("heap held %u elements\n", n);
+
+  printf("Typed tree and heap checks passed (%u nodes at the end)\n", cnt);
+}
+
+
+void timeit()
+{
+  struct avltree at, tat;
+  struct rbtree rt, trt;
+  struct anelem *ae;
+  struct rbelem *re;
+  struct tavl_node *tae;
+  struct trb_node *tre;
+  struct heap hp;
+  struct evq q;
+  struct event *evs, *ev, e;
+  void **elems;
+  struct timeval start, end;
+  ulong sum = 0, tsum = 0;
+  uint i;
+
+  ae = malloc(NMAP * sizeof(*ae));
+  re = malloc(NMAP * sizeof(*re));
+  tae = malloc(NMAP * sizeof(*tae));
+  tre = malloc(NMAP * sizeof(*tre));
+  evs = malloc(NTIME * sizeof(*evs));
+  elems = malloc(NTIME * sizeof(*elems));
+  if (!ae || !re || !tae || !tre || !evs || !elems)
+    err("out of memory\n");
+
+  avl_init(&at, cmpul);
+  rb_init(&rt, cmpul);
+  tavl_init(&tat);
+  trb_init(&trt);
+
+  printf("Integer keyed maps (%u keys, %u lookups):\n", NMAP, NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NMAP; ++i) {
+    ae[i].key = keys[i];
+    avl_ninit(&ae[i].n, &ae[i].key);
+    avl_ins(&at, &ae[i].n, NULL, 0);
+  }
+  gettimeofday(&end, NULL);
+  printf("  avl_ins:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NMAP);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NMAP; ++i) {
+    tavl_ninit(&tae[i], keys[i]);
+    tavl_ins(&tat, &tae[i]);
+  }
+  gettimeofday(&end, NULL);
+  printf("  tavl_ins: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NMAP);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += *(ulong *)avl_lkup(&at, &keys[(NTIME - 1 - i) % NMAP], NULL)->key;
+  gettimeofday(&end, NULL);
+  printf("  avl_lkup:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    tsum += tavl_lkup(&tat, keys[(NTIME - 1 - i) % NMAP])->key;
+  gettimeofday(&end, NULL);
+  printf("  tavl_lkup: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NMAP; ++i) {
+    re[i].key = keys[i];
+    rb_ninit(&re[i].n, &re[i].key);
+    rb_ins(&rt, &re[i].n, NULL, 0);
+  }
+  gettimeofday(&end, NULL);
+  printf("  rb_ins:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NMAP);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NMAP; ++i) {
+    trb_ninit(&tre[i], keys[i]);
+    trb_ins(&trt, &tre[i]);
+  }
+  gettimeofday(&end, NULL);
+  printf("  trb_ins: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NMAP);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    sum += *(ulong *)rb_lkup(&rt, &keys[(NTIME - 1 - i) % NMAP], NULL)->key;
+  gettimeofday(&end, NULL);
+  printf("  rb_lkup:  roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    tsum += trb_lkup(&trt, keys[(NTIME - 1 - i) % NMAP])->key;
+  gettimeofday(&end, NULL);
+  printf("  trb_lkup: roughly %f nsec per op\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  if (sum != tsum)
+    err("map timing runs gave wrong results\n");
+
+  printf("Priority queues (%u events):\n", NTIME);
+
+  for (i = 0; i < NTIME; ++i) {
+    evs[i].when = keys[i];
+    evs[i].task = &evs[i];
+  }
+  hp_init(&hp, elems, NTIME, 0, cmpev, NULL);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    hp_add(&hp, &evs[i], NULL);
+  sum = 0;
+  for (i = 0; i < NTIME; ++i) {
+    ev = hp_extract(&hp);
+    sum += ev->when;
+  }
+  gettimeofday(&end, NULL);
+  printf("  hp_add + hp_extract:   roughly %f nsec per element\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+
+  /* the heap sorts the events in place:  put them back in random order */
+  for (i = 0; i < NTIME; ++i)
+    evs[i].when = keys[i];
+  evq_init(&q, malloc(NTIME * sizeof(struct event)), NTIME, 0, NULL);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NTIME; ++i)
+    evq_add(&q, evs[i], NULL);
+  for (i = 0; i < NTIME; ++i) {
+    evq_extract(&q, &e);
+    sum -= e.when;
+  }
+  gettimeofday(&end, NULL);
+  printf("  evq_add + evq_extract: roughly %f nsec per element\n",
+         tdiff(&start, &end) * 1000.0 / NTIME);
+  if (sum != 0)
+    err("heap timing runs gave wrong results\n");
+
+  free(q.elem);
+  free(ae);
+  free(re);
+  free(tae);
+  free(tre);
+  free(evs);
+  free(elems);
+}
+
+
+int main(int argc, char *argv[])
+{
+  uint i, j;
+  ulong tmp;
+
+  check();
+
+  keys = malloc(NTIME * sizeof(*keys));
+  if (!keys)
+    err("out of memory\n");
+  for (i = 0; i < NTIME; ++i)
+    keys[i] = i;
+  for (i = NTIME - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+  timeit();
+  free(keys);
+  return 0;
+}
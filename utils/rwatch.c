@@ -0,0 +1,268 @@
+#include <cat/peg.h>
+#include <cat/cpg.h>
+#include <stdio.h>
+#include <string.h>
+#line 0 "rwatch.pp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <cat/err.h>
+#include <cat/emalloc.h>
+#include <cat/stduse.h>
+#include <cat/raw.h>
+#include <cat/list.h>
+#include <cat/pspawn.h>
+
+enum etype { STRING, INT, FLOAT, RATE };
+
+struct elem {
+	struct list ln;
+	int type;
+	char *str;
+	unsigned long rate;
+};
+#define ln2e(_l) container(_l, struct elem, ln)
+
+struct list before_elems;
+struct list after_elems;
+
+void add_elem(struct raw *s, void *ctx, int type)
+{
+	struct list *curlist = ctx;
+	struct elem *e = emalloc(sizeof(*e));
+
+	e->str = erawsdup(s);
+	e->type = type;
+	l_enq(curlist, &e->ln);
+}
+
+
+static int __cpeg_peg_action7(int __cpeg_node, struct raw *cpeg_text, void *cpeg_ctx)
+{ int cpeg_error = 0;
+#line 39 "rwatch.pp"
+{ add_elem(cpeg_text, cpeg_ctx, FLOAT); }
+return cpeg_error; }
+static int __cpeg_peg_action10(int __cpeg_node, struct raw *cpeg_text, void *cpeg_ctx)
+{ int cpeg_error = 0;
+#line 40 "rwatch.pp"
+{ add_elem(cpeg_text, cpeg_ctx, INT); }
+return cpeg_error; }
+static int __cpeg_peg_action13(int __cpeg_node, struct raw *cpeg_text, void *cpeg_ctx)
+{ int cpeg_error = 0;
+#line 41 "rwatch.pp"
+{ add_elem(cpeg_text, cpeg_ctx, STRING); }
+return cpeg_error; }
+struct peg_node __cpeg_peg_nodes[54] = {
+{ 4, {0, NULL}, -1, 4, 37, 1, 0, 0, NULL},
+{ 2, {0, NULL}, -1, 3, 37, 0, 0, 0, NULL},
+{ 4, {0, NULL}, -1, 14, 37, 2, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 2, 37, 0, 0, 4, NULL},
+{ 1, {0, NULL}, 1, 0, 37, 0, 0, 0, NULL},
+{ 2, {0, NULL}, 8, 7, 39, 0, 0, 0, NULL},
+{ 4, {0, NULL}, -1, 26, 39, 2, 0, 0, NULL},
+{ 3, {18, (byte_t *)"__cpeg_peg_action7"}, -1, 6, 39, 3, 0, 0, &__cpeg_peg_action7},
+{ 2, {0, NULL}, 11, 10, 40, 0, 0, 0, NULL},
+{ 4, {0, NULL}, -1, 45, 40, 2, 0, 0, NULL},
+{ 3, {19, (byte_t *)"__cpeg_peg_action10"}, -1, 9, 40, 3, 0, 0, &__cpeg_peg_action10},
+{ 2, {0, NULL}, -1, 13, 41, 0, 0, 0, NULL},
+{ 4, {0, NULL}, -1, 53, 41, 2, 0, 0, NULL},
+{ 3, {19, (byte_t *)"__cpeg_peg_action13"}, -1, 12, 41, 3, 0, 0, &__cpeg_peg_action13},
+{ 1, {0, NULL}, 5, 2, 39, 0, 0, 0, NULL},
+{ 2, {0, NULL}, -1, 17, 43, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xfe\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 43, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 19, 16, 43, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xff\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 43, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 21, 18, 43, 0, 0, 4, NULL},
+{ 5, {1, (byte_t *)"."}, -1, -1, 43, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 23, 20, 43, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xfe\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 43, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 25, 22, 43, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xff\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 43, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 24, 43, 0, 0, 4, NULL},
+{ 1, {0, NULL}, 15, 6, 43, 0, 0, 0, NULL},
+{ 2, {0, NULL}, 32, 29, 44, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xfe\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 31, 28, 44, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xff\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 30, 44, 0, 0, 4, NULL},
+{ 2, {0, NULL}, 37, 34, 44, 0, 0, 0, NULL},
+{ 5, {2, (byte_t *)"0x"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 36, 33, 44, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xff\x03~\x00\x00\x00~\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 35, 44, 0, 0, 5, NULL},
+{ 2, {0, NULL}, 42, 39, 44, 0, 0, 0, NULL},
+{ 5, {1, (byte_t *)"0"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 41, 38, 44, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xff\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 40, 44, 0, 0, 5, NULL},
+{ 2, {0, NULL}, -1, 44, 44, 0, 0, 0, NULL},
+{ 5, {1, (byte_t *)"0"}, -1, -1, 44, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 43, 44, 0, 0, 0, NULL},
+{ 1, {0, NULL}, 27, 9, 44, 0, 0, 0, NULL},
+{ 2, {0, NULL}, -1, 52, 45, 0, 0, 0, NULL},
+{ 2, {0, NULL}, -1, 49, 45, 0, 0, 0, NULL},
+{ 6, {32, (byte_t *)"\x00\x00\x00\x00\x00\x00\xff\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"}, -1, -1, 45, 0, 0, 0, NULL},
+{ 3, {0, NULL}, 51, 48, 45, 0, 2, 0, NULL},
+{ 6, {32, (byte_t *)"\xfe\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"}, -1, -1, 45, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 50, 45, 0, 0, 0, NULL},
+{ 3, {0, NULL}, -1, 47, 45, 0, 0, 5, NULL},
+{ 1, {0, NULL}, 46, 12, 45, 0, 0, 0, NULL},
+};
+static struct peg_grammar __cpeg_peg_grammar = {
+	__cpeg_peg_nodes,
+	54,
+	54,
+	0,
+	0,
+	0,
+};
+
+struct cpeg_parser {
+	struct cpg_state pstate;
+};
+
+int cpeg_init(struct cpeg_parser *p, int (*getc)(void *));
+
+int cpeg_parse(struct cpeg_parser *p, void *in, void *aux);
+
+void cpeg_reset(struct cpeg_parser *p);
+
+void cpeg_fini(struct cpeg_parser *p);
+
+static int __cpeg_getc(void *fp) { return fgetc(fp); }
+
+int cpeg_init(struct cpeg_parser *p, int (*getc)(void *)) {
+  if (getc == NULL) getc = &__cpeg_getc;
+  return cpg_init(&p->pstate, &__cpeg_peg_grammar, getc);
+}
+
+int cpeg_parse(struct cpeg_parser *p, void *in, void *aux) {
+  return cpg_parse(&p->pstate, in, aux);
+}
+
+void cpeg_reset(struct cpeg_parser *p) {
+  cpg_reset(&p->pstate);
+}
+
+void cpeg_fini(struct cpeg_parser *p) {
+  cpg_fini(&p->pstate);
+}
+
+#line 48 "rwatch.pp"
+
+
+uint duration = 10;
+extern char **environ;
+
+
+void parse_cmd_out(char **argv, struct list *linelist)
+{
+	struct pspawn *ps;
+	struct cpeg_parser parser;
+
+	l_init(linelist);
+	cpeg_init(&parser, NULL);
+	ps = ps_spawn_x("1+2", argv, environ);
+	if ( ps == NULL )
+		errsys("error running command: ");
+	if ( cpeg_parse(&parser, ps_get_locfile(ps, 1), linelist) < 0 )
+		err("Error parsing input from command\n");
+	cpeg_fini(&parser);
+	ps_cleanup(ps, 1);
+}
+
+
+int get_rate(struct elem *be, struct elem *ae)
+{
+	if ( be->type != ae->type )
+		return -1;
+	if ( strcmp(be->str, ae->str) == 0 )
+		return 0;
+	if ( be->type == INT ) {
+		unsigned long bv, av;
+		sscanf(be->str, "%lu", &bv);
+		sscanf(ae->str, "%lu", &av);
+		ae->rate = (av - bv) / duration;
+		ae->type = RATE;
+	} else if ( be->type == FLOAT ) {
+		double bv, av;
+		sscanf(be->str, "%lf", &bv);
+		sscanf(ae->str, "%lf", &av);
+		ae->rate = (av - bv) / duration;
+		ae->type = RATE;
+	}
+	return 0;
+}
+
+
+void get_rates(struct list *blist, struct list *alist)
+{
+	struct list *bln, *aln;
+	struct elem *be, *ae;
+
+	bln = l_head(blist);
+	l_for_each( aln, alist ) {
+		if ( bln == l_end(blist) )
+			break;
+		if ( get_rate(ln2e(bln), ln2e(aln)) < 0 )
+			break;
+		bln = l_next(bln);
+	}
+}
+
+
+void print_rates(struct list *alist)
+{
+	struct list *aln;
+	struct elem *e;
+
+	l_for_each( aln, alist ) {
+		e = ln2e(aln);
+		if ( e->type == RATE )
+			printf("(%lu / sec)", e->rate);
+		else
+			fputs(e->str, stdout);
+	}
+}
+
+
+void usage(char *prog)
+{
+	err("usage: %s [-d duration] command arg1 arg2...\n", prog);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i = 2;
+	int arg = 1;
+	char **cmd;
+	char *cp;
+
+	if ( argc < 2 || strcmp(argv[1], "-h") == 0 )
+		usage(argv[0]);
+
+	if ( strcmp(argv[1], "-d") == 0 ) {
+		if ( argc < 4 )
+			usage(argv[0]);
+		duration = strtoul(argv[2], &cp, 0);
+		if ( cp == argv[2] || *cp != '\0' )
+			usage(argv[0]);
+		arg = 3;
+	}
+
+	cmd = emalloc(sizeof(char *) * (argc + 2));
+	cmd[0] = "/bin/sh";
+	cmd[1] = "-c";
+	while ( (cmd[i++] = argv[arg++]) != NULL ) ; 
+
+	ps_ignore_sigcld();
+	parse_cmd_out(cmd, &before_elems);
+	sleep(duration);
+	parse_cmd_out(cmd, &after_elems);
+
+	get_rates(&before_elems, &after_elems);
+	print_rates(&after_elems);
+
+	return 0;
+}